@@ -53,17 +53,7 @@ std::vector<CvRect> DetectFaces(IplImage* img, FDBuf *fdBuf)
 	};
   */
 
-	/*
-	static IplImage *img = cvCreateImage( cvSize(imgIn->width,imgIn->height), IPL_DEPTH_8U, imgIn->nChannels );		
-	if( imgIn->origin == IPL_ORIGIN_TL )
-		cvCopy( imgIn, img, 0 );
-	else
-		cvFlip( imgIn, img, 0 );
-	*/
-	
-
 	Int i;
-	IplImage *gray;
 	
 	int MinSize = fdBuf->FD_MinFaceSize;
 
@@ -71,27 +61,25 @@ std::vector<CvRect> DetectFaces(IplImage* img, FDBuf *fdBuf)
 	MyRect mr;
 	bool valid;
 
-	gray = cvCreateImage( cvSize(img->width,img->height), 8, 1 );
-	cvCvtColor( img, gray, CV_BGR2GRAY );
-	cvEqualizeHist( gray, gray );
-	cvClearMemStorage(fdBuf->storage);
+	// grey, equalised, and its pyramid are kept between frames
+	haarpyramid_set_frame( fdBuf->pyramid, img, CV_BGR2GRAY, 1 );
 
 	vector<CvRect> faceVec;
 
 	if( fdBuf->cascade )
 	{
 		Double t = ( Double ) cvGetTickCount();
-		CvSeq* faces;
+		int nfaces;
 
-		faces = cvHaarDetectObjects( gray, fdBuf->cascade, fdBuf->storage,
-			1.1, 2, 0/*CV_HAAR_DO_CANNY_PRUNING*/, cvSize(MinSize, MinSize) );
+		nfaces = haarpyramid_detect( fdBuf->pyramid, fdBuf->cascade,
+			2, cvSize(MinSize, MinSize), cvSize(0, 0) );
 
 		t = ( Double )cvGetTickCount() - t;
 		//printf( "detection time = %gms\n", t/(( Double )cvGetTickFrequency()*1000.) );
 
-		for( i = 0; i < (faces ? faces->total : 0); i++ )
+		for( i = 0; i < nfaces; i++ )
 		{
-			CvRect* r = (CvRect*)cvGetSeqElem( faces, i );
+			CvRect* r = &fdBuf->pyramid->scan.objects[i];
 			
 			UInt faceX = cvRound(r->x);
 			UInt faceY = cvRound(r->y);
@@ -130,7 +118,6 @@ std::vector<CvRect> DetectFaces(IplImage* img, FDBuf *fdBuf)
 	}
 	*/
 	
-	cvReleaseImage( &gray );
 	fdBuf->h.UpdateTime();
 	//cvWaitKey(1);
 
@@ -168,7 +155,7 @@ extern "C" void *InitFaceDetector2(char *cascade_name, int minfacesize)
     fprintf( stderr, "Classifier cascade loaded successfully\n" );
   }
   
-  fdBuf->storage = cvCreateMemStorage(0);
+  fdBuf->pyramid = haarpyramid_create(1.1);
   
   fdBuf->smoothingFilter = new SmoothingFilter();
   
@@ -181,7 +168,7 @@ extern "C" void ReleaseFaceDetector(void *buf)
 
         if(fdBuf->smoothingFilter)
           delete fdBuf->smoothingFilter;
-	cvReleaseMemStorage(&(fdBuf->storage));
+	haarpyramid_destroy(fdBuf->pyramid);
 
 	delete fdBuf;
 }
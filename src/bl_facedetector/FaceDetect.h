@@ -7,6 +7,7 @@
 #include "highgui.h"
 #include "SmoothingFilter.h"
 #include "history.h"
+#include "../opencv/haarpyramid.h"
 #include <stdlib.h>
 #include <vector>
 #include <string>
@@ -14,8 +15,8 @@
 
 struct FDBuf
 {
-	CvMemStorage			*storage;
 	CvHaarClassifierCascade *cascade;
+	t_haarpyramid			*pyramid;
 	int						FD_MinFaceSize;
 	SmoothingFilter			*smoothingFilter;
 	History					h;
@@ -115,7 +115,8 @@ gst_facedetectorV3_finalize (GObject * object)
 {
   GstFaceDetectorV3 *facedetectorV3 = GST_FACEDETECTORV3 (object);
 
-  //cvReleaseImage(&img);
+  if (facedetectorV3->img)
+    cvReleaseImage(&facedetectorV3->img);
   ReleaseFaceDetector(facedetectorV3->fdBuf); 
   
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -204,6 +205,7 @@ gst_facedetectorV3_init (GstFaceDetectorV3 * facedetectorV3, GstFaceDetectorV3Cl
   facedetectorV3->drawbox = DEFAULT_DRAWBOX;
   facedetectorV3->classifier_filename = classifier_file;
   facedetectorV3->min_face_size = DEFAULT_MIN_FACE_SIZE;
+  facedetectorV3->img = NULL;
 
  
 }
@@ -234,7 +236,8 @@ gst_facedetectorV3_chain (GstPad * pad, GstBuffer * buf)
   GstFlowReturn ret = GST_FLOW_OK;
   GstBuffer *output_video_buf = NULL;
   gint width, height;	
-  IplImage *img = 0;
+  IplImage *img;
+  guint size;
   char *str;
   //static int detector_lib_initialized = 0;
   GstClock *element_clock;
@@ -261,9 +264,18 @@ gst_facedetectorV3_chain (GstPad * pad, GstBuffer * buf)
   GST_DEBUG(" stream is %dx%d\r\n", width, height);
  
   //////////////////////////////////////////////////////////////////////////////
-  img = cvCreateImage(cvSize(width,height), IPL_DEPTH_8U, IMAGE_NUM_CHANNELS);
+  // kept between frames, only reallocated if the caps changed the size
+  img = facedetectorV3->img;
+  if (!img || img->width != width || img->height != height) {
+    if (img)
+      cvReleaseImage(&facedetectorV3->img);
+    img = facedetectorV3->img = cvCreateImage(cvSize(width,height), IPL_DEPTH_8U, IMAGE_NUM_CHANNELS);
+  }
   
-  memcpy(img->imageData, GST_BUFFER_DATA(buf), width*height*IMAGE_NUM_CHANNELS);
+  // never more than the buffer or the image hold
+  size = MIN((guint)(width*height*IMAGE_NUM_CHANNELS), (guint)img->imageSize);
+  size = MIN(size, GST_BUFFER_SIZE(buf));
+  memcpy(img->imageData, GST_BUFFER_DATA(buf), size);
   //memcpy(img->imageData, GST_BUFFER_DATA(buf), GST_BUFFER_SIZE(buf) );
 
   str = DetectFacesV2(img,facedetectorV3->fdBuf);
@@ -273,8 +285,7 @@ gst_facedetectorV3_chain (GstPad * pad, GstBuffer * buf)
   //Create output_video_buf and copy video data into it.
   output_video_buf = gst_buffer_copy(buf); //This creates output_video_buf as a copy of buf. Original image data is copied as well - that's a waste of time.
   gst_buffer_copy_metadata(output_video_buf, buf, (GstBufferCopyFlags)GST_BUFFER_COPY_ALL); 
-  // todo: this is segment violation... use size of buffer?
-  memcpy(GST_BUFFER_DATA(output_video_buf), img->imageData, width*height*IMAGE_NUM_CHANNELS);
+  memcpy(GST_BUFFER_DATA(output_video_buf), img->imageData, MIN(size, GST_BUFFER_SIZE(output_video_buf)));
  
 
   //We need to stamp the output buffer with a timestamp and copy that timestamp into the posted message so that 
@@ -343,7 +354,6 @@ gst_facedetectorV3_chain (GstPad * pad, GstBuffer * buf)
   free(str);
   gst_buffer_unref (buf);
   gst_object_unref (facedetectorV3);
-  cvReleaseImage(&img);
 
   return ret;
 }
@@ -74,6 +74,7 @@ struct _GstFaceDetectorV3
 
   int init;
   void *fdBuf; //pointer returned by facedetectInit();
+  struct _IplImage *img; //frame handed to the detector, reallocated only if the size changes
 };
 
 struct _GstFaceDetectorV3Class
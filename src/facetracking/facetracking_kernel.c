@@ -5,6 +5,7 @@
  #                                                                      #
  ######################################################################*/
 #include "facetracking_kernel.h"
+#include "../opencv/mtxfixed.h"
 
 
 /*#######################################################################
@@ -12,6 +13,9 @@
  # DEFINES, MACROS                                                      #
  #                                                                      #
  ######################################################################*/
+// sizes of the filter built by facetracking_init()
+#define KALMAN_DP 6
+#define KALMAN_MP 4
 
 /*#######################################################################
  #                                                                      #
@@ -48,6 +52,12 @@
 struct bbox_int iterate_kalman( struct kernel_internal_state* kernel, 
                                 struct bbox_double* meas, 
                                 int nobjects);
+static guint32 run_cascade( GstFacetracker3 *facetracker3, int which, 
+                            struct bbox_double* p);
+static guint32 fuse_detections( const guint32 *n, const struct bbox_double* found,
+                                struct bbox_double* p);
+static const CvMat* kalman_predict( CvKalman* k );
+static void kalman_correct( CvKalman* k, const CvMat* z );
 
 /*#######################################################################
  #                                                                      #
@@ -58,65 +68,61 @@ struct bbox_int iterate_kalman( struct kernel_internal_state* kernel,
 ////////////////////////////////////////////////////////////////////////////////
 int facetracking_kernel(GstFacetracker3 *facetracker3)
 {
-  struct bbox_double p, p2;
-  guint32  ntorsos, nfaces, nsidefaces, trackingonwhat;
-
-  CvScalar colour=RED; trackingonwhat=0;
-  ntorsos = nfaces = nsidefaces = 0;
+  struct bbox_double p, found[FACETRACKER3_NCASCADES];
+  guint32  n[FACETRACKER3_NCASCADES] = { 0 };
+  guint32  trackingonwhat;
+  int i;
 
   // algorithmic idea: we detect the face. No face detected -> torso. 
   // If a face is detected, we run the profile classifier. If this detects sth
   // different than the normal face by over N pixels, we prefer this.
   // The chosen bbox goes into a kalman to smooth out the nonsenses.
 
-  haarwrapper_detect( facetracker3->hc, facetracker3->image_rgb, &p, &nfaces ); 
-  //  p --> "raw" haar detection output, if nfaces > 0
-  if( nfaces>0 ) {colour=GREEN; trackingonwhat=1;}
-
-  //// now try and find a sidewards looking face.
-  //haarwrapper_detect( facetracker3->hc3, facetracker3->image_rgb, &p2, &nsidefaces ); 
-  //
-  //if( nsidefaces > 0 ){
-  //  // if the distance between them is larger than X, prefer the sidewards
-  //  if( (abs(p2.x - p.x) + abs(p2.y - p.y)) > 25.0 ){
-  //    colour=BLUE; trackingonwhat=2;
-  //    memcpy( &p, &p2, sizeof(struct bbox_double));
-  //  }    
-  //}
-  //else{ // flip vertically the image and try again.
-  //  haarwrapper_flip( facetracker3->hc3, facetracker3->image_rgb, facetracker3->image_rgb2 );
-  //  haarwrapper_detect( facetracker3->hc3, facetracker3->image_rgb2, &p2, &nsidefaces ); 
-  //  if( nsidefaces > 0 )
-  //    // if the distance between them is larger than X, prefer the sidewards
-  //    if( (abs(p2.x - p.x) + abs(p2.y - p.y)) > 25.0 ){
-  //      colour=PURPLE; trackingonwhat=3;
-  //      memcpy( &p, &p2, sizeof(struct bbox_double));
-  //    }    
-  //}
-
-  if( ( nfaces == 0 ) ){//& ( nsidefaces == 0 )){
-    
+  // grey frame and pyramid built once, for all the cascades below
+  guint64 t = stageprof_start( facetracker3->prof );
+  haarpyramid_set_frame( facetracker3->pyramid, facetracker3->cvBGR, CV_BGR2GRAY, 0 );
+  stageprof_stop( facetracker3->prof, STAGEPROF_CONVERT, t );
+
+  t = stageprof_start( facetracker3->prof );
+
+  if( facetracker3->parallel ){
+    // all the cascades, profile ones included, every frame: the levels they
+    // share are built first, then each one scans them on a thread of its own
+    haarwrapper_prepare_pyramid( facetracker3->hc, facetracker3->pyramid );
+    if( facetracker3->hc2 ) haarwrapper_prepare_pyramid( facetracker3->hc2, facetracker3->pyramid );
+    if( facetracker3->hc3 ) haarwrapper_prepare_pyramid( facetracker3->hc3, facetracker3->pyramid );
+
+    #pragma omp parallel for num_threads(facetracker3->cascade_threads) schedule(dynamic, 1)
+    for( i = 0; i < FACETRACKER3_NCASCADES; i++ )
+      n[i] = run_cascade( facetracker3, i, &found[i] );
+  }
+  else{
+    n[FACETRACKER3_FACE] = run_cascade( facetracker3, FACETRACKER3_FACE, &found[FACETRACKER3_FACE] );
     // no face -> track torso
-    if( facetracker3->hc2 ){
-      haarwrapper_detect( facetracker3->hc2, facetracker3->image_rgb, &p, &ntorsos ); 
-      if( ntorsos > 0 ){
-        p.x  = (p.x + (p.w/2)) - (0.35 *(p.w/2)) ;
-        p.y  = (p.y + (p.h/2)) - (0.525*(p.w/2)) ;
-        p.w *= 0.35;
-        p.h *= 0.40;
-        colour = YELLOW; trackingonwhat=4;
-      }
-    }
+    if( n[FACETRACKER3_FACE] == 0 )
+      n[FACETRACKER3_TORSO] = run_cascade( facetracker3, FACETRACKER3_TORSO, &found[FACETRACKER3_TORSO] );
   }
 
-  if( (nfaces>0) || (nsidefaces>0) || (ntorsos>0)){
+  trackingonwhat = fuse_detections( n, found, &p );
+  stageprof_stop( facetracker3->prof, STAGEPROF_DETECT, t );
+
+  CvScalar colour = RED;
+  if( 1 == trackingonwhat )       colour = GREEN;
+  else if( 2 == trackingonwhat )  colour = BLUE;
+  else if( 3 == trackingonwhat )  colour = PURPLE;
+  else if( 4 == trackingonwhat )  colour = YELLOW;
+
+  if( trackingonwhat > 0 ){
+    t = stageprof_start( facetracker3->prof );
     struct bbox_int k_face = iterate_kalman( facetracker3->facek, &p, 1);
     memcpy( facetracker3->face, &k_face, sizeof( struct bbox_int ));
+    stageprof_stop( facetracker3->prof, STAGEPROF_TRACK, t );
   }
   else{
     //bbox_double_to_int( facetracker3->face, &p );
   }
 
+  t = stageprof_start( facetracker3->prof );
   haarwrapper_drawbox( facetracker3->cvBGR, facetracker3->face , colour);
   if( 0 == trackingonwhat )
     haarwrapper_drawtext(facetracker3->cvBGR, facetracker3->face , colour, (char*)"tracking"); 
@@ -128,6 +134,7 @@ int facetracking_kernel(GstFacetracker3 *facetracker3)
     haarwrapper_drawtext(facetracker3->cvBGR, facetracker3->face , colour, (char*)"profile2"); 
   else if( 4 == trackingonwhat )
     haarwrapper_drawtext(facetracker3->cvBGR, facetracker3->face , colour, (char*)"torso"); 
+  stageprof_stop( facetracker3->prof, STAGEPROF_DRAW, t );
 
 //  //////////////////////////////////////////////////////////////////////////////
 //  //////////////////////////////////////////////////////////////////////////////
@@ -312,7 +319,7 @@ struct bbox_int iterate_kalman( struct kernel_internal_state* kernel, struct bbo
 
   //////////////////////////////////////////////////////////////////////////////
   // Kalman predict
-  const CvMat* y_k = cvKalmanPredict( kernel->k , NULL );
+  const CvMat* y_k = kalman_predict( kernel->k );
  
   //////////////////////////////////////////////////////////////////////////////
   if( nobjects > 0 ){
@@ -327,7 +334,7 @@ struct bbox_int iterate_kalman( struct kernel_internal_state* kernel, struct bbo
     //cvMatMulAdd( kernel->H, kernel->x_k, kernel->z_k, kernel->z_k );
    
     // Adjust kalman filter state
-    cvKalmanCorrect( kernel->k, kernel->z_k );
+    kalman_correct( kernel->k, kernel->z_k );
   }
   else{
     // if there is no meas, best is to input nothing to kalman correction step
@@ -354,5 +361,156 @@ struct bbox_int iterate_kalman( struct kernel_internal_state* kernel, struct bbo
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// one of the FACETRACKER3_* cascades on the current frame, timed. Different
+// cascades can run concurrently once their pyramid levels are prepared: each
+// one has its cascade and scan output, and the mirrored profile its pyramid.
+static guint32 run_cascade( GstFacetracker3 *facetracker3, int which, struct bbox_double* p)
+{
+  const int64 t0 = cvGetTickCount();
+  guint32 n = 0;
+
+  switch( which ){
+  case FACETRACKER3_FACE:
+    haarwrapper_detect_pyramid( facetracker3->hc, facetracker3->pyramid, p, &n );
+    break;
+  case FACETRACKER3_PROFILE:
+    if( facetracker3->hc3 )
+      haarwrapper_detect_pyramid( facetracker3->hc3, facetracker3->pyramid, p, &n );
+    break;
+  case FACETRACKER3_PROFILE_MIRROR:
+    // the profile cascade only knows one side: flip the frame and try again
+    if( facetracker3->hc3_mirror ){
+      cvFlip( facetracker3->cvBGR, facetracker3->cvBGR_mirror, 1 );
+      haarpyramid_set_frame( facetracker3->pyramid_mirror, facetracker3->cvBGR_mirror, CV_BGR2GRAY, 0 );
+      if( haarwrapper_detect_pyramid( facetracker3->hc3_mirror, facetracker3->pyramid_mirror, p, &n ) )
+        p->x = facetracker3->width - p->x - p->w;
+    }
+    break;
+  case FACETRACKER3_TORSO:
+    if( facetracker3->hc2 )
+      haarwrapper_detect_pyramid( facetracker3->hc2, facetracker3->pyramid, p, &n );
+    break;
+  }
+
+  const double ms = (cvGetTickCount() - t0) / (cvGetTickFrequency() * 1000.0);
+  facetracker3->cascade_ms[which] = 0.9 * facetracker3->cascade_ms[which] + 0.1 * ms;
+  return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// the face; a profile instead if it is over 25 pixels away from it (or there is
+// no face); the torso, shrunk to where its face should be, if there is neither.
+// Returns what is tracked, 0 for nothing, 1 face, 2 profile, 3 mirrored
+// profile, 4 torso, with its bbox in p.
+static guint32 fuse_detections( const guint32 *n, const struct bbox_double* found, struct bbox_double* p)
+{
+  const struct bbox_double* face = &found[FACETRACKER3_FACE];
+  guint32 trackingonwhat = 0;
+
+  if( n[FACETRACKER3_FACE] > 0 ){
+    memcpy( p, face, sizeof(struct bbox_double));
+    trackingonwhat = 1;
+  }
+
+  for( int i = FACETRACKER3_PROFILE; i <= FACETRACKER3_PROFILE_MIRROR; i++ ){
+    const struct bbox_double* side = &found[i];
+    if( n[i] == 0 )
+      continue;
+    if( n[FACETRACKER3_FACE] == 0 || (fabs(side->x - face->x) + fabs(side->y - face->y)) > 25.0 ){
+      memcpy( p, side, sizeof(struct bbox_double));
+      trackingonwhat = (i == FACETRACKER3_PROFILE) ? 2 : 3;
+      break;
+    }
+  }
+
+  if( trackingonwhat == 0 && n[FACETRACKER3_TORSO] > 0 ){
+    const struct bbox_double* t = &found[FACETRACKER3_TORSO];
+    p->x = (t->x + (t->w/2)) - (0.35 *(t->w/2)) ;
+    p->y = (t->y + (t->h/2)) - (0.525*(t->w/2)) ;
+    p->w = t->w * 0.35;
+    p->h = t->h * 0.40;
+    trackingonwhat = 4;
+  }
+  return trackingonwhat;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+// cvKalmanPredict() and cvKalmanCorrect(), on the same CvKalman matrices, with
+// the sizes of our filter fixed: no generic GEMMs, and the 4x4 innovation is
+// inverted by Cholesky instead of solved by SVD. Any other filter goes to OpenCV.
+static bool kalman_is_fixed( const CvKalman* k )
+{
+  return k->DP == KALMAN_DP && k->MP == KALMAN_MP && k->CP == 0 &&
+    CV_MAT_TYPE(k->transition_matrix->type) == CV_32FC1 && CV_IS_MAT_CONT(k->transition_matrix->type) &&
+    CV_MAT_TYPE(k->measurement_matrix->type) == CV_32FC1 && CV_IS_MAT_CONT(k->measurement_matrix->type) &&
+    CV_MAT_TYPE(k->process_noise_cov->type) == CV_32FC1 && CV_IS_MAT_CONT(k->process_noise_cov->type) &&
+    CV_MAT_TYPE(k->measurement_noise_cov->type) == CV_32FC1 && CV_IS_MAT_CONT(k->measurement_noise_cov->type) &&
+    CV_MAT_TYPE(k->error_cov_post->type) == CV_32FC1 && CV_IS_MAT_CONT(k->error_cov_post->type);
+}
+
+static const CvMat* kalman_predict( CvKalman* k )
+{
+  if( !kalman_is_fixed( k ) )
+    return cvKalmanPredict( k, NULL );
+
+  const float* F = k->transition_matrix->data.fl;
+  float FP[KALMAN_DP*KALMAN_DP];
+
+  // x'(k) = F.x(k), P'(k) = F.P(k).F' + Q
+  mtxf_multiply<KALMAN_DP,KALMAN_DP,1>( k->state_pre->data.fl, F, k->state_post->data.fl );
+  mtxf_multiply<KALMAN_DP,KALMAN_DP,KALMAN_DP>( FP, F, k->error_cov_post->data.fl );
+  mtxf_multiply_ct<KALMAN_DP,KALMAN_DP,KALMAN_DP>( k->error_cov_pre->data.fl, FP, F );
+  mtxf_add<KALMAN_DP*KALMAN_DP>( k->error_cov_pre->data.fl, k->error_cov_pre->data.fl, k->process_noise_cov->data.fl );
+
+  // as OpenCV, for a measurement before the next predict
+  memcpy( k->state_post->data.fl, k->state_pre->data.fl, KALMAN_DP*sizeof(float) );
+  return k->state_pre;
+}
+
+static void kalman_correct( CvKalman* k, const CvMat* z )
+{
+  if( !kalman_is_fixed( k ) || CV_MAT_TYPE(z->type) != CV_32FC1 ){
+    cvKalmanCorrect( k, z );
+    return;
+  }
+
+  const float* H  = k->measurement_matrix->data.fl;
+  const float* Pp = k->error_cov_pre->data.fl;
+  float HP[KALMAN_MP*KALMAN_DP];
+  float S[KALMAN_MP*KALMAN_MP], invS[KALMAN_MP*KALMAN_MP];
+  float Kt[KALMAN_MP*KALMAN_DP];
+  float y[KALMAN_MP], Hx[KALMAN_MP];
+  float KHP[KALMAN_DP*KALMAN_DP];
+
+  // S = H.P'.H' + R
+  mtxf_multiply<KALMAN_MP,KALMAN_DP,KALMAN_DP>( HP, H, Pp );
+  mtxf_multiply_ct<KALMAN_MP,KALMAN_DP,KALMAN_MP>( S, HP, H );
+  mtxf_add<KALMAN_MP*KALMAN_MP>( S, S, k->measurement_noise_cov->data.fl );
+  if( !mtxf_invert_spd<KALMAN_MP>( invS, S ) ){
+    cvKalmanCorrect( k, z );
+    return;
+  }
+
+  // K' = inv(S).H.P', y = z - H.x'
+  mtxf_multiply<KALMAN_MP,KALMAN_MP,KALMAN_DP>( Kt, invS, HP );
+  mtxf_multiply<KALMAN_MP,KALMAN_DP,1>( Hx, H, k->state_pre->data.fl );
+  mtxf_sub<KALMAN_MP>( y, z->data.fl, Hx );
+
+  // x(k) = x'(k) + K.y, P(k) = P'(k) - K.H.P'
+  for( int i = 0; i < KALMAN_DP; i++ ){
+    float s = 0;
+    for( int j = 0; j < KALMAN_MP; j++ ){
+      k->gain->data.fl[i*KALMAN_MP + j] = Kt[j*KALMAN_DP + i];
+      s += Kt[j*KALMAN_DP + i] * y[j];
+    }
+    k->state_post->data.fl[i] = k->state_pre->data.fl[i] + s;
+  }
+  mtxf_multiply_bt<KALMAN_DP,KALMAN_MP,KALMAN_DP>( KHP, Kt, HP );
+  mtxf_sub<KALMAN_DP*KALMAN_DP>( k->error_cov_post->data.fl, Pp, KHP );
+}
+
 
 //EOF///////////////////////////////////////////////////////////////////////////
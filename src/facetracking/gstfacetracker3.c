@@ -6,6 +6,14 @@
  * This element detects and tracks the largest face position in the scene.
  * 
  * Different from facetracker2: profile face is also used.
+ *
+ * With parallel=true the frontal, profile, mirrored profile and torso cascades
+ * are all evaluated on every frame, concurrently on up to cascade-threads
+ * threads, and their results fused; otherwise the frontal cascade runs alone
+ * and the torso one only when it finds nothing. The time each cascade takes
+ * is in the read only cascade-timing property, and the time of the grey
+ * conversion, detection, Kalman tracking and drawing stages in the stats one,
+ * also posted on the bus every stats-interval if stats-messages is set.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -27,6 +35,10 @@ GST_DEBUG_CATEGORY_STATIC (gst_facetracker3_debug);
 #define DEFAULT_MIN_SIZE_WIDTH 0
 #define DEFAULT_MIN_SIZE_HEIGHT 0
 #define DEFAULT_FPS G_MAXINT
+#define DEFAULT_PARALLEL FALSE
+#define DEFAULT_CASCADE_THREADS FACETRACKER3_NCASCADES
+#define DEFAULT_STATS_INTERVAL STAGEPROF_DEFAULT_INTERVAL
+#define DEFAULT_STATS_MESSAGES FALSE
 
 #define FACETRACKER3_TIMEOUT 50
 
@@ -43,6 +55,12 @@ enum {
 	PROP_MIN_SIZE_WIDTH,
 	PROP_MIN_SIZE_HEIGHT,
 	PROP_TRACKER,
+	PROP_PROFILE3,
+	PROP_PARALLEL,
+	PROP_CASCADE_THREADS,
+	PROP_CASCADE_TIMING,
+	PROP_STATS_INTERVAL,
+	PROP_STATS_MESSAGES,
 	PROP_LAST
 };
 
@@ -86,6 +104,13 @@ void CleanFacetracker3(GstFacetracker3 *facetracker3)
   if (facetracker3->hc )  haarwrapper_destroy(facetracker3->hc );
   if (facetracker3->hc2)  haarwrapper_destroy(facetracker3->hc2);
   if (facetracker3->hc3)  haarwrapper_destroy(facetracker3->hc3);
+  if (facetracker3->pyramid)  haarpyramid_destroy(facetracker3->pyramid);
+  facetracker3->pyramid = NULL;
+  if (facetracker3->hc3_mirror)      haarwrapper_destroy(facetracker3->hc3_mirror);
+  facetracker3->hc3_mirror = NULL;
+  if (facetracker3->pyramid_mirror)  haarpyramid_destroy(facetracker3->pyramid_mirror);
+  facetracker3->pyramid_mirror = NULL;
+  if (facetracker3->cvBGR_mirror)    cvReleaseImage(&facetracker3->cvBGR_mirror);
 
 
   if (facetracker3->face )  free(facetracker3->face );
@@ -146,6 +171,27 @@ static void gst_facetracker3_class_init(GstFacetracker3Class * klass)
   g_object_class_install_property(gobject_class, PROP_TRACKER, 
                                   g_param_spec_int("tracker", "tracker",
                                                    "tracker on/off", 0, 1, 1, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_PROFILE3, g_param_spec_string("profile3", "Profile3",
+                                                                                    "Location of Haar cascade file to use for profile face detection", DEFAULT_PROFILE3, (GParamFlags)(G_PARAM_READWRITE
+                                                                                                                                                                                        | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_PARALLEL, g_param_spec_boolean("parallel", "Parallel",
+                                                                                     "Evaluate the face, profile, mirrored profile and torso cascades concurrently on every frame and fuse their results",
+                                                                                     DEFAULT_PARALLEL, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_CASCADE_THREADS, g_param_spec_int("cascade-threads", "Cascade threads",
+                                                                                        "Threads running the cascades in parallel mode", 1, FACETRACKER3_NCASCADES,
+                                                                                        DEFAULT_CASCADE_THREADS, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_CASCADE_TIMING, g_param_spec_string("cascade-timing", "Cascade timing",
+                                                                                          "Smoothed milliseconds per frame of the face, profile, mirrored profile and torso cascades",
+                                                                                          NULL, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_STATS, g_param_spec_string("stats", "Stats",
+                                                                                 "Count, mean, median, 95th percentile and maximum milliseconds of each stage over the last stats-interval",
+                                                                                 NULL, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_STATS_INTERVAL, g_param_spec_int("stats-interval", "Stats interval",
+                                                                                       "Milliseconds summarised by stats", 100, 60000,
+                                                                                       DEFAULT_STATS_INTERVAL, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_STATS_MESSAGES, g_param_spec_boolean("stats-messages", "Stats messages",
+                                                                                           "Post stats as a stageprof element message every stats-interval",
+                                                                                           DEFAULT_STATS_MESSAGES, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
   
   btrans_class->passthrough_on_same_caps = TRUE;
   //btrans_class->always_in_place = TRUE;
@@ -166,6 +212,8 @@ static void gst_facetracker3_init(GstFacetracker3 * facetracker3, GstFacetracker
   facetracker3->profile3 = g_strdup(DEFAULT_PROFILE3);
   facetracker3->display = 0;
   facetracker3->tracker = 1;
+  facetracker3->parallel = DEFAULT_PARALLEL;
+  facetracker3->cascade_threads = DEFAULT_CASCADE_THREADS;
   facetracker3->nframes=0;
   facetracker3->nframes_with_face_detected=0;
   facetracker3->scale_factor = DEFAULT_SCALE_FACTOR;
@@ -179,6 +227,14 @@ static void gst_facetracker3_init(GstFacetracker3 * facetracker3, GstFacetracker
   facetracker3->hc  = NULL;
   facetracker3->hc2 = NULL;
   facetracker3->hc3 = NULL;
+  facetracker3->pyramid = NULL;
+  facetracker3->hc3_mirror     = NULL;
+  facetracker3->pyramid_mirror = NULL;
+  facetracker3->cvBGR_mirror   = NULL;
+  memset(facetracker3->cascade_ms, 0, sizeof(facetracker3->cascade_ms));
+  facetracker3->stats_interval = DEFAULT_STATS_INTERVAL;
+  facetracker3->stats_messages = DEFAULT_STATS_MESSAGES;
+  facetracker3->prof = stageprof_create(facetracker3->stats_interval);
 
   facetracker3->timer = 0;
 }
@@ -194,6 +250,8 @@ static void gst_facetracker3_finalize(GObject * object)
   GST_FACETRACKER3_LOCK (facetracker3);
   CleanFacetracker3(facetracker3);
   g_free(facetracker3->profile);
+  g_free(facetracker3->profile3);
+  stageprof_destroy(facetracker3->prof);
   GST_FACETRACKER3_UNLOCK (facetracker3);
   GST_INFO("Facetracker3 destroyed (%s).", GST_OBJECT_NAME(object));
   
@@ -247,6 +305,26 @@ static void gst_facetracker3_set_property(GObject * object, guint prop_id, const
 	case PROP_TRACKER:
 		facetracker3->tracker = g_value_get_int(value);
 		break;
+	case PROP_PROFILE3:
+		g_free(facetracker3->profile3);
+		facetracker3->profile3 = g_value_dup_string(value);
+		break;
+	case PROP_PARALLEL:
+		facetracker3->parallel = g_value_get_boolean(value);
+		break;
+	case PROP_CASCADE_THREADS:
+		facetracker3->cascade_threads = g_value_get_int(value);
+		break;
+	case PROP_CASCADE_TIMING:
+		// read only
+		break;
+	case PROP_STATS_INTERVAL:
+		facetracker3->stats_interval = g_value_get_int(value);
+		stageprof_set_interval(facetracker3->prof, facetracker3->stats_interval);
+		break;
+	case PROP_STATS_MESSAGES:
+		facetracker3->stats_messages = g_value_get_boolean(value);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -286,6 +364,33 @@ static void gst_facetracker3_get_property(GObject * object, guint prop_id, GValu
   case PROP_TRACKER:
     g_value_set_int(value, facetracker3->tracker);
     break;
+  case PROP_PROFILE3:
+    g_value_set_string(value, facetracker3->profile3);
+    break;
+  case PROP_PARALLEL:
+    g_value_set_boolean(value, facetracker3->parallel);
+    break;
+  case PROP_CASCADE_THREADS:
+    g_value_set_int(value, facetracker3->cascade_threads);
+    break;
+  case PROP_CASCADE_TIMING:
+    g_value_take_string(value, g_strdup_printf("face %.1f profile %.1f mirrored %.1f torso %.1f ms",
+                                               facetracker3->cascade_ms[FACETRACKER3_FACE],
+                                               facetracker3->cascade_ms[FACETRACKER3_PROFILE],
+                                               facetracker3->cascade_ms[FACETRACKER3_PROFILE_MIRROR],
+                                               facetracker3->cascade_ms[FACETRACKER3_TORSO]));
+    break;
+  case PROP_STATS: {
+    gchar buffer[1024];
+    g_value_set_string(value, stageprof_print(facetracker3->prof, buffer, sizeof(buffer)));
+    break;
+  }
+  case PROP_STATS_INTERVAL:
+    g_value_set_int(value, facetracker3->stats_interval);
+    break;
+  case PROP_STATS_MESSAGES:
+    g_value_set_boolean(value, facetracker3->stats_messages);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -336,6 +441,13 @@ static gboolean gst_facetracker3_set_caps(GstBaseTransform * btrans, GstCaps * i
     facetracker3->hc2 = haarwrapper_create(facetracker3->profile2);
   if( facetracker3->profile3 )
     facetracker3->hc3 = haarwrapper_create(facetracker3->profile3);
+  facetracker3->pyramid = haarpyramid_create(1.25);
+  // the cascade and the levels are per scan: the mirrored pass needs its own
+  if( facetracker3->hc3 ){
+    facetracker3->hc3_mirror     = haarwrapper_create(facetracker3->profile3);
+    facetracker3->pyramid_mirror = haarpyramid_create(1.25);
+  }
+  memset(facetracker3->cascade_ms, 0, sizeof(facetracker3->cascade_ms));
   
   const CvSize size = cvSize(facetracker3->width, facetracker3->height);
   GST_WARNING (" width %d, height %d", facetracker3->width, facetracker3->height);
@@ -344,6 +456,8 @@ static gboolean gst_facetracker3_set_caps(GstBaseTransform * btrans, GstCaps * i
   // allocate image structs in BGR  ////////////////////////////////////////////
   facetracker3->cvBGR_input = cvCreateImageHeader(size, IPL_DEPTH_8U, 3);
   facetracker3->cvBGR       = cvCreateImage      (size, IPL_DEPTH_8U, 3);
+  if( facetracker3->hc3_mirror )
+    facetracker3->cvBGR_mirror = cvCreateImage(size, IPL_DEPTH_8U, 3);
 
   //////////////////////////////////////////////////////////////////////////////
   // allocate image structs in BGR or RGB or similar ///////////////////////////
@@ -385,8 +499,10 @@ static void gst_facetracker3_before_transform(GstBaseTransform * btrans, GstBuff
 static GstFlowReturn gst_facetracker3_transform_ip(GstBaseTransform * btrans, GstBuffer * gstbuf) 
 {
   GstFacetracker3 *facetracker3 = GST_FACETRACKER3 (btrans);
+  GstMessage *stats = NULL;
 
   GST_FACETRACKER3_LOCK (facetracker3);
+  const guint64 t_frame = stageprof_frame_start(facetracker3->prof);
 
   //////////////////////////////////////////////////////////////////////////////
   // Image preprocessing: color space conversion etc
@@ -404,7 +520,9 @@ static GstFlowReturn gst_facetracker3_transform_ip(GstBaseTransform * btrans, Gs
   //////////////////////////////////////////////////////////////////////////////
   // Box drawing, output text etc
   if( facetracker3->display ){
+    const guint64 t = stageprof_start(facetracker3->prof);
     facetracking_display_info(facetracker3);
+    stageprof_stop(facetracker3->prof, STAGEPROF_DRAW, t);
   }
   
   GST_INFO(" detected face in %d,%d, w %d, h %d", 
@@ -422,8 +540,12 @@ static GstFlowReturn gst_facetracker3_transform_ip(GstBaseTransform * btrans, Gs
  
   //facetracker3->nframes++; facetracker3->nframes_with_face_detected += ( nobjects > 0 ) ? 1 :0;
  
+  if( stageprof_frame_end(facetracker3->prof, t_frame) && facetracker3->stats_messages )
+    stats = stageprof_message(facetracker3->prof, GST_OBJECT(facetracker3));
   GST_FACETRACKER3_UNLOCK (facetracker3);
   
+  if( stats )
+    gst_element_post_message(GST_ELEMENT(facetracker3), stats);
   
   return GST_FLOW_OK;
 }
@@ -10,6 +10,7 @@
 
 #include "haarwrapper/haarwrapper.h"
 #include "kalmantracking.h"
+#include "../opencv/stageprof.h"
 
 G_BEGIN_DECLS
 
@@ -24,6 +25,15 @@ G_BEGIN_DECLS
 #define GST_IS_FACETRACKER3_CLASS(klass) \
 	(G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_FACETRACKER3))
 
+// cascades run by facetracking_kernel(), indices of cascade_ms
+enum {
+  FACETRACKER3_FACE,
+  FACETRACKER3_PROFILE,
+  FACETRACKER3_PROFILE_MIRROR,
+  FACETRACKER3_TORSO,
+  FACETRACKER3_NCASCADES
+};
+
 typedef struct _GstFacetracker3 GstFacetracker3;
 typedef struct _GstFacetracker3Class GstFacetracker3Class;
 
@@ -41,6 +51,8 @@ struct _GstFacetracker3 {
   
   gboolean display;
   gboolean tracker;
+  gboolean parallel;
+  gint     cascade_threads;
   long nframes, nframes_with_face_detected;
   
   gchar *profile;
@@ -55,10 +67,18 @@ struct _GstFacetracker3 {
   t_haarwrapper_image *image_rgb2;
   IplImage            *cvBGR_input;
   IplImage            *cvBGR;
+  IplImage            *cvBGR_mirror;
 
   t_haarwrapper       *hc;
   t_haarwrapper       *hc2;
   t_haarwrapper       *hc3;
+  t_haarpyramid       *pyramid;   // shared by hc, hc2 and hc3 on each frame
+  t_haarwrapper       *hc3_mirror;      // hc3 again, to scan the mirrored frame
+  t_haarpyramid       *pyramid_mirror;  // concurrently with hc3 in parallel mode
+  gdouble              cascade_ms[FACETRACKER3_NCASCADES];  // smoothed, per frame
+  t_stageprof         *prof;            // stages of facetracking_kernel(), see stats
+  gint                 stats_interval;  // ms
+  gboolean             stats_messages;
 
   struct bbox_int   *face, *torso, *side;
   struct kernel_internal_state *facek, *torsok, *sidek;
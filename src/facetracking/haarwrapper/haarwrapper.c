@@ -14,6 +14,7 @@ t_haarwrapper* haarwrapper_create(const char* filename)
   
   hc->storage = NULL;
   hc->cascade = NULL;
+  memset(&hc->scan, 0, sizeof(t_haarscan));
   
   hc->cascade = (CvHaarClassifierCascade*)cvLoad(hc->cascade_name, 0, 0, 0);
   hc->storage = cvCreateMemStorage(0);
@@ -36,6 +37,7 @@ void haarwrapper_destroy(t_haarwrapper* hc) {
 
   cvReleaseMemStorage(&hc->storage);
   cvRelease((void**)&hc->cascade);
+  haarscan_release(&hc->scan);
 
   free(hc);
 }
@@ -79,6 +81,27 @@ guint32 haarwrapper_detect(t_haarwrapper *hc, t_haarwrapper_image* im, struct bb
   return *np;
 }
 
+guint32 haarwrapper_detect_pyramid(t_haarwrapper *hc, t_haarpyramid *pyr, struct bbox_double* p, guint32 *np)
+{
+  // the pyramid has no canny pruning, the levels are already there for the
+  // cascades after the first one
+  *np = haarpyramid_detect_scan(pyr, &hc->scan, hc->cascade, 2,
+                                cvSize(pyr->width/16, pyr->height/16), cvSize(0, 0));
+  if(*np){
+    const CvRect* r = &hc->scan.objects[0];
+    p->x = r->x;
+    p->y = r->y;
+    p->w = r->width;
+    p->h = r->height;
+  }
+  return *np;
+}
+
+void haarwrapper_prepare_pyramid(t_haarwrapper *hc, t_haarpyramid *pyr)
+{
+  haarpyramid_prepare(pyr, hc->cascade, cvSize(pyr->width/16, pyr->height/16), cvSize(0, 0));
+}
+
 
 void haarwrapper_drawbox(IplImage *frame, struct bbox_int* bbox, CvScalar colour)
 {
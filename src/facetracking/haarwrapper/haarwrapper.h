@@ -5,6 +5,7 @@
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
 #include <gst/gst.h>  // guint32 etc
+#include "../../opencv/haarpyramid.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -32,12 +33,19 @@ typedef struct {
   char cascade_name[512];
   CvMemStorage* storage;
   CvHaarClassifierCascade* cascade;
+  t_haarscan scan;                  // output of haarwrapper_detect_pyramid()
 } t_haarwrapper;
 
 t_haarwrapper* haarwrapper_create(const char* filename);
 void           haarwrapper_destroy(t_haarwrapper* hc);
 guint32        haarwrapper_detect(t_haarwrapper *hc, t_haarwrapper_image* im, 
                                   struct bbox_double* p, guint32 *np);
+// same on the frame last set in pyr, sharing its levels with the other cascades
+guint32        haarwrapper_detect_pyramid(t_haarwrapper *hc, t_haarpyramid *pyr,
+                                          struct bbox_double* p, guint32 *np);
+// builds the levels of pyr hc will scan, so that different hc can then run
+// haarwrapper_detect_pyramid() on it concurrently
+void           haarwrapper_prepare_pyramid(t_haarwrapper *hc, t_haarpyramid *pyr);
 void           haarwrapper_drawbox(IplImage *frame, struct bbox_int* bbox, CvScalar colour);
 void           haarwrapper_drawtext(IplImage *frame, struct bbox_int* pos, CvScalar colour, char* text);
 
@@ -14,6 +14,21 @@ t_colorbins* colorbins_create(unsigned char ymin, unsigned char ymax, unsigned c
 
 	cb->inbins = (unsigned int*)malloc(ny*nu*nv*sizeof(unsigned int));
 
+	// the index computations of every channel value, once: below, inside or
+	// above the range gives the outlier offsets 0, 1 or 2 times 9, 3 and 1
+	const unsigned char lo[3] = { ymin, umin, vmin };
+	const unsigned char hi[3] = { ymax, umax, vmax };
+	const unsigned int nbins[3] = { ny, nu, nv };
+	const unsigned int weight[3] = { 9, 3, 1 };
+	const unsigned int stride[3] = { (unsigned int)nu*nv, nv, 1 };
+	unsigned int c, i;
+	for (c=0; c<3; c++)
+		for (i=0; i<256; i++) {
+			if (i>=hi[c]) { cb->lutout[c][i] = 2*weight[c]; cb->lutin[c][i] = 0; }
+			else if (i>=lo[c]) { cb->lutout[c][i] = weight[c]; cb->lutin[c][i] = (((i-lo[c])*nbins[c])/(hi[c]-lo[c]))*stride[c]; }
+			else { cb->lutout[c][i] = 0; cb->lutin[c][i] = 0; }
+		}
+
 	colorbins_reset(cb);
 
 	return cb;
@@ -66,28 +81,32 @@ void colorbins_set_weights(t_colorbins* cb)
 
 // get index of outlier bin
 inline unsigned char colorbins_get_indexout(t_colorbins *cb, unsigned char* ii) {
-	unsigned char nout = 0;
-	if (ii[0]>=cb->ymax) nout+=18; else if (ii[0]>=cb->ymin) nout+=9;
-	if (ii[1]>=cb->umax) nout+=6; else if (ii[1]>=cb->umin) nout+=3;
-	if (ii[2]>=cb->vmax) nout+=2; else if (ii[2]>=cb->vmin) nout+=1;
-	return nout;
+	return cb->lutout[0][ii[0]] + cb->lutout[1][ii[1]] + cb->lutout[2][ii[2]];
 }
 // get index of inlier bin
 inline unsigned int colorbins_get_indexin(t_colorbins *cb, unsigned char* ii) {
-	unsigned int nin = ((ii[2]-cb->vmin)*cb->nv)/(cb->vmax-cb->vmin);
-	nin += (((ii[1]-cb->umin)*cb->nu)/(cb->umax-cb->umin))*cb->nv;
-	nin += (((ii[0]-cb->ymin)*cb->ny)/(cb->ymax-cb->ymin))*cb->nv*cb->nu;
-	return nin;
+	return cb->lutin[0][ii[0]] + cb->lutin[1][ii[1]] + cb->lutin[2][ii[2]];
+}
+
+// count of the bin of a pixel, without branches: the inlier index of an
+// outlier is still a valid bin, only not the one to use
+static inline unsigned int colorbins_score(const t_colorbins *cb, const unsigned char* ii) {
+	const unsigned int nout = cb->lutout[0][ii[0]] + cb->lutout[1][ii[1]] + cb->lutout[2][ii[2]];
+	const unsigned int in = cb->inbins[cb->lutin[0][ii[0]] + cb->lutin[1][ii[1]] + cb->lutin[2][ii[2]]];
+	const unsigned int out = cb->outbins[nout];
+	return (nout==13) ? in : out;
 }
 
 // increase count of the corresponding bin for one pixel
-void colorbins_addpixel(t_colorbins *cb, unsigned char* ii) {
-	unsigned char nout = colorbins_get_indexout(cb, ii);
+static inline void colorbins_count(t_colorbins *cb, const unsigned char* ii) {
+	const unsigned int nout = cb->lutout[0][ii[0]] + cb->lutout[1][ii[1]] + cb->lutout[2][ii[2]];
 	cb->outbins[nout]++;
-	if (nout==13) {
-		unsigned int nin = colorbins_get_indexin(cb, ii);
-		cb->inbins[nin]++;
-	}
+	cb->inbins[cb->lutin[0][ii[0]] + cb->lutin[1][ii[1]] + cb->lutin[2][ii[2]]] += (nout==13);
+}
+
+// increase count of the corresponding bin for one pixel
+void colorbins_addpixel(t_colorbins *cb, unsigned char* ii) {
+	colorbins_count(cb, ii);
 	cb->total++;
 }
 
@@ -102,12 +121,14 @@ void colorbins_addsubimage(t_colorbins *cb, t_image *image, unsigned int x1, uns
 	if (y2>image->height) y2 = image->height;
 
 	unsigned int i, j;
+	unsigned int n = 0;
 	for (i=y1; i<y2; i+=ys) {
-		unsigned char *ii = image->data[0] + image->rowbytes*i +x1*HAARCOL_BYTESPIXEL;
-		for (j=x1; j<x2; j+=xs, ii+=HAARCOL_BYTESPIXEL*xs)
-			colorbins_addpixel(cb, ii);
+		const unsigned char *ii = image->data[0] + image->rowbytes*i +x1*HAARCOL_BYTESPIXEL;
+		for (j=x1; j<x2; j+=xs, ii+=HAARCOL_BYTESPIXEL*xs, n++)
+			colorbins_count(cb, ii);
 
 	}
+	cb->total += n;
 
 }
 
@@ -128,10 +149,7 @@ void colorbins_add_gaussian_particles(t_colorbins* cb, unsigned char my, unsigne
 
 // get the count of the bin corresponding to a pixel
 unsigned int colorbins_scorepixel(t_colorbins *cb, unsigned char* ii) {
-	unsigned char nout = colorbins_get_indexout(cb, ii);
-	if (nout!=13) return cb->outbins[nout];
-	unsigned int nin = colorbins_get_indexin(cb, ii);
-	return cb->inbins[nin];
+	return colorbins_score(cb, ii);
 }
 
 // get the mean count/total of all pixels in a ROI
@@ -148,9 +166,9 @@ float colorbins_scoresubimage(t_colorbins *cb, t_image *image, unsigned int x1,
 	unsigned int ss = 0;
 	unsigned int sn = 0;
 	for (i=y1; i<y2; i+=ys) {
-		unsigned char *ii = image->data[0] + image->rowbytes*i + HAARCOL_BYTESPIXEL*x1;
+		const unsigned char *ii = image->data[0] + image->rowbytes*i + HAARCOL_BYTESPIXEL*x1;
 		for (j=x1; j<x2; j+=xs, ii+=HAARCOL_BYTESPIXEL*xs, sn++)
-			ss += colorbins_scorepixel(cb, ii);
+			ss += colorbins_score(cb, ii);
 	}
 
 	if (sn<2) return 0;
@@ -158,6 +176,45 @@ float colorbins_scoresubimage(t_colorbins *cb, t_image *image, unsigned int x1,
 	return ((float)ss/sn)/cb->total;
 }
 
+// integral of the scores of the pixels within a ROI, every step pixels in x and y
+void colorbins_scoreintegral(t_colorbins *cb, t_image *image, unsigned int x1, unsigned int x2, unsigned int y1, unsigned int y2, unsigned int step, t_colorscore *cs)
+{
+	if (step<1) step=1;
+
+	if (x2>image->width) x2 = image->width;
+
+	if (y2>image->height) y2 = image->height;
+
+	cs->x0 = x1;
+	cs->y0 = y1;
+	cs->step = step;
+	cs->w = (x2>x1) ? (x2-x1+step-1)/step : 0;
+	cs->h = (y2>y1) ? (y2-y1+step-1)/step : 0;
+	cs->total = cb->total;
+
+	const unsigned int n = (cs->w+1)*(cs->h+1);
+	if (n>cs->capacity) {
+		free(cs->sum);
+		cs->sum = (unsigned int*)malloc(n*sizeof(unsigned int));
+		cs->capacity = cs->sum ? n : 0;
+		if (!cs->sum) { cs->w = cs->h = 0; return; }
+	}
+
+	unsigned int i, j;
+	memset(cs->sum, 0, (cs->w+1)*sizeof(unsigned int));
+	for (i=0; i<cs->h; i++) {
+		const unsigned char *ii = image->data[0] + image->rowbytes*(y1+i*step) + HAARCOL_BYTESPIXEL*x1;
+		const unsigned int *above = cs->sum + i*(cs->w+1);
+		unsigned int *ss = cs->sum + (i+1)*(cs->w+1);
+		unsigned int row = 0;
+		ss[0] = 0;
+		for (j=0; j<cs->w; j++, ii+=HAARCOL_BYTESPIXEL*step) {
+			row += colorbins_score(cb, ii);
+			ss[j+1] = above[j+1] + row;
+		}
+	}
+}
+
 // scale the UV channels of a YUV image to the score of the pixels according to the cb
 // make sure the cb is normalized (either by volume or by another cb)
 void colorbins_scoreimage(t_colorbins *cb, t_image *in, t_image *out)
@@ -167,7 +224,7 @@ void colorbins_scoreimage(t_colorbins *cb, t_image *in, t_image *out)
 		unsigned char *ii = in->data[0] + in->rowbytes*i;
 		unsigned char *oo = out->data[0] + out->rowbytes*i;
 		for (j=0; j<in->width; j++, ii+=HAARCOL_BYTESPIXEL, oo+=HAARCOL_BYTESPIXEL) {
-			unsigned int score = colorbins_scorepixel(cb, ii);
+			unsigned int score = colorbins_score(cb, ii);
 			if (score>255) score=255;
 			oo[1] = (oo[1]*score)/255; oo[2] = (oo[2]*score)/255;
 		}
@@ -238,3 +295,44 @@ void colorbins_saturate_inbins(t_colorbins *cb, unsigned int max) {
 	for (i=0; i<n; i++, cc++)
 		if (*cc>max) {*cc=max; cb->total-=(*cc-max);}
 }
+
+
+// constructor, empty until the first colorbins_scoreintegral
+t_colorscore* colorscore_create(void)
+{
+	t_colorscore *cs = (t_colorscore*)malloc(sizeof(t_colorscore));
+	memset(cs,0,sizeof(t_colorscore));
+	return cs;
+}
+
+// destructor
+void colorscore_destroy(t_colorscore *cs)
+{
+	free(cs->sum);
+	free(cs);
+}
+
+// like colorbins_scoresubimage on a ROI, from the samples of the integral in it:
+// the mean over the integral's grid, not the ROI's own sampling
+float colorscore_box(const t_colorscore *cs, int x1, int x2, int y1, int y2)
+{
+	// first sample at or after x1, first one at or after x2 (excluded)
+	const int s = cs->step;
+	int i1 = (x1 > (int)cs->x0) ? (x1-cs->x0+s-1)/s : 0;
+	int i2 = (x2 > (int)cs->x0) ? (x2-cs->x0+s-1)/s : 0;
+	int j1 = (y1 > (int)cs->y0) ? (y1-cs->y0+s-1)/s : 0;
+	int j2 = (y2 > (int)cs->y0) ? (y2-cs->y0+s-1)/s : 0;
+	if (i1 > (int)cs->w) i1 = cs->w;
+	if (i2 > (int)cs->w) i2 = cs->w;
+	if (j1 > (int)cs->h) j1 = cs->h;
+	if (j2 > (int)cs->h) j2 = cs->h;
+
+	const int sn = (i2-i1)*(j2-j1);
+	if (sn<2) return 0;
+
+	const unsigned int *s1 = cs->sum + j1*(cs->w+1);
+	const unsigned int *s2 = cs->sum + j2*(cs->w+1);
+	const unsigned int ss = s2[i2] - s2[i1] - s1[i2] + s1[i1];
+
+	return ((float)ss/sn)/cs->total;
+}
@@ -10,8 +10,23 @@ typedef struct {
 	unsigned int total;
 	unsigned char ymin, ymax, umin, umax, vmin, vmax;
 	unsigned char ny, nu, nv;
+	// bin index per channel value (Y, U, V), filled in by the constructor: the
+	// outlier offsets of a pixel add up to its outbin (13 for an inlier) and the
+	// inlier ones to its inbin, valid only for an inlier
+	unsigned char lutout[3][256];
+	unsigned int lutin[3][256];
 } t_colorbins;
 
+// integral image of the scores of a region of an image, sampled every step
+// pixels, giving the mean score of any box in the region in constant time
+typedef struct {
+	unsigned int *sum;			// (w+1)*(h+1), first row and column zero
+	unsigned int capacity;
+	unsigned int x0, y0, step;	// image position of the first sample, spacing
+	unsigned int w, h;			// samples per row, rows
+	unsigned int total;			// of the bins scored
+} t_colorscore;
+
 // constructor
 t_colorbins* colorbins_create(unsigned char ymin, unsigned char ymax, unsigned char ny, unsigned char umin, unsigned char umax, unsigned char nu, unsigned char vmin, unsigned char vmax, unsigned char nv);
 // destructor
@@ -48,6 +63,9 @@ void colorbins_add_gaussian_particles(t_colorbins* cb, unsigned char my, unsigne
 unsigned int colorbins_scorepixel(t_colorbins *cb, unsigned char* ii);
 // get the mean count/total of all pixels in a ROI
 float colorbins_scoresubimage(t_colorbins *cb, t_image *image, unsigned int x1, unsigned int x2, unsigned int xs, unsigned int y1, unsigned int y2, unsigned int ys);
+// integral of the scores of the pixels within a ROI, every step pixels in x and y
+// the cb must be normalized, as for colorbins_scoreimage, so that the sums fit
+void colorbins_scoreintegral(t_colorbins *cb, t_image *image, unsigned int x1, unsigned int x2, unsigned int y1, unsigned int y2, unsigned int step, t_colorscore *cs);
 // scale the UV channels of a YUV image to the score of the pixels according to the cb
 // make sure the cb is normalized (either by volume or by another cb)
 void colorbins_scoreimage(t_colorbins *cb, t_image *in, t_image *out);
@@ -65,4 +83,13 @@ void colorbins_scale(t_colorbins *cb, float s);
 // saturate
 void colorbins_saturate_inbins(t_colorbins *cb, unsigned int max);
 
+
+// constructor, empty until the first colorbins_scoreintegral
+t_colorscore* colorscore_create(void);
+// destructor
+void colorscore_destroy(t_colorscore *cs);
+// like colorbins_scoresubimage on a ROI, from the samples of the integral in it:
+// the mean over the integral's grid, not the ROI's own sampling
+float colorscore_box(const t_colorscore *cs, int x1, int x2, int y1, int y2);
+
 #endif
@@ -2,6 +2,8 @@
 #include <string.h>
 #include "drawing.h"
 
+#define FACE_SCORE_STACK 64
+
 inline unsigned char uSub(unsigned char a, unsigned char b) {
 	if (a > b)
 		return (a - b);
@@ -39,6 +41,7 @@ t_face* face_create(t_image *image) {
 	face->skincolor = colorbins_create(60, 240, 10, 100, 150, 10, 120, 170, 10);
 	face->bgcolor = colorbins_create(60, 240, 10, 100, 150, 10, 120, 170, 10);
 	face->fgcolor = colorbins_create(60, 240, 10, 100, 150, 10, 120, 170, 10);
+	face->skinscore = colorscore_create();
 
 	face_reset(face, image);
 
@@ -91,6 +94,7 @@ t_face* face_deep_copy(t_face *face, bool deepcopy_geometry, bool deepcopy_color
 	cp->skincolor = face->skincolor;
 	cp->bgcolor = face->bgcolor;
 	cp->fgcolor = face->fgcolor;
+	cp->skinscore = face->skinscore;
 
 	if (deepcopy_geometry)
 		cp->geometry = ks_deep_copy(face->geometry);
@@ -98,6 +102,7 @@ t_face* face_deep_copy(t_face *face, bool deepcopy_geometry, bool deepcopy_color
 		cp->skincolor = colorbins_deep_copy(face->skincolor);
 		cp->bgcolor = colorbins_deep_copy(face->bgcolor);
 		cp->fgcolor = colorbins_deep_copy(face->fgcolor);
+		cp->skinscore = colorscore_create();
 	}
 
 	return cp;
@@ -109,6 +114,7 @@ void face_destroy(t_face *face, bool destroy_geometry, bool destroy_colormodels)
 		colorbins_destroy(face->skincolor);
 		colorbins_destroy(face->bgcolor);
 		colorbins_destroy(face->fgcolor);
+		colorscore_destroy(face->skinscore);
 	}
 	if (destroy_geometry && destroy_colormodels)
 		free(face);
@@ -178,54 +184,125 @@ void face_skincolor_update(t_face *face, t_image *in) {
 	colorbins_reset_outbins(face->skincolor);
 }
 
-bool face_geometry_update_haar(t_face *face, t_image *in, t_haarclass *hc, t_image *out) {
+// the measurement matrix of a detection (x, y, width) and the detection predicted by it
+static void face_geometry_detection_model(t_face *face, float *Ht, float *hx) {
+	mat_set(Ht, 0, 15);
+	Ht[0] = Ht[9] = Ht[4] = Ht[13] = 1.0;
+	Ht[8] = 2.0;
+	mat_multiply_transpose(hx, Ht, face->geometry->mean, 3, 5, 1, MAT_TRANSPOSE_B);
+}
+
+// a detection as a measurement
+static void face_detection_observation(t_blobfeature *bb, t_kalman_state *o) {
+	mat_set(o->cov, 0, 9);
+	o->mean[0] = bb->p[0];
+	o->cov[0] = 0.5 * bb->w * bb->w;
+	o->mean[1] = bb->p[1];
+	o->cov[4] = 0.5 * bb->w * bb->w;
+	o->mean[2] = bb->w;
+	o->cov[8] = 1.0 * bb->w * bb->w;
+}
+
+void face_geometry_score_features(t_face *face, t_image *in, t_featurelist *fl, float *score) {
 	unsigned int i;
+	t_blobfeature *bb = fl->feat.blob;
 
-	///////////////////////
-	// SELECT BEST MATCH
+	float om[3], oc[9];
+	t_kalman_state ko;
+	t_kalman_state *o = &ko;
+	ks_init_static(o, om, oc, 3);
 
-	t_featurelist *fl = featurelist_haar(in, NULL, hc);
+	float Ht[15];
+	float hx[3];
+	float HPHt[9];
+
+	face_geometry_detection_model(face, Ht, hx);
+	// the prediction part of S, the same for every candidate
+	kalman_score_init(face->geometry, Ht, 3, HPHt);
+
+	// colour score of the candidates from one integral of the skin scores over
+	// all of them, at the finest sampling of theirs, if that samples fewer
+	// pixels than scoring every box on its own. This is an approximation: a
+	// box is then sampled on the grid shared by all the candidates, not from
+	// its own corner every w/20+1 pixels, so its score, and which candidate
+	// wins, can depend on the other candidates in the list
+	t_colorscore *cs = NULL;
+	if (fl->nfeat > 1) {
+		float x1 = in->width, x2 = 0, y1 = in->height, y2 = 0, direct = 0;
+		unsigned int step = in->width;
+		for (i = 0; i < fl->nfeat; i++, bb++) {
+			const unsigned int s = bb->w / 20 + 1;
+			const float r = bb->w / 4;
+			if (bb->p[0] - r < x1) x1 = bb->p[0] - r;
+			if (bb->p[0] + r > x2) x2 = bb->p[0] + r;
+			if (bb->p[1] - r < y1) y1 = bb->p[1] - r;
+			if (bb->p[1] + r > y2) y2 = bb->p[1] + r;
+			if (s < step) step = s;
+			direct += (2 * r / s) * (2 * r / s);
+		}
+		bb = fl->feat.blob;
+		if (x1 < 0) x1 = 0;
+		if (y1 < 0) y1 = 0;
+		if (x2 > x1 && y2 > y1 && (x2 - x1) * (y2 - y1) / (step * step) < direct) {
+			colorbins_scoreintegral(face->skincolor, in, x1, x2, y1, y2, step, face->skinscore);
+			cs = face->skinscore;
+		}
+	}
 
-	float minscore;
-	t_blobfeature *bb = fl->feat.blob;
+	for (i = 0; i < fl->nfeat; i++, bb++) {
+		face_detection_observation(bb, o);
+		float colorscore = 0.3 / (0.01 + (cs ? colorscore_box(cs, bb->p[0] - bb->w / 4, bb->p[0] + bb->w / 4, bb->p[1] - bb->w / 4, bb->p[1] + bb->w / 4)
+		                                      : colorbins_scoresubimage(face->skincolor, in, bb->p[0] - bb->w / 4, bb->p[0] + bb->w / 4, bb->w
+		                                                                / 20 + 1, bb->p[1] - bb->w / 4, bb->p[1] + bb->w / 4, bb->w / 20 + 1)));
+		float geoscore = kalman_score_hpht(HPHt, o, hx);
+		score[i] = colorscore * geoscore;
+	}
+}
 
-	t_kalman_state *o = ks_create_shared(3);
-	t_kalman_state *besto = ks_create_shared(3);
+void face_geometry_update_feature(t_face *face, t_blobfeature *bb) {
+	float om[3], oc[9];
+	t_kalman_state ko;
+	t_kalman_state *o = &ko;
+	ks_init_static(o, om, oc, 3);
 
 	float Ht[15];
 	float hx[3];
 
-	// set Ht, hx
-	mat_set(Ht, 0, 15);
-	Ht[0] = Ht[9] = Ht[4] = Ht[13] = 1.0;
-	Ht[8] = 2.0;
-	mat_multiply_transpose(hx, Ht, face->geometry->mean, 3, 5, 1, MAT_TRANSPOSE_B);
+	face_geometry_detection_model(face, Ht, hx);
+	face_detection_observation(bb, o);
+
+	kalman_update_cov(face->geometry, o, hx, Ht);
+	kalman_update_cov(face->geometry, o, hx, Ht);
+}
+
+void face_reset_geometry_at(t_face *face, t_image *image, t_blobfeature *bb) {
+	face_reset_geometry(face, image);
+	// the detection as is, with its measurement variances
+	face->geometry->mean[0] = bb->p[0];	face->geometry->cov[0] = 0.5 * bb->w * bb->w;
+	face->geometry->mean[1] = bb->p[1];	face->geometry->cov[6] = 0.5 * bb->w * bb->w;
+	face->geometry->mean[2] = bb->w / 2;	face->geometry->cov[12] = 0.25 * bb->w * bb->w;
+}
+
+// updates the geometry with the detection of fl that best matches the prediction, fl is destroyed
+static bool face_geometry_update_features(t_face *face, t_image *in, t_featurelist *fl, t_image *out) {
+	unsigned int i;
+	t_blobfeature *bb = fl->feat.blob;
+	t_blobfeature *best = NULL;
+	float minscore = FACE_MAX_SCORE;
 
-	// init kalman score
-	minscore = 2.0;
-	memcpy(besto->mean, hx, 3 * sizeof(float));
-	mat_eye(besto->cov, 1e32, 3);
+	///////////////////////
+	// SELECT BEST MATCH
+
+	float score_stack[FACE_SCORE_STACK];
+	float *score = (fl->nfeat <= FACE_SCORE_STACK) ? score_stack : (float*)malloc(fl->nfeat * sizeof(float));
+	if (score)
+		face_geometry_score_features(face, in, fl, score);
 
 	//printf("[FaceTracker] score = [");
-	for (i = 0; i < fl->nfeat; i++, bb++) {
-          
-          // set o
-          mat_set(o->cov, 0, 9);
-          o->mean[0] = bb->p[0];
-          o->cov[0] = 0.5 * bb->w * bb->w;
-          o->mean[1] = bb->p[1];
-          o->cov[4] = 0.5 * bb->w * bb->w;
-          o->mean[2] = bb->w;
-          o->cov[8] = 1.0 * bb->w * bb->w;
-          
-          float colorscore = 0.3 / (0.01 + colorbins_scoresubimage(face->skincolor, in, bb->p[0] - bb->w / 4, bb->p[0] + bb->w / 4, bb->w
-                                                                   / 20 + 1, bb->p[1] - bb->w / 4, bb->p[1] + bb->w / 4, bb->w / 20 + 1));
-          float geoscore = kalman_score(face->geometry, o, hx, Ht);
-          
-          if (colorscore * geoscore < minscore) {
-            minscore = colorscore * geoscore;
-            memcpy(besto->mean, o->mean, 3 * sizeof(float));
-            memcpy(besto->cov, o->cov, 9 * sizeof(float));
+	for (i = 0; score && i < fl->nfeat; i++, bb++) {
+          if (score[i] < minscore) {
+            minscore = score[i];
+            best = bb;
           }
           
           if (out) {
@@ -233,36 +310,95 @@ bool face_geometry_update_haar(t_face *face, t_image *in, t_haarclass *hc, t_ima
             draw_line(out,bb->p[0]-bb->w*0.7,bb->p[1],bb->p[0]+bb->w*0.7,bb->p[1], DRAWING_YUV_RED, 255);
             draw_line(out,bb->p[0],bb->p[1]-bb->w*0.7,bb->p[0],bb->p[1]+bb->w*0.7, DRAWING_YUV_RED, 255);
           }
-          
-          //printf("%f*%f=%f,  ",colorscore,geoscore,colorscore*geoscore);
         }
         //printf("];\n");
-        featurelist_destroy_custom(fl);
+        if (score != score_stack)
+          free(score);
+
 	//////////////
 	// UPDATE
-        
-        //mat_scale(besto->cov,besto->cov,minscore,9);
-	//mat_scale(besto->cov,besto->cov,minscore,9);
-        
-        if (besto->cov[0]<1e16) kalman_update_cov(face->geometry, besto, hx, Ht);
-	if (besto->cov[0]<1e16) kalman_update_cov(face->geometry, besto, hx, Ht);
-        
-	const bool ret = (besto->cov[0]<1e16);
-        
+
+	const bool ret = (best != NULL);
+	if (ret)
+		face_geometry_update_feature(face, best);
+
 	if (out && ret) {
-          draw_circle_outline(out, besto->mean[0], besto->mean[1], besto->mean[2]/2.0, DRAWING_YUV_GREEN, 255);
-          draw_line(out,besto->mean[0]-besto->mean[2]*0.7,besto->mean[1],besto->mean[0]+besto->mean[2]*0.7,besto->mean[1], DRAWING_YUV_GREEN, 255);
-          draw_line(out,besto->mean[0],besto->mean[1]-besto->mean[2]*0.7,besto->mean[0],besto->mean[1]+besto->mean[2]*0.7, DRAWING_YUV_GREEN, 255);
+          draw_circle_outline(out, best->p[0], best->p[1], best->w/2.0, DRAWING_YUV_GREEN, 255);
+          draw_line(out,best->p[0]-best->w*0.7,best->p[1],best->p[0]+best->w*0.7,best->p[1], DRAWING_YUV_GREEN, 255);
+          draw_line(out,best->p[0],best->p[1]-best->w*0.7,best->p[0],best->p[1]+best->w*0.7, DRAWING_YUV_GREEN, 255);
 	}
-
-	ks_destroy_shared(o);
-	ks_destroy_shared(besto);
+        featurelist_destroy_custom(fl);
 
 	return ret;
 }
 
+bool face_geometry_update_haar(t_face *face, t_image *in, t_haarclass *hc, t_image *out) {
+	t_featurelist *fl = featurelist_haar(in, NULL, hc);
+	if (!fl)
+		return false;
+	return face_geometry_update_features(face, in, fl, out);
+}
+
+bool face_geometry_haar_roi(t_face *face, t_image *in, float margin, float band, int *roi) {
+	// predicted detection, same as hx in face_geometry_update_features()
+	const float cx = face->geometry->mean[0] + face->geometry->mean[3];
+	const float cy = face->geometry->mean[1] + face->geometry->mean[4];
+	const float w = 2.0 * face->geometry->mean[2];
+
+	// the largest face of the band plus the margin on every side
+	const float half = 0.5 * w * band + margin * w;
+	int x0 = (int)(cx - half), y0 = (int)(cy - half);
+	int x1 = (int)(cx + half), y1 = (int)(cy + half);
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > (int)in->width) x1 = in->width;
+	if (y1 > (int)in->height) y1 = in->height;
+
+	const int minw = (int)(w / band);
+	if (x1 - x0 < minw || y1 - y0 < minw)
+		return false;
+
+	roi[0] = x0;
+	roi[1] = y0;
+	roi[2] = x1 - x0;
+	roi[3] = y1 - y0;
+	roi[4] = minw;
+	roi[5] = (int)(w * band);
+	return true;
+}
+
+bool face_geometry_update_haar_roi(t_face *face, t_image *in, t_haarclass *hc, t_image *out, float margin, float band) {
+	int roi[6];
+	if (!face_geometry_haar_roi(face, in, margin, band, roi))
+		return face_geometry_update_haar(face, in, hc, out);
+
+	t_featurelist *fl = featurelist_haar_region(in, NULL, hc, roi[0], roi[1], roi[2], roi[3], roi[4], roi[5]);
+	if (!fl)
+		return false;
+
+	if (out)
+		draw_box_outline(out, roi[0], roi[1], roi[0] + roi[2] - 1, roi[1] + roi[3] - 1, DRAWING_YUV_YELLOW, 255);
+
+	return face_geometry_update_features(face, in, fl, out);
+}
+
+bool face_geometry_update_detections(t_face *face, t_image *in, t_featurelist *fl, float dx, float dy, t_image *out) {
+	unsigned int i;
+	t_blobfeature *bb = fl->feat.blob;
+
+	// move the detections along with the face since the frame they were found in
+	for (i = 0; i < fl->nfeat; i++, bb++) {
+		bb->p[0] += dx;
+		bb->p[1] += dy;
+	}
+	return face_geometry_update_features(face, in, fl, out);
+}
+
 bool face_geometry_update_color(t_face *face, t_image *in, t_image *out) {
-	t_kalman_state *o = ks_create_shared(3);
+	float om[3], oc[9];
+	t_kalman_state ko;
+	t_kalman_state *o = &ko;
+	ks_init_static(o, om, oc, 3);
 	float Ht[15];
 	float hx[3];
 	unsigned int i, j;
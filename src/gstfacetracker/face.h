@@ -8,12 +8,14 @@
 #include "imagefeature.h"
 
 #define FACE_MIN_RADIUS 10.0
+#define FACE_MAX_SCORE 2.0	// colour * geometry score above which a detection is not the face
 
 typedef struct {
 	t_kalman_state* geometry;
 	t_colorbins* skincolor;
 	t_colorbins* bgcolor;
 	t_colorbins* fgcolor;
+	t_colorscore* skinscore;	// scratch of the candidate scoring, goes with the colour models
 } t_face;
 
 int face_create_bins(t_face* face, t_image *image, unsigned char ymean = 150, unsigned char yvar = 90, unsigned char umean = 125, unsigned char uvar = 25,
@@ -26,6 +28,18 @@ void face_destroy(t_face *face, bool destroy_geometry, bool destroy_colormodels)
 
 void face_geometry_predict(t_face *face);
 bool face_geometry_update_haar(t_face *face, t_image *in, t_haarclass *hc, t_image *out);
+// same, only around the predicted face: margin (of the face size) on every side and face sizes within band
+bool face_geometry_update_haar_roi(t_face *face, t_image *in, t_haarclass *hc, t_image *out, float margin, float band);
+// region searched by the above as x, y, w, h, minw, maxw in roi, false if too small (full frame then)
+bool face_geometry_haar_roi(t_face *face, t_image *in, float margin, float band, int *roi);
+// updates with detections found dx,dy (of the face motion) ago, e.g. on an older frame; fl is destroyed
+bool face_geometry_update_detections(t_face *face, t_image *in, t_featurelist *fl, float dx, float dy, t_image *out);
+// colour * geometry score of every detection of fl as this face (lower is better), into score[fl->nfeat]
+void face_geometry_score_features(t_face *face, t_image *in, t_featurelist *fl, float *score);
+// updates with one detection, e.g. the one assigned to this face
+void face_geometry_update_feature(t_face *face, t_blobfeature *bb);
+// restarts the geometry on a detection
+void face_reset_geometry_at(t_face *face, t_image *image, t_blobfeature *bb);
 bool face_geometry_update_color(t_face *face, t_image *in, t_image *out);
 void face_skincolor_update(t_face *face, t_image *in);
 void face_bgcolor_update(t_face *face, t_image *in);
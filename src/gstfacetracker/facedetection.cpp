@@ -304,8 +304,10 @@ int SetFacesToSeq(struct haar_internalParams& iParams, CCluster* clusters, float
 		}
 	}
 
+	// at most the *np faces p has room for
+	const int max_np = *np;
 	(*np) = 0;
-	for (i = 0, xsum = 0, ysum = 0, wsum = 0; i < mergedclusters->m_currentclustercount; i++, xsum = 0, ysum = 0, wsum = 0) {
+	for (i = 0, xsum = 0, ysum = 0, wsum = 0; i < mergedclusters->m_currentclustercount && i < max_np; i++, xsum = 0, ysum = 0, wsum = 0) {
 
 		for (j = 0; j < mergedclusters->m_count[i]; j++) {
 			xsum += mergedclusters->m_x[i][j];
@@ -703,91 +705,214 @@ int FiniHaar(struct haar_internalParams& iParams) {
 	return FreeHaarClassifier(iParams);
 }
 
+static void free_scales(struct haar_internalParams& iParams) {
+	for (int i = 0; i < iParams.nscales; i++) {
+		struct haar_scale* sc = &iParams.scales[i];
+		if (0 != sc->src8u) ippiFree(sc->src8u);
+		if (0 != sc->src32f) ippiFree(sc->src32f);
+		if (0 != sc->sqr) ippiFree(sc->sqr);
+		if (0 != sc->norm) ippiFree(sc->norm);
+		if (0 != sc->mask) ippiFree(sc->mask);
+		if (0 != sc->resizeBuf) ippsFree(sc->resizeBuf);
+	}
+	free(iParams.scales);
+	iParams.scales = 0;
+	iParams.nscales = 0;
+
+	if (0 != iParams.clusters) {
+		delete iParams.clusters;
+		iParams.clusters = 0;
+	}
+
+	if (0 != iParams.pTmp) {
+		ippiFree(iParams.pTmp);
+		iParams.pTmp = 0;
+	}
+}
+
 int init_ipp_classifier(struct haar_internalParams& iParams, int width, int height, PARAMS_FCDFLT& params, const char* cascade_name) {
 
 	if (iParams.firstTime) {
-		StartHaar(iParams, cascade_name);
+		if (0 != StartHaar(iParams, cascade_name))
+		return -1;
 
 		iParams.firstTime = 0;
+		iParams.face.width = 20;
+		iParams.face.height= 20;
+	}
 
-		iParams.roi0.width = width;
-		iParams.roi0.height = height;
+	if (params.maxfacew <= 0)
+	params.maxfacew = width;
 
-		iParams.rect0.x = 0;
-		iParams.rect0.y = 0;
-		iParams.rect0.width = iParams.roi0.width;
-		iParams.rect0.height = iParams.roi0.height;
+	if (params.minfacew <= 0)
+	params.minfacew = iParams.face.width;
 
-		iParams.rect.x = iParams.bord;
-		iParams.rect.y = iParams.bord;
+	if (iParams.scales && width == iParams.width && height == iParams.height && params.minfacew == iParams.minfacew
+			&& params.maxfacew == iParams.maxfacew && params.sfactor == iParams.sfactor)
+	return 0;
 
-		iParams.pTmp = ippiMalloc_8u_C1(iParams.roi0.width, iParams.roi0.height, &iParams.tmpStep);
-		if (0 == iParams.pTmp)
-		return -1;
+	// a failure below frees the scales again, so the next frame retries
+	free_scales(iParams);
 
-		if (params.maxfacew <= 0)
-		params.maxfacew = iParams.roi0.width;
+	iParams.width = width;
+	iParams.height = height;
+	iParams.minfacew = params.minfacew;
+	iParams.maxfacew = params.maxfacew;
+	iParams.sfactor = params.sfactor;
 
-		if (params.minfacew <= 0)
-                  params.minfacew = iParams.face.width;
+	iParams.roi0.width = width;
+	iParams.roi0.height = height;
 
-		if (iParams.face.width > 0)
-		iParams.factor = ((float)params.minfacew) / ((float)iParams.face.width);
+	iParams.rect0.x = 0;
+	iParams.rect0.y = 0;
+	iParams.rect0.width = iParams.roi0.width;
+	iParams.rect0.height = iParams.roi0.height;
 
-		iParams.maxfacecount = 0;
-                iParams.face.width = 20;
-                iParams.face.height= 20;
-		iParams.maxfacecount = ((iParams.roi0.width / iParams.face.width) * (iParams.roi0.height / iParams.face.height) / 3);
-		iParams.maxrectcount = (int)(iParams.distfactor * iParams.distfactor * params.maxfacew / params.minfacew);
-		iParams.maxfacecount = IPP_MIN(iParams.maxfacecount, 100);
-		iParams.maxrectcount = IPP_MIN(iParams.maxrectcount, 1000);
+	iParams.rect.x = iParams.bord;
+	iParams.rect.y = iParams.bord;
+	iParams.rect.width = iParams.face.width - iParams.bord - iParams.bord;
+	iParams.rect.height = iParams.face.height - iParams.bord - iParams.bord;
 
-		iParams.src32f = ippiMalloc_32f_C1((int)(iParams.roi0.width / iParams.factor + 2), (int)(iParams.roi0.height / iParams.factor
-						+ 2), &iParams.src32fStep);
-		if (0 == iParams.src32f)
+	iParams.pTmp = ippiMalloc_8u_C1(iParams.roi0.width, iParams.roi0.height, &iParams.tmpStep);
+	if (0 == iParams.pTmp) {
+		free_scales(iParams);
 		return -1;
+	}
 
-		iParams.sqr = (Ipp64f*)ippiMalloc_32fc_C1((int)(iParams.roi0.width / iParams.factor + 2), (int)(iParams.roi0.height
-						/ iParams.factor + 2), &iParams.sqrStep);
-		if (0 == iParams.sqr)
-		return -1;
+	iParams.factor = ((float)params.minfacew) / ((float)iParams.face.width);
 
-		iParams.norm = ippiMalloc_32f_C1((int)(iParams.roi0.width / iParams.factor), (int)(iParams.roi0.height / iParams.factor),
-				&iParams.normStep);
-		if (0 == iParams.norm)
-		return -1;
+	iParams.maxfacecount = ((iParams.roi0.width / iParams.face.width) * (iParams.roi0.height / iParams.face.height) / 3);
+	iParams.maxrectcount = (int)(iParams.distfactor * iParams.distfactor * params.maxfacew / params.minfacew);
+	iParams.maxfacecount = IPP_MIN(iParams.maxfacecount, 100);
+	iParams.maxrectcount = IPP_MIN(iParams.maxrectcount, 1000);
 
-		iParams.mask = ippiMalloc_8u_C1((int)(iParams.roi0.width / iParams.factor), (int)(iParams.roi0.height / iParams.factor),
-				&iParams.maskStep);
-		if (0 == iParams.mask)
-		return -1;
+	if (iParams.maxfacecount > 0 && iParams.maxrectcount > 0) {
+		iParams.clusters = new CCluster;
+		if (0 != iParams.clusters->Init(iParams.maxrectcount, iParams.maxfacecount)) {
+			free_scales(iParams);
+			return -1;
+		}
+	}
+
+	// same scales as the scan always did, from minfacew up by sfactor
+	int n = 0;
+	for (Ipp32f f = iParams.factor; iParams.roi0.width / f > iParams.face.width + 5 && iParams.roi0.height / f
+			> iParams.face.height + 5 && iParams.face.width * f < params.maxfacew; f *= params.sfactor)
+	n++;
 
+	iParams.scales = (struct haar_scale*)calloc(n ? n : 1, sizeof(struct haar_scale));
+	if (0 == iParams.scales) {
+		free_scales(iParams);
+		return -1;
+	}
+	iParams.nscales = n;
+
+	Ipp32f f = iParams.factor;
+	for (int i = 0; i < n; i++, f *= params.sfactor) {
+		struct haar_scale* sc = &iParams.scales[i];
+
+		sc->factor = f;
+		sc->roi.width = (int)(iParams.roi0.width / f);
+		sc->roi.height = (int)(iParams.roi0.height / f);
+		sc->roi1.width = sc->roi.width - iParams.classifierSize.width + 1;
+		sc->roi1.height = sc->roi.height - iParams.classifierSize.height + 1;
+
+		sc->src8u = ippiMalloc_8u_C1(sc->roi.width, sc->roi.height, &sc->src8uStep);
+		sc->src32f = ippiMalloc_32f_C1(sc->roi.width + 2, sc->roi.height + 2, &sc->src32fStep);
+		sc->sqr = (Ipp64f*)ippiMalloc_32fc_C1(sc->roi.width + 2, sc->roi.height + 2, &sc->sqrStep);
+		sc->norm = ippiMalloc_32f_C1(sc->roi.width, sc->roi.height, &sc->normStep);
+		sc->mask = ippiMalloc_8u_C1(sc->roi.width, sc->roi.height, &sc->maskStep);
+
+		IppiRect dstRoi = {0, 0, sc->roi.width, sc->roi.height};
+		int bufsize = 0;
+		/* calculation of work buffer size */
+		ippiResizeGetBufSize(iParams.rect0, dstRoi, 1, IPPI_INTER_NN, &bufsize);
+		sc->resizeBuf = ippsMalloc_8u(bufsize);
+
+		if (0 == sc->src8u || 0 == sc->src32f || 0 == sc->sqr || 0 == sc->norm || 0 == sc->mask || 0 == sc->resizeBuf) {
+			free_scales(iParams);
+			return -1;
+		}
 	}
+
 	return 0;
 }
 
 int deinit_ipp_classifier(struct haar_internalParams& iParams) {
 
-	if (0 != iParams.src32f)
-	ippiFree(iParams.src32f);
+	free_scales(iParams);
+
+	return 0;
+}
+
+// Evaluates the cascade on one scale, leaving the candidate positions in its mask.
+// Only touches the buffers of that scale, so scales can be scanned concurrently.
+static int scan_scale(struct haar_internalParams& iParams, struct haar_scale* sc, PARAMS_FCDFLT& params) {
+	IppStatus status;
+	IppiRect dstRoi = {0, 0, sc->roi.width, sc->roi.height};
+
+	status = ippiResizeSqrPixel_8u_C1R(iParams.pTmp, iParams.roi0, iParams.tmpStep, iParams.rect0, sc->src8u, sc->src8uStep,
+			dstRoi, 1.0 / sc->factor, 1.0 / sc->factor, /*IPPI_INTER_LANCZOS*/
+			0, 0, IPPI_INTER_NN, sc->resizeBuf);
+	if (ippStsNoErr != status)
+	return -1;
+
+	status = ippsSet_8u(0, sc->mask, sc->maskStep * sc->roi.height);
+	if (ippStsNoErr != status)
+	return -1;
+
+	status = ippiSqrIntegral_8u32f64f_C1R(sc->src8u, sc->src8uStep, sc->src32f, sc->src32fStep, sc->sqr,
+			sc->sqrStep, sc->roi, (Ipp32f)(-(1 << 24)), 0.0);
+	if (ippStsNoErr != status)
+	return -1;
+
+	status = ippiRectStdDev_32f_C1R(sc->src32f, sc->src32fStep, sc->sqr, sc->sqrStep, sc->norm,
+			sc->normStep, sc->roi1, iParams.rect);
+	if (ippStsNoErr != status)
+	return -1;
+
+	status = ippiSet_8u_C1R(1, sc->mask, sc->maskStep, sc->roi1);
+	if (ippStsNoErr != status)
+	return -1;
+
+	switch (params.pruning) {
+		case RowPruning:
+		PruningSetRow(sc->mask, sc->maskStep, sc->roi1, iParams.pruningParam);
+		break;
+
+		case ColPruning:
+		PruningSetCol(sc->mask, sc->maskStep, sc->roi1, iParams.pruningParam2);
+		break;
+
+		case RowColMixPruning:
+		PruningSetRowColMix(sc->mask, sc->maskStep, sc->roi1, iParams.pruningParam, iParams.pruningParam2);
+		break;
 
-	if (0 != iParams.sqr)
-	ippiFree(iParams.sqr);
+		default:
+		break;
 
-	if (0 != iParams.norm)
-	ippiFree(iParams.norm);
+	}
+
+	int positive = sc->roi1.width * sc->roi1.height;
 
-	if (0 != iParams.mask)
-	ippiFree(iParams.mask);
+	for (int i = 0; i < iParams.stages; i++) {
+		status = ippiApplyHaarClassifier_32f_C1R(sc->src32f, sc->src32fStep, sc->norm, sc->normStep,
+				sc->mask, sc->maskStep, sc->roi1, &positive, iParams.sThreshold[i], iParams.pHaar[i]);
+		if (ippStsNoErr != status)
+		return -1;
 
-	if (0 != iParams.pTmp)
-	ippiFree(iParams.pTmp);
+		if (!positive)
+		break;
+	}
 
 	return 0;
 }
 
 int facedetection_filter(struct haar_internalParams& iParams, const CIppImage& src, PARAMS_FCDFLT& params, float* p, int* np) {
 
+	const int max_np = *np;
+	*np = 0;
+
 #if FACETRK_FORMAT == FACETRK_FORMAT_YUV
 	ippiCopy_8u_C3C1R((const Ipp8u*)src, src.Step(), iParams.pTmp, iParams.tmpStep, iParams.roi0);
 #endif
@@ -806,160 +931,35 @@ int facedetection_filter(struct haar_internalParams& iParams, const CIppImage& s
 	if (ippStsNoErr != iParams.status)
 	return -1;
 
-	if (iParams.maxfacecount > 0 && iParams.maxrectcount > 0) {
-
-		CCluster* clusters = new CCluster;
-		if (0 == clusters)
-		{
-			delete clusters;
-			return -1;
-		}
-
-		i = clusters->Init(iParams.maxrectcount, iParams.maxfacecount);
-		if (i != 0)
-		{
-			delete clusters;
-			return -1;
-		}
-
-		for (; iParams.roi0.width / iParams.factor > iParams.face.width + 5 && iParams.roi0.height / iParams.factor
-				> iParams.face.height + 5 && iParams.face.width * iParams.factor < params.maxfacew; iParams.factor *= params.sfactor) {
-			int src8uStep;
-
-			iParams.roi.width = (int)(iParams.roi0.width / iParams.factor);
-			iParams.roi.height = (int)(iParams.roi0.height / iParams.factor);
-
-			Ipp8u* src8u = ippiMalloc_8u_C1(iParams.roi.width, iParams.roi.height, &src8uStep);
-			if (0 == src8u)
-			{
-				delete clusters;
-				return -1;
-			}
-
-			IppiRect dstRoi = {0,0,iParams.roi.width, iParams.roi.height};
-			int bufsize = 0;
-			/* calculation of work buffer size */
-			ippiResizeGetBufSize( iParams.rect0, dstRoi , 1, IPPI_INTER_NN, &bufsize );
-			Ipp8u* pBuffer = ippsMalloc_8u( bufsize );
-			iParams.status = ippiResizeSqrPixel_8u_C1R(iParams.pTmp, iParams.roi0, iParams.tmpStep, iParams.rect0, src8u, src8uStep,
-					dstRoi, 1.0 / iParams.factor, 1.0 / iParams.factor, /*IPPI_INTER_LANCZOS*/
-					0, 0, IPPI_INTER_NN, pBuffer);
-			ippiFree(pBuffer);
-			if (ippStsNoErr != iParams.status)
-			{
-				delete clusters;
-				if (0 != src8u) {
-					ippiFree(src8u);
-					src8u = 0;
-				}
-				return -1;
-			}
-
-			iParams.status = ippsSet_8u(0, iParams.mask, iParams.maskStep * iParams.roi.height);
-			if (ippStsNoErr != iParams.status)
-			{
-				delete clusters;
-				if (0 != src8u) {
-					ippiFree(src8u);
-					src8u = 0;
-				}
-				return -1;
-			}
-
-			iParams.roi1.width = iParams.roi.width - iParams.classifierSize.width + 1;
-			iParams.roi1.height = iParams.roi.height - iParams.classifierSize.height + 1;
-
-			iParams.rect.width = iParams.face.width - iParams.bord - iParams.bord;
-			iParams.rect.height = iParams.face.height - iParams.bord - iParams.bord;
-
-			iParams.status = ippiSqrIntegral_8u32f64f_C1R(src8u, src8uStep, iParams.src32f, iParams.src32fStep, iParams.sqr,
-					iParams.sqrStep, iParams.roi, (Ipp32f)(-(1 << 24)), 0.0);
-			if (ippStsNoErr != iParams.status)
-			{
-				delete clusters;
-				if (0 != src8u) {
-					ippiFree(src8u);
-					src8u = 0;
-				}
-				return -1;
-			}
-
-			iParams.status = ippiRectStdDev_32f_C1R(iParams.src32f, iParams.src32fStep, iParams.sqr, iParams.sqrStep, iParams.norm,
-					iParams.normStep, iParams.roi1, iParams.rect);
-			if (ippStsNoErr != iParams.status)
-			{
-				delete clusters;
-				if (0 != src8u) {
-					ippiFree(src8u);
-					src8u = 0;
-				}
-				return -1;
-			}
-
-			iParams.status = ippiSet_8u_C1R(1, iParams.mask, iParams.maskStep, iParams.roi1);
-			if (ippStsNoErr != iParams.status)
-			{
-				delete clusters;
-				if (0 != src8u) {
-					ippiFree(src8u);
-					src8u = 0;
-				}
-				return -1;
-			}
-
-			switch (params.pruning) {
-				case RowPruning:
-				PruningSetRow(iParams.mask, iParams.maskStep, iParams.roi1, iParams.pruningParam);
-				break;
-
-				case ColPruning:
-				PruningSetCol(iParams.mask, iParams.maskStep, iParams.roi1, iParams.pruningParam2);
-				break;
-
-				case RowColMixPruning:
-				PruningSetRowColMix(iParams.mask, iParams.maskStep, iParams.roi1, iParams.pruningParam, iParams.pruningParam2);
-				break;
-
-				default:
-				break;
-
-			}
-
-			iParams.positive = iParams.roi1.width * iParams.roi1.height;
-
-			for (i = 0; i < iParams.stages; i++) {
-				iParams.status = ippiApplyHaarClassifier_32f_C1R(iParams.src32f, iParams.src32fStep, iParams.norm, iParams.normStep,
-						iParams.mask, iParams.maskStep, iParams.roi1, &iParams.positive, iParams.sThreshold[i], iParams.pHaar[i]);
-				if (ippStsNoErr != iParams.status)
-				return -1;
-
-				if (!iParams.positive)
-				break;
-			}
-
-			ClusterFaces(iParams, iParams.mask, iParams.roi, iParams.maskStep, clusters, iParams.face, iParams.factor);
+	if (0 == iParams.clusters)
+	return 0;
 
-			if (0 != src8u) {
-				ippiFree(src8u);
-				src8u = 0;
-			}
+	// the scales are independent, only the clustering below needs them in order
+	int failed = 0;
+	#pragma omp parallel for num_threads(params.nthreads > 0 ? params.nthreads : 1) schedule(dynamic, 1) reduction(|:failed)
+	for (i = 0; i < iParams.nscales; i++)
+	failed |= (0 != scan_scale(iParams, &iParams.scales[i], params));
 
-		}
+	if (failed)
+	return -1;
 
-		SetFacesToSeq(iParams, clusters, p, np);
+	CCluster* clusters = iParams.clusters;
+	clusters->m_currentclustercount = 0;
 
-		for (int i = 0; i < *np; i++) {
-			p[4 * i + 1] = src.Size().height - p[4 * i + 1];
-		}
-		if (0 != clusters) {
-			delete clusters;
-			clusters = 0;
-		}
+	for (i = 0; i < iParams.nscales; i++) {
+		struct haar_scale* sc = &iParams.scales[i];
+		ClusterFaces(iParams, sc->mask, sc->roi, sc->maskStep, clusters, iParams.face, sc->factor);
+	}
 
+	*np = max_np;
+	if (SetFacesToSeq(iParams, clusters, p, np) != 0) {
+		*np = 0;
+		return -1;
 	}
 
-	if (iParams.face.width > 0)
-	iParams.factor = ((float)params.minfacew) / ((float)iParams.face.width);
+	for (int i = 0; i < *np; i++) {
+		p[4 * i + 1] = src.Size().height - p[4 * i + 1];
+	}
 
 	return 0;
 } // facedetection_filter()
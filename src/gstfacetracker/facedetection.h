@@ -93,6 +93,26 @@ typedef struct
 
 }PARAMS_FCDFLT;
 
+// buffers of one scale of the scan, resident from one frame to the next
+struct haar_scale {
+	Ipp32f factor;
+	IppiSize roi;
+	IppiSize roi1;
+
+	Ipp8u* src8u;
+	Ipp32f* src32f;
+	Ipp64f* sqr;
+	Ipp32f* norm;
+	Ipp8u* mask;
+	Ipp8u* resizeBuf;
+
+	int src8uStep;
+	int src32fStep;
+	int sqrStep;
+	int normStep;
+	int maskStep;
+};
+
 struct haar_internalParams {
 
 	int minneighbors;
@@ -143,21 +163,24 @@ struct haar_internalParams {
 	int tmpStep;
 	Ipp8u* pTmp;
 
-	Ipp32f* src32f;
-	Ipp64f* sqr;
-	Ipp32f* norm;
-	Ipp8u* mask;
+	// scales of the scan and the parameters they were built for, see init_ipp_classifier()
+	struct haar_scale* scales;
+	int nscales;
+	int width, height;
+	int minfacew, maxfacew;
+	float sfactor;
+	CCluster* clusters;
 
-	int src32fStep;
-	int sqrStep;
-	int normStep;
-	int maskStep;
 	int firstTime;
 
 };
 
 int init_haar_internalParams(haar_internalParams& iParams);
+// np: on input the faces p has room for (4 floats each), on output the faces found
 int facedetection_filter( struct haar_internalParams& iParams, const CIppImage& src, PARAMS_FCDFLT& params, float* p, int* np);
+// Loads the cascade the first time and builds the buffers of every scale for
+// width x height and the face sizes of params. Nothing is done if they did not
+// change since the last call, so it is cheap to call before every detection.
 int init_ipp_classifier( struct haar_internalParams& iParams, int width, int height, PARAMS_FCDFLT& params, const char* cascade_name);
 int deinit_ipp_classifier(struct haar_internalParams& iParams);
 int StartHaar(struct haar_internalParams* iParams, const char* cascade_name);
@@ -17,6 +17,7 @@
 #include "face.h"
 #include "facedetection.h"
 #include "drawing.h"
+#include <string.h>
 #include <gst/controller/gstcontroller.h>
 
 
@@ -33,6 +34,18 @@ GST_DEBUG_CATEGORY_STATIC (gst_facetracker_debug);
 #define DEFAULT_MIN_SIZE_WIDTH 0
 #define DEFAULT_MIN_SIZE_HEIGHT 0
 #define DEFAULT_FPS G_MAXINT
+#define DEFAULT_ROI FALSE
+#define DEFAULT_ROI_MARGIN 0.5
+#define DEFAULT_ROI_SCALE_BAND 1.5
+#define DEFAULT_FULL_SCAN_INTERVAL 15
+#define DEFAULT_FULL_SCAN_MISSES 3
+#define DEFAULT_HAAR_THREADS 1
+#define DEFAULT_ASYNC FALSE
+#define DEFAULT_MAX_FACES 1
+#define DEFAULT_MAX_CANDIDATES HAARCLASS_MAX_CANDIDATES
+#define DEFAULT_TRACK_MISSES 5
+#define DEFAULT_STATS_INTERVAL STAGEPROF_DEFAULT_INTERVAL
+#define DEFAULT_STATS_MESSAGES FALSE
 
 #define FACETRACKER_TIMEOUT 200000000
 
@@ -52,6 +65,19 @@ enum {
 	PROP_DEBUG,
 	PROP_SHOWSKIN,
   PROP_ENABLESKIN,
+  PROP_LEARNSKIN,
+  PROP_ROI,
+  PROP_ROI_MARGIN,
+  PROP_ROI_SCALE_BAND,
+  PROP_FULL_SCAN_INTERVAL,
+  PROP_FULL_SCAN_MISSES,
+  PROP_HAAR_THREADS,
+  PROP_ASYNC,
+  PROP_MAX_FACES,
+  PROP_TRACK_MISSES,
+  PROP_MAX_CANDIDATES,
+  PROP_STATS_INTERVAL,
+  PROP_STATS_MESSAGES,
 	PROP_LAST
 };
 
@@ -89,16 +115,25 @@ static void gst_facetracker_set_property(GObject * object, guint prop_id, const
 static void gst_facetracker_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
 static void gst_facetracker_finalize(GObject * object);
 
-gint gstfacetracker_send_event_downstream(struct _GstFacetracker *facetracker, GstBaseTransform * btrans, bool has_haarface);
+gint gstfacetracker_send_event_downstream(struct _GstFacetracker *facetracker, GstBaseTransform * btrans,
+                                          t_face *face, gint id, bool has_haarface);
 gint gstfacetracker_send_bus_event(struct _GstFacetracker *facetracker, GstBaseTransform * btrans, 
-                                   bool has_haarface, GstBuffer * buf);
-gint gstfacetracker_printinfo_n_display(struct _GstFacetracker *facetracker, GstBaseTransform * btrans, bool has_haarface);
+                                   t_face *face, gint id, bool has_haarface, GstBuffer * buf);
+gint gstfacetracker_printinfo_n_display(struct _GstFacetracker *facetracker, GstBaseTransform * btrans,
+                                        t_face *face, bool has_haarface);
 gint gstfacetracker_find_skin_center_of_mass(struct _GstFacetracker *facetracker, float *x, float *y, gint display,
                                              float seed_x, float seed_y, float seed_r, bool facefound);
+void gstfacetracker_learn_skin(struct _GstFacetracker *facetracker, t_face *face);
+static void gstfacetracker_stop_detection(GstFacetracker *ft);
+static void gstfacetracker_drop_tracks(GstFacetracker *ft, gint keep, GstBaseTransform *btrans, GstBuffer *gstbuf);
+static void gstfacetracker_set_max_candidates(GstFacetracker *ft);
 
 GST_BOILERPLATE (GstFacetracker, gst_facetracker, GstVideoFilter, GST_TYPE_VIDEO_FILTER);
 
 void CleanFacetracker(GstFacetracker *facetracker) {
+	// the worker uses hc and the frame size
+	gstfacetracker_stop_detection(facetracker);
+	gstfacetracker_drop_tracks(facetracker, 0, NULL, NULL);
 	if (facetracker->face) {
 		face_destroy(facetracker->face, true, true);
 		facetracker->face = NULL;
@@ -107,6 +142,13 @@ void CleanFacetracker(GstFacetracker *facetracker) {
 		destroy_image(facetracker->image);
 		facetracker->image = NULL;
 	}
+	if (facetracker->skinlut) {
+		skinlut_destroy(facetracker->skinlut);
+		facetracker->skinlut = NULL;
+	}
+	if (facetracker->skinmask) {
+		cvReleaseImage(&facetracker->skinmask);
+	}
 #if (FACETRK_FORMAT == FACETRK_FORMAT_RGBA) || (FACETRK_FORMAT == FACETRK_FORMAT_YUVA && !defined(USE_IPP))
 	if (facetracker->cvYUV) {
 		cvReleaseImage(&facetracker->cvYUV);
@@ -131,6 +173,7 @@ void CleanFacetracker(GstFacetracker *facetracker) {
 #endif
 	if (facetracker->hc) {
 		haarclass_destroy(facetracker->hc);
+		facetracker->hc = NULL;
 	}
 
 	printf("Face detection rate: total:%ld found:%ld(%.2f%%)\n",facetracker->frameCount,facetracker->faceCount,(facetracker->faceCount*100.0)/facetracker->frameCount);
@@ -166,10 +209,11 @@ static void gst_facetracker_class_init(GstFacetrackerClass * klass) {
 			FALSE, (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS) ) );
 
 	g_object_class_install_property(gobject_class, PROP_STATS,
-			g_param_spec_string("stats", "statslog", "statistical info",
+			g_param_spec_string("stats", "statslog", "statistical info: the frame times if fps is set, then the count, mean, "
+			"median, 95th percentile and maximum milliseconds of each stage over the last stats-interval",
 			"",	(GParamFlags)(G_PARAM_READABLE | GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_STRINGS)));
 
-	g_object_class_install_property(gobject_class, PROP_SETFPS, g_param_spec_int("setfps", "SETFPS", "set the maximum frames/second", 1,
+	g_object_class_install_property(gobject_class, PROP_SETFPS, g_param_spec_int("setfps", "SETFPS", "set the maximum face detections/second, the frames in between are tracked on colour", 1,
 			G_MAXINT, DEFAULT_FPS, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
 	g_object_class_install_property(gobject_class, PROP_DISPLAY, g_param_spec_boolean("display", "Display",
@@ -205,6 +249,59 @@ static void gst_facetracker_class_init(GstFacetrackerClass * klass) {
             "If set to true use skin colour patches & gravity center to assist face tracker", TRUE, (GParamFlags)(G_PARAM_READWRITE
                     | G_PARAM_STATIC_STRINGS)));
 
+  g_object_class_install_property(gobject_class, PROP_LEARNSKIN, g_param_spec_boolean("learnskin", "LearnSkin",
+            "If set, the skin colour model is learned from the detected faces and published to the skin consumers (skin, gcs)", FALSE, (GParamFlags)(G_PARAM_READWRITE
+                    | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_ROI, g_param_spec_boolean("roi", "ROI",
+            "If set, the Haar detector only searches around the predicted face, with a full frame scan every full-scan-interval "
+            "frames or after full-scan-misses frames without a face", DEFAULT_ROI, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_ROI_MARGIN, g_param_spec_double("roi-margin", "ROI margin",
+            "Margin searched on every side of the predicted face, relative to its size", 0.0, 10.0, DEFAULT_ROI_MARGIN,
+            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_ROI_SCALE_BAND, g_param_spec_double("roi-scale-band", "ROI scale band",
+            "Face sizes searched, from the predicted one divided by this to the predicted one times this", 1.0, 10.0,
+            DEFAULT_ROI_SCALE_BAND, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_FULL_SCAN_INTERVAL, g_param_spec_int("full-scan-interval", "Full scan interval",
+            "Frames between two full frame scans in roi mode (0 = only after misses)", 0, G_MAXINT, DEFAULT_FULL_SCAN_INTERVAL,
+            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_FULL_SCAN_MISSES, g_param_spec_int("full-scan-misses", "Full scan misses",
+            "Consecutive frames without a face after which roi mode scans the full frame until a face is found", 1, G_MAXINT,
+            DEFAULT_FULL_SCAN_MISSES, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_HAAR_THREADS, g_param_spec_int("haar-threads", "Haar threads",
+            "Threads scanning the scales of the Haar cascade concurrently (IPP build only)", 1, 64, DEFAULT_HAAR_THREADS,
+            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_ASYNC, g_param_spec_boolean("async", "Async",
+            "If set, the Haar detection runs on a worker thread on the latest frame, every frame is tracked on colour "
+            "and the detections are merged as they complete", DEFAULT_ASYNC, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_MAX_FACES, g_param_spec_int("max-faces", "Max faces",
+            "Faces tracked at most, each sent in its own facelocation event with its \"id\", and a last one with "
+            "facefound FALSE when it is dropped; above 1 the roi, async and enableskin modes are not used", 1, FACETRACKER_MAX_FACES, DEFAULT_MAX_FACES,
+            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_TRACK_MISSES, g_param_spec_int("track-misses", "Track misses",
+            "With max-faces above 1, detection passes in a row without a face after which it is no longer tracked", 1, G_MAXINT,
+            DEFAULT_TRACK_MISSES, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_MAX_CANDIDATES, g_param_spec_int("max-candidates", "Max candidates",
+            "Detections kept at most per Haar pass, the ones beyond are dropped", 1, 4096, DEFAULT_MAX_CANDIDATES,
+            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_STATS_INTERVAL, g_param_spec_int("stats-interval", "Stats interval",
+            "Milliseconds summarised by the stages of stats", 100, 60000, DEFAULT_STATS_INTERVAL,
+            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_STATS_MESSAGES, g_param_spec_boolean("stats-messages", "Stats messages",
+            "Post the stages of stats as a stageprof element message every stats-interval", DEFAULT_STATS_MESSAGES,
+            (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
 
 	btrans_class->passthrough_on_same_caps = TRUE;
 	//btrans_class->always_in_place = TRUE;
@@ -237,8 +334,34 @@ static void gst_facetracker_init(GstFacetracker * facetracker, GstFacetrackerCla
   facetracker->imageCpy = NULL;
 #endif
   facetracker->image = NULL;
+  facetracker->skinlut = NULL;
+  facetracker->skinmask = NULL;
+  facetracker->skinmodel = (t_skinlut_model*)g_malloc0(sizeof(t_skinlut_model));
+  facetracker->learnskin = false;
+  facetracker->roi = DEFAULT_ROI;
+  facetracker->roi_margin = DEFAULT_ROI_MARGIN;
+  facetracker->roi_scale_band = DEFAULT_ROI_SCALE_BAND;
+  facetracker->full_scan_interval = DEFAULT_FULL_SCAN_INTERVAL;
+  facetracker->full_scan_misses = DEFAULT_FULL_SCAN_MISSES;
+  facetracker->frames_since_full_scan = 0;
+  facetracker->haar_misses = 0;
+  facetracker->haar_threads = DEFAULT_HAAR_THREADS;
+  facetracker->max_candidates = DEFAULT_MAX_CANDIDATES;
+  facetracker->async = DEFAULT_ASYNC;
+  facetracker->det_thread = NULL;
+  facetracker->det_lock = g_mutex_new();
+  facetracker->det_cond = g_cond_new();
+  facetracker->det_image = NULL;
+  facetracker->det_result = NULL;
+  facetracker->max_faces = DEFAULT_MAX_FACES;
+  facetracker->track_misses = DEFAULT_TRACK_MISSES;
+  facetracker->ntracks = 0;
+  facetracker->next_track_id = 0;
   facetracker->timer = 0;
   facetracker->statslog = NULL;
+  facetracker->stats_interval = DEFAULT_STATS_INTERVAL;
+  facetracker->stats_messages = DEFAULT_STATS_MESSAGES;
+  facetracker->prof = stageprof_create(facetracker->stats_interval);
 }
 
 static void gst_facetracker_finalize(GObject * object) {
@@ -247,11 +370,15 @@ static void gst_facetracker_finalize(GObject * object) {
 	GST_FACETRACKER_LOCK (facetracker);
 	CleanFacetracker(facetracker);
 	g_free(facetracker->profile);
+	g_free(facetracker->skinmodel);
 	statslog_destroy(facetracker->statslog);
+	stageprof_destroy(facetracker->prof);
 	GST_FACETRACKER_UNLOCK (facetracker);
 	GST_INFO("Facetracker destroyed (%s).", GST_OBJECT_NAME(object));
 
 	g_static_mutex_free(&facetracker->lock);
+	g_mutex_free(facetracker->det_lock);
+	g_cond_free(facetracker->det_cond);
 
 	G_OBJECT_CLASS(parent_class)->finalize(object);
 }
@@ -307,6 +434,51 @@ static void gst_facetracker_set_property(GObject * object, guint prop_id, const
   case PROP_ENABLESKIN:
     facetracker->enableskin = g_value_get_boolean(value);
     break;
+  case PROP_LEARNSKIN:
+    facetracker->learnskin = g_value_get_boolean(value);
+    break;
+  case PROP_ROI:
+    facetracker->roi = g_value_get_boolean(value);
+    break;
+  case PROP_ROI_MARGIN:
+    facetracker->roi_margin = g_value_get_double(value);
+    break;
+  case PROP_ROI_SCALE_BAND:
+    facetracker->roi_scale_band = g_value_get_double(value);
+    break;
+  case PROP_FULL_SCAN_INTERVAL:
+    facetracker->full_scan_interval = g_value_get_int(value);
+    break;
+  case PROP_FULL_SCAN_MISSES:
+    facetracker->full_scan_misses = g_value_get_int(value);
+    break;
+  case PROP_HAAR_THREADS:
+    facetracker->haar_threads = g_value_get_int(value);
+    if (facetracker->hc)
+      facetracker->hc->nthreads = facetracker->haar_threads;
+    break;
+  case PROP_ASYNC:
+    // the worker is started or stopped by the next frame
+    facetracker->async = g_value_get_boolean(value);
+    break;
+  case PROP_MAX_FACES:
+    // the tracks above it are dropped by the next frame
+    facetracker->max_faces = g_value_get_int(value);
+    break;
+  case PROP_TRACK_MISSES:
+    facetracker->track_misses = g_value_get_int(value);
+    break;
+  case PROP_MAX_CANDIDATES:
+    // the detection buffer is resized by the next frame, the worker may be using it
+    facetracker->max_candidates = g_value_get_int(value);
+    break;
+  case PROP_STATS_INTERVAL:
+    facetracker->stats_interval = g_value_get_int(value);
+    stageprof_set_interval(facetracker->prof, facetracker->stats_interval);
+    break;
+  case PROP_STATS_MESSAGES:
+    facetracker->stats_messages = g_value_get_boolean(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -322,15 +494,21 @@ static void gst_facetracker_get_property(GObject * object, guint prop_id, GValue
   case PROP_FPS:
     g_value_set_boolean(value, facetracker->statslog != NULL);
     break;
-  case PROP_STATS:
+  case PROP_STATS: {
+    char buffer[1024], stages[1024];
+    stageprof_print(facetracker->prof, stages, sizeof(stages));
     if (facetracker->statslog) {
-      char buffer[1024];
       statslog_print_frame_time(facetracker->statslog, buffer);
+      if (strcmp(stages, "NA")) {
+        g_strlcat(buffer, " | ", sizeof(buffer));
+        g_strlcat(buffer, stages, sizeof(buffer));
+      }
       g_value_set_string(value, buffer);
     } else {
-      g_value_set_string(value, "NA");
+      g_value_set_string(value, stages);
     }
     break;
+  }
   case PROP_SETFPS:
     g_value_set_int(value, facetracker->setfps);
     break;
@@ -361,6 +539,45 @@ static void gst_facetracker_get_property(GObject * object, guint prop_id, GValue
   case PROP_ENABLESKIN:
     g_value_set_boolean(value, facetracker->enableskin);
     break;
+  case PROP_LEARNSKIN:
+    g_value_set_boolean(value, facetracker->learnskin);
+    break;
+  case PROP_ROI:
+    g_value_set_boolean(value, facetracker->roi);
+    break;
+  case PROP_ROI_MARGIN:
+    g_value_set_double(value, facetracker->roi_margin);
+    break;
+  case PROP_ROI_SCALE_BAND:
+    g_value_set_double(value, facetracker->roi_scale_band);
+    break;
+  case PROP_FULL_SCAN_INTERVAL:
+    g_value_set_int(value, facetracker->full_scan_interval);
+    break;
+  case PROP_FULL_SCAN_MISSES:
+    g_value_set_int(value, facetracker->full_scan_misses);
+    break;
+  case PROP_HAAR_THREADS:
+    g_value_set_int(value, facetracker->haar_threads);
+    break;
+  case PROP_ASYNC:
+    g_value_set_boolean(value, facetracker->async);
+    break;
+  case PROP_MAX_FACES:
+    g_value_set_int(value, facetracker->max_faces);
+    break;
+  case PROP_TRACK_MISSES:
+    g_value_set_int(value, facetracker->track_misses);
+    break;
+  case PROP_MAX_CANDIDATES:
+    g_value_set_int(value, facetracker->max_candidates);
+    break;
+  case PROP_STATS_INTERVAL:
+    g_value_set_int(value, facetracker->stats_interval);
+    break;
+  case PROP_STATS_MESSAGES:
+    g_value_set_boolean(value, facetracker->stats_messages);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -448,6 +665,11 @@ static gboolean gst_facetracker_set_caps(GstBaseTransform * btrans, GstCaps * in
   GST_INFO("Initialising Facetracker...");
   CleanFacetracker(facetracker);
   facetracker->hc = haarclass_create(facetracker->profile);
+  if (facetracker->hc) {
+    facetracker->hc->nthreads = facetracker->haar_threads;
+    haarclass_prepare(facetracker->hc, facetracker->width, facetracker->height);
+    gstfacetracker_set_max_candidates(facetracker);
+  }
   
   //const CvSize size = cvSize(facetracker->width, facetracker->height);
 #if FACETRK_FORMAT == FACETRK_FORMAT_RGBA
@@ -494,11 +716,320 @@ static void gst_facetracker_before_transform(GstBaseTransform * btrans, GstBuffe
 		gst_object_sync_values(G_OBJECT(facetracker), timestamp);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// in roi mode only around the prediction, unless it is time for a full scan or
+// the face has not been seen for a while (or ever)
+static bool gstfacetracker_full_scan(GstFacetracker *ft)
+{
+  ft->frames_since_full_scan++;
+  if( !ft->roi || (ft->faceCount == 0) || (ft->haar_misses >= ft->full_scan_misses) ||
+      (ft->full_scan_interval && ft->frames_since_full_scan >= ft->full_scan_interval) ){
+    ft->frames_since_full_scan = 0;
+    return true;
+  }
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// detection buffer of hc for max-candidates, not while the worker runs
+static void gstfacetracker_set_max_candidates(GstFacetracker *ft)
+{
+  if( haarclass_set_max_candidates(ft->hc, ft->max_candidates) != 0 ){
+    GST_WARNING_OBJECT(ft, "no room for %d candidates, keeping %u", ft->max_candidates, ft->hc->max_candidates);
+    ft->max_candidates = ft->hc->max_candidates;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Detection worker: waits for a frame, runs the Haar cascade on it without the
+// element lock and leaves the detections in det_result for the streaming thread.
+static gpointer gstfacetracker_detection_worker(gpointer data)
+{
+  GstFacetracker *ft = GST_FACETRACKER (data);
+
+  g_mutex_lock(ft->det_lock);
+  while( !ft->det_quit ){
+    if( !ft->det_pending ){
+      g_cond_wait(ft->det_cond, ft->det_lock);
+      continue;
+    }
+    ft->det_pending = false;
+    ft->det_busy = true;
+    g_mutex_unlock(ft->det_lock);
+
+    t_featurelist *fl;
+    const guint64 t = stageprof_start(ft->prof);
+    if( ft->det_full )
+      fl = featurelist_haar(ft->det_image, NULL, ft->hc);
+    else
+      fl = featurelist_haar_region(ft->det_image, NULL, ft->hc, ft->det_roi[0], ft->det_roi[1],
+                                   ft->det_roi[2], ft->det_roi[3], ft->det_roi[4], ft->det_roi[5]);
+    stageprof_stop(ft->prof, STAGEPROF_DETECT, t);
+
+    g_mutex_lock(ft->det_lock);
+    if( ft->det_result )
+      featurelist_destroy_custom(ft->det_result);
+    ft->det_result = fl;
+    ft->det_done = true;
+    ft->det_busy = false;
+  }
+  g_mutex_unlock(ft->det_lock);
+  return NULL;
+}
+
+static void gstfacetracker_start_detection(GstFacetracker *ft)
+{
+  ft->det_image = create_image(COLOR_SPACE_YUV, IMAGE_DATA_FORMAT_PACKED);
+  alloc_image(ft->det_image, ft->width, ft->height);
+  ft->det_quit = ft->det_pending = ft->det_busy = ft->det_done = false;
+  ft->det_result = NULL;
+
+  ft->det_thread = g_thread_create(gstfacetracker_detection_worker, ft, TRUE, NULL);
+  if( !ft->det_thread ){
+    GST_WARNING_OBJECT(ft, "could not start the detection thread, detecting on the streaming thread");
+    free_image(ft->det_image);
+    destroy_image(ft->det_image);
+    ft->det_image = NULL;
+    ft->async = false;
+  }
+}
+
+static void gstfacetracker_stop_detection(GstFacetracker *ft)
+{
+  if( !ft->det_thread )
+    return;
+
+  g_mutex_lock(ft->det_lock);
+  ft->det_quit = true;
+  g_cond_signal(ft->det_cond);
+  g_mutex_unlock(ft->det_lock);
+  g_thread_join(ft->det_thread);
+  ft->det_thread = NULL;
+
+  if( ft->det_result ){
+    featurelist_destroy_custom(ft->det_result);
+    ft->det_result = NULL;
+  }
+  free_image(ft->det_image);
+  destroy_image(ft->det_image);
+  ft->det_image = NULL;
+}
+
+// hands the current frame to the worker, unless it is still busy on a previous one
+static bool gstfacetracker_submit_detection(GstFacetracker *ft, GstClockTime ts)
+{
+  bool submitted = false;
+
+  g_mutex_lock(ft->det_lock);
+  if( !ft->det_busy ){
+    copy_image(ft->det_image, ft->image);
+    ft->det_full = gstfacetracker_full_scan(ft) ||
+      !face_geometry_haar_roi(ft->face, ft->image, ft->roi_margin, ft->roi_scale_band, ft->det_roi);
+    ft->det_x = ft->face->geometry->mean[0];
+    ft->det_y = ft->face->geometry->mean[1];
+    ft->det_ts = ts;
+    ft->det_pending = true;
+    g_cond_signal(ft->det_cond);
+    submitted = true;
+  }
+  g_mutex_unlock(ft->det_lock);
+  return submitted;
+}
+
+// merges the detections of the worker, if any completed since the last frame,
+// moved by what the face moved since their frame was submitted. Returns true if
+// there were any, found tells if they matched the face.
+static bool gstfacetracker_merge_detection(GstFacetracker *ft, GstClockTime ts, bool *found)
+{
+  g_mutex_lock(ft->det_lock);
+  if( !ft->det_done ){
+    g_mutex_unlock(ft->det_lock);
+    return false;
+  }
+  t_featurelist *fl = ft->det_result;
+  const float dx = ft->face->geometry->mean[0] - ft->det_x;
+  const float dy = ft->face->geometry->mean[1] - ft->det_y;
+  const GstClockTime det_ts = ft->det_ts;
+  ft->det_result = NULL;
+  ft->det_done = false;
+  g_mutex_unlock(ft->det_lock);
+
+  GST_LOG_OBJECT(ft, "detection on %" GST_TIME_FORMAT " merged on %" GST_TIME_FORMAT ", moved by (%.1f,%.1f)",
+                 GST_TIME_ARGS(det_ts), GST_TIME_ARGS(ts), dx, dy);
+  *found = fl ? face_geometry_update_detections(ft->face, ft->image, fl, dx, dy, NULL) : false;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Multi-face mode: a table of faces, each with its own Kalman geometry and
+// colour models, fed by one Haar detection pass per setfps slot.
+// With a frame, the track signs off with a last event and message of its id
+// with facefound FALSE
+static void gstfacetracker_remove_track(GstFacetracker *ft, gint i, GstBaseTransform *btrans, GstBuffer *gstbuf)
+{
+  if( btrans ){
+    gstfacetracker_send_event_downstream(ft, btrans, ft->tracks[i].face, ft->tracks[i].id, false);
+    gstfacetracker_send_bus_event(ft, btrans, ft->tracks[i].face, ft->tracks[i].id, false, gstbuf);
+  }
+  face_destroy(ft->tracks[i].face, true, true);
+  ft->ntracks--;
+  memmove(&ft->tracks[i], &ft->tracks[i + 1], (ft->ntracks - i) * sizeof(GstFacetrackerTrack));
+}
+
+// the newest tracks above keep are dropped
+static void gstfacetracker_drop_tracks(GstFacetracker *ft, gint keep, GstBaseTransform *btrans, GstBuffer *gstbuf)
+{
+  while( ft->ntracks > keep )
+    gstfacetracker_remove_track(ft, ft->ntracks - 1, btrans, gstbuf);
+}
+
+// true if the detection lies on the box of a tracked face
+static bool gstfacetracker_tracked(GstFacetracker *ft, t_blobfeature *bb)
+{
+  for( gint i = 0; i < ft->ntracks; i++ ){
+    const float *m = ft->tracks[i].face->geometry->mean;
+    if( fabs(bb->p[0] - m[0]) < m[2] && fabs(bb->p[1] - m[1]) < m[2] )
+      return true;
+  }
+  return false;
+}
+
+// Greedy assignment of the detections to the tracks, lowest colour * geometry
+// score first, as long as it is below the one a single face accepts. The
+// detections left start new tracks unless on a tracked face already.
+static void gstfacetracker_assign_detections(GstFacetracker *ft, t_featurelist *fl)
+{
+  const unsigned int nc = fl->nfeat;
+  const gint nt = ft->ntracks;
+  if( nc == 0 )
+    return;
+
+  float *cost = g_new(float, nt * nc + 1);
+  bool  *taken = g_new0(bool, nc);
+  for( gint t = 0; t < nt; t++ )
+    face_geometry_score_features(ft->tracks[t].face, ft->image, fl, cost + t * nc);
+
+  for( ;; ){
+    gint bt = -1;
+    unsigned int bc = 0;
+    float best = FACE_MAX_SCORE;
+    for( gint t = 0; t < nt; t++ ){
+      if( ft->tracks[t].found )
+        continue;
+      for( unsigned int c = 0; c < nc; c++ )
+        if( !taken[c] && cost[t * nc + c] < best ){
+          best = cost[t * nc + c];
+          bt = t;
+          bc = c;
+        }
+    }
+    if( bt < 0 )
+      break;
+    face_geometry_update_feature(ft->tracks[bt].face, &fl->feat.blob[bc]);
+    ft->tracks[bt].found = true;
+    ft->tracks[bt].hits++;
+    taken[bc] = true;
+  }
+
+  for( unsigned int c = 0; c < nc && ft->ntracks < ft->max_faces; c++ ){
+    t_blobfeature *bb = &fl->feat.blob[c];
+    if( taken[c] || gstfacetracker_tracked(ft, bb) )
+      continue;
+    GstFacetrackerTrack *track = &ft->tracks[ft->ntracks++];
+    track->id = ft->next_track_id++;
+    track->face = face_create(ft->image);
+    face_reset_geometry_at(track->face, ft->image, bb);
+    track->hits = 1;
+    track->misses = 0;
+    track->found = true;
+    GST_DEBUG_OBJECT(ft, "face %d appeared on (%.1f,%.1f)", track->id, bb->p[0], bb->p[1]);
+  }
+
+  g_free(cost);
+  g_free(taken);
+}
+
+static void gstfacetracker_track_faces(GstFacetracker *ft, GstBaseTransform *btrans, GstBuffer *gstbuf, uint64_t now_time)
+{
+  gint i;
+  bool has_haarface = false;
+
+  // max-faces lowered since the last frame
+  gstfacetracker_drop_tracks(ft, ft->max_faces, btrans, gstbuf);
+  guint64 t_track = stageprof_start(ft->prof);
+
+  for( i = 0; i < ft->ntracks; i++ ){
+    face_geometry_predict(ft->tracks[i].face);
+    ft->tracks[i].found = false;
+  }
+
+  // one detection pass for all the faces every setfps slot, the frames in
+  // between and the faces it missed are tracked on their colour bins
+  const bool detected = (ft->setfps_time < now_time);
+  if( detected ){
+    ft->setfps_time = now_time + ft->setfps_delay;
+    const guint64 t = stageprof_start(ft->prof);
+    t_featurelist *fl = featurelist_haar(ft->image, NULL, ft->hc);
+    t_track += stageprof_stop(ft->prof, STAGEPROF_DETECT, t);
+    if( fl ){
+      gstfacetracker_assign_detections(ft, fl);
+      featurelist_destroy_custom(fl);
+    }
+  }
+
+  bool learnt = false;
+  for( i = 0; i < ft->ntracks; i++ ){
+    GstFacetrackerTrack *track = &ft->tracks[i];
+    if( !track->found )
+      face_geometry_update_color(track->face, ft->image, NULL);
+    else if( ft->learnskin && !learnt ){
+      // the oldest face found is the one published
+      gstfacetracker_learn_skin(ft, track->face);
+      learnt = true;
+    }
+    else {
+      face_bgcolor_update(track->face, ft->image);
+      face_skincolor_update(track->face, ft->image);
+    }
+    if( detected )
+      track->misses = track->found ? 0 : track->misses + 1;
+    has_haarface |= track->found;
+  }
+
+  for( i = 0; i < ft->ntracks; ){
+    if( ft->tracks[i].misses >= ft->track_misses ){
+      GST_DEBUG_OBJECT(ft, "face %d lost after %d detections", ft->tracks[i].id, ft->tracks[i].hits);
+      gstfacetracker_remove_track(ft, i, btrans, gstbuf);
+    }
+    else
+      i++;
+  }
+
+  if( detected )
+    ft->haar_misses = has_haarface ? 0 : ft->haar_misses + 1;
+  if( has_haarface ){
+    ft->faceCount++;
+    ft->frame_last_known_face = ft->frameCount;
+  }
+
+  stageprof_stop(ft->prof, STAGEPROF_TRACK, t_track);
+
+  for( i = 0; i < ft->ntracks; i++ ){
+    GstFacetrackerTrack *track = &ft->tracks[i];
+    const guint64 t = stageprof_start(ft->prof);
+    gstfacetracker_printinfo_n_display(ft, btrans, track->face, track->found);
+    stageprof_stop(ft->prof, STAGEPROF_DRAW, t);
+    gstfacetracker_send_event_downstream(ft, btrans, track->face, track->id, track->found);
+    gstfacetracker_send_bus_event(ft, btrans, track->face, track->id, track->found, gstbuf);
+  }
+}
+
 static GstFlowReturn gst_facetracker_transform_ip(GstBaseTransform * btrans, GstBuffer * gstbuf) 
 {
   GstFacetracker *facetracker = GST_FACETRACKER (btrans);
   bool has_haarface;
   uint64_t now_time;
+  GstMessage *stats = NULL;
   facetracker->frameCount++;
 
   if(facetracker->debug){
@@ -516,134 +1047,199 @@ static GstFlowReturn gst_facetracker_transform_ip(GstBaseTransform * btrans, Gst
   }
 
   GST_FACETRACKER_LOCK (facetracker);
-
-  if (facetracker->setfps_time < now_time) {
-    facetracker->setfps_time = now_time + facetracker->setfps_delay;
+  const guint64 t_frame = stageprof_frame_start(facetracker->prof);
 
 #if FACETRK_FORMAT == FACETRK_FORMAT_RGBA
-    facetracker->img->imageData = (char*)GST_BUFFER_DATA(gstbuf);
-    cvCvtColor(facetracker->img, facetracker->cvYUV, CV_RGB2YUV);
+  const guint64 t_convert = stageprof_start(facetracker->prof);
+  facetracker->img->imageData = (char*)GST_BUFFER_DATA(gstbuf);
+  cvCvtColor(facetracker->img, facetracker->cvYUV, CV_RGB2YUV);
+  stageprof_stop(facetracker->prof, STAGEPROF_CONVERT, t_convert);
 #endif
 
 #if (FACETRK_FORMAT == FACETRK_FORMAT_YUVA) || (FACETRK_FORMAT == FACETRK_FORMAT_YUV)
-    setdata_image(facetracker->image, (unsigned char*)GST_BUFFER_DATA(gstbuf));
-    if (facetracker->face == NULL)
-      facetracker->face = face_create(facetracker->image);
+  setdata_image(facetracker->image, (unsigned char*)GST_BUFFER_DATA(gstbuf));
+  if (facetracker->face == NULL)
+    facetracker->face = face_create(facetracker->image);
 #endif
 
-    ////////////////////////////////////////////////////////////////////////////
-    // geometry prediction /////////////////////////////////////////////////////
-    face_geometry_predict(facetracker->face);
+  // with the worker stopped, it is restarted below
+  if (facetracker->hc && facetracker->hc->max_candidates != (unsigned int)facetracker->max_candidates) {
+    gstfacetracker_stop_detection(facetracker);
+    gstfacetracker_set_max_candidates(facetracker);
+  }
+
+  const bool async = facetracker->async && facetracker->max_faces == 1;
+  if (async && !facetracker->det_thread)
+    gstfacetracker_start_detection(facetracker);
+  else if (!async && facetracker->det_thread)
+    gstfacetracker_stop_detection(facetracker);
 
+  if (facetracker->max_faces > 1) {
+    gstfacetracker_track_faces(facetracker, btrans, gstbuf, now_time);
+    if (stageprof_frame_end(facetracker->prof, t_frame) && facetracker->stats_messages)
+      stats = stageprof_message(facetracker->prof, GST_OBJECT(facetracker));
+    GST_FACETRACKER_UNLOCK (facetracker);
+    if (stats)
+      gst_element_post_message(GST_ELEMENT(facetracker), stats);
+    if (facetracker->statslog)
+      statslog_frame_stop(facetracker->statslog);
+    return GST_FLOW_OK;
+  }
+  gstfacetracker_drop_tracks(facetracker, 0, btrans, gstbuf);
+
+  ////////////////////////////////////////////////////////////////////////////
+  // geometry prediction /////////////////////////////////////////////////////
+  // tracking is timed up to the display, less the detection on this thread
+  guint64 t_track = stageprof_start(facetracker->prof);
+  face_geometry_predict(facetracker->face);
+
+  // a detection every setfps slot, on this thread or on the worker, the
+  // frames in between are tracked on the colour bins
+  bool detected = false;
+  has_haarface = false;
+  if (facetracker->det_thread) {
+    detected = gstfacetracker_merge_detection(facetracker, GST_BUFFER_TIMESTAMP(gstbuf), &has_haarface);
+    if (!has_haarface)
+      face_geometry_update_color(facetracker->face, facetracker->image, NULL);
+    if ((facetracker->setfps_time < now_time) &&
+        gstfacetracker_submit_detection(facetracker, GST_BUFFER_TIMESTAMP(gstbuf)))
+      facetracker->setfps_time = now_time + facetracker->setfps_delay;
+  }
+  else if (facetracker->setfps_time < now_time) {
+    facetracker->setfps_time = now_time + facetracker->setfps_delay;
     //face_y_normalization(facetracker->image->data[0], facetracker->width, facetracker->height, 3, 200);
-    has_haarface = face_geometry_update_haar(facetracker->face, facetracker->image, facetracker->hc, NULL);
+    detected = true;
+    const guint64 t = stageprof_start(facetracker->prof);
+    if (gstfacetracker_full_scan(facetracker))
+      has_haarface = face_geometry_update_haar(facetracker->face, facetracker->image, facetracker->hc, NULL);
+    else
+      has_haarface = face_geometry_update_haar_roi(facetracker->face, facetracker->image, facetracker->hc, NULL,
+                                                   facetracker->roi_margin, facetracker->roi_scale_band);
+    t_track += stageprof_stop(facetracker->prof, STAGEPROF_DETECT, t);
+  }
+  else
+    face_geometry_update_color(facetracker->face, facetracker->image, NULL);
 
-    if( has_haarface ){
-      facetracker->faceCount++;
-      facetracker->frame_last_known_face =  facetracker->frameCount;                                     
-    }
+  if (detected)
+    facetracker->haar_misses = has_haarface ? 0 : facetracker->haar_misses + 1;
 
-    ///////////// SKIN COLOUR BLOB FACE DETECTION/////////////////////////////////
-    ///////////// we correct horizontally the face detection /////////////////////
-    //////////////////////////////////////////////////////////////////////////////
-    if(facetracker->enableskin)                                                 //
-    {                                                                           //
-      float x,y;                                                                //
-      //printf("still havent seen a face(frame %ld)\n",facetracker->frameCount);//
-      if( facetracker->frameCount >= 5 ){                                       //
-        int display = facetracker->showskin;                                    //
-        gint facefound =
-        gstfacetracker_find_skin_center_of_mass( facetracker, &x, &y, display,
-                                                 facetracker->face->geometry->mean[0],
-                                                 facetracker->face->geometry->mean[1],
-                                                 facetracker->face->geometry->mean[2],
-                                                 has_haarface);
-        if( (x>1.0) && (x<320.0)){                                              //
-          // we got a skin correction: use it                                   //
-          facetracker->face->geometry->mean[0] = x;                             //
-          if( (facetracker->frameCount > 0) && (facetracker->faceCount == 0) ){ //
-            // if we are in the first frames and no face detected, just go skin //
-            facetracker->face->geometry->mean[1] = y;                           //
-          }                                                                     //
-        }                                                                       //
-        // if not facefound (no skin colour under face bbox), just revert face bbox
-        if( (facefound==0) || (facetracker->face->geometry->mean[2]<=20.1) ){     //
-          if( facetracker->last_known_face_x > 1.0)
-            facetracker->face->geometry->mean[0] = facetracker->last_known_face_x;
-          if( facetracker->last_known_face_y > 1.0)
-            facetracker->face->geometry->mean[1] = facetracker->last_known_face_y;
-          if( facetracker->last_known_face_size > 1.0)
-            facetracker->face->geometry->mean[2] = facetracker->last_known_face_size;
-        }
+  if( has_haarface ){
+    facetracker->faceCount++;
+    facetracker->frame_last_known_face =  facetracker->frameCount;                                     
+  }
+
+  // adapt the skin colour model to the face just found
+  if( has_haarface && facetracker->learnskin )
+    gstfacetracker_learn_skin(facetracker, facetracker->face);
+
+  ///////////// SKIN COLOUR BLOB FACE DETECTION/////////////////////////////////
+  ///////////// we correct horizontally the face detection /////////////////////
+  //////////////////////////////////////////////////////////////////////////////
+  if(facetracker->enableskin)                                                 //
+  {                                                                           //
+    float x,y;                                                                //
+    //printf("still havent seen a face(frame %ld)\n",facetracker->frameCount);//
+    if( facetracker->frameCount >= 5 ){                                       //
+      int display = facetracker->showskin;                                    //
+      gint facefound =
+      gstfacetracker_find_skin_center_of_mass( facetracker, &x, &y, display,
+                                               facetracker->face->geometry->mean[0],
+                                               facetracker->face->geometry->mean[1],
+                                               facetracker->face->geometry->mean[2],
+                                               has_haarface);
+      if( (x>1.0) && (x<320.0)){                                              //
+        // we got a skin correction: use it                                   //
+        facetracker->face->geometry->mean[0] = x;                             //
+        if( (facetracker->frameCount > 0) && (facetracker->faceCount == 0) ){ //
+          // if we are in the first frames and no face detected, just go skin //
+          facetracker->face->geometry->mean[1] = y;                           //
+        }                                                                     //
+      }                                                                       //
+      // if not facefound (no skin colour under face bbox), just revert face bbox
+      if( (facefound==0) || (facetracker->face->geometry->mean[2]<=20.1) ){     //
+        if( facetracker->last_known_face_x > 1.0)
+          facetracker->face->geometry->mean[0] = facetracker->last_known_face_x;
+        if( facetracker->last_known_face_y > 1.0)
+          facetracker->face->geometry->mean[1] = facetracker->last_known_face_y;
+        if( facetracker->last_known_face_size > 1.0)
+          facetracker->face->geometry->mean[2] = facetracker->last_known_face_size;
+      }
 #undef  BOOTSTRAPPING
 #ifdef  BOOTSTRAPPING
-        // EXCEPT if we have seen no face for a long time then bootstrap stuff
-        if( (facetracker->frameCount - facetracker->frame_last_known_face)>50){
-          printf("bootstrapping face with skin, new pos (%f,%f)(%f)\n",x,y, facetracker->face->geometry->mean[2]);
-          facetracker->face->geometry->mean[0] = x;  
-          facetracker->face->geometry->mean[1] = y;
-          facetracker->frame_last_known_face = facetracker->frameCount;
-        }
+      // EXCEPT if we have seen no face for a long time then bootstrap stuff
+      if( (facetracker->frameCount - facetracker->frame_last_known_face)>50){
+        printf("bootstrapping face with skin, new pos (%f,%f)(%f)\n",x,y, facetracker->face->geometry->mean[2]);
+        facetracker->face->geometry->mean[0] = x;  
+        facetracker->face->geometry->mean[1] = y;
+        facetracker->frame_last_known_face = facetracker->frameCount;
+      }
 #endif//  BOOTSTRAPPING
-        // keep actual face location for next frame.
-        facetracker->last_known_face_size = facetracker->face->geometry->mean[2];
-        facetracker->last_known_face_x    = facetracker->face->geometry->mean[0];
-        facetracker->last_known_face_y    = facetracker->face->geometry->mean[1];
-      }                                                                       //
-      if(facetracker->showskin){                                              //
-        draw_box_outline(facetracker->image,                                  //
-                         (int)facetracker->face->geometry->mean[0] - facetracker->face->geometry->mean[2],       //
-                         (int)facetracker->face->geometry->mean[1] - facetracker->face->geometry->mean[2],       //
-                         (int)facetracker->face->geometry->mean[0] + facetracker->face->geometry->mean[2],       //
-                         (int)facetracker->face->geometry->mean[1] + facetracker->face->geometry->mean[2],       //
-                         DRAWING_YUV_RED, 255);                               //
-        draw_box_outline(facetracker->image,                                  //
-                         (int)x - facetracker->face->geometry->mean[2],       //
-                         (int)y - facetracker->face->geometry->mean[2],       //
-                         (int)x + facetracker->face->geometry->mean[2],       //
-                         (int)y + facetracker->face->geometry->mean[2],       //
-                         DRAWING_YUV_GREEN, 255);                             //
-        y = (float) facetracker->face->geometry->mean[1];                     //
-        draw_box_outline(facetracker->image,                                  //                         
-                         (int)x - facetracker->face->geometry->mean[2],       //
-                         (int)y - facetracker->face->geometry->mean[2],       //
-                         (int)x + facetracker->face->geometry->mean[2],       //
-                         (int)y + facetracker->face->geometry->mean[2],       //
-                         DRAWING_YUV_YELLOW, 255);                            //
-      }                                                                       //
-
-    }                                                                           //
-    //////////////////////////////////////////////////////////////////////////////
-
-
-    //////////////////////////////////////////////////////////////////////////////
-    ///////////// Display bboxes etc if so activated /////////////////////////////
-    gstfacetracker_printinfo_n_display( facetracker, btrans, has_haarface);
-
-
-    //////////////////////////////////////////////////////////////////////////////
-    ///////////// send an inbound message downstream /////////////////////////////
-    gstfacetracker_send_event_downstream( facetracker, btrans, has_haarface);
-
-    ///////////// send an inbound message downstream /////////////////////////////
-    gstfacetracker_send_bus_event( facetracker, btrans, has_haarface, gstbuf);
-
-    if (has_haarface) {
-      if (facetracker->timer >= FACETRACKER_TIMEOUT)
-        GST_INFO("[FaceTracker] Oh, Romeo, there art thou!");
-      facetracker->timer = 0;
-    }
-    else if (facetracker->timer >= FACETRACKER_TIMEOUT) {
-      GST_INFO("[FaceTracker] Long time no see... Romeo, where art thou?");
-      face_reset(facetracker->face, facetracker->image);
-      facetracker->faceAppearanceCnt = 0;
-    }
-    facetracker->timer++;
+      // keep actual face location for next frame.
+      facetracker->last_known_face_size = facetracker->face->geometry->mean[2];
+      facetracker->last_known_face_x    = facetracker->face->geometry->mean[0];
+      facetracker->last_known_face_y    = facetracker->face->geometry->mean[1];
+    }                                                                       //
+    if(facetracker->showskin){                                              //
+      draw_box_outline(facetracker->image,                                  //
+                       (int)facetracker->face->geometry->mean[0] - facetracker->face->geometry->mean[2],       //
+                       (int)facetracker->face->geometry->mean[1] - facetracker->face->geometry->mean[2],       //
+                       (int)facetracker->face->geometry->mean[0] + facetracker->face->geometry->mean[2],       //
+                       (int)facetracker->face->geometry->mean[1] + facetracker->face->geometry->mean[2],       //
+                       DRAWING_YUV_RED, 255);                               //
+      draw_box_outline(facetracker->image,                                  //
+                       (int)x - facetracker->face->geometry->mean[2],       //
+                       (int)y - facetracker->face->geometry->mean[2],       //
+                       (int)x + facetracker->face->geometry->mean[2],       //
+                       (int)y + facetracker->face->geometry->mean[2],       //
+                       DRAWING_YUV_GREEN, 255);                             //
+      y = (float) facetracker->face->geometry->mean[1];                     //
+      draw_box_outline(facetracker->image,                                  //                         
+                       (int)x - facetracker->face->geometry->mean[2],       //
+                       (int)y - facetracker->face->geometry->mean[2],       //
+                       (int)x + facetracker->face->geometry->mean[2],       //
+                       (int)y + facetracker->face->geometry->mean[2],       //
+                       DRAWING_YUV_YELLOW, 255);                            //
+    }                                                                       //
+
+  }                                                                           //
+  //////////////////////////////////////////////////////////////////////////////
+
+
+  //////////////////////////////////////////////////////////////////////////////
+  ///////////// Display bboxes etc if so activated /////////////////////////////
+  stageprof_stop(facetracker->prof, STAGEPROF_TRACK, t_track);
+  const guint64 t_draw = stageprof_start(facetracker->prof);
+  gstfacetracker_printinfo_n_display( facetracker, btrans, facetracker->face, has_haarface);
+  stageprof_stop(facetracker->prof, STAGEPROF_DRAW, t_draw);
+
+
+  //////////////////////////////////////////////////////////////////////////////
+  ///////////// send an inbound message downstream /////////////////////////////
+  gstfacetracker_send_event_downstream( facetracker, btrans, facetracker->face, -1, has_haarface);
+
+  ///////////// send an inbound message downstream /////////////////////////////
+  gstfacetracker_send_bus_event( facetracker, btrans, facetracker->face, -1, has_haarface, gstbuf);
+
+  if (has_haarface) {
+    if (facetracker->timer >= FACETRACKER_TIMEOUT)
+      GST_INFO("[FaceTracker] Oh, Romeo, there art thou!");
+    facetracker->timer = 0;
+  }
+  else if (facetracker->timer >= FACETRACKER_TIMEOUT) {
+    GST_INFO("[FaceTracker] Long time no see... Romeo, where art thou?");
+    face_reset(facetracker->face, facetracker->image);
+    facetracker->faceAppearanceCnt = 0;
   }
+  facetracker->timer++;
 
+  if (stageprof_frame_end(facetracker->prof, t_frame) && facetracker->stats_messages)
+    stats = stageprof_message(facetracker->prof, GST_OBJECT(facetracker));
 
   GST_FACETRACKER_UNLOCK (facetracker);
   
+  if (stats)
+    gst_element_post_message(GST_ELEMENT(facetracker), stats);
+
   // record statistical info
   if (facetracker->statslog)
     statslog_frame_stop(facetracker->statslog);
@@ -671,18 +1267,22 @@ gboolean gst_facetracker_plugin_init(GstPlugin * plugin) {
 
 
 ////////////////////////////////////////////////////////////////////////////////
-gint gstfacetracker_send_event_downstream(struct _GstFacetracker *facetracker, GstBaseTransform * btrans, bool has_haarface)
+gint gstfacetracker_send_event_downstream(struct _GstFacetracker *facetracker, GstBaseTransform * btrans,
+                                          t_face *face, gint id, bool has_haarface)
 {
-   //TRACE("[%x] gstfacetracker_send_event_downstream(): face: pos %.2fx%.2f size %.2f\n", (pid_t)syscall(SYS_gettid)), facetracker->face->geometry->mean[0], facetracker->face->geometry->mean[1], facetracker->face->geometry->mean[2]);
+   //TRACE("[%x] gstfacetracker_send_event_downstream(): face: pos %.2fx%.2f size %.2f\n", (pid_t)syscall(SYS_gettid)), face->geometry->mean[0], face->geometry->mean[1], face->geometry->mean[2]);
    GstStructure *str = gst_structure_new("facelocation", 
-                                         "x", G_TYPE_DOUBLE, facetracker->face->geometry->mean[0], 
-                                         "y", G_TYPE_DOUBLE, facetracker->face->geometry->mean[1], 
-                                         "width", G_TYPE_DOUBLE, facetracker->face->geometry->mean[2] * 2.0 * 0.85, 
-                                         "height", G_TYPE_DOUBLE, facetracker->face->geometry->mean[2] * 2.0, 
+                                         "x", G_TYPE_DOUBLE, face->geometry->mean[0], 
+                                         "y", G_TYPE_DOUBLE, face->geometry->mean[1], 
+                                         "width", G_TYPE_DOUBLE, face->geometry->mean[2] * 2.0 * 0.85, 
+                                         "height", G_TYPE_DOUBLE, face->geometry->mean[2] * 2.0, 
                                          "facefound", G_TYPE_BOOLEAN, has_haarface, NULL);
+   // only in the multi-face mode
+   if (id >= 0)
+     gst_structure_set(str, "id", G_TYPE_INT, id, NULL);
    GstEvent* ev = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, str);
    GST_INFO("sending custom DS event of face detection on (%.2f,%.2f)(%.2f)", 
-            facetracker->face->geometry->mean[0], facetracker->face->geometry->mean[1], facetracker->face->geometry->mean[2]);
+            face->geometry->mean[0], face->geometry->mean[1], face->geometry->mean[2]);
    gst_pad_push_event(GST_BASE_TRANSFORM_SRC_PAD(&(btrans->element)), ev);
    
    return(0);
@@ -690,12 +1290,13 @@ gint gstfacetracker_send_event_downstream(struct _GstFacetracker *facetracker, G
 
 
 ////////////////////////////////////////////////////////////////////////////////
-gint gstfacetracker_send_bus_event(struct _GstFacetracker *facetracker, GstBaseTransform * btrans, bool has_haarface, GstBuffer * buf)
+gint gstfacetracker_send_bus_event(struct _GstFacetracker *facetracker, GstBaseTransform * btrans,
+                                   t_face *face, gint id, bool has_haarface, GstBuffer * buf)
 {
-  guint x = (unsigned int) facetracker->face->geometry->mean[0];
-  guint y = (unsigned int) facetracker->face->geometry->mean[1];
-  guint w = (unsigned int) facetracker->face->geometry->mean[2] * 2.0 * 0.85;
-  guint h = (unsigned int) facetracker->face->geometry->mean[2] * 2.0;
+  guint x = (unsigned int) face->geometry->mean[0];
+  guint y = (unsigned int) face->geometry->mean[1];
+  guint w = (unsigned int) face->geometry->mean[2] * 2.0 * 0.85;
+  guint h = (unsigned int) face->geometry->mean[2] * 2.0;
   GstStructure *s;
   ////////////////////////// TJ/ quick hack to add bus msg output //////////////
   bool relative = true; // this should be configurable !!
@@ -715,6 +1316,8 @@ gint gstfacetracker_send_bus_event(struct _GstFacetracker *facetracker, GstBaseT
                            "height", G_TYPE_FLOAT, (float)h/(float)240, 
                            "num", G_TYPE_UINT, has_haarface, NULL);
   }
+  if (id >= 0)
+    gst_structure_set(s, "id", G_TYPE_INT, id, NULL);
   GstMessage *m = gst_message_new_element (GST_OBJECT (facetracker), s);
   
   m->timestamp = GST_BUFFER_TIMESTAMP(buf); //This is the timestamp on the input buf.
@@ -727,12 +1330,13 @@ gint gstfacetracker_send_bus_event(struct _GstFacetracker *facetracker, GstBaseT
 
 
 ////////////////////////////////////////////////////////////////////////////////
-gint gstfacetracker_printinfo_n_display(struct _GstFacetracker *ft, GstBaseTransform * btrans, bool has_haarface)
+gint gstfacetracker_printinfo_n_display(struct _GstFacetracker *ft, GstBaseTransform * btrans,
+                                        t_face *face, bool has_haarface)
 {
   GST_DEBUG("x:%d y:%d r:%d", 
-            (int)ft->face->geometry->mean[0], 
-            (int)ft->face->geometry->mean[1], 
-            (int)ft->face->geometry->mean[2]);
+            (int)face->geometry->mean[0], 
+            (int)face->geometry->mean[1], 
+            (int)face->geometry->mean[2]);
 
   if (ft->display) {
 #ifdef	FACETRACKER_COLORTRACK
@@ -745,29 +1349,29 @@ gint gstfacetracker_printinfo_n_display(struct _GstFacetracker *ft, GstBaseTrans
       in->rowbytes = ft->cvYUV->widthStep;
       in->data[0] = (unsigned char*)ft->cvYUV->imageData;
 
-      face_draw_color(ft->face, in, in);
+      face_draw_color(face, in, in);
 
       destroy_image(in);
     }
 #endif
 #if FACETRK_FORMAT == FACETRK_FORMAT_YUVA
     if (ft->binsInitialized)
-      face_draw_color(ft->face, ft->image, ft->image);
+      face_draw_color(face, ft->image, ft->image);
 #endif
 #endif
 
 #if FACETRK_FORMAT == FACETRK_FORMAT_RGBA
     CvPoint center;
-    center.x = (int)ft->face->geometry->mean[0];
-    center.y = (int)ft->face->geometry->mean[1];
-    int radius = (int)ft->face->geometry->mean[2];
+    center.x = (int)face->geometry->mean[0];
+    center.y = (int)face->geometry->mean[1];
+    int radius = (int)face->geometry->mean[2];
     cvCircle(ft->img, center, radius, CV_RGB(255, 32, 32), 3);
 #endif
 
 #if (FACETRK_FORMAT == FACETRK_FORMAT_YUVA) || (FACETRK_FORMAT == FACETRK_FORMAT_YUV)
-    int x = (int)ft->face->geometry->mean[0];
-    int y = (int)ft->face->geometry->mean[1];
-    int radius = (int)ft->face->geometry->mean[2];
+    int x = (int)face->geometry->mean[0];
+    int y = (int)face->geometry->mean[1];
+    int radius = (int)face->geometry->mean[2];
 
     if( has_haarface )
     {
@@ -796,53 +1400,43 @@ gint gstfacetracker_find_skin_center_of_mass(struct _GstFacetracker *ft, float *
 #if FACETRK_FORMAT == FACETRK_FORMAT_YUVA //////////////////////////////////////
   #error dont use YUVA !!!!
 #endif
-#if FACETRK_FORMAT == FACETRK_FORMAT_YUV ///////////////////////////////////////
-  IplImage* imageYUV = cvCreateImageHeader(cvSize(ft->width, ft->height), IPL_DEPTH_8U, 3);
-  imageYUV->imageData = (char*)ft->image->data[0];
-  IplImage* imageRGB = cvCreateImage( cvSize(ft->width, ft->height), IPL_DEPTH_8U, 3);
-  cvCvtColor(imageYUV, imageRGB, CV_YUV2RGB);
-#endif
-
 #if FACETRK_FORMAT == FACETRK_FORMAT_RGBA //////////////////////////////////////
   #error dont use RGBA !!!!
 #endif
-  IplImage* imageHSV = cvCreateImage( cvSize(ft->width, ft->height), IPL_DEPTH_8U, 3);
-  cvCvtColor(imageRGB, imageHSV, CV_RGB2HSV);
 
 ////////////////////////////////////////////////////////////////////////////////
-  IplImage* planeH = cvCreateImage( cvGetSize(imageHSV), 8, 1);	// Hue component.
-  IplImage* planeS = cvCreateImage( cvGetSize(imageHSV), 8, 1);	// Saturation component.
-  IplImage* planeV = cvCreateImage( cvGetSize(imageHSV), 8, 1);	// Brightness component.
-  cvCvtPixToPlane(imageHSV, planeH, planeS, planeV, 0);	// Extract the 3 color components.
-  IplImage* planeH2 = cvCreateImage( cvGetSize(imageHSV), 8, 1);	// Hue component.
-  cvCopy( planeH, planeH2, NULL);
-
-  int h_thr =ft->h_thr_high,  s_thr=ft->s_thr_low,   v_thr =ft->v_thr_low;
-  int h_thr2=ft->h_thr_low;
-  // Detect which pixels in each of the H, S and V channels are probably skin pixels.
-  // Assume that skin has a Hue between 0 to 18 (out of 180), and Saturation above 50, and Brightness above 80.
-  cvThreshold(planeH , planeH , h_thr, UCHAR_MAX, CV_THRESH_BINARY_INV);     //(hue < 20) !!!!
-  cvThreshold(planeS , planeS , s_thr, UCHAR_MAX, CV_THRESH_BINARY);         //(sat > 48)
-  cvThreshold(planeV , planeV , v_thr, UCHAR_MAX, CV_THRESH_BINARY);         //(val > 80)
-  // erode the HUE to get rid of noise.
-  cvErode(planeH,  planeH,  NULL, 1);
-  cvThreshold(planeH2 , planeH2 , h_thr2, UCHAR_MAX, CV_THRESH_BINARY);      //(hue > 10)
-
-
-
-////////////////////////////////////////////////////////////////////////////////
-  // Combine all thresholded color components, so that an output pixel will only
-  // be white (255) if the H, S and V pixels were also white.
-  IplImage* imageSkinPixels = cvCreateImage( cvGetSize(imageHSV), 8, 1);        // Greyscale output image.
-  // originally: imageSkin =  (hue > 10) ^ (hue < 20) ^ (sat > 48) ^ (val > 80), where   ^ mean pixels-wise AND
-  cvAnd(planeH         , planeS  , imageSkinPixels);	
-  cvAnd(imageSkinPixels, planeV , imageSkinPixels);	
-  cvAnd(imageSkinPixels, planeH2,  imageSkinPixels);	
-
+  // Detect which pixels are probably skin pixels. Assume that skin has a Hue
+  // between 10 to 20 (out of 180), and Saturation above 48, and Brightness above 80.
+  // The thresholds are baked into a YUV colour table, only rebuilt if they change.
+  t_skinlut_params params;
+  skinlut_default_params(SKINLUT_METHOD_HSV, &params);
+  params.h_low  = ft->h_thr_low;
+  params.h_high = ft->h_thr_high;
+  params.s_low  = ft->s_thr_low;
+  params.v_low  = ft->v_thr_low;
+  if( !ft->skinlut )
+    ft->skinlut = skinlut_create(SKINLUT_METHOD_HSV, SKINLUT_INPUT_YUV, &params);
+  else if( !skinlut_params_equal(&ft->skinlut->params, &params) )
+    skinlut_rebuild(ft->skinlut, SKINLUT_METHOD_HSV, &params);
+  if( !ft->skinmask )
+    ft->skinmask = cvCreateImage( cvSize(ft->width, ft->height), IPL_DEPTH_8U, 1);
+
+  // in learning mode the table drifts towards the colour bins of the face,
+  // a slice of it per frame
+  if( ft->learnskin && ft->skinmodel->version )
+    skinlut_learn(ft->skinlut, ft->skinmodel, SKINLUT_LEARN_RATE, SKINLUT_LEARN_BUDGET);
+
+  IplImage* imageSkinPixels = ft->skinmask;        // Greyscale output image.
+  t_skinlut_moments all_moments;
+  skinlut_classify(ft->skinlut, ft->width, ft->height,
+                   ft->image->data[0], ft->image->rowbytes, 3,
+                   (unsigned char*)imageSkinPixels->imageData, imageSkinPixels->widthStep, 1,
+                   128, &all_moments);
 
   /// add a weight to the thresholded pixels. /////////////////////////////
   float face_x = ft->face->geometry->mean[0];
   float face_y = ft->face->geometry->mean[1];
+  double m00 = 0.0, m10 = 0.0, m01 = 0.0;
 
 #define SKINCOLOUR_WEIGHTING_AROUND_FACE
 #ifdef SKINCOLOUR_WEIGHTING_AROUND_FACE
@@ -864,65 +1458,59 @@ gint gstfacetracker_find_skin_center_of_mass(struct _GstFacetracker *ft, float *
       }
       else
         ptr[ix] = ptr[ix]/(1 + 35*(abs(ix-face_x)/320) + 35*(abs(iy-face_y)/240) );        
+      // centre of mass accumulated on the fly, no second pass through cvMoments
+      m00 += ptr[ix];
+      m10 += ptr[ix] * ix;
+      m01 += ptr[ix] * iy;
     }
   }
 #endif //  SKINCOLOUR_WEIGHTING_AROUND_FACE
- 
-  //then find the centers of mass of the found regions 
-  CvMoments moments;
-  cvMoments(imageSkinPixels, &moments, 0);
-  double m00, m10, m01;
-  m00 = cvGetSpatialMoment(&moments, 0,0);
-  m10 = cvGetSpatialMoment(&moments, 1,0);
-  m01 = cvGetSpatialMoment(&moments, 0,1);
         
-  // TBD check that m00 != 0
   if( abs(m00) > 0.1 ){
     *x = m10/m00;
     *y = m01/m00;
     skin_under_seed = 1;
   }
-  else{ // no skin pixels under box: use whole image
-    //printf(" reset!!\n");
-    cvAnd(planeH         , planeS , imageSkinPixels);	
-    cvAnd(imageSkinPixels, planeV , imageSkinPixels);	
-    cvMoments(imageSkinPixels, &moments, 0);
-    m00 = cvGetSpatialMoment(&moments, 0,0);
-    m10 = cvGetSpatialMoment(&moments, 1,0);
-    m01 = cvGetSpatialMoment(&moments, 0,1);
-    if( abs(m00) > 0.1 ){
-      *x = m10/m00;
-      *y = m01/m00;
-    }    
+  else{ // no skin pixels under box: use whole image, already computed by the classifier
+    skinlut_center_of_mass(&all_moments, x, y);
   }
 
   if(display){
-    cvCvtColor(imageSkinPixels, imageRGB, CV_GRAY2RGB);
-
-#if FACETRK_FORMAT == FACETRK_FORMAT_YUV ///////////////////////////////////////
-    cvCvtColor(imageRGB, imageYUV, CV_RGB2YUV);
-#endif
+    // grey mask to YUV: luma = mask, chroma neutral
+    for(int iy=0; iy < imageSkinPixels->height; iy++){
+      const uchar *ptr = (uchar*) (imageSkinPixels->imageData + iy * imageSkinPixels->widthStep);
+      unsigned char *yuv = ft->image->data[0] + iy * ft->image->rowbytes;
+      for(int ix=0; ix < imageSkinPixels->width; ix++, yuv += 3){
+        yuv[0] = ptr[ix];
+        yuv[1] = 128;
+        yuv[2] = 128;
+      }
+    }
   }
-  //cvCircle(imageYUV,cvPoint(int(*x),int(*y)), 10, CV_RGB(200,50,50),3);
-
-
-  cvReleaseImage( &imageSkinPixels );
-  cvReleaseImage( &planeH );
-  cvReleaseImage( &planeS );
-  cvReleaseImage( &planeV );
-  cvReleaseImage( &planeH2 );
-#ifdef ADAPTIVE_SKIN_THRESHOLDING
-  cvReleaseImage( &planeS2 );
-  cvReleaseImage( &planeV2 );
-#endif // ADAPTIVE_SKIN_THRESHOLDING
-  cvReleaseImage( &imageHSV );
-  cvReleaseImage( &imageRGB );
-#if FACETRK_FORMAT == FACETRK_FORMAT_YUV ///////////////////////////////////////
-  cvReleaseImage( &imageYUV );
-#endif
-#if FACETRK_FORMAT == FACETRK_FORMAT_RGBA ///////////////////////////////////////
-  cvReleaseImage( &imageRGBA );
-#endif
 
   return(skin_under_seed);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// Updates the face colour bins with the current detection and publishes them as
+// the learned skin model, for this and any other skin consumer in the process.
+void gstfacetracker_learn_skin(struct _GstFacetracker *ft, t_face *face)
+{
+  face_bgcolor_update(face, ft->image);
+  face_skincolor_update(face, ft->image);
+
+  t_colorbins     *cb = face->skincolor;
+  t_skinlut_model *m  = ft->skinmodel;
+  const unsigned int n = cb->ny * cb->nu * cb->nv;
+  if( n > SKINLUT_MODEL_MAXBINS )
+    return;
+
+  m->ymin = cb->ymin;  m->ymax = cb->ymax;  m->ny = cb->ny;
+  m->umin = cb->umin;  m->umax = cb->umax;  m->nu = cb->nu;
+  m->vmin = cb->vmin;  m->vmax = cb->vmax;  m->nv = cb->nv;
+  // same Y-major layout as the colour bins, normalised to [0..255] already
+  for( unsigned int i = 0; i < n; i++ )
+    m->prob[i] = (cb->inbins[i] > 255) ? 255 : cb->inbins[i];
+
+  skinlut_model_publish(m);
+}
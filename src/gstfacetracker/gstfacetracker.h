@@ -13,6 +13,8 @@
 #include "helper.h"
 #include "camshift.h"
 #include "ftrack.h"
+#include "../opencv/skinlut.h"
+#include "../opencv/stageprof.h"
 
 #ifdef USE_IPP
 //#include "facedetection.h"
@@ -34,6 +36,17 @@ G_BEGIN_DECLS
 typedef struct _GstFacetracker GstFacetracker;
 typedef struct _GstFacetrackerClass GstFacetrackerClass;
 
+#define FACETRACKER_MAX_FACES   16
+
+// One face of the multi-face mode: its own geometry and colour models
+typedef struct {
+  gint id;                 // sent along its events
+  t_face *face;
+  gint hits;               // detections matched since it appeared
+  gint misses;             // detection passes in a row without a match
+  bool found;              // matched a detection on this frame
+} GstFacetrackerTrack;
+
 struct _GstFacetracker {
 	GstVideoFilter parent;
 
@@ -92,6 +105,9 @@ struct _GstFacetracker {
 	int binsInitialized;
 
 	t_statslog* statslog;
+  t_stageprof *prof;      // detection, tracking and drawing times, see stats
+  gint stats_interval;
+  bool stats_messages;
 
 	long frameCount, faceCount;
 
@@ -105,6 +121,39 @@ struct _GstFacetracker {
 
   // to keep the HSV thresholding between frames.
   gint h_thr_low, h_thr_high, s_thr_low, s_thr_high, v_thr_low, v_thr_high;
+  t_skinlut *skinlut;   // HSV thresholds above, baked into a YUV colour table
+  IplImage  *skinmask;
+  t_skinlut_model *skinmodel; // learned from the face colour bins if learnskin
+  bool learnskin;
+
+  // Haar detection around the prediction only, see the roi property
+  bool roi;
+  gdouble roi_margin, roi_scale_band;
+  gint full_scan_interval, full_scan_misses;
+  gint frames_since_full_scan, haar_misses;
+  gint haar_threads;   // scales of the IPP cascade scanned concurrently
+  gint max_candidates; // detections kept per Haar pass, applied to hc by the streaming thread
+
+  // Haar detection on a worker thread, see the async property. The request
+  // (det_image, det_roi...) is only written while the worker is not busy on it.
+  bool async;
+  GThread *det_thread;
+  GMutex *det_lock;
+  GCond *det_cond;
+  bool det_quit, det_pending, det_busy, det_done;
+  t_image *det_image;              // copy of the frame submitted
+  bool det_full;                   // full frame, otherwise det_roi
+  int det_roi[6];
+  float det_x, det_y;              // face position when the frame was submitted
+  GstClockTime det_ts;
+  t_featurelist *det_result;       // valid if det_done, NULL on failure
+
+  // Several faces, see the max-faces property. One detection pass per frame is
+  // shared by all of them; tracks[] is in order of appearance.
+  gint max_faces, track_misses;
+  GstFacetrackerTrack tracks[FACETRACKER_MAX_FACES];
+  gint ntracks;
+  gint next_track_id;
 };
 
 struct _GstFacetrackerClass {
@@ -9,6 +9,13 @@ t_haarclass* haarclass_create(const char* filename) {
 
 	t_haarclass* hc = (t_haarclass*)malloc(sizeof(t_haarclass));
 	strcpy(hc->cascade_name, filename);
+	hc->nthreads = 1;
+	hc->max_candidates = 0;
+	hc->p = NULL;
+	if (haarclass_set_max_candidates(hc, HAARCLASS_MAX_CANDIDATES) != 0) {
+		free(hc);
+		return NULL;
+	}
 
 	#ifdef USE_IPP
 	init_haar_internalParams(hc->iParams);
@@ -16,6 +23,7 @@ t_haarclass* haarclass_create(const char* filename) {
 	#else
 	hc->storage = NULL;
 	hc->cascade = NULL;
+	hc->pyramid = haarpyramid_create(1.2);
 
 	hc->cascade = (CvHaarClassifierCascade*)cvLoad(hc->cascade_name, 0, 0, 0);
 	hc->storage = cvCreateMemStorage(0);
@@ -35,16 +43,50 @@ t_haarclass* haarclass_create(const char* filename) {
 void haarclass_destroy(t_haarclass* hc) {
 	if (hc == NULL)
 		return;
+	free(hc->p);
 	#ifdef USE_IPP
 	deinit_ipp_classifier(hc->iParams);
 	FiniHaar(hc->iParams);
 	#else
 	cvReleaseMemStorage(&hc->storage);
 	cvRelease((void**)&hc->cascade);
+	if (hc->pyramid)
+		haarpyramid_destroy(hc->pyramid);
 	#endif
 	free(hc);
 }
 
+#ifdef USE_IPP
+static void haarclass_params(t_haarclass *hc, int width, PARAMS_FCDFLT *params) {
+	params->nthreads = hc->nthreads;
+	params->minfacew = (int)(width/8);
+	params->maxfacew = (int)(width);
+	params->sfactor = 1.1;
+	params->pruning = RowColMixPruning;
+}
+#endif
+
+int haarclass_prepare(t_haarclass* hc, int width, int height) {
+#ifdef USE_IPP
+	PARAMS_FCDFLT params;
+	haarclass_params(hc, width, &params);
+	return init_ipp_classifier(hc->iParams, width, height, params, hc->cascade_name);
+#else
+	return 0;
+#endif
+}
+
+int haarclass_set_max_candidates(t_haarclass* hc, unsigned int n) {
+	if (n == 0)
+		n = 1;
+	float *p = (float*)realloc(hc->p, 4 * n * sizeof(float));
+	if (!p)
+		return -1;
+	hc->p = p;
+	hc->max_candidates = n;
+	return 0;
+}
+
 // p: np x 4 matrix of (cx,cy,w,h) defining rectangles around detected objects (must be allocated beforehand)
 // im must be PACKED
 
@@ -53,22 +95,22 @@ unsigned int haarclass_detect(t_haarclass *hc, t_image* im, float* p, unsigned i
 
 #ifdef USE_IPP
 
-	*np = 0;
 	PARAMS_FCDFLT params;
 
 	CIppImage src;
 
-	params.nthreads = 1;
-	params.minfacew = (int)(im->width/8);
-	params.maxfacew = (int)(im->width);
-	params.sfactor = 1.1;
-	params.pruning = RowColMixPruning;
+	haarclass_params(hc, im->width, &params);
 
 	src.Attach(im->width, im->height, HAARCOL_BYTESPIXEL, 8, im->data[0], (im->width)*HAARCOL_BYTESPIXEL);
 
-	init_ipp_classifier(hc->iParams, im->width, im->height, params, hc->cascade_name);
+	// no-op unless the size changed since haarclass_prepare()
+	if (init_ipp_classifier(hc->iParams, im->width, im->height, params, hc->cascade_name) != 0) {
+		*np = 0;
+		return 0;
+	}
 
-	facedetection_filter(hc->iParams,src, params, p, (int*)np);
+	if (facedetection_filter(hc->iParams,src, params, p, (int*)np) != 0)
+		*np = 0;
 
 #else
 
@@ -78,14 +120,14 @@ unsigned int haarclass_detect(t_haarclass *hc, t_image* im, float* p, unsigned i
 
 	img->widthStep = im->rowbytes;
 	img->imageData = (char*)im->data[0];
-	// opencv 2.2 expects 7 parameters
-	CvSeq* obj = cvHaarDetectObjects( img, hc->cascade, hc->storage, 1.2, 2, 0, cvSize(im->width/8,im->height/8) );
-	// opencv 2.1 expects 8 parameters
-	//CvSeq* obj = cvHaarDetectObjects( img, hc->cascade, hc->storage, 1.2, 2, 0, cvSize(40, 40), cvSize(0, 0) );
+	// same as cvHaarDetectObjects(img, cascade, storage, 1.2, 2, 0, min size) on a resident pyramid
+	haarpyramid_set_frame(hc->pyramid, img, CV_BGR2GRAY, 0);
+	const unsigned int n = haarpyramid_detect(hc->pyramid, hc->cascade, 2, cvSize(im->width/8,im->height/8), cvSize(0, 0));
+	if (n < *np)
+		*np = n;
 
-	*np = (obj ? obj->total : 0);
 	for (i = 0; i < *np; i++, p += 4) {
-		CvRect* r = (CvRect*)cvGetSeqElem(obj, i);
+		const CvRect* r = &hc->pyramid->scan.objects[i];
 		p[0] = r->x + r->width / 2.0;
 		p[1] = r->y + r->height / 2.0;
 		p[2] = r->width;
@@ -97,3 +139,54 @@ unsigned int haarclass_detect(t_haarclass *hc, t_image* im, float* p, unsigned i
 
 	return *np;
 }
+
+unsigned int haarclass_detect_region(t_haarclass *hc, t_image* im, int x, int y, int w, int h, int minw, int maxw, float* p, unsigned int *np) {
+
+#ifdef USE_IPP
+
+	// the IPP classifier buffers are sized once for the whole image: detect on
+	// all of it and keep the detections of the region and of the size band
+	float *q = p;
+	unsigned int i, n = *np;
+
+	haarclass_detect(hc, im, p, &n);
+
+	*np = 0;
+	for (i = 0; i < n; i++, q += 4) {
+		if (q[0] < x || q[0] >= x + w || q[1] < y || q[1] >= y + h || q[2] < minw || q[2] > maxw)
+			continue;
+		memmove(p + 4 * (*np), q, 4 * sizeof(float));
+		(*np)++;
+	}
+
+#else
+
+	int i;
+	const unsigned int max_np = *np;
+
+	IplImage *img = cvCreateImageHeader(cvSize(w, h), IPL_DEPTH_8U, HAARCOL_BYTESPIXEL);
+
+	img->widthStep = im->rowbytes;
+	img->imageData = (char*)im->data[0] + y * im->rowbytes + x * HAARCOL_BYTESPIXEL;
+	cvClearMemStorage(hc->storage);
+	// scales below minw are not scanned, the ones above maxw are bounded by the region itself
+	CvSeq* obj = cvHaarDetectObjects( img, hc->cascade, hc->storage, 1.2, 2, 0, cvSize(minw, minw) );
+
+	*np = 0;
+	for (i = 0; obj && i < obj->total && *np < max_np; i++) {
+		CvRect* r = (CvRect*)cvGetSeqElem(obj, i);
+		if (r->width > maxw)
+			continue;
+		p[0] = x + r->x + r->width / 2.0;
+		p[1] = y + r->y + r->height / 2.0;
+		p[2] = r->width;
+		p[3] = r->height;
+		p += 4;
+		(*np)++;
+	}
+
+	cvReleaseImageHeader(&img);
+#endif
+
+	return *np;
+}
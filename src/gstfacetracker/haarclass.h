@@ -5,6 +5,7 @@
 #include <opencv/highgui.h>
 #include "defines.h"
 #include "image.h"
+#include "../opencv/haarpyramid.h"
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -14,7 +15,12 @@
 #include "facedetection.h"
 #endif
 
+#define HAARCLASS_MAX_CANDIDATES 64
+
 typedef struct {
+	int nthreads;		// scales scanned concurrently (IPP only)
+	float *p;		// detections of featurelist_haar(), room for max_candidates
+	unsigned int max_candidates;
 #ifdef USE_IPP
 	struct haar_internalParams iParams;
 	char cascade_name[512];
@@ -22,18 +28,31 @@ typedef struct {
 	char cascade_name[512];
 	CvMemStorage* storage;
 	CvHaarClassifierCascade* cascade;
+	t_haarpyramid* pyramid;		// grey frame and integral images of haarclass_detect()
 #endif
 } t_haarclass;
 
 t_haarclass* haarclass_create(const char* filename);
 void haarclass_destroy(t_haarclass* hc);
 
+// builds the classifier buffers for width x height images, to be called when the
+// frame size is known (caps), otherwise it is done by the first haarclass_detect()
+int haarclass_prepare(t_haarclass* hc, int width, int height);
+
+// resizes hc->p for n detections, -1 (hc untouched) if it cannot be allocated;
+// not while a detection runs on hc
+int haarclass_set_max_candidates(t_haarclass* hc, unsigned int n);
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // wrapper around opencv's haarclassifier
 //
 // p: np x 4 matrix of (cx,cy,w,h) defining rectangles around detected objects (must be allocated beforehand)
+// np: on input the rows p has room for, on output the objects written; the ones beyond are dropped
 // im must be PACKED
 //
 unsigned int haarclass_detect(t_haarclass *hc, t_image* im, float *p, unsigned int *np);
 
+// same on the (x,y,w,h) region of im, only for objects minw to maxw wide; p is in im coordinates
+unsigned int haarclass_detect_region(t_haarclass *hc, t_image* im, int x, int y, int w, int h, int minw, int maxw, float *p, unsigned int *np);
+
 #endif
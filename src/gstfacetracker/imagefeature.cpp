@@ -126,11 +126,13 @@ unsigned int featurelist_destroy_custom(t_featurelist *fl) {
 }
 
 
-t_featurelist *featurelist_haar(t_image *inim, t_image *outim, t_haarclass *hc) {
+// roi: x, y, width, height, min and max object width, NULL for the whole image
+static t_featurelist *featurelist_haar_roi(t_image *inim, t_image *outim, t_haarclass *hc, const int *roi) {
 	t_featurelist *fl;
 	t_blobfeature *ff;
-	float p[100];
-	unsigned int np;
+	// the buffer of hc, detections beyond its max_candidates are dropped
+	float *p = hc->p;
+	unsigned int np = hc->max_candidates;
 	unsigned int i;
 
 	// detect
@@ -144,7 +146,10 @@ t_featurelist *featurelist_haar(t_image *inim, t_image *outim, t_haarclass *hc)
 	startchrono(chrono);
 #endif
 
-	haarclass_detect(hc, inim, p, &np);
+	if (roi)
+		haarclass_detect_region(hc, inim, roi[0], roi[1], roi[2], roi[3], roi[4], roi[5], p, &np);
+	else
+		haarclass_detect(hc, inim, p, &np);
 
 #ifdef __DEBUG_HAAR_TIMING__
 	long long delay = stepchrono(chrono);
@@ -186,3 +191,12 @@ t_featurelist *featurelist_haar(t_image *inim, t_image *outim, t_haarclass *hc)
 	return fl;
 
 }
+
+t_featurelist *featurelist_haar(t_image *inim, t_image *outim, t_haarclass *hc) {
+	return featurelist_haar_roi(inim, outim, hc, NULL);
+}
+
+t_featurelist *featurelist_haar_region(t_image *inim, t_image *outim, t_haarclass *hc, int x, int y, int w, int h, int minw, int maxw) {
+	const int roi[6] = { x, y, w, h, minw, maxw };
+	return featurelist_haar_roi(inim, outim, hc, roi);
+}
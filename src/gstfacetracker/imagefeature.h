@@ -35,5 +35,7 @@ unsigned int featurelist_destroy_custom(t_featurelist *fl);
 
 // EXTRACTION
 t_featurelist *featurelist_haar(t_image *inim, t_image *outim, t_haarclass *hc);
+// same, searching only the (x,y,w,h) region of inim for objects minw to maxw wide
+t_featurelist *featurelist_haar_region(t_image *inim, t_image *outim, t_haarclass *hc, int x, int y, int w, int h, int minw, int maxw);
 
 #endif
@@ -1,8 +1,13 @@
 #include "kalman.h"
 #include "mtxcore.h"
+#include "../opencv/mtxfixed.h"
 #include <string.h>
 #include "stdlib.h"
 
+// the facetracker face geometry: (x, y, size, nose dx, dy), observed as (x, y, size)
+#define KALMAN_FIXED_NX 5
+#define KALMAN_FIXED_NZ 3
+
 t_kalman_state *ks_create_shared(unsigned int nx)
 {
 	t_kalman_state *ks = ks_create_header_shared(nx);
@@ -30,6 +35,16 @@ unsigned int ks_destroy_shared(t_kalman_state *ks)
 	return 0;
 }
 
+void ks_init_static(t_kalman_state *ks, float *mean, float *cov, unsigned int nx)
+{
+	ks->nx = nx;
+	ks->type = KALMAN_TYPE_COV;
+	ks->mean = mean;
+	ks->cov = cov;
+	memset(ks->mean,0,nx*sizeof(float));
+	mat_eye(ks->cov,1e20,nx);
+}
+
 t_kalman_state *ks_deep_copy(t_kalman_state *ks) {
 
 	t_kalman_state *cp = ks_create_shared(ks->nx);
@@ -137,11 +152,43 @@ void kalman_update_info(t_kalman_state *s, t_kalman_state *o, float *x, float *h
 
 }
 
+// kalman_update_cov with the sizes known, false (s untouched) if S is not positive definite
+template <unsigned int NX, unsigned int NZ>
+static bool kalman_update_cov_fixed(t_kalman_state *s, t_kalman_state *o, float *hx, float *Ht)
+{
+	float y[NZ];
+	float PHt[NX*NZ];
+	float S[NZ*NZ];
+	float invS[NZ*NZ];
+	float K[NX*NZ];
+	float dx[NX];
+	float dP[NX*NX];
+
+	// S = HPH' + R
+	mtxf_multiply<NX,NX,NZ>(PHt,s->cov,Ht);
+	mtxf_multiply_bt<NZ,NX,NZ>(S,Ht,PHt);
+	mtxf_add<NZ*NZ>(S,S,o->cov);
+	if (!mtxf_invert_spd<NZ>(invS,S)) return false;
+
+	// K = PH'inv(S), x = x + K.y, P = P - KHP
+	mtxf_sub<NZ>(y,o->mean,hx);
+	mtxf_multiply<NX,NZ,NZ>(K,PHt,invS);
+	mtxf_multiply<NX,NZ,1>(dx,K,y);
+	mtxf_add<NX>(s->mean,s->mean,dx);
+	mtxf_multiply_ct<NX,NZ,NX>(dP,K,PHt);
+	mtxf_sub<NX*NX>(s->cov,s->cov,dP);
+	return true;
+}
+
 void kalman_update_cov(t_kalman_state *s, t_kalman_state *o, float *hx, float *Ht)
 {
 	unsigned char ts = s->type;
 	unsigned char to = o->type;
 
+	if (ts==KALMAN_TYPE_COV && to==KALMAN_TYPE_COV && s->nx==KALMAN_FIXED_NX && o->nx==KALMAN_FIXED_NZ &&
+	    kalman_update_cov_fixed<KALMAN_FIXED_NX,KALMAN_FIXED_NZ>(s,o,hx,Ht))
+		return;
+
 	kalman_convert_cov(s);
 	kalman_convert_cov(o);
 
@@ -216,13 +263,63 @@ void kalman_update_old(float *x, float *P, float *z, float *R, float *hx, float
 }
 
 
-void kalman_score_init(t_kalman_state *s, t_kalman_state *besto, float *hx, float *Ht, float *HPHt)
+// y'.inv(HPHt + R).y for the sizes known, -1 if S is not positive definite
+template <unsigned int NZ>
+static float kalman_score_fixed(const float *HPHt, t_kalman_state *o, const float *hx)
 {
+	float S[NZ*NZ];
+	float invS[NZ*NZ];
+	float y[NZ];
+	float invSy[NZ];
+
+	mtxf_add<NZ*NZ>(S,HPHt,o->cov);
+	if (!mtxf_invert_spd<NZ>(invS,S)) return -1;
+	mtxf_sub<NZ>(y,o->mean,hx);
+	mtxf_multiply<NZ,NZ,1>(invSy,invS,y);
+	return mtxf_dot<NZ>(y,invSy);
+}
 
+void kalman_score_init(t_kalman_state *s, float *Ht, unsigned int nz, float *HPHt)
+{
+	if (s->nx==KALMAN_FIXED_NX && nz==KALMAN_FIXED_NZ) {
+		float PHt[KALMAN_FIXED_NX*KALMAN_FIXED_NZ];
+		mtxf_multiply<KALMAN_FIXED_NX,KALMAN_FIXED_NX,KALMAN_FIXED_NZ>(PHt,s->cov,Ht);
+		mtxf_multiply_bt<KALMAN_FIXED_NZ,KALMAN_FIXED_NX,KALMAN_FIXED_NZ>(HPHt,Ht,PHt);
+		return;
+	}
+
+	float PHt[s->nx*nz];
+	mat_multiply(PHt,s->cov,Ht,s->nx,s->nx,nz);
+	mat_multiply_transpose(HPHt,Ht,PHt,nz,s->nx,nz,MAT_TRANSPOSE_B);
+}
+
+float kalman_score_hpht(float *HPHt, t_kalman_state *o, float *hx)
+{
+	if (o->nx==KALMAN_FIXED_NZ) {
+		const float e = kalman_score_fixed<KALMAN_FIXED_NZ>(HPHt,o,hx);
+		if (e>=0) return e;
+	}
+
+	float invS[o->nx*o->nx];
+	float S[o->nx*o->nx];
+	float y[o->nx];
+	float invSy[o->nx];
+
+	mat_add(S,HPHt,o->cov,o->nx*o->nx);
+	mat_invert(invS,S,o->nx);
+	mat_sub(y,o->mean,hx,o->nx);
+	mat_multiply(invSy,invS,y,o->nx,o->nx,1);
+	return mat_dot(y,invSy,o->nx);
 }
 
 float kalman_score(t_kalman_state *s, t_kalman_state *o, float *hx, float *Ht)
 {
+	if (s->nx==KALMAN_FIXED_NX && o->nx==KALMAN_FIXED_NZ) {
+		float HPHt[KALMAN_FIXED_NZ*KALMAN_FIXED_NZ];
+		kalman_score_init(s,Ht,o->nx,HPHt);
+		return kalman_score_hpht(HPHt,o,hx);
+	}
+
 	float PHt[s->nx*o->nx];
 	float invS[o->nx*o->nx];
 	float S[o->nx*o->nx];
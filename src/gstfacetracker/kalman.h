@@ -19,6 +19,8 @@ t_kalman_state *ks_create_shared(unsigned int nx);
 t_kalman_state *ks_create_header_shared(unsigned int nx);
 unsigned int ks_destroy_shared(t_kalman_state *ks);
 t_kalman_state *ks_deep_copy(t_kalman_state *ks);
+// state on storage of the caller (e.g. on the stack), initialised as ks_create_shared, nothing to destroy
+void ks_init_static(t_kalman_state *ks, float *mean, float *cov, unsigned int nx);
 
 // info <-> cov
 void kalman_convert_info(t_kalman_state *ks);
@@ -32,6 +34,10 @@ void kalman_update_diag(t_kalman_state *s, t_kalman_state *o);
 
 // kalman score
 float kalman_score(t_kalman_state *s, t_kalman_state *o, float *hx, float *Ht);
+// HPHt[nz,nz] = H.P.H', the part of S common to all the observations scored against s
+void kalman_score_init(t_kalman_state *s, float *Ht, unsigned int nz, float *HPHt);
+// kalman score, with the HPHt of kalman_score_init for s
+float kalman_score_hpht(float *HPHt, t_kalman_state *o, float *hx);
 
 
 // x: current/new state mean (1 x nx)
@@ -15,6 +15,7 @@
 #include "opencv/gsterode.h"////////////////////////////////////////////////////////////////////////
 #include "opencv/gstmorphology.h"///////////////////////////////////////////////////////////////////
 #include "opencv/gstalphamix.h"/////////////////////////////////////////////////////////////////////
+#include "opencv/gstalphacombine.h"/////////////////////////////////////////////////////////////////
 #include "vibe/gstvibe.h"///////////////////////////////////////////////////////////////////////////
 #include "opencv/gsttsm.h"//////////////////////////////////////////////////////////////////////////
 #include "opencv/gstgcs.h"//////////////////////////////////////////////////////////////////////////
@@ -65,6 +66,9 @@ static gboolean plugin_init (GstPlugin * plugin)
   // Alpha mix plugin                                                                        //////
   if (!gst_alphamix_plugin_init(plugin))                                                     //////
     return FALSE;                                                                            //////
+  // N-input alpha combiner plugin                                                          //////
+  if (!gst_alphacombine_plugin_init(plugin))                                                 //////
+    return FALSE;                                                                            //////
   // Vibe motion detection plugin                                                            //////
   if (!gst_vibe_plugin_init(plugin))                                                         //////
     return FALSE;                                                                            //////
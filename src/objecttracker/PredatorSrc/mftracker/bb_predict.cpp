@@ -53,53 +53,44 @@ float getBbHeight(float* bb)
  * Calculates the new (moved and resized) Bounding box.
  * Calculation based on all relative distance changes of all points
  * to every point. Then the Median of the relative Values is used.
+ * Without points the box is kept, without pairs its scale.
  */
 int predictbb(float *bb0, CvPoint2D32f* pt0, CvPoint2D32f* pt1, int nPts,
-    float *bb1, float* shift)
+    float *bb1, float* shift, float* scratch)
 {
-  float* ofx = (float*) malloc(sizeof(float) * nPts);
-  float* ofy = (float*) malloc(sizeof(float) * nPts);
+  float* ofx = scratch;
+  float* ofy = scratch + nPts;
+  float* dist = scratch + 2 * nPts;
   int i;
   int j;
   int d = 0;
-  float dx,dy;
+  float dx = 0, dy = 0;
   int lenPdist;
-  float* dist0;
-  float* dist1;
   float s0,s1;
   for (i = 0; i < nPts; i++)
   {
     ofx[i] = pt1[i].x - pt0[i].x;
     ofy[i] = pt1[i].y - pt0[i].y;
   }
-  dx = getMedianUnmanaged(ofx, nPts);
-  dy = getMedianUnmanaged(ofy, nPts);
-  free(ofx);
-  ofx = 0;
-  free(ofy);
-  ofy = 0;
+  if (nPts > 0)
+  {
+    dx = getMedianUnmanaged(ofx, nPts);
+    dy = getMedianUnmanaged(ofy, nPts);
+  }
   //m(m-1)/2
   lenPdist = nPts * (nPts - 1) / 2;
-  dist0 = (float*) malloc(sizeof(float) * lenPdist);
-  dist1 = (float*) malloc(sizeof(float) * lenPdist);
   for (i = 0; i < nPts; i++)
   {
     for (j = i + 1; j < nPts; j++, d++)
     {
-      dist0[d]
-          = sqrt(pow(pt0[i].x - pt0[j].x, 2) + pow(pt0[i].y - pt0[j].y, 2));
-      dist1[d]
-          = sqrt(pow(pt1[i].x - pt1[j].x, 2) + pow(pt1[i].y - pt1[j].y, 2));
-      dist0[d] = dist1[d] / dist0[d];
+      float dx0 = pt0[i].x - pt0[j].x, dy0 = pt0[i].y - pt0[j].y;
+      float dx1 = pt1[i].x - pt1[j].x, dy1 = pt1[i].y - pt1[j].y;
+      dist[d] = sqrt((dx1 * dx1 + dy1 * dy1) / (dx0 * dx0 + dy0 * dy0));
     }
   }
   //The scale change is the median of all changes of distance.
   //same as s = median(d2./d1) with above
-  *shift = getMedianUnmanaged(dist0, lenPdist);
-  free(dist0);
-  dist0 = 0;
-  free(dist1);
-  dist1 = 0;
+  *shift = (lenPdist > 0) ? getMedianUnmanaged(dist, lenPdist) : 1;
   s0 = 0.5 * (*shift - 1) * getBbWidth(bb0);
   s1 = 0.5 * (*shift - 1) * getBbHeight(bb0);
 
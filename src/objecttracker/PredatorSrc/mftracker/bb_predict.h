@@ -56,9 +56,10 @@
  *              1 == no scalechange, experience: if shift == 0
  *              BoundingBox moved completely out of picture
  *              (not validated)
+ * @param scratch Buffer of 2 * nPts + nPts * (nPts - 1) / 2 floats.
  */
 int predictbb(float *bb0, CvPoint2D32f* pt0, CvPoint2D32f* pt1, int nPts,
-    float*bb1, float*shift);
+    float*bb1, float*shift, float*scratch);
 
 /***********************************************************
  * EPILOGUE
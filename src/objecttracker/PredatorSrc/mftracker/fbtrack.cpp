@@ -27,67 +27,72 @@
  * INCLUDES
  ***********************************************************/
 
+#include "fbtrack.h"
 #include "bb.h"
 #include "bb_predict.h"
 #include "median.h"
 #include "stdio.h"
+#include <stdlib.h>
+#include <string.h>
 #include "lk.h"
 
 /***********************************************************
  * FUNCTION
  ***********************************************************/
 
+FBTrackContext *fbtrackCreateContext()
+{
+  FBTrackContext *ctx = (FBTrackContext*) malloc(sizeof(FBTrackContext));
+  ctx->lk = lkCreateContext();
+  return ctx;
+}
+
+void fbtrackReleaseContext(FBTrackContext **ctx)
+{
+  if (*ctx == 0)
+    return;
+  lkReleaseContext(&(*ctx)->lk);
+  free(*ctx);
+  *ctx = 0;
+}
+
 /**
  * Calculate the bounding box of an Object in a following Image.
  * Imgs aren't changed.
+ * @param ctx        buffers, see fbtrackCreateContext
  * @param imgI       Image contain Object with known BoundingBox
  * @param imgJ       Following Image.
  * @param bb         Bounding box of object to track in imgI.
  *                   Format x1,y1,x2,y2
  * @param scaleshift returns relative scale change of bb
+ * @param reuseI     1 if imgI was the imgJ of the previous call on ctx
  */
-int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew,
-    float* scaleshift)
+int fbtrack(FBTrackContext *ctx, IplImage *imgI, IplImage *imgJ, float* bb,
+    float* bbnew, float* scaleshift, int reuseI)
 {
   char level = 5;
-  int numM = 10;
-  int numN = 10;
-  int nPoints = numM * numN;
+  int nPoints = FB_POINTS;
   int sizePointsArray = nPoints * 2;
 
-  float* fb = (float*) malloc(nPoints * sizeof(float));
-  float* ncc = (float*) malloc(nPoints * sizeof(float));
-  char* status = (char*) malloc(nPoints);
-
-  float * pt = (float*) malloc(sizeof(float) * sizePointsArray);
-  float * ptTracked = (float*) malloc(sizeof(float) * sizePointsArray);
-  int nlkPoints;
-  CvPoint2D32f* startPoints;
-  CvPoint2D32f* targetPoints;
-  float *fbLkCleaned;
-  float *nccLkCleaned;
+  float* fb = ctx->fb;
+  float* ncc = ctx->ncc;
+  char* status = ctx->status;
+  float * pt = ctx->pt;
+  float * ptTracked = ctx->ptTracked;
+  CvPoint2D32f* startPoints = ctx->startPoints;
+  CvPoint2D32f* targetPoints = ctx->targetPoints;
+  float *fbLkCleaned = ctx->fbLkCleaned;
+  float *nccLkCleaned = ctx->nccLkCleaned;
   int i,M;
   int nRealPoints;
   float medFb;
   float medNcc;
   int nAfterFbUsage;
-  getFilledBBPoints(bb, numM, numN, 5, &pt);
-  //getFilledBBPoints(bb, numM, numN, 5, &ptTracked);
+  getFilledBBPoints(bb, FB_GRID, FB_GRID, 5, &pt);
   memcpy(ptTracked, pt, sizeof(float) * sizePointsArray);
 
-  initImgs();
-  trackLK(imgI, imgJ, pt, nPoints, ptTracked, nPoints, level, fb, ncc, status);
-  initImgs();
-  //  char* status = *statusP;
-  nlkPoints = 0;
-  for (i = 0; i < nPoints; i++)
-  {
-    nlkPoints += status[i];
-  }
-  startPoints = (CvPoint2D32f*) malloc(nlkPoints * sizeof(CvPoint2D32f));
-  targetPoints = (CvPoint2D32f*) malloc(nlkPoints * sizeof(CvPoint2D32f));
-  fbLkCleaned = (float*) malloc(nlkPoints * sizeof(float));
-  nccLkCleaned = (float*) malloc(nlkPoints * sizeof(float));
+  trackLK(ctx->lk, imgI, imgJ, pt, nPoints, ptTracked, nPoints, level, fb,
+      ncc, status, reuseI);
 
   M = 2;
   nRealPoints = 0;
@@ -110,15 +115,16 @@ int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew,
       nRealPoints++;
     }
   }
-  free(pt);
-  free(ptTracked);
-  //assert nRealPoints==nlkPoints
-  medFb = getMedian(fbLkCleaned, nlkPoints);
-  medNcc = getMedian(nccLkCleaned, nlkPoints);
+  //nothing left to take a median of
+  if (nRealPoints == 0)
+    return 0;
+
+  medFb = getMedianBuffered(fbLkCleaned, nRealPoints, ctx->scratch);
+  medNcc = getMedianBuffered(nccLkCleaned, nRealPoints, ctx->scratch);
   /*  printf("medianfb: %f\nmedianncc: %f\n", medFb, medNcc);
-   printf("Number of points after lk: %d\n", nlkPoints);*/
+   printf("Number of points after lk: %d\n", nRealPoints);*/
   nAfterFbUsage = 0;
-  for (i = 0; i < nlkPoints; i++)
+  for (i = 0; i < nRealPoints; i++)
   {
     if ((fbLkCleaned[i] <= medFb) & (nccLkCleaned[i] >= medNcc))
     {
@@ -128,30 +134,16 @@ int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew,
     }
   }
   /*printf("Number of points after fb correction: %d\n", nAfterFbUsage);*/
-  //  showIplImage(IMGS[1]);
-  // show "OpticalFlow" fb filtered.
-  //  drawLinesCvPoint2D32f(imgI, startPoints, nRealPoints, targetPoints,
-  //      nRealPoints);
-  //  showIplImage(imgI);
 
-  predictbb(bb, startPoints, targetPoints, nAfterFbUsage, bbnew, scaleshift);
+  predictbb(bb, startPoints, targetPoints, nAfterFbUsage, bbnew, scaleshift,
+      ctx->scratch);
   /*printf("bbnew: %f,%f,%f,%f\n", bbnew[0], bbnew[1], bbnew[2], bbnew[3]);
    printf("relative scale: %f \n", scaleshift[0]);*/
-  //show picture with tracked bb
-  //  drawRectFromBB(imgJ, bbnew);
-  //  showIplImage(imgJ);
-  free(fb);
-  free(ncc);
-  free(status);
-  free(startPoints);
-  free(targetPoints);
-  free(fbLkCleaned);
-  free(nccLkCleaned);
 
   if(medFb > 10) return 0;
   else return 1;
-
 }
+
 /***********************************************************
  * END OF FILE
  ***********************************************************/
@@ -29,18 +29,53 @@
  * INCLUDES
  ***********************************************************/
 #include <opencv/cv.h>
+#include "lk.h"
+
+/***********************************************************
+ * CONSTANT AND MACRO DEFINITIONS
+ ***********************************************************/
+#define FB_GRID       10                      // points per side of the grid tracked
+#define FB_POINTS     (FB_GRID * FB_GRID)
+#define FB_PAIRS      (FB_POINTS * (FB_POINTS - 1) / 2)
+
+/***********************************************************
+ * DATA DEFINITIONS
+ ***********************************************************/
+/**
+ * Everything fbtrack needs from frame to frame, so that tracking does not
+ * allocate. One per tracked object.
+ */
+typedef struct
+{
+  LKContext *lk;
+  float pt[2 * FB_POINTS];
+  float ptTracked[2 * FB_POINTS];
+  float fb[FB_POINTS];
+  float ncc[FB_POINTS];
+  char status[FB_POINTS];
+  CvPoint2D32f startPoints[FB_POINTS];
+  CvPoint2D32f targetPoints[FB_POINTS];
+  float fbLkCleaned[FB_POINTS];
+  float nccLkCleaned[FB_POINTS];
+  float scratch[2 * FB_POINTS + FB_PAIRS];   // medians and predictbb
+} FBTrackContext;
 
 /***********************************************************
  * FUNCTION
  ***********************************************************/
+FBTrackContext *fbtrackCreateContext();
+void fbtrackReleaseContext(FBTrackContext **ctx);
 /*
+ * @param ctx        buffers, see fbtrackCreateContext
  * @param imgI       Image contain Object with known BoundingBox
  * @param imgJ       Following Image.
  * @param bb         Bounding box of object to track in imgI.
  *                   Format x1,y1,x2,y2
  * @param scaleshift returns relative scale change of bb
+ * @param reuseI     1 if imgI was the imgJ of the previous call on ctx
  */
-int fbtrack(IplImage *imgI, IplImage *imgJ, float* bb, float* bbnew, float* scaleshift);
+int fbtrack(FBTrackContext *ctx, IplImage *imgI, IplImage *imgJ, float* bb,
+    float* bbnew, float* scaleshift, int reuseI);
 
 #endif /* FBTRACK_H_ */
 /***********************************************************
@@ -32,20 +32,21 @@
 #include <opencv/highgui.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 /***********************************************************
  * CONSTANT AND MACRO DEFINITIONS
  ***********************************************************/
 
-const int MAX_COUNT = 500;
-const int MAX_IMG = 2;
 const double N_A_N = -1.0;
 /**
  * Size of the search window of each pyramid level in cvCalcOpticalFlowPyrLK.
  */
 int win_size_lk = 4;
-CvPoint2D32f* points[3] = { 0, 0, 0 };
-static IplImage **PYR = 0;
+/**
+ * Side of the patches compared by normCrossCorrelation.
+ */
+#define WINSIZE_NCC 10
 
 /***********************************************************
  * FUNCTION
@@ -69,7 +70,46 @@ void euclideanDistance(CvPoint2D32f *point1, CvPoint2D32f *point2,
   }
 }
 /**
- * Calculates normalized cross correlation for every point.
+ * Samples a winsize x winsize patch centred on center with bilinear
+ * interpolation, replicating the border, like cvGetRectSubPix but straight
+ * from the 8 bit image memory into floats.
+ */
+static void getPatchSubPix(IplImage *img, CvPoint2D32f center, int winsize,
+    float *patch)
+{
+  const unsigned char *data = (const unsigned char *) img->imageData;
+  const int step = img->widthStep;
+  const int maxX = img->width - 1, maxY = img->height - 1;
+  float x0 = center.x - (winsize - 1) * 0.5f;
+  float y0 = center.y - (winsize - 1) * 0.5f;
+  int i, j;
+
+  for (i = 0; i < winsize; i++)
+  {
+    float y = y0 + i;
+    y = (y < 0) ? 0 : (y > maxY) ? maxY : y;
+    int iy = (int) y;
+    int iy1 = (iy < maxY) ? iy + 1 : maxY;
+    float ay = y - iy;
+    const unsigned char *row0 = data + iy * step;
+    const unsigned char *row1 = data + iy1 * step;
+
+    for (j = 0; j < winsize; j++)
+    {
+      float x = x0 + j;
+      x = (x < 0) ? 0 : (x > maxX) ? maxX : x;
+      int ix = (int) x;
+      int ix1 = (ix < maxX) ? ix + 1 : maxX;
+      float ax = x - ix;
+      float top = row0[ix] + ax * (row0[ix1] - row0[ix]);
+      float bottom = row1[ix] + ax * (row1[ix1] - row1[ix]);
+      patch[i * winsize + j] = top + ay * (bottom - top);
+    }
+  }
+}
+/**
+ * Calculates normalized cross correlation (CV_TM_CCOEFF_NORMED) for every
+ * point, on patches sampled directly from the images.
  * @param imgI      Image 1.
  * @param imgJ      Image 2.
  * @param points0   Array of points of imgI
@@ -79,65 +119,102 @@ void euclideanDistance(CvPoint2D32f *point1, CvPoint2D32f *point2,
  *                  if status[i] == 1 => match[i] is calculated.
  *                  else match[i] = 0.0
  * @param match     Output: Array will contain ncc values.
- *                  0.0 if not calculated.
- * @param winsize   Size of quadratic area around the point
- *                  which is compared.
- * @param method    Specifies the way how image regions are compared.
- *                  see cvMatchTemplate
+ *                  0.0 if not calculated, or if a patch is flat.
  */
 void normCrossCorrelation(IplImage *imgI, IplImage *imgJ,
     CvPoint2D32f *points0, CvPoint2D32f *points1, int nPts, char *status,
-    float *match, int winsize, int method)
+    float *match)
 {
-  IplImage *rec0 = cvCreateImage(cvSize(winsize, winsize), 8, 1);
-  IplImage *rec1 = cvCreateImage(cvSize(winsize, winsize), 8, 1);
-  IplImage *res = cvCreateImage(cvSize(1, 1), IPL_DEPTH_32F, 1);
+  const int n = WINSIZE_NCC * WINSIZE_NCC;
+  float rec0[WINSIZE_NCC * WINSIZE_NCC];
+  float rec1[WINSIZE_NCC * WINSIZE_NCC];
 
-  int i;
+  int i, k;
   for (i = 0; i < nPts; i++)
   {
-    if (status[i] == 1)
+    if (status[i] != 1)
+    {
+      match[i] = 0.0;
+      continue;
+    }
+    getPatchSubPix(imgI, points0[i], WINSIZE_NCC, rec0);
+    getPatchSubPix(imgJ, points1[i], WINSIZE_NCC, rec1);
+
+    float s0 = 0, s1 = 0, s00 = 0, s11 = 0, s01 = 0;
+    for (k = 0; k < n; k++)
     {
-      cvGetRectSubPix(imgI, rec0, points0[i]);
-      cvGetRectSubPix(imgJ, rec1, points1[i]);
-      cvMatchTemplate(rec0, rec1, res, method);
-      match[i] = ((float *) (res->imageData))[0];
+      s0 += rec0[k];
+      s1 += rec1[k];
+      s00 += rec0[k] * rec0[k];
+      s11 += rec1[k] * rec1[k];
+      s01 += rec0[k] * rec1[k];
     }
+    double num = s01 - (double) s0 * s1 / n;
+    double den = sqrt((s00 - (double) s0 * s0 / n) * (s11 - (double) s1 * s1 / n));
+    if (den <= 1e-6)
+      match[i] = 0.0;
     else
     {
-      match[i] = 0.0;
+      num /= den;
+      match[i] = (num > 1) ? 1 : (num < -1) ? -1 : num;
     }
   }
-  cvReleaseImage(&rec0);
-  cvReleaseImage(&rec1);
-  cvReleaseImage(&res);
+}
+
+LKContext *lkCreateContext()
+{
+  return (LKContext*) calloc(1, sizeof(LKContext));
+}
+
+void lkReleaseContext(LKContext **ctx)
+{
+  int i;
+  if (*ctx == 0)
+    return;
+  for (i = 0; i < 2; i++)
+    cvReleaseImage(&(*ctx)->pyr[i]);
+  for (i = 0; i < 3; i++)
+    free((*ctx)->points[i]);
+  free((*ctx)->statusBacktrack);
+  free(*ctx);
+  *ctx = 0;
 }
 /**
- * Needed before start of trackLK and at the end of the program for cleanup.
- * Handles PYR(Pyramid cache) variable.
+ * (Re)allocates the buffers of ctx for images of size and nPts points, only
+ * when they do not fit already.
  */
-void initImgs()
+static void lkReserve(LKContext *ctx, CvSize size, int nPts)
 {
-  if (PYR != 0)
+  int i;
+  if (ctx->pyr[0] == 0 || size.width != ctx->size.width
+      || size.height != ctx->size.height)
+  {
+    CvSize pyr_sz = cvSize(size.width + 8, size.height / 3);
+    for (i = 0; i < 2; i++)
+    {
+      cvReleaseImage(&ctx->pyr[i]);
+      ctx->pyr[i] = cvCreateImage(pyr_sz, IPL_DEPTH_32F, 1);
+    }
+    ctx->size = size;
+    ctx->pyrJReady = 0;
+  }
+  if (nPts > ctx->capacity)
   {
-    int i;
-    for (i = 0; i < MAX_IMG; i++)
+    for (i = 0; i < 3; i++)
     {
-      cvReleaseImage(&(PYR[i]));
-      PYR[i] = 0;
+      free(ctx->points[i]);
+      ctx->points[i] = (CvPoint2D32f*) malloc(nPts * sizeof(CvPoint2D32f));
     }
-    free(PYR);
-    PYR = 0;
-    //printf("LK: deallocated\n");
+    free(ctx->statusBacktrack);
+    ctx->statusBacktrack = (char*) malloc(nPts);
+    ctx->capacity = nPts;
   }
-  PYR = (IplImage**) calloc(MAX_IMG, sizeof(IplImage*));
-  //printf("LK: initialized\n");
 }
 
 /**
  * Tracks Points from 1.Image to 2.Image.
- * Need initImgs before start and at the end of the program for cleanup.
  *
+ * @param ctx       buffers, see lkCreateContext
  * @param imgI      previous Image source. (isn't changed)
  * @param imgJ      actual Image target. (isn't changed)
  * @param ptsI      points to track from first Image.
@@ -153,22 +230,25 @@ void initImgs()
  * @param ncc       normCrossCorrelation values. needs as inputlength nPtsI * sizeof(float)
  * @param status    Indicates positive tracks. 1 = PosTrack 0 = NegTrack
  *                  needs as inputlength nPtsI * sizeof(char)
+ * @param reuseI    1 if imgI was the imgJ of the previous call
  *
  *
  * Based Matlab function:
  * lk(2,imgI,imgJ,ptsI,ptsJ,Level) (Level is optional)
  */
-int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
-    float ptsJ[], int nPtsJ, int level, float * fb, float*ncc, char*status)
+int trackLK(LKContext *ctx, IplImage *imgI, IplImage *imgJ, float ptsI[],
+    int nPtsI, float ptsJ[], int nPtsJ, int level, float * fb, float*ncc,
+    char*status, int reuseI)
 {
   //TODO: watch NaN cases
   //double nan = std::numeric_limits<double>::quiet_NaN();
   //double inf = std::numeric_limits<double>::infinity();
 
   // tracking
-  int I, J, winsize_ncc;
-  CvSize pyr_sz;
+  int I, J;
   int i;
+  int flags;
+  CvPoint2D32f **points = ctx->points;
   //if unused std 5
   if (level == -1)
   {
@@ -176,12 +256,6 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
   }
   I = 0;
   J = 1;
-  winsize_ncc = 10;
-
-  //NOTE: initImgs() must be used correctly or memleak will follow.
-  pyr_sz = cvSize(imgI->width + 8, imgI->height / 3);
-  PYR[I] = cvCreateImage(pyr_sz, IPL_DEPTH_32F, 1);
-  PYR[J] = cvCreateImage(pyr_sz, IPL_DEPTH_32F, 1);
 
   // Points
   if (nPtsJ != nPtsI)
@@ -190,11 +264,18 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
     return 0;
   }
 
-  points[0] = (CvPoint2D32f*) malloc(nPtsI * sizeof(CvPoint2D32f)); // template
-  points[1] = (CvPoint2D32f*) malloc(nPtsI * sizeof(CvPoint2D32f)); // target
-  points[2] = (CvPoint2D32f*) malloc(nPtsI * sizeof(CvPoint2D32f)); // forward-backward
-  //TODO:Free
-  char* statusBacktrack = (char*) malloc(nPtsI);
+  lkReserve(ctx, cvGetSize(imgI), nPtsI);
+
+  // the pyramid of the previous target is the one of this template
+  flags = CV_LKFLOW_INITIAL_GUESSES;
+  if (reuseI && ctx->pyrJReady)
+  {
+    IplImage *tmp = ctx->pyr[I];
+    ctx->pyr[I] = ctx->pyr[J];
+    ctx->pyr[J] = tmp;
+    flags |= CV_LKFLOW_PYR_A_READY;
+  }
+  ctx->pyrJReady = 0;
 
   for (i = 0; i < nPtsI; i++)
   {
@@ -207,28 +288,28 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
   }
 
   //lucas kanade track
-  cvCalcOpticalFlowPyrLK(imgI, imgJ, PYR[I], PYR[J], points[0], points[1],
+  cvCalcOpticalFlowPyrLK(imgI, imgJ, ctx->pyr[I], ctx->pyr[J], points[0], points[1],
       nPtsI, cvSize(win_size_lk, win_size_lk), level, status, 0, cvTermCriteria(
           CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03),
-      CV_LKFLOW_INITIAL_GUESSES);
+      flags);
 
   //backtrack
-  cvCalcOpticalFlowPyrLK(imgJ, imgI, PYR[J], PYR[I], points[1], points[2],
-      nPtsI, cvSize(win_size_lk, win_size_lk), level, statusBacktrack, 0, cvTermCriteria(
+  cvCalcOpticalFlowPyrLK(imgJ, imgI, ctx->pyr[J], ctx->pyr[I], points[1], points[2],
+      nPtsI, cvSize(win_size_lk, win_size_lk), level, ctx->statusBacktrack, 0, cvTermCriteria(
           CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03),
       CV_LKFLOW_INITIAL_GUESSES | CV_LKFLOW_PYR_A_READY | CV_LKFLOW_PYR_B_READY);
+  ctx->pyrJReady = 1;
 
     for (i = 0; i < nPtsI; i++)
     {
-      if (status[i] && statusBacktrack[i])
+      if (status[i] && ctx->statusBacktrack[i])
       {
     	  status[i] = 1;
       }else{
     	  status[i] = 0;
       }
     }
-  normCrossCorrelation(imgI, imgJ, points[0], points[1], nPtsI, status, ncc,
-      winsize_ncc, CV_TM_CCOEFF_NORMED);
+  normCrossCorrelation(imgI, imgJ, points[0], points[1], nPtsI, status, ncc);
   euclideanDistance(points[0], points[2], fb, nPtsI);
 
   for (i = 0; i < nPtsI; i++)
@@ -247,12 +328,6 @@ int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
       ncc[i] = N_A_N;
     }
   }
-  for (i = 0; i < 3; i++)
-  {
-    free(points[i]);
-    points[i] = 0;
-  }
-  free(statusBacktrack);
   return 1;
 }
 
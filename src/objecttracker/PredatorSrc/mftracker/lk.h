@@ -43,17 +43,31 @@
 /***********************************************************
  * DATA DEFINITIONS
  ***********************************************************/
+/**
+ * Buffers of trackLK, kept from call to call. One per tracker.
+ */
+typedef struct
+{
+  CvSize size;              // image size the pyramids are allocated for
+  IplImage *pyr[2];         // pyramids of imgI and imgJ
+  int pyrJReady;            // pyr[1] holds the pyramid of the last imgJ
+  int capacity;             // points the buffers below can hold
+  CvPoint2D32f *points[3];  // template, target, forward-backward
+  char *statusBacktrack;
+} LKContext;
 
 /***********************************************************
  * FUNCTIONS
  ***********************************************************/
+LKContext *lkCreateContext();
+void lkReleaseContext(LKContext **ctx);
 /**
- * Need before start of trackLK and at the end of the program for cleanup.
+ * @param reuseI    1 if imgI is the imgJ of the previous call on ctx, whose
+ *                  pyramid is then reused instead of built again.
  */
-void initImgs();
-int trackLK(IplImage *imgI, IplImage *imgJ, float ptsI[], int nPtsI,
-    float ptsJ[], int nPtsJ, int level, float * fbOut, float*nccOut,
-    char*statusOut);
+int trackLK(LKContext *ctx, IplImage *imgI, IplImage *imgJ, float ptsI[],
+    int nPtsI, float ptsJ[], int nPtsJ, int level, float * fbOut,
+    float*nccOut, char*statusOut, int reuseI);
 
 #endif /* LK_H_ */
 
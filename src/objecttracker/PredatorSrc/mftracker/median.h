@@ -58,6 +58,13 @@ float getMedian(float arr[], int n);
  * @pram n length of array
  */
 float getMedianUnmanaged(float arr[], int n);
+/**
+ * Calculates Median of the array. Don't change array, copies it to buffer
+ * (at least n floats) instead of allocating.
+ * @param arr the array
+ * @pram n length of array
+ */
+float getMedianBuffered(const float arr[], int n, float buffer[]);
 
 /***********************************************************
  * EPILOGUE
@@ -27,6 +27,10 @@
 
 #include <algorithm>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "TLDUtil.h"
 
 namespace tld {
@@ -59,6 +63,15 @@ DetectorCascade::DetectorCascade() {
 	clustering = new Clustering();
 
 	detectionResult = new DetectionResult();
+
+	//One candidate buffer per worker, kept across objects and model loads
+#ifdef _OPENMP
+	candidates.resize(omp_get_max_threads());
+#else
+	candidates.resize(1);
+#endif
+	candidatePatches.resize(candidates.size());
+	candidateConfidences.resize(candidates.size());
 }
 
 DetectorCascade::~DetectorCascade() {
@@ -133,6 +146,13 @@ void DetectorCascade::release() {
 	objWidth = -1;
 	objHeight = -1;
 
+	//The per worker buffers stay, detect() needs one per worker
+	for(size_t t = 0; t < candidates.size(); t++) {
+		candidates[t].clear();
+		candidatePatches[t].clear();
+		candidateConfidences[t].clear();
+	}
+
 	detectionResult->release();
 }
 
@@ -236,7 +256,8 @@ void DetectorCascade::initWindowOffsets() {
 	}
 }
 
-void DetectorCascade::detect(Mat img) {
+//frame, if given, is img's TLDFrame and its integral images are used
+void DetectorCascade::detect(Mat img, TLDFrame * frame) {
 	//For every bounding box, the output is confidence, pattern, variance
 
 	detectionResult->reset();
@@ -247,49 +268,65 @@ void DetectorCascade::detect(Mat img) {
 
 	//Prepare components
 	foregroundDetector->nextIteration(img); //Calculates foreground
-	varianceFilter->nextIteration(img); //Calculates integral images
+	if(frame != NULL) {
+		varianceFilter->nextIteration(frame->integralImg, frame->integralImg_squared);
+	} else {
+		varianceFilter->nextIteration(img); //Calculates integral images
+	}
 	ensembleClassifier->nextIteration(img);
 
-	#pragma omp parallel for
-	for (int i = 0; i < numWindows; i++) {
-
-		int * window = &windows[TLD_WINDOW_SIZE*i];
-
-		if(foregroundDetector->isActive()) {
-			bool isInside = false;
-
-			for(size_t j = 0; j < detectionResult->fgList->size(); j++) {
-
-				int bgBox[4];
-				tldRectToArray(detectionResult->fgList->at(j), bgBox);
-				if(tldIsInside(window,bgBox)) { //TODO: This is inefficient and should be replaced by a quadtree
-					isInside = true;
-				}
+	//The windows are split among the workers, each one appends the windows that
+	//pass the ensemble to its own buffer and then keeps those the NN classifier
+	//accepts, scored as one batch. The filter stages only write the slots of
+	//the window they are given (variances[i], posteriors[i], featureVectors[i])
+	//and only read the classifier models, which are not modified until
+	//learning, after detection.
+	bool fgActive = foregroundDetector->isActive();
+	int numBuffers = (int)candidates.size();
+
+	#pragma omp parallel num_threads(numBuffers)
+	{
+#ifdef _OPENMP
+		int worker = omp_get_thread_num();
+#else
+		int worker = 0;
+#endif
+		vector<int>& found = candidates[worker];
+		found.clear();
+
+		#pragma omp for schedule(dynamic, 64) nowait
+		for (int i = 0; i < numWindows; i++) {
+
+			int * window = &windows[TLD_WINDOW_SIZE*i];
+
+			if(fgActive && !foregroundDetector->isInside(window)) {
+				detectionResult->posteriors[i] = 0;
+				continue;
 			}
 
-			if(!isInside) {
+			if(!varianceFilter->filter(i)) {
 				detectionResult->posteriors[i] = 0;
 				continue;
 			}
-		}
 
-		if(!varianceFilter->filter(i)) {
-			detectionResult->posteriors[i] = 0;
-			continue;
-		}
-
-		if(!ensembleClassifier->filter(i)) {
-			continue;
-		}
+			if(!ensembleClassifier->filter(i)) {
+				continue;
+			}
 
-		if(!nnClassifier->filter(img, i)) {
-			continue;
+			found.push_back(i);
 		}
 
-		detectionResult->confidentIndices->push_back(i);
-
+		nnClassifier->filterWindows(img, found, candidatePatches[worker], candidateConfidences[worker]);
+	}
 
+	//Merge the buffers; sorting makes the result independent of the amount of
+	//workers and of which one took each window
+	vector<int>* confident = detectionResult->confidentIndices;
+	for(int t = 0; t < numBuffers; t++) {
+		confident->insert(confident->end(), candidates[t].begin(), candidates[t].end());
 	}
+	sort(confident->begin(), confident->end());
+
 	//Cluster
 	clustering->clusterConfidentIndices();
 
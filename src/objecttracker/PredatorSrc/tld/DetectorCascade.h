@@ -32,6 +32,7 @@
 #include "../tld/EnsembleClassifier.h"
 #include "../tld/Clustering.h"
 #include "../tld/NNClassifier.h"
+#include "../tld/TLDFrame.h"
 
 
 
@@ -45,6 +46,9 @@ class DetectorCascade {
 	//Working data
 	int numScales;
 	Size* scales;
+	vector<vector<int> > candidates; //Windows accepted by each detection worker
+	vector<vector<NormalizedPatch> > candidatePatches; //...their patches, for the NN classifier
+	vector<vector<float> > candidateConfidences;
 public:
 	//Configurable members
 	int minScale;
@@ -90,7 +94,7 @@ public:
 
 	void release();
 	void cleanPreviousData();
-	void detect(Mat img);
+	void detect(Mat img, TLDFrame * frame = NULL);
 };
 
 } /* namespace tld */
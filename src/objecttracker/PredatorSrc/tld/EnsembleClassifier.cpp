@@ -25,6 +25,7 @@
 
 #include <cstdlib>
 #include <math.h>
+#include <string.h>
 #include <opencv/cv.h>
 
 #include "DetectorCascade.h"
@@ -43,6 +44,7 @@ EnsembleClassifier::EnsembleClassifier() :
 	features(NULL),
 	featureOffsets(NULL),
 	posteriors(NULL),
+	posteriorsFixed(NULL),
 	positives(NULL),
 	negatives(NULL)
 {
@@ -71,6 +73,8 @@ void EnsembleClassifier::release() {
 	featureOffsets = NULL;
 	delete[] posteriors;
 	posteriors = NULL;
+	delete[] posteriorsFixed;
+	posteriorsFixed = NULL;
 	delete[] positives;
 	positives = NULL;
 	delete[] negatives;
@@ -114,12 +118,14 @@ void EnsembleClassifier::initFeatureOffsets() {
 
 void EnsembleClassifier::initPosteriors() {
 	posteriors = new float[numTrees * numIndices];
+	posteriorsFixed = new unsigned short[numTrees * numIndices];
 	positives = new int[numTrees * numIndices];
 	negatives = new int[numTrees * numIndices];
 
 	for (int i = 0; i<numTrees; i++) {
 		for(int j = 0; j < numIndices; j++) {
 			posteriors[i*numIndices + j] = 0;
+			posteriorsFixed[i*numIndices + j] = 0;
 			positives[i*numIndices + j] = 0;
 			negatives[i*numIndices + j] = 0;
 		}
@@ -165,11 +171,39 @@ float EnsembleClassifier::calcConfidence(int * featureVector) {
 	return conf;
 }
 
+//All the ferns of a window in one go, used by the detector. The offsets of the
+//window scale are contiguous, tree after tree, and shared by all the windows of
+//that scale (windows are laid out scale by scale), so they stay in cache along
+//the scan; the comparisons are branchless. The confidence is accumulated in
+//fixed point from posteriorsFixed, one small table per tree.
+int EnsembleClassifier::calcFeatureVectorFixed(int windowIdx, int * featureVector) {
+	const int *bbox = windowOffsets + windowIdx*TLD_WINDOW_OFFSET_SIZE;
+	const int *off = featureOffsets + bbox[4]; //bbox[4] is pointer to features for the current scale
+	const unsigned char *base = img + bbox[0];
+	const unsigned short *table = posteriorsFixed;
+	int conf = 0;
+
+	for(int i = 0; i < numTrees; i++) {
+		int index = 0;
+
+		for(int j = 0; j < numFeatures; j++) {
+			index = (index << 1) | (base[off[0]] > base[off[1]]);
+			off += 2;
+		}
+
+		featureVector[i] = index;
+		conf += table[index];
+		table += numIndices;
+	}
+
+	return conf;
+}
+
 void EnsembleClassifier::classifyWindow(int windowIdx) {
 	int* featureVector = detectionResult->featureVectors + numTrees * windowIdx;
-	calcFeatureVector(windowIdx, featureVector);
+	int conf = calcFeatureVectorFixed(windowIdx, featureVector);
 
-	detectionResult->posteriors[windowIdx] = calcConfidence(featureVector);
+	detectionResult->posteriors[windowIdx] = conf * (1.0f / TLD_POSTERIOR_FIXED_ONE);
 }
 
 bool EnsembleClassifier::filter(int i)  {
@@ -184,6 +218,20 @@ void EnsembleClassifier::updatePosterior(int treeIdx, int idx, int positive, int
 	int arrayIndex = treeIdx * numIndices + idx;
 	(positive) ? positives[arrayIndex] += amount : negatives[arrayIndex] += amount;
 	posteriors[arrayIndex] = ((float) positives[arrayIndex]) / (positives[arrayIndex] + negatives[arrayIndex]) / 10.0;
+	posteriorsFixed[arrayIndex] = (unsigned short)(posteriors[arrayIndex] * TLD_POSTERIOR_FIXED_ONE + 0.5f);
+}
+
+//Bulk load of counts and posteriors after initPosteriors(), e.g. from a model file
+void EnsembleClassifier::setPosteriors(const int * positives, const int * negatives, const float * posteriors) {
+	int size = numTrees * numIndices;
+
+	memcpy(this->positives, positives, sizeof(int) * size);
+	memcpy(this->negatives, negatives, sizeof(int) * size);
+	memcpy(this->posteriors, posteriors, sizeof(float) * size);
+
+	for(int i = 0; i < size; i++) {
+		posteriorsFixed[i] = (unsigned short)(posteriors[i] * TLD_POSTERIOR_FIXED_ONE + 0.5f);
+	}
 }
 
 void EnsembleClassifier::updatePosteriors(int *featureVector, int positive, int amount) {
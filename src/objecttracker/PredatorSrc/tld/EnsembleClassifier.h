@@ -32,12 +32,16 @@ using namespace cv;
 
 namespace tld {
 
+//Fixed point scale of the posteriors used for detection, a confidence of 1
+static const int TLD_POSTERIOR_FIXED_ONE = 1 << 16;
+
 class EnsembleClassifier {
 	unsigned char* img;
 
 	float calcConfidence(int * featureVector);
 	int calcFernFeature(int windowIdx, int treeIdx);
 	void calcFeatureVector(int windowIdx, int * featureVector);
+	int calcFeatureVectorFixed(int windowIdx, int * featureVector);
 	void updatePosteriors(int *featureVector, int positive, int amount);
 public:
 	bool enabled;
@@ -57,6 +61,7 @@ public:
 	int numIndices;
 
 	float * posteriors;
+	unsigned short * posteriorsFixed; //posteriors in TLD_POSTERIOR_FIXED_ONE units, same layout
 	int * positives;
 	int * negatives;
 
@@ -72,6 +77,7 @@ public:
 	void nextIteration(Mat img);
 	void classifyWindow(int windowIdx);
 	void updatePosterior(int treeIdx, int idx, int positive, int amount);
+	void setPosteriors(const int * positives, const int * negatives, const float * posteriors);
 	void learn(Mat img, int * boundary, int positive, int * featureVector);
 	bool filter(int i);
 };
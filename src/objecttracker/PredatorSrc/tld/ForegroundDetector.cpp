@@ -26,6 +26,7 @@
 #include "ForegroundDetector.h"
 
 #include "../cvblobs/BlobResult.h"
+#include "TLDUtil.h"
 
 using namespace cv;
 
@@ -34,23 +35,74 @@ namespace tld {
 ForegroundDetector::ForegroundDetector() {
 	fgThreshold = 16;
 	minBlobSize = 0;
+	useCvBlobs = false;
+	maxFgWidth = 0;
+	maxFgHeight = 0;
+	blobStats = NULL;
 }
 
 ForegroundDetector::~ForegroundDetector() {
+	release();
 }
 
 void ForegroundDetector::release() {
+	if(blobStats != NULL) {
+		blobstats_destroy(blobStats);
+		blobStats = NULL;
+	}
+	absImg.release();
 }
 
 void ForegroundDetector::nextIteration(Mat img) {
+	maxFgWidth = 0;
+	maxFgHeight = 0;
+
 	if(bgImg.empty()) {
 		return;
 	}
 
-	Mat absImg = Mat(img.cols, img.rows, img.type());
-	Mat threshImg = Mat(img.cols, img.rows, img.type());
+	absdiff(bgImg, img, absImg); //Only allocates on the first frame or a size change
+
+	if(useCvBlobs) {
+		labelCvBlobs();
+	} else {
+		labelRuns();
+	}
+
+	buildIndex(img.cols, img.rows);
+}
+
+//Single pass run length labelling of absImg > fgThreshold, only the area and
+//bounding box of every blob are needed. Same boxes as cvBlobs (width and height
+//are the last minus the first pixel), the area is counted in pixels instead of
+//being the area enclosed by the outer contour.
+void ForegroundDetector::labelRuns() {
+	if(blobStats == NULL || blobStats->width != absImg.cols || blobStats->height != absImg.rows) {
+		if(blobStats != NULL) {
+			blobstats_destroy(blobStats);
+		}
+		//As many blobs of minBlobSize as fit in the frame, so that none is dropped
+		int maxBlobs = min(((absImg.cols+1)/2) * ((absImg.rows+1)/2), absImg.cols * absImg.rows / max(minBlobSize, 1));
+		blobStats = blobstats_create(absImg.cols, absImg.rows, maxBlobs);
+		if(blobStats == NULL) {
+			labelCvBlobs();
+			return;
+		}
+	}
+
+	vector<Rect>* fgList = detectionResult->fgList;
+	fgList->clear();
+
+	int numBlobs = blobstats_label(blobStats, absImg.data, absImg.step, 1, fgThreshold, BLOBSTATS_CONNECT8, minBlobSize);
 
-	absdiff(bgImg, img, absImg);
+	for(int i = 0; i < numBlobs; i++) {
+		t_blob * blob = &blobStats->blobs[i];
+		fgList->push_back(Rect(blob->x0, blob->y0, blob->x1 - blob->x0, blob->y1 - blob->y0));
+	}
+}
+
+void ForegroundDetector::labelCvBlobs() {
+	Mat threshImg;
 	threshold(absImg, threshImg, fgThreshold, 255, CV_THRESH_BINARY );
 
 	IplImage im = (IplImage)threshImg;
@@ -66,7 +118,52 @@ void ForegroundDetector::nextIteration(Mat img) {
 		CvRect rect = blob->GetBoundingBox();
 		fgList->push_back(rect);
 	}
+}
 
+void ForegroundDetector::buildIndex(int width, int height) {
+	vector<Rect>* fgList = detectionResult->fgList;
+
+	//Windows end at most at (width,height)
+	colMask.assign(width+1, 0);
+	rowMask.assign(height+1, 0);
+	maxFgWidth = 0;
+	maxFgHeight = 0;
+
+	for(size_t k = 0; k < fgList->size(); k++) {
+		Rect r = (*fgList)[k];
+
+		maxFgWidth = max(maxFgWidth, r.width);
+		maxFgHeight = max(maxFgHeight, r.height);
+
+		if(k >= (size_t)TLD_FG_INDEX_BITS) continue;
+
+		unsigned long long bit = 1ULL << k;
+		for(int x = max(r.x+1, 0); x < min(r.x+r.width, width+1); x++) colMask[x] |= bit;
+		for(int y = max(r.y+1, 0); y < min(r.y+r.height, height+1); y++) rowMask[y] |= bit;
+	}
+}
+
+//Same as tldIsInside(window, blob) for any blob of fgList, in O(1)
+bool ForegroundDetector::isInside(int * window) {
+	//No blob is large enough for this scale
+	if(window[2] + 2 > maxFgWidth || window[3] + 2 > maxFgHeight) {
+		return false;
+	}
+
+	if(colMask[window[0]] & colMask[window[0]+window[2]] &
+	   rowMask[window[1]] & rowMask[window[1]+window[3]]) {
+		return true;
+	}
+
+	vector<Rect>* fgList = detectionResult->fgList;
+	for(size_t j = TLD_FG_INDEX_BITS; j < fgList->size(); j++) {
+		int bgBox[4];
+		tldRectToArray((*fgList)[j], bgBox);
+		if(tldIsInside(window,bgBox)) {
+			return true;
+		}
+	}
+	return false;
 }
 
 bool ForegroundDetector::isActive() {
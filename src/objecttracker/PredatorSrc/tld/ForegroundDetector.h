@@ -30,16 +30,38 @@
 #include <opencv/cv.h>
 
 #include "../tld/DetectionResult.h"
+#include "../../../opencv/blobstats.h"
 
 using namespace std;
 using namespace cv;
 
 namespace tld {
 
+//Amount of foreground blobs looked up through the index, the rest (if any) are
+//checked one by one
+static const int TLD_FG_INDEX_BITS = 64;
+
 class ForegroundDetector {
+	//Per frame index of fgList: bit k of colMask[x] (rowMask[y]) is set if x (y)
+	//lies strictly inside the horizontal (vertical) extent of blob k. A window is
+	//inside blob k if both its left and right columns and both its top and bottom
+	//rows have bit k set.
+	vector<unsigned long long> colMask;
+	vector<unsigned long long> rowMask;
+	int maxFgWidth;
+	int maxFgHeight;
+
+	//Kept from frame to frame, reallocated only when the frame size changes
+	Mat absImg;
+	t_blobstats * blobStats;
+
+	void labelRuns();
+	void labelCvBlobs();
+	void buildIndex(int width, int height);
 public:
 	int fgThreshold;
 	int minBlobSize;
+	bool useCvBlobs; //Label with cvBlobs (contour tracing) instead of the run based labelling
 	Mat bgImg;
 	DetectionResult * detectionResult;
 
@@ -48,6 +70,7 @@ public:
 	void release();
 	void nextIteration(Mat img);
 	bool isActive();
+	bool isInside(int * window);
 };
 
 } /* namespace tld */
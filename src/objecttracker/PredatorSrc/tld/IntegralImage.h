@@ -42,6 +42,8 @@ public:
 
 	IntegralImage(Size size) {
 		data = new T[size.width*size.height];
+		width = size.width;
+		height = size.height;
 	}
 
 	virtual ~IntegralImage() {
@@ -50,18 +52,19 @@ public:
 
 	void calcIntImg(Mat img, bool squared = false)
 	{
-		unsigned char *input = (unsigned char*)(img.data);
-		T *output = data;
-		for(int i = 0;i < img.cols;i++){
-			for(int j = 0;j < img.rows;j++){
-				T A = (i > 0) ? output[img.cols * j + i - 1] : 0;
-				T B = (j > 0) ? output[img.cols * (j - 1) + i] : 0;
-				T C = (j > 0 && i > 0) ? output[img.cols * (j - 1) + i - 1] : 0;
-				T value = input[img.step * j + i];
+		//Row by row: running sum of the row plus the entry above
+		for(int j = 0;j < img.rows;j++){
+			const unsigned char *input = (const unsigned char*)(img.data) + img.step * j;
+			T *output = data + img.cols * j;
+			const T *above = output - img.cols;
+			T rowSum = 0;
+			for(int i = 0;i < img.cols;i++){
+				T value = input[i];
 				if(squared) {
 					value = value*value;
 				}
-				output[img.cols * j + i] = A + B - C + value;
+				rowSum += value;
+				output[i] = (j > 0) ? rowSum + above[i] : rowSum;
 			}
 		}
 
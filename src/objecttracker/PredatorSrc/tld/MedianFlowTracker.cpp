@@ -24,17 +24,18 @@
  */
 
 #include "MedianFlowTracker.h"
-#include "../mftracker/fbtrack.h"
 #include <cmath>
 
 namespace tld {
 
 MedianFlowTracker::MedianFlowTracker() {
 	trackerBB = NULL;
+	fbContext = fbtrackCreateContext();
 }
 
 MedianFlowTracker::~MedianFlowTracker() {
 	cleanPreviousData();
+	fbtrackReleaseContext(&fbContext);
 }
 
 void MedianFlowTracker::cleanPreviousData() {
@@ -53,7 +54,10 @@ void MedianFlowTracker::track(Mat prevMat, Mat currMat, Rect* prevBB) {
 		IplImage prevImg = prevMat;
 		IplImage currImg = currMat;
 
-		int success = fbtrack(&prevImg, &currImg, bb_tracker,bb_tracker,&scale);
+		//Consecutive frames: the pyramid built for the last currMat is prevMat's
+		int reusePyramid = (lastImg.data != NULL && lastImg.data == prevMat.data);
+		int success = fbtrack(fbContext, &prevImg, &currImg, bb_tracker,bb_tracker,&scale, reusePyramid);
+		lastImg = currMat;
 
 		//Extract subimage
 		float x,y,w,h;
@@ -28,11 +28,15 @@
 
 #include <opencv/cv.h>
 
+#include "../mftracker/fbtrack.h"
+
 using namespace cv;
 
 namespace tld {
 
 class MedianFlowTracker {
+	FBTrackContext * fbContext;
+	Mat lastImg; //Image whose pyramid fbContext holds, referenced so it cannot be recycled
 public:
 	Rect* trackerBB;
 
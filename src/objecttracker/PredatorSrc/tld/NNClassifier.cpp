@@ -27,11 +27,14 @@
 #include "DetectorCascade.h"
 #include "TLDUtil.h"
 
+#include <algorithm>
+
 namespace tld {
 
 NNClassifier::NNClassifier() {
 	thetaFP = .5;
 	thetaTP = .65;
+	maxTemplates = 0;
 
 	truePositives = new vector<NormalizedPatch>();
 	falsePositives = new vector<NormalizedPatch>();
@@ -48,26 +51,105 @@ NNClassifier::~NNClassifier() {
 void NNClassifier::release() {
 	falsePositives->clear();
 	truePositives->clear();
+	positiveTemplates.clear();
+	negativeTemplates.clear();
+	positiveRedundancy.clear();
+	negativeRedundancy.clear();
 }
 
-float NNClassifier::ncc(float *f1,float *f2) {
-	double corr = 0;
-	double norm1 = 0;
-	double norm2 = 0;
+//Brings the normalised templates up to date with truePositives and
+//falsePositives, which can also be filled from outside (model import).
+//Must not be called while classifying from several threads: the owner calls
+//it before detecting, never from the detection (see TLD::startDetection()).
+void NNClassifier::syncTemplates() {
+	if(positiveTemplates.size() > (int)truePositives->size()) {
+		positiveTemplates.clear();
+		positiveRedundancy.clear();
+	}
+	for(size_t i = positiveTemplates.size(); i < truePositives->size(); i++) {
+		if(insertTemplate(positiveTemplates, positiveRedundancy, truePositives->at(i).values, false, true) < 0) {
+			//Out of memory: the patches without a template are dropped
+			truePositives->erase(truePositives->begin() + i, truePositives->end());
+			break;
+		}
+	}
+
+	if(negativeTemplates.size() > (int)falsePositives->size()) {
+		negativeTemplates.clear();
+		negativeRedundancy.clear();
+	}
+	for(size_t i = negativeTemplates.size(); i < falsePositives->size(); i++) {
+		if(insertTemplate(negativeTemplates, negativeRedundancy, falsePositives->at(i).values, false, false) < 0) {
+			falsePositives->erase(falsePositives->begin() + i, falsePositives->end());
+			break;
+		}
+	}
+}
+
+//Appends values to templates or, if bounded and maxTemplates rows are used,
+//overwrites the most redundant row, i.e. the closest to another of its class.
+//Row 0 of the positive class (the initial patch) is never overwritten.
+//Returns the row written, -1 if out of memory. Costs one correlation against every row, as much as
+//classifying the patch, so with a budget the cost of learning stays bounded;
+//an eviction adds one more, plus one per row whose closest partner it was.
+int NNClassifier::insertTemplate(TemplateMatrix & templates, vector<float> & redundancy, const float * values, bool bounded, bool positive) {
+	float unit[TLD_TEMPLATE_STRIDE] __attribute__((aligned(32)));
+	int rows = templates.size();
+
+	scores.resize(rows + 1);
+	if(TemplateMatrix::normalize(values, unit)) {
+		templates.correlate(unit, &scores[0]);
+	} else {
+		fill(scores.begin(), scores.end(), 0.0f);
+	}
+
+	int row = rows;
+	int first = positive ? 1 : 0;
+	if(bounded && maxTemplates > 0 && rows >= maxTemplates && rows > first) {
+		row = first;
+		for(int r = first+1; r < rows; r++) {
+			if(redundancy[r] > redundancy[row]) row = r;
+		}
+		//Correlations of the row about to be lost, before it is overwritten
+		evictedScores.resize(rows);
+		templates.correlateRow(row, &evictedScores[0]);
+	}
 
-	int size = TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+	//Nothing is updated unless the template can be stored
+	if(row == rows && !templates.add(values)) {
+		return -1;
+	}
 
-	for (int i = 0; i<size; i++) {
-		corr += f1[i]*f2[i];
-		norm1 += f1[i]*f1[i];
-		norm2 += f2[i]*f2[i];
+	float own = 0;
+	for(int r = 0; r < rows; r++) {
+		if(r == row) continue;
+		if(scores[r] > redundancy[r]) redundancy[r] = scores[r];
+		if(scores[r] > own) own = scores[r];
 	}
-	// normalization to <0,1>
 
-	return (corr / sqrt(norm1*norm2) + 1) / 2.0;
+	if(row == rows) {
+		redundancy.push_back(own);
+	} else {
+		templates.set(row, values);
+		redundancy[row] = own;
+
+		//Rows whose closest partner was the evicted one, unless the new row is
+		//as close, look for their partner again
+		for(int r = 0; r < rows; r++) {
+			if(r == row || evictedScores[r] + 1e-6f < redundancy[r]) continue;
+			templates.correlateRow(r, &scores[0]);
+			redundancy[r] = 0;
+			for(int s = 0; s < rows; s++) {
+				if(s != r && scores[s] > redundancy[r]) redundancy[r] = scores[s];
+			}
+		}
+	}
+
+	return row;
 }
 
-float NNClassifier::classifyPatch(NormalizedPatch * patch) {
+//The templates are kept normalised, so each comparison is a single dot product
+float NNClassifier::classifyUnitPatch(const float * unit, bool flat) {
 
 	if(truePositives->empty()) {
 		return 0;
@@ -77,23 +159,9 @@ float NNClassifier::classifyPatch(NormalizedPatch * patch) {
 		return 1;
 	}
 
-	float ccorr_max_p = 0;
-	//Compare patch to positive patches
-	for(size_t i = 0; i < truePositives->size(); i++) {
-		float ccorr = ncc(truePositives->at(i).values, patch->values);
-		if(ccorr > ccorr_max_p) {
-			ccorr_max_p = ccorr;
-		}
-	}
-
-	float ccorr_max_n = 0;
-	//Compare patch to positive patches
-	for(size_t i = 0; i < falsePositives->size(); i++) {
-		float ccorr = ncc(falsePositives->at(i).values, patch->values);
-		if(ccorr > ccorr_max_n) {
-			ccorr_max_n = ccorr;
-		}
-	}
+	//A flat patch correlates with nothing
+	float ccorr_max_p = flat ? 0 : positiveTemplates.maxCorrelation(unit);
+	float ccorr_max_n = flat ? 0 : negativeTemplates.maxCorrelation(unit);
 
 	float dN = 1-ccorr_max_n;
 	float dP = 1-ccorr_max_p;
@@ -102,36 +170,76 @@ float NNClassifier::classifyPatch(NormalizedPatch * patch) {
 	return distance;
 }
 
-float NNClassifier::classifyBB(Mat img, Rect* bb) {
-	NormalizedPatch patch;
+float NNClassifier::classifyPatch(NormalizedPatch * patch) {
+	float unit[TLD_TEMPLATE_STRIDE] __attribute__((aligned(32)));
+	bool flat = !TemplateMatrix::normalize(patch->values, unit);
 
-	tldExtractNormalizedPatchRect(img, bb, patch.values);
-	return classifyPatch(&patch);
+	return classifyUnitPatch(unit, flat);
+}
+
+//Candidates are scored in blocks, so that every template is loaded once per
+//block instead of once per candidate
+void NNClassifier::classifyPatches(NormalizedPatch * patches, int numPatches, float * confidences) {
+	const int block = 16;
+	float units[block*TLD_TEMPLATE_STRIDE] __attribute__((aligned(32)));
+	float maxP[block], maxN[block];
+	bool flat[block];
 
+	for(int first = 0; first < numPatches; first += block) {
+		int n = min(block, numPatches - first);
+
+		for(int j = 0; j < n; j++) {
+			flat[j] = !TemplateMatrix::normalize(patches[first+j].values, units + TLD_TEMPLATE_STRIDE*j);
+		}
+
+		positiveTemplates.maxCorrelation(units, n, maxP);
+		negativeTemplates.maxCorrelation(units, n, maxN);
+
+		for(int j = 0; j < n; j++) {
+			if(truePositives->empty()) {
+				confidences[first+j] = 0;
+			} else if(falsePositives->empty()) {
+				confidences[first+j] = 1;
+			} else {
+				float dN = 1 - (flat[j] ? 0 : maxN[j]);
+				float dP = 1 - (flat[j] ? 0 : maxP[j]);
+				confidences[first+j] = dN/(dN+dP);
+			}
+		}
+	}
 }
 
-float NNClassifier::classifyWindow(Mat img, int windowIdx) {
+float NNClassifier::classifyBB(Mat img, Rect* bb) {
 	NormalizedPatch patch;
 
-	int * bbox = &windows[TLD_WINDOW_SIZE*windowIdx];
-	tldExtractNormalizedPatchBB(img, bbox, patch.values);
-
+	tldExtractNormalizedPatchRect(img, bb, patch.values);
 	return classifyPatch(&patch);
+
 }
 
-bool NNClassifier::filter(Mat img, int windowIdx) {
-	if(!enabled) return true;
+void NNClassifier::filterWindows(Mat img, vector<int> & windowIndices, vector<NormalizedPatch> & patches, vector<float> & confidences) {
+	if(!enabled || windowIndices.empty()) return;
 
-	float conf = classifyWindow(img, windowIdx);
+	int n = (int)windowIndices.size();
+	patches.resize(n);
+	confidences.resize(n);
 
-	if(conf < thetaTP) {
-		return false;
+	for(int j = 0; j < n; j++) {
+		tldExtractNormalizedPatchBB(img, &windows[TLD_WINDOW_SIZE*windowIndices[j]], patches[j].values);
 	}
 
-	return true;
+	classifyPatches(&patches[0], n, &confidences[0]);
+
+	int kept = 0;
+	for(int j = 0; j < n; j++) {
+		if(confidences[j] >= thetaTP) windowIndices[kept++] = windowIndices[j];
+	}
+	windowIndices.resize(kept);
 }
 
 void NNClassifier::learn(vector<NormalizedPatch> patches) {
+	syncTemplates();
+
 	//TODO: Randomization might be a good idea here
 	for(size_t i = 0; i < patches.size(); i++) {
 
@@ -140,11 +248,16 @@ void NNClassifier::learn(vector<NormalizedPatch> patches) {
 		float conf = classifyPatch(&patch);
 
 		if(patch.positive && conf <= thetaTP) {
-			truePositives->push_back(patch);
+			//Not stored if out of memory, the model is then left as it was
+			int row = insertTemplate(positiveTemplates, positiveRedundancy, patch.values, true, true);
+			if(row >= 0 && (size_t)row < truePositives->size()) (*truePositives)[row] = patch;
+			else if(row >= 0) truePositives->push_back(patch);
 		}
 
 		if(!patch.positive && conf >= thetaFP) {
-			falsePositives->push_back(patch);
+			int row = insertTemplate(negativeTemplates, negativeRedundancy, patch.values, true, false);
+			if(row >= 0 && (size_t)row < falsePositives->size()) (*falsePositives)[row] = patch;
+			else if(row >= 0) falsePositives->push_back(patch);
 		}
 	}
 
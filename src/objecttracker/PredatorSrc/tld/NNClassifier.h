@@ -30,6 +30,7 @@
 #include <opencv/cv.h>
 
 #include "../tld/NormalizedPatch.h"
+#include "../tld/TemplateMatrix.h"
 #include "../tld/DetectionResult.h"
 
 using namespace std;
@@ -38,10 +39,23 @@ using namespace cv;
 namespace tld {
 
 class NNClassifier {
-	float ncc(float *f1,float *f2);
+	//Normalised copies of truePositives and falsePositives
+	TemplateMatrix positiveTemplates;
+	TemplateMatrix negativeTemplates;
+
+	//Per row, highest correlation with any other row of the same class
+	vector<float> positiveRedundancy;
+	vector<float> negativeRedundancy;
+	vector<float> scores;
+	vector<float> evictedScores;
+
+	float classifyUnitPatch(const float * unit, bool flat);
+	int insertTemplate(TemplateMatrix & templates, vector<float> & redundancy, const float * values, bool bounded, bool positive);
 public:
 	bool enabled;
 
+	int maxTemplates; //per class, 0 means unbounded
+
 	int * windows;
 	float thetaFP;
 	float thetaTP;
@@ -53,11 +67,14 @@ public:
 	virtual ~NNClassifier();
 
 	void release();
+	void syncTemplates();
 	float classifyPatch(NormalizedPatch * patch);
+	void classifyPatches(NormalizedPatch * patches, int numPatches, float * confidences);
 	float classifyBB(Mat img, Rect* bb);
-	float classifyWindow(Mat img, int windowIdx);
 	void learn(vector<NormalizedPatch> patches);
-	bool filter(Mat img, int windowIdx);
+	//Keeps in windowIndices the windows whose patch reaches thetaTP, scored
+	//with classifyPatches(); patches and confidences are scratch buffers
+	void filterWindows(Mat img, vector<int> & windowIndices, vector<NormalizedPatch> & patches, vector<float> & confidences);
 };
 
 } /* namespace tld */
@@ -26,7 +26,10 @@
 #include "TLD.h"
 #include "NNClassifier.h"
 #include "TLDUtil.h"
+#include "TLDModel.h"
 #include <iostream>
+#include <string>
+#include <glib.h>
 
 using namespace std;
 
@@ -37,6 +40,14 @@ TLD::TLD() {
 	detectorEnabled = true;
 	learningEnabled = true;
 	alternating = false;
+	detectionInterval = 1;
+	detectionThreshold = 0;
+	detectionThreaded = false;
+	framesSinceDetection = 0;
+	trackerConf = 0;
+	detectionRunning = false;
+	detectionDone = false;
+	pthread_mutex_init(&detectionLock, NULL);
 	valid = false;
 	wasValid = false;
 	learning = false;
@@ -49,16 +60,20 @@ TLD::TLD() {
 }
 
 TLD::~TLD() {
+	finishDetection();
 	storeCurrentData();
+	pthread_mutex_destroy(&detectionLock);
 
 	delete detectorCascade;
 	delete medianFlowTracker;
 }
 
 void TLD::release() {
+	finishDetection();
 	detectorCascade->release();
 	medianFlowTracker->cleanPreviousData();
 	delete currBB;
+	currBB = NULL;
 }
 
 void TLD::storeCurrentData() {
@@ -66,13 +81,17 @@ void TLD::storeCurrentData() {
 	prevImg = currImg; //Store old image (if any)
 	prevBB = currBB;		//Store old bounding box (if any)
 
-	detectorCascade->cleanPreviousData(); //Reset detector results
+	if(!detectionRunning) {
+		detectorCascade->cleanPreviousData(); //Reset detector results
+	}
 	medianFlowTracker->cleanPreviousData();
 
 	wasValid = valid;
 }
 
 void TLD::selectObject(Mat img, Rect * bb) {
+	finishDetection();
+
 	//Delete old object
 	detectorCascade->release();
 
@@ -92,29 +111,166 @@ void TLD::selectObject(Mat img, Rect * bb) {
 }
 
 void TLD::processImage(Mat img) {
+	ownFrame.update(img);
+	processFrame(&ownFrame);
+}
+
+//Same as processImage() on a frame prepared once for all the objects in it
+void TLD::processFrame(TLDFrame * frame) {
 	storeCurrentData();
-	Mat grey_frame;
-	cvtColor( img,grey_frame, CV_RGB2GRAY );
-	currImg = grey_frame; // Store new image , right after storeCurrentData();
+	currImg = frame->grey; // Store new image , right after storeCurrentData();
 
 	if(trackerEnabled) {
 		medianFlowTracker->track(prevImg, currImg, prevBB);
 	}
 
-	if(detectorEnabled && (!alternating || medianFlowTracker->trackerBB == NULL)) {
-		detectorCascade->detect(grey_frame);
+	Rect* trackerBB = medianFlowTracker->trackerBB;
+	trackerConf = (trackerBB != NULL) ? nnClassifier->classifyBB(currImg, trackerBB) : 0;
+
+	framesSinceDetection++;
+	bool scheduled = detectionScheduled(trackerBB);
+	bool detect = detectorEnabled && (!alternating || trackerBB == NULL) && scheduled;
+
+	if(detectionThreaded) {
+		//The detector and the classifiers belong to the worker while it runs,
+		//this frame is decided by the tracker alone
+		fuseHypotheses(false);
+		learning = false;
+
+		mergeDetection();
+
+		if(detect && !detectionRunning) {
+			startDetection();
+		}
+		return;
+	}
+
+	finishDetection(); //Left by detectionThreaded being switched off
+
+	if(detect) {
+		nnClassifier->syncTemplates();
+		detectorCascade->detect(currImg, frame);
+		framesSinceDetection = 0;
+	}
+
+	fuseHypotheses(true);
+
+	if(scheduled) {
+		learn();
+	} else {
+		learning = false;
+	}
+
+}
+
+bool TLD::detectionScheduled(Rect * trackerBB) {
+	if(trackerBB == NULL || detectionInterval == 1) {
+		return true;
+	}
+
+	if(detectionInterval > 1 && framesSinceDetection >= detectionInterval) {
+		return true;
 	}
 
-	fuseHypotheses();
+	return trackerConf < detectionThreshold;
+}
 
-	learn();
+void TLD::startDetection() {
+	framesSinceDetection = 0;
 
+	detectionImg = currImg; //A new image every frame, see TLDFrame::update()
+	detectionHasBB = (currBB != NULL);
+	if(detectionHasBB) {
+		detectionBB = *currBB;
+	}
+	detectionValid = valid;
+	detectionConf = trackerConf;
+	detectionDone = false;
+	detectionRunning = true;
+
+	//Here, as the worker only reads the templates and classifyBB() keeps
+	//reading them on this thread while it runs
+	nnClassifier->syncTemplates();
+
+	if(pthread_create(&detectionThread, NULL, detectionWorker, this) != 0) {
+		g_warning("Could not start the detection thread, detecting in place from now on");
+		detectionRunning = false;
+		detectionThreaded = false;
+	}
 }
 
-void TLD::fuseHypotheses() {
+void * TLD::detectionWorker(void * arg) {
+	TLD * tld = (TLD *) arg;
+
+	//Not the frame integral images, the frame will be gone by then
+	tld->detectorCascade->detect(tld->detectionImg);
+
+	pthread_mutex_lock(&tld->detectionLock);
+	tld->detectionDone = true;
+	pthread_mutex_unlock(&tld->detectionLock);
+	return NULL;
+}
+
+//Merges a finished detection into the current frame. The detection and
+//the learning refer to the frame the worker was started on; a detection that
+//wins over the track (same rule as fuseHypotheses()) re-seeds the tracker,
+//a few frames late.
+bool TLD::mergeDetection() {
+	if(!detectionRunning) {
+		return false;
+	}
+
+	pthread_mutex_lock(&detectionLock);
+	bool done = detectionDone;
+	pthread_mutex_unlock(&detectionLock);
+
+	if(!done) {
+		return false;
+	}
+
+	pthread_join(detectionThread, NULL);
+	detectionRunning = false;
+
+	DetectionResult* detectionResult = detectorCascade->detectionResult;
+
+	if(detectionResult->numClusters == 1) {
+		Rect* detectorBB = detectionResult->detectorBB;
+		float confDetector = nnClassifier->classifyBB(detectionImg, detectorBB);
+
+		if(currBB == NULL || (confDetector > detectionConf &&
+				(!detectionHasBB || tldOverlapRectRect(detectionBB, *detectorBB) < 0.5))) {
+			delete currBB;
+			currBB = tldCopyRect(detectorBB);
+			currConf = confDetector;
+			valid = false;
+		}
+	}
+
+	if(learningEnabled && detectorEnabled && detectionValid && detectionHasBB) {
+		learning = true;
+		learnOn(detectionImg, &detectionBB);
+	}
+
+	detectionImg.release();
+	return true;
+}
+
+//Waits for a detection in progress, which is dropped
+void TLD::finishDetection() {
+	if(!detectionRunning) {
+		return;
+	}
+
+	pthread_join(detectionThread, NULL);
+	detectionRunning = false;
+	detectionImg.release();
+	detectorCascade->cleanPreviousData();
+}
+
+void TLD::fuseHypotheses(bool withDetector) {
 	Rect* trackerBB = medianFlowTracker->trackerBB;
-	int numClusters = detectorCascade->detectionResult->numClusters;
-	Rect* detectorBB = detectorCascade->detectionResult->detectorBB;
+	int numClusters = withDetector ? detectorCascade->detectionResult->numClusters : 0;
+	Rect* detectorBB = withDetector ? detectorCascade->detectionResult->detectorBB : NULL;
 
 
 	currBB = NULL;
@@ -128,7 +284,7 @@ void TLD::fuseHypotheses() {
 	}
 
 	if(trackerBB != NULL) {
-		float confTracker = nnClassifier->classifyBB(currImg, trackerBB);
+		float confTracker = trackerConf;
 
 		if(numClusters == 1 && confDetector > confTracker && tldOverlapRectRect(*trackerBB, *detectorBB) < 0.5) {
 
@@ -240,18 +396,24 @@ void TLD::learn() {
 	}
 	learning = true;
 
-	DetectionResult* detectionResult = detectorCascade->detectionResult;
-
-	if(!detectionResult->containsValidData) {
+	if(!detectorCascade->detectionResult->containsValidData) {
+		nnClassifier->syncTemplates();
 		detectorCascade->detect(currImg);
 	}
 
+	learnOn(currImg, currBB);
+}
+
+//Learns bb in img, from the detector results of img
+void TLD::learnOn(Mat img, Rect * bb) {
+	DetectionResult* detectionResult = detectorCascade->detectionResult;
+
 	//This is the positive patch
 	NormalizedPatch patch;
-	tldExtractNormalizedPatchRect(currImg, currBB, patch.values);
+	tldExtractNormalizedPatchRect(img, bb, patch.values);
 
 	float * overlap = new float[detectorCascade->numWindows];
-	tldOverlapRect(detectorCascade->windows, detectorCascade->numWindows, currBB,overlap);
+	tldOverlapRect(detectorCascade->windows, detectorCascade->numWindows, bb,overlap);
 
 	//Add all bounding boxes with high overlap
 
@@ -293,21 +455,21 @@ void TLD::learn() {
 	for(size_t i = 0; i < negativeIndices.size(); i++) {
 		int idx = negativeIndices.at(i);
 		//TODO: Somewhere here image warping might be possible
-		detectorCascade->ensembleClassifier->learn(currImg, &detectorCascade->windows[TLD_WINDOW_SIZE*idx], false, &detectionResult->featureVectors[detectorCascade->numTrees*idx]);
+		detectorCascade->ensembleClassifier->learn(img, &detectorCascade->windows[TLD_WINDOW_SIZE*idx], false, &detectionResult->featureVectors[detectorCascade->numTrees*idx]);
 	}
 
 	//TODO: Randomization might be a good idea
 	for(int i = 0; i < numIterations; i++) {
 		int idx = positiveIndices.at(i).first;
 		//TODO: Somewhere here image warping might be possible
-		detectorCascade->ensembleClassifier->learn(currImg, &detectorCascade->windows[TLD_WINDOW_SIZE*idx], true, &detectionResult->featureVectors[detectorCascade->numTrees*idx]);
+		detectorCascade->ensembleClassifier->learn(img, &detectorCascade->windows[TLD_WINDOW_SIZE*idx], true, &detectionResult->featureVectors[detectorCascade->numTrees*idx]);
 	}
 
 	for(size_t i = 0; i < negativeIndicesForNN.size(); i++) {
 		int idx = negativeIndicesForNN.at(i);
 
 		NormalizedPatch patch;
-		tldExtractNormalizedPatchBB(currImg, &detectorCascade->windows[TLD_WINDOW_SIZE*idx], patch.values);
+		tldExtractNormalizedPatchBB(img, &detectorCascade->windows[TLD_WINDOW_SIZE*idx], patch.values);
 		patch.positive = 0;
 		patches.push_back(patch);
 	}
@@ -326,6 +488,8 @@ typedef struct {
 } TldExportEntry;
 
 void TLD::writeToFile(const char * path) {
+	finishDetection();
+
 	NNClassifier * nn = detectorCascade->nnClassifier;
 	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
 
@@ -397,7 +561,49 @@ void TLD::writeToFile(const char * path) {
 
 }
 
-void TLD::readFromFile(const char * path) {
+//Reports a text model that cannot be read and drops what was read of it,
+//leaving no object
+static bool modelError(DetectorCascade * dc, FILE * file, const char * path, const char * what) {
+	if(file != NULL) {
+		fclose(file);
+	}
+	dc->nnClassifier->truePositives->clear();
+	dc->nnClassifier->falsePositives->clear();
+	dc->ensembleClassifier->release();
+	g_warning("Cannot read the TLD model %s: %s", path, what);
+	return false;
+}
+
+//Reads the rows of a patch, at most TLD_PATCH_SIZE values each
+static void readPatch(FILE * file, char * str_buf, int max_len, float * values) {
+	for(int i = 0; i < TLD_PATCH_SIZE; i++) {
+		if(fgets(str_buf, max_len, file) == NULL) { /*Read sample*/
+			str_buf[0] = 0;
+		}
+
+		char * pch;
+		pch = strtok (str_buf," ");
+		int j = 0;
+		while (pch != NULL && j < TLD_PATCH_SIZE)
+		{
+			values[i*TLD_PATCH_SIZE+j] = atof(pch);
+			pch = strtok (NULL, " ");
+			j++;
+		}
+	}
+}
+
+//Text or binary model, told apart by the content. Returns false, leaving no
+//object, if path is missing or not a valid model.
+bool TLD::readFromFile(const char * path) {
+	if(TLDModel::isModelFile(path)) {
+		if(!readFromBinaryFile(path)) {
+			g_warning("Cannot read the TLD model %s: invalid binary model", path);
+			return false;
+		}
+		return true;
+	}
+
 	release();
 
 	NNClassifier * nn = detectorCascade->nnClassifier;
@@ -406,84 +612,66 @@ void TLD::readFromFile(const char * path) {
 	FILE * file = fopen(path, "r");
 
 	if(file == NULL) {
-		printf("Error: Model not found: %s\n", path);
-		exit(1);
+		return modelError(detectorCascade, NULL, path, "not found");
 	}
 
 	int MAX_LEN=255;
 	char str_buf[255];
-	fgets(str_buf, MAX_LEN, file); /*Skip line*/
+	if(fgets(str_buf, MAX_LEN, file) == NULL) { /*Skip line*/
+		return modelError(detectorCascade, file, path, "empty");
+	}
 
-	fscanf(file,"%d \n", &detectorCascade->objWidth);
+	if(fscanf(file,"%d \n", &detectorCascade->objWidth) != 1) {
+		return modelError(detectorCascade, file, path, "no width");
+	}
 	fgets(str_buf, MAX_LEN, file); /*Skip rest of line*/
-	fscanf(file,"%d \n", &detectorCascade->objHeight);
+	if(fscanf(file,"%d \n", &detectorCascade->objHeight) != 1) {
+		return modelError(detectorCascade, file, path, "no height");
+	}
 	fgets(str_buf, MAX_LEN, file); /*Skip rest of line*/
+	if(detectorCascade->objWidth <= 0 || detectorCascade->objHeight <= 0) {
+		return modelError(detectorCascade, file, path, "invalid object size");
+	}
 
-	fscanf(file,"%f \n", &detectorCascade->varianceFilter->minVar);
+	if(fscanf(file,"%f \n", &detectorCascade->varianceFilter->minVar) != 1) {
+		return modelError(detectorCascade, file, path, "no minimum variance");
+	}
 	fgets(str_buf, MAX_LEN, file); /*Skip rest of line*/
 
 	int numPositivePatches;
-	fscanf(file, "%d \n", &numPositivePatches);
+	if(fscanf(file, "%d \n", &numPositivePatches) != 1 || numPositivePatches < 0) {
+		return modelError(detectorCascade, file, path, "invalid positive sample size");
+	}
 	fgets(str_buf, MAX_LEN, file); /*Skip line*/
 
-
 	for(int s = 0; s < numPositivePatches; s++) {
 		NormalizedPatch patch;
-
-		for(int i = 0; i < 15; i++) { //Do 15 times
-
-			fgets(str_buf, MAX_LEN, file); /*Read sample*/
-
-			char * pch;
-			pch = strtok (str_buf," ");
-			int j = 0;
-			while (pch != NULL)
-			{
-				float val = atof(pch);
-				patch.values[i*TLD_PATCH_SIZE+j] = val;
-
-				pch = strtok (NULL, " ");
-
-				j++;
-			}
-		}
-
+		readPatch(file, str_buf, MAX_LEN, patch.values);
 		nn->truePositives->push_back(patch);
 	}
 
 	int numNegativePatches;
-	fscanf(file, "%d \n", &numNegativePatches);
+	if(fscanf(file, "%d \n", &numNegativePatches) != 1 || numNegativePatches < 0) {
+		return modelError(detectorCascade, file, path, "invalid negative sample size");
+	}
 	fgets(str_buf, MAX_LEN, file); /*Skip line*/
 
-
 	for(int s = 0; s < numNegativePatches; s++) {
 		NormalizedPatch patch;
-		for(int i = 0; i < 15; i++) { //Do 15 times
-
-			fgets(str_buf, MAX_LEN, file); /*Read sample*/
-
-			char * pch;
-			pch = strtok (str_buf," ");
-			int j = 0;
-			while (pch != NULL)
-			{
-				float val = atof(pch);
-				patch.values[i*TLD_PATCH_SIZE+j] = val;
-
-				pch = strtok (NULL, " ");
-
-				j++;
-			}
-		}
-
+		readPatch(file, str_buf, MAX_LEN, patch.values);
 		nn->falsePositives->push_back(patch);
 	}
 
-	fscanf(file,"%d \n", &ec->numTrees);
+	if(fscanf(file,"%d \n", &ec->numTrees) != 1 || ec->numTrees <= 0) {
+		return modelError(detectorCascade, file, path, "invalid number of trees");
+	}
 	detectorCascade->numTrees = ec->numTrees;
 	fgets(str_buf, MAX_LEN, file); /*Skip rest of line*/
 
-	fscanf(file,"%d \n", &ec->numFeatures);
+	//2^numFeatures leaves per tree
+	if(fscanf(file,"%d \n", &ec->numFeatures) != 1 || ec->numFeatures <= 0 || ec->numFeatures > 24) {
+		return modelError(detectorCascade, file, path, "invalid number of features");
+	}
 	detectorCascade->numFeatures = ec->numFeatures;
 	fgets(str_buf, MAX_LEN, file); /*Skip rest of line*/
 
@@ -497,23 +685,37 @@ void TLD::readFromFile(const char * path) {
 
 		for(int j = 0; j < ec->numFeatures; j++) {
 			float * features = ec->features + 4*ec->numFeatures*i + 4*j;
-			fscanf(file, "%f %f %f %f",&features[0], &features[1], &features[2], &features[3]);
+			if(fscanf(file, "%f %f %f %f",&features[0], &features[1], &features[2], &features[3]) != 4) {
+				return modelError(detectorCascade, file, path, "truncated features");
+			}
 			fgets(str_buf, MAX_LEN, file); /*Skip rest of line*/
 		}
 
 		/* read number of leaves*/
 		int numLeaves;
-		fscanf(file,"%d \n", &numLeaves);
+		if(fscanf(file,"%d \n", &numLeaves) != 1) {
+			return modelError(detectorCascade, file, path, "no number of leaves");
+		}
 		fgets(str_buf, MAX_LEN, file); /*Skip rest of line*/
 
 		for(int j = 0; j < numLeaves; j++) {
 			TldExportEntry entry;
-			fscanf(file,"%d %d %d \n", &entry.index, &entry.P, &entry.N);
+			if(fscanf(file,"%d %d %d \n", &entry.index, &entry.P, &entry.N) != 3 ||
+					entry.index < 0 || entry.index >= ec->numIndices) {
+				return modelError(detectorCascade, file, path, "invalid leaf");
+			}
 			ec->updatePosterior(i, entry.index, 1, entry.P);
 			ec->updatePosterior(i, entry.index, 0, entry.N);
 		}
 	}
 
+	fclose(file);
+	initFromModel();
+	return true;
+}
+
+//Detector set up for a model read into the classifiers
+void TLD::initFromModel() {
 	detectorCascade->initWindowsAndScales();
 	detectorCascade->initWindowOffsets();
 
@@ -521,8 +723,116 @@ void TLD::readFromFile(const char * path) {
 
 	detectorCascade->initialised = true;
 
-	ec->initFeatureOffsets();
+	detectorCascade->ensembleClassifier->initFeatureOffsets();
+
+	detectorCascade->nnClassifier->syncTemplates();
+}
+
+//Same content as writeToFile(), as a TLDModel file. Written aside and renamed
+//so that trackers mapping the previous version never see a partial file.
+bool TLD::writeToBinaryFile(const char * path) {
+	finishDetection();
+
+	NNClassifier * nn = detectorCascade->nnClassifier;
+	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
+
+	TLDModelHeader header;
+	memset(&header, 0, sizeof(header));
+	header.objWidth = detectorCascade->objWidth;
+	header.objHeight = detectorCascade->objHeight;
+	header.minVar = detectorCascade->varianceFilter->minVar;
+	header.numPositives = nn->truePositives->size();
+	header.numNegatives = nn->falsePositives->size();
+	header.numTrees = ec->numTrees;
+	header.numFeatures = ec->numFeatures;
+	header.numIndices = ec->numIndices;
+	TLDModel::layout(&header);
+
+	string tmpPath = string(path) + ".tmp";
+	FILE * file = fopen(tmpPath.c_str(), "wb");
+	if(file == NULL) {
+		return false;
+	}
+
+	int patchSize = TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+	int treeSize = ec->numTrees * ec->numIndices;
+
+	fwrite(&header, sizeof(header), 1, file);
+
+	TLDModel::pad(file, header.positivePatches);
+	for(size_t s = 0; s < nn->truePositives->size(); s++) {
+		fwrite(nn->truePositives->at(s).values, sizeof(float), patchSize, file);
+	}
+
+	TLDModel::pad(file, header.negativePatches);
+	for(size_t s = 0; s < nn->falsePositives->size(); s++) {
+		fwrite(nn->falsePositives->at(s).values, sizeof(float), patchSize, file);
+	}
+
+	TLDModel::pad(file, header.features);
+	fwrite(ec->features, sizeof(float), 4 * ec->numTrees * ec->numFeatures, file);
+	TLDModel::pad(file, header.positives);
+	fwrite(ec->positives, sizeof(int), treeSize, file);
+	TLDModel::pad(file, header.negatives);
+	fwrite(ec->negatives, sizeof(int), treeSize, file);
+	TLDModel::pad(file, header.posteriors);
+	fwrite(ec->posteriors, sizeof(float), treeSize, file);
+
+	bool ok = ftell(file) == (long)header.fileSize;
+	ok = (fclose(file) == 0) && ok;
+	ok = ok && rename(tmpPath.c_str(), path) == 0;
+	if(!ok) {
+		remove(tmpPath.c_str());
+	}
+	return ok;
+}
+
+//The arrays are copied out of the shared mapping, as learning keeps updating
+//them afterwards. Returns false, leaving no object, if path is not a valid model.
+bool TLD::readFromBinaryFile(const char * path) {
+	release();
+
+	TLDModel * model = TLDModel::open(path);
+	if(model == NULL) {
+		return false;
+	}
+
+	const TLDModelHeader * header = model->header();
+	NNClassifier * nn = detectorCascade->nnClassifier;
+	EnsembleClassifier* ec = detectorCascade->ensembleClassifier;
+	int patchSize = TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+
+	detectorCascade->objWidth = header->objWidth;
+	detectorCascade->objHeight = header->objHeight;
+	detectorCascade->varianceFilter->minVar = header->minVar;
+
+	nn->truePositives->resize(header->numPositives);
+	for(int s = 0; s < header->numPositives; s++) {
+		memcpy(nn->truePositives->at(s).values, model->positivePatches() + s * patchSize, sizeof(float) * patchSize);
+		nn->truePositives->at(s).positive = true;
+	}
+
+	nn->falsePositives->resize(header->numNegatives);
+	for(int s = 0; s < header->numNegatives; s++) {
+		memcpy(nn->falsePositives->at(s).values, model->negativePatches() + s * patchSize, sizeof(float) * patchSize);
+		nn->falsePositives->at(s).positive = false;
+	}
+
+	ec->numTrees = detectorCascade->numTrees = header->numTrees;
+	ec->numFeatures = detectorCascade->numFeatures = header->numFeatures;
+	ec->numIndices = header->numIndices;
+
+	int size = 2 * 2 * ec->numFeatures * ec->numTrees;
+	ec->features = new float[size];
+	memcpy(ec->features, model->features(), sizeof(float) * size);
+
+	ec->initPosteriors();
+	ec->setPosteriors(model->positives(), model->negatives(), model->posteriors());
+
+	TLDModel::close(model);
 
+	initFromModel();
+	return true;
 }
 
 
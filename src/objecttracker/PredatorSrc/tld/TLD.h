@@ -27,9 +27,11 @@
 #define TLD_H_
 
 #include <opencv/cv.h>
+#include <pthread.h>
 
 #include "MedianFlowTracker.h"
 #include "DetectorCascade.h"
+#include "TLDFrame.h"
 
 using namespace cv;
 
@@ -37,15 +39,47 @@ namespace tld {
 
 class TLD {
 	void storeCurrentData();
-	void fuseHypotheses();
+	void fuseHypotheses(bool withDetector);
 	void learn();
+	void learnOn(Mat img, Rect * bb);
 	void initialLearning();
+	void initFromModel();
+	bool detectionScheduled(Rect * trackerBB);
+	void startDetection();
+	bool mergeDetection();
+	void finishDetection();
+	static void * detectionWorker(void * tld);
+
+	TLDFrame ownFrame; //Used by processImage()
+
+	int framesSinceDetection;
+	float trackerConf;
+
+	//Detection running on the worker thread, and the state of the frame it
+	//was started on, which it is merged against
+	pthread_t detectionThread;
+	pthread_mutex_t detectionLock;
+	bool detectionRunning;
+	bool detectionDone;
+	Mat detectionImg;
+	Rect detectionBB;
+	bool detectionHasBB;
+	bool detectionValid;
+	float detectionConf;
 public:
 	bool trackerEnabled;
 	bool detectorEnabled;
 	bool learningEnabled;
 	bool alternating;
 
+	//Detection cadence: the tracker runs on every frame, the detector at most
+	//every detectionInterval frames, and also whenever the tracker confidence
+	//is below detectionThreshold or the tracker is lost. The learning step
+	//needs the detector results, so it is done on the detection frames only.
+	int detectionInterval; //1 = every frame
+	float detectionThreshold; //0 = confidence does not trigger detections
+	bool detectionThreaded; //Detect on a worker thread, merged when done
+
 	MedianFlowTracker* medianFlowTracker;
 	DetectorCascade* detectorCascade;
 	NNClassifier* nnClassifier;
@@ -63,8 +97,11 @@ public:
 	void release();
 	void selectObject(Mat img, Rect * bb);
 	void processImage(Mat img);
+	void processFrame(TLDFrame * frame);
 	void writeToFile(const char * path);
-	void readFromFile(const char * path);
+	bool readFromFile(const char * path);
+	bool writeToBinaryFile(const char * path);
+	bool readFromBinaryFile(const char * path);
 };
 
 struct TrackerResult
@@ -0,0 +1,53 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * TLDFrame.cpp
+ */
+
+#include "TLDFrame.h"
+
+namespace tld {
+
+TLDFrame::TLDFrame() {
+	integralImg = NULL;
+	integralImg_squared = NULL;
+}
+
+TLDFrame::~TLDFrame() {
+	delete integralImg;
+	delete integralImg_squared;
+}
+
+void TLDFrame::update(Mat img) {
+	//A new grey image every frame: the trackers keep the previous one
+	grey = Mat();
+	cvtColor(img, grey, CV_RGB2GRAY);
+
+	//The integral images are only used while detecting in this frame
+	if(integralImg == NULL || integralImg->width != grey.cols || integralImg->height != grey.rows) {
+		delete integralImg;
+		delete integralImg_squared;
+		integralImg = new IntegralImage<int>(grey.size());
+		integralImg_squared = new IntegralImage<long long>(grey.size());
+	}
+	integralImg->calcIntImg(grey);
+	integralImg_squared->calcIntImg(grey, true);
+}
+
+} /* namespace tld */
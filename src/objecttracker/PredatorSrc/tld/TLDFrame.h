@@ -0,0 +1,52 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * TLDFrame.h
+ *
+ * Per-frame data that does not depend on the object: the grey image and its
+ * integral images. Computed once per frame and shared by every TLD tracking
+ * an object in it, see TLD::processFrame().
+ */
+
+#ifndef TLDFRAME_H_
+#define TLDFRAME_H_
+
+#include <opencv/cv.h>
+
+#include "../tld/IntegralImage.h"
+
+using namespace cv;
+
+namespace tld {
+
+class TLDFrame {
+public:
+	Mat grey;
+	IntegralImage<int>* integralImg;
+	IntegralImage<long long>* integralImg_squared;
+
+	TLDFrame();
+	virtual ~TLDFrame();
+
+	//img is converted the way TLD::processImage() does it
+	void update(Mat img);
+};
+
+} /* namespace tld */
+#endif /* TLDFRAME_H_ */
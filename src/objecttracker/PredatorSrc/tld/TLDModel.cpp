@@ -0,0 +1,178 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * TLDModel.cpp
+ */
+
+#include "TLDModel.h"
+#include "NormalizedPatch.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+
+using namespace std;
+
+namespace tld {
+
+//Mappings in use, by path
+static pthread_mutex_t modelsLock = PTHREAD_MUTEX_INITIALIZER;
+static map<string, TLDModel *> models;
+
+static uint64_t alignOffset(uint64_t offset) {
+	return (offset + TLD_MODEL_ALIGN - 1) / TLD_MODEL_ALIGN * TLD_MODEL_ALIGN;
+}
+
+TLDModel::TLDModel() {
+	path = NULL;
+	base = NULL;
+	size = 0;
+	refs = 0;
+}
+
+TLDModel::~TLDModel() {
+	if(base != NULL) munmap(base, size);
+	free(path);
+}
+
+void TLDModel::layout(TLDModelHeader * header) {
+	uint64_t patchBytes = sizeof(float) * TLD_PATCH_SIZE * TLD_PATCH_SIZE;
+	uint64_t treeBytes = sizeof(int32_t) * (uint64_t)header->numTrees * header->numIndices;
+
+	memcpy(header->magic, TLD_MODEL_MAGIC, sizeof(header->magic));
+	header->version = TLD_MODEL_VERSION;
+	header->headerSize = sizeof(TLDModelHeader);
+	header->patchSize = TLD_PATCH_SIZE;
+	header->reserved = 0;
+
+	header->positivePatches = alignOffset(sizeof(TLDModelHeader));
+	header->negativePatches = alignOffset(header->positivePatches + patchBytes * header->numPositives);
+	header->features = alignOffset(header->negativePatches + patchBytes * header->numNegatives);
+	header->positives = alignOffset(header->features + sizeof(float) * 4 * header->numTrees * header->numFeatures);
+	header->negatives = alignOffset(header->positives + treeBytes);
+	header->posteriors = alignOffset(header->negatives + treeBytes);
+	header->fileSize = header->posteriors + treeBytes;
+}
+
+void TLDModel::pad(FILE * file, uint64_t offset) {
+	long current = ftell(file);
+	for(; current >= 0 && (uint64_t)current < offset; current++) {
+		fputc(0, file);
+	}
+}
+
+//Everything the loader relies on, so that a truncated or foreign file is
+//rejected instead of read out of bounds
+static bool validHeader(const TLDModelHeader * h, size_t size) {
+	if(size < sizeof(TLDModelHeader)) return false;
+	if(memcmp(h->magic, TLD_MODEL_MAGIC, sizeof(h->magic)) != 0) return false;
+	if(h->version != TLD_MODEL_VERSION || h->headerSize != sizeof(TLDModelHeader)) return false;
+	if(h->patchSize != TLD_PATCH_SIZE) return false;
+	if(h->numPositives < 0 || h->numNegatives < 0) return false;
+	if(h->numTrees <= 0 || h->numFeatures <= 0 || h->numFeatures > 24) return false;
+	if(h->numIndices != (1 << h->numFeatures)) return false;
+
+	TLDModelHeader expected = *h;
+	TLDModel::layout(&expected);
+	return memcmp(&expected, h, sizeof(TLDModelHeader)) == 0 && h->fileSize <= size;
+}
+
+TLDModel * TLDModel::open(const char * path) {
+	struct stat st;
+	if(stat(path, &st) != 0) return NULL;
+
+	pthread_mutex_lock(&modelsLock);
+
+	map<string, TLDModel *>::iterator it = models.find(path);
+	if(it != models.end()) {
+		TLDModel * model = it->second;
+		if(model->device == st.st_dev && model->inode == st.st_ino &&
+				model->mtime == st.st_mtime && model->size == (size_t)st.st_size) {
+			model->refs++;
+			pthread_mutex_unlock(&modelsLock);
+			return model;
+		}
+		//Rewritten since: whoever holds the old mapping keeps it until closing
+		models.erase(it);
+	}
+
+	TLDModel * model = NULL;
+	int fd = ::open(path, O_RDONLY);
+	if(fd >= 0 && st.st_size > 0) {
+		void * base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if(base != MAP_FAILED) {
+			model = new TLDModel();
+			model->base = base;
+			model->size = st.st_size;
+			if(validHeader(model->header(), model->size)) {
+				model->path = strdup(path);
+				model->refs = 1;
+				model->device = st.st_dev;
+				model->inode = st.st_ino;
+				model->mtime = st.st_mtime;
+				models[path] = model;
+			} else {
+				delete model;
+				model = NULL;
+			}
+		}
+	}
+	if(fd >= 0) ::close(fd);
+
+	pthread_mutex_unlock(&modelsLock);
+	return model;
+}
+
+void TLDModel::close(TLDModel * model) {
+	if(model == NULL) return;
+
+	pthread_mutex_lock(&modelsLock);
+	if(--model->refs == 0) {
+		map<string, TLDModel *>::iterator it = models.find(model->path);
+		if(it != models.end() && it->second == model) models.erase(it);
+		delete model;
+	}
+	pthread_mutex_unlock(&modelsLock);
+}
+
+bool TLDModel::isModelFile(const char * path) {
+	char magic[8];
+	FILE * file = fopen(path, "rb");
+	if(file == NULL) return false;
+
+	bool isModel = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+			memcmp(magic, TLD_MODEL_MAGIC, sizeof(magic)) == 0;
+	fclose(file);
+	return isModel;
+}
+
+bool TLDModel::hasModelExtension(const char * path) {
+	size_t len = strlen(path);
+	size_t extLen = strlen(TLD_MODEL_EXTENSION);
+	return len >= extLen && strcmp(path + len - extLen, TLD_MODEL_EXTENSION) == 0;
+}
+
+} /* namespace tld */
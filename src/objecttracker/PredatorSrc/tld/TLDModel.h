@@ -0,0 +1,105 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * TLDModel.h
+ *
+ * Binary model file: a header followed by the patches of the NN classifier,
+ * the fern features and the fern counts and posteriors, each array starting
+ * on a TLD_MODEL_ALIGN boundary so that it can be used straight from a
+ * read-only memory mapping. Values are stored in the byte order of the host.
+ * The trackers loading a file at the same time share its mapping; each one
+ * copies the arrays out of it, as learning keeps updating them, and the file
+ * is unmapped once the last load is done.
+ */
+
+#ifndef TLDMODEL_H_
+#define TLDMODEL_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+namespace tld {
+
+#define TLD_MODEL_MAGIC "TLDMODEL"
+#define TLD_MODEL_EXTENSION ".tldm"
+static const uint32_t TLD_MODEL_VERSION = 1;
+static const int TLD_MODEL_ALIGN = 32;
+
+//All the offsets are in bytes from the start of the file
+struct TLDModelHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	int32_t patchSize;             //TLD_PATCH_SIZE, patches are patchSize^2 floats
+	int32_t objWidth;
+	int32_t objHeight;
+	float minVar;
+	int32_t numPositives;
+	int32_t numNegatives;
+	int32_t numTrees;
+	int32_t numFeatures;
+	int32_t numIndices;            //2^numFeatures
+	int32_t reserved;
+	uint64_t positivePatches;      //numPositives patches
+	uint64_t negativePatches;      //numNegatives patches
+	uint64_t features;             //numTrees*numFeatures*4 floats
+	uint64_t positives;            //numTrees*numIndices int32
+	uint64_t negatives;            //numTrees*numIndices int32
+	uint64_t posteriors;           //numTrees*numIndices floats
+	uint64_t fileSize;
+};
+
+class TLDModel {
+	char * path;
+	void * base;
+	size_t size;
+	int refs;
+	dev_t device;
+	ino_t inode;
+	time_t mtime;
+
+	TLDModel();
+	~TLDModel();
+public:
+	const TLDModelHeader * header() const { return (const TLDModelHeader *)base; }
+	const float * positivePatches() const { return (const float *)((const char *)base + header()->positivePatches); }
+	const float * negativePatches() const { return (const float *)((const char *)base + header()->negativePatches); }
+	const float * features() const { return (const float *)((const char *)base + header()->features); }
+	const int * positives() const { return (const int *)((const char *)base + header()->positives); }
+	const int * negatives() const { return (const int *)((const char *)base + header()->negatives); }
+	const float * posteriors() const { return (const float *)((const char *)base + header()->posteriors); }
+
+	//Maps path, or takes a reference on the mapping of another tracker if the
+	//file has not changed since. NULL if the file is not a valid binary model.
+	static TLDModel * open(const char * path);
+	static void close(TLDModel * model);
+
+	//True if path starts like a binary model, false for anything else (text)
+	static bool isModelFile(const char * path);
+	static bool hasModelExtension(const char * path);
+
+	//Fills in magic, version, sizes and the offsets of header from its counts
+	static void layout(TLDModelHeader * header);
+	//Writes zeros up to offset
+	static void pad(FILE * file, uint64_t offset);
+};
+
+} /* namespace tld */
+#endif /* TLDMODEL_H_ */
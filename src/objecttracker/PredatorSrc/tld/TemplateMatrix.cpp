@@ -0,0 +1,203 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * TemplateMatrix.cpp
+ */
+
+#include "TemplateMatrix.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace tld {
+
+TemplateMatrix::TemplateMatrix() {
+	data = NULL;
+	valid = NULL;
+	rows = 0;
+	capacity = 0;
+}
+
+TemplateMatrix::~TemplateMatrix() {
+	free(data);
+	free(valid);
+}
+
+//On failure the matrix is left as it was
+bool TemplateMatrix::reserve(int n) {
+	if(n <= capacity) return true;
+
+	int newCapacity = (capacity > 0) ? capacity : 64;
+	while(newCapacity < n) newCapacity *= 2;
+
+	//valid may end up larger than capacity, never smaller
+	bool * newValid = (bool *)realloc(valid, sizeof(bool)*newCapacity);
+	if(newValid == NULL) {
+		return false;
+	}
+	valid = newValid;
+
+	void * newData = NULL;
+	if(posix_memalign(&newData, 32, sizeof(float)*TLD_TEMPLATE_STRIDE*newCapacity) != 0) {
+		return false;
+	}
+	if(rows > 0) memcpy(newData, data, sizeof(float)*TLD_TEMPLATE_STRIDE*rows);
+	free(data);
+	data = (float *)newData;
+
+	capacity = newCapacity;
+	return true;
+}
+
+void TemplateMatrix::clear() {
+	rows = 0;
+}
+
+bool TemplateMatrix::add(const float * values) {
+	if(!reserve(rows+1)) return false; //Out of memory, the template is not added
+
+	rows++;
+	set(rows-1, values);
+	return true;
+}
+
+void TemplateMatrix::set(int row, const float * values) {
+	valid[row] = normalize(values, data + TLD_TEMPLATE_STRIDE*row);
+}
+
+void TemplateMatrix::remove(int row) {
+	//Last row takes its place, order is irrelevant for the max
+	rows--;
+	if(row != rows) {
+		memcpy(data + TLD_TEMPLATE_STRIDE*row, data + TLD_TEMPLATE_STRIDE*rows, sizeof(float)*TLD_TEMPLATE_STRIDE);
+		valid[row] = valid[rows];
+	}
+}
+
+bool TemplateMatrix::normalize(const float * values, float * unit) {
+	const int size = TLD_PATCH_SIZE*TLD_PATCH_SIZE;
+	double norm = 0;
+
+	for(int i = 0; i < size; i++) {
+		norm += values[i]*values[i];
+	}
+
+	for(int i = size; i < TLD_TEMPLATE_STRIDE; i++) {
+		unit[i] = 0;
+	}
+
+	if(norm <= 0) {
+		for(int i = 0; i < size; i++) unit[i] = 0;
+		return false;
+	}
+
+	float scale = (float)(1.0 / sqrt(norm));
+	for(int i = 0; i < size; i++) {
+		unit[i] = values[i]*scale;
+	}
+	return true;
+}
+
+//Both rows must be TLD_TEMPLATE_STRIDE long and 16 byte aligned
+float TemplateMatrix::dot(const float * a, const float * b) {
+#ifdef __SSE__
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for(int i = 0; i < TLD_TEMPLATE_STRIDE; i += 8) {
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_load_ps(a+i),   _mm_load_ps(b+i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_load_ps(a+i+4), _mm_load_ps(b+i+4)));
+	}
+	float sum[4] __attribute__((aligned(16)));
+	_mm_store_ps(sum, _mm_add_ps(acc0, acc1));
+	return sum[0] + sum[1] + sum[2] + sum[3];
+#else
+	float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	for(int i = 0; i < TLD_TEMPLATE_STRIDE; i += 4) {
+		s0 += a[i]*b[i];
+		s1 += a[i+1]*b[i+1];
+		s2 += a[i+2]*b[i+2];
+		s3 += a[i+3]*b[i+3];
+	}
+	return (s0 + s1) + (s2 + s3);
+#endif
+}
+
+void TemplateMatrix::correlate(const float * unit, float * scores) const {
+	for(int r = 0; r < rows; r++) {
+		// normalization to <0,1>, flat patches never match (their NCC is undefined)
+		scores[r] = valid[r] ? (dot(data + TLD_TEMPLATE_STRIDE*r, unit) + 1) / 2.0f : 0;
+	}
+}
+
+void TemplateMatrix::correlateRow(int row, float * scores) const {
+	if(!valid[row]) {
+		for(int r = 0; r < rows; r++) scores[r] = 0;
+		return;
+	}
+	correlate(data + TLD_TEMPLATE_STRIDE*row, scores);
+}
+
+int TemplateMatrix::bestMatch(const float * unit, float * score) const {
+	float best = 0;
+	int bestRow = -1;
+
+	for(int r = 0; r < rows; r++) {
+		if(!valid[r]) continue;
+
+		float ccorr = (dot(data + TLD_TEMPLATE_STRIDE*r, unit) + 1) / 2.0f;
+		if(ccorr > best) {
+			best = ccorr;
+			bestRow = r;
+		}
+	}
+
+	if(score != NULL) *score = best;
+	return bestRow;
+}
+
+float TemplateMatrix::maxCorrelation(const float * unit) const {
+	float best;
+	bestMatch(unit, &best);
+	return best;
+}
+
+void TemplateMatrix::maxCorrelation(const float * units, int numUnits, float * best) const {
+	for(int j = 0; j < numUnits; j++) {
+		best[j] = 0;
+	}
+
+	for(int r = 0; r < rows; r++) {
+		if(!valid[r]) continue;
+
+		const float * row = data + TLD_TEMPLATE_STRIDE*r;
+		for(int j = 0; j < numUnits; j++) {
+			float ccorr = (dot(row, units + TLD_TEMPLATE_STRIDE*j) + 1) / 2.0f;
+			if(ccorr > best[j]) {
+				best[j] = ccorr;
+			}
+		}
+	}
+}
+
+} /* namespace tld */
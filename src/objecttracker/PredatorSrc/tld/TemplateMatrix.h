@@ -0,0 +1,78 @@
+/*  Copyright 2011 AIT Austrian Institute of Technology
+*
+*   This file is part of OpenTLD.
+*
+*   OpenTLD is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   OpenTLD is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with OpenTLD.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+/*
+ * TemplateMatrix.h
+ *
+ * Patches of the NN classifier stored zero mean and unit norm, one row per
+ * patch in a contiguous aligned buffer, so that the normalised cross
+ * correlation of a candidate against every template is a dot product per row.
+ */
+
+#ifndef TEMPLATEMATRIX_H_
+#define TEMPLATEMATRIX_H_
+
+#include "../tld/NormalizedPatch.h"
+
+namespace tld {
+
+//Row length in floats: TLD_PATCH_SIZE^2 padded to a whole amount of 8 floats,
+//the padding is kept at zero
+static const int TLD_TEMPLATE_STRIDE = ((TLD_PATCH_SIZE*TLD_PATCH_SIZE + 7) / 8) * 8;
+
+class TemplateMatrix {
+	float * data;     //rows*TLD_TEMPLATE_STRIDE floats, 32 byte aligned
+	bool * valid;     //false for flat patches, which correlate with nothing
+	int rows;
+	int capacity;
+
+	bool reserve(int n);
+
+	//Owns its buffers, not copyable
+	TemplateMatrix(const TemplateMatrix &);
+	TemplateMatrix & operator=(const TemplateMatrix &);
+public:
+	TemplateMatrix();
+	virtual ~TemplateMatrix();
+
+	int size() const { return rows; }
+	void clear();
+	bool add(const float * values); //false if out of memory
+	void set(int row, const float * values);
+	void remove(int row);
+
+	//values (zero mean) -> unit norm row of TLD_TEMPLATE_STRIDE floats,
+	//returns false if the patch is flat
+	static bool normalize(const float * values, float * unit);
+	static float dot(const float * a, const float * b);
+
+	//NCC in [0,1] of a normalised candidate against every row
+	void correlate(const float * unit, float * scores) const;
+	//the above for one of the rows, all 0 if it is flat
+	void correlateRow(int row, float * scores) const;
+	//max over the rows of the above, 0 if there are no rows
+	float maxCorrelation(const float * unit) const;
+	//row holding the max, -1 if none
+	int bestMatch(const float * unit, float * score) const;
+	//maxCorrelation() of numUnits candidates stored every TLD_TEMPLATE_STRIDE
+	//floats; each row is read once for all of them
+	void maxCorrelation(const float * units, int numUnits, float * best) const;
+};
+
+} /* namespace tld */
+#endif /* TEMPLATEMATRIX_H_ */
@@ -34,6 +34,7 @@ VarianceFilter::VarianceFilter() {
 	minVar = 0;
 	integralImg = NULL;
 	integralImg_squared = NULL;
+	ownsIntegralImages = false;
 }
 
 VarianceFilter::~VarianceFilter() {
@@ -41,11 +42,13 @@ VarianceFilter::~VarianceFilter() {
 }
 
 void VarianceFilter::release() {
-	if(integralImg != NULL) delete integralImg;
+	if(ownsIntegralImages) {
+		delete integralImg;
+		delete integralImg_squared;
+	}
 	integralImg = NULL;
-
-	if(integralImg_squared != NULL) delete integralImg_squared;
 	integralImg_squared = NULL;
+	ownsIntegralImages = false;
 }
 
 float VarianceFilter::calcVariance(int *off) {
@@ -61,15 +64,28 @@ float VarianceFilter::calcVariance(int *off) {
 void VarianceFilter::nextIteration(Mat img) {
 	if(!enabled) return;
 
-	release();
+	//Own images are kept from frame to frame as long as the size does not change
+	if(!ownsIntegralImages || integralImg->width != img.cols || integralImg->height != img.rows) {
+		release();
+		integralImg = new IntegralImage<int>(img.size());
+		integralImg_squared = new IntegralImage<long long>(img.size());
+		ownsIntegralImages = true;
+	}
 
-	integralImg = new IntegralImage<int>(img.size());
 	integralImg->calcIntImg(img);
-
-	integralImg_squared = new IntegralImage<long long>(img.size());
 	integralImg_squared->calcIntImg(img, true);
 }
 
+//Integral images of the frame computed once for all the objects tracked in it
+void VarianceFilter::nextIteration(IntegralImage<int>* sharedImg, IntegralImage<long long>* sharedImg_squared) {
+	if(!enabled) return;
+
+	release();
+
+	integralImg = sharedImg;
+	integralImg_squared = sharedImg_squared;
+}
+
 bool VarianceFilter::filter(int i) {
 	if(!enabled) return true;
 
@@ -37,6 +37,7 @@ namespace tld {
 class VarianceFilter {
 	IntegralImage<int>* integralImg;
 	IntegralImage<long long>* integralImg_squared;
+	bool ownsIntegralImages; //false if they come from a TLDFrame
 
 public:
 	bool enabled;
@@ -51,6 +52,7 @@ public:
 
 	void release();
 	void nextIteration(Mat img);
+	void nextIteration(IntegralImage<int>* sharedImg, IntegralImage<long long>* sharedImg_squared);
 	bool filter(int idx);
 	float calcVariance(int *off);
 };
@@ -21,6 +21,10 @@ Predator::Predator()
 	//wrapper->imAcq = imAcq; SSS
 
 	config.configure(wrapper);
+	maxTemplates = 0;
+	detectionInterval = 1;
+	detectionThreshold = 0;
+	detectionThreaded = false;
 
 	srand(wrapper->seed);
 
@@ -44,9 +48,9 @@ void Predator::setTemplate(IplImage *img, Rect boundingBox)
 	wrapper->setTemplate(img, boundingBox);
 }
 
-TrackerResult Predator::doWork(IplImage *img)
+TrackerResult Predator::doWork(IplImage *img, TLDFrame *frame)
 {
-	return wrapper->doWork(img); //wrapper->doWork() return "TrackerResult". Just return it from this funcition
+	return wrapper->doWork(img, frame); //wrapper->doWork() return "TrackerResult". Just return it from this funcition
 }
 
 
@@ -55,11 +59,52 @@ void Predator::resetTemplate(IplImage *img, Rect boundingBox)
 	delete wrapper;
 	wrapper = new Wrapper();
 	config.configure(wrapper);
+	applySettings();
 	srand(wrapper->seed);
 	wrapper->init(img);
 	wrapper->setTemplate(img, boundingBox);
 }
 
 
+bool Predator::loadModel(IplImage *img, const char *path)
+{
+	delete wrapper;
+	wrapper = new Wrapper();
+	config.configure(wrapper);
+	applySettings();
+	srand(wrapper->seed);
+	wrapper->init(img);
+	return wrapper->tld->readFromFile(path);
+}
+
+// The settings below survive resetTemplate(), which recreates the wrapper
+void Predator::applySettings()
+{
+	wrapper->tld->detectorCascade->nnClassifier->maxTemplates = maxTemplates;
+	wrapper->tld->detectionInterval = detectionInterval;
+	wrapper->tld->detectionThreshold = detectionThreshold;
+	wrapper->tld->detectionThreaded = detectionThreaded;
+}
+
+void Predator::setMaxTemplates(int maxTemplates)
+{
+	this->maxTemplates = maxTemplates;
+	applySettings();
+}
+
+void Predator::setDetectionSchedule(int interval, float threshold, bool threaded)
+{
+	detectionInterval = interval;
+	detectionThreshold = threshold;
+	detectionThreaded = threaded;
+	applySettings();
+}
+
+void Predator::getModelSize(int *positives, int *negatives)
+{
+	NNClassifier *nn = wrapper->tld->detectorCascade->nnClassifier;
+	*positives = nn->truePositives->size();
+	*negatives = nn->falsePositives->size();
+}
 
 } //namespace tld
@@ -3,6 +3,7 @@
 
 #include "wrapper.h"
 #include "config.h"
+#include "../tld/TLDModel.h"
 //#include "imAcq.h" SSS
 //#include "gui.h"
 
@@ -26,10 +27,20 @@ public:
 	void init(IplImage *img);
 	void setTemplate(IplImage *img, Rect boundingBox);
     void resetTemplate(IplImage *img, Rect boundingBox);
-	TrackerResult doWork(IplImage *img);
+	bool loadModel(IplImage *img, const char *path);  // text or binary (TLDModel) model, false if unreadable
+	TrackerResult doWork(IplImage *img, TLDFrame *frame = NULL);
+	void setMaxTemplates(int maxTemplates);  // per NN class, 0 = unbounded
+	// detector every interval frames (0 = never, 1 = always) or below threshold confidence
+	void setDetectionSchedule(int interval, float threshold, bool threaded);
+	void getModelSize(int *positives, int *negatives);
 private:
 	Wrapper	*wrapper;
 	Config	config;
+	int		maxTemplates;
+	int		detectionInterval;
+	float	detectionThreshold;
+	bool	detectionThreaded;
+	void	applySettings();
 	//ImAcq	*imAcq; SSS
 	//Gui		*gui; SSS
 };
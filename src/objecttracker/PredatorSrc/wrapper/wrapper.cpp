@@ -28,6 +28,7 @@
 // #include "imAcq.h" //SSS
 //#include "gui.h" //SSS
 #include "../tld/TLDUtil.h"
+#include "../tld/TLDModel.h"
 
 void Wrapper::init(IplImage *img)
 {
@@ -81,8 +82,7 @@ void Wrapper::init(IplImage *img)
 
 	bool reuseFrameOnce = false;
 	bool skipProcessingOnce = false;
-	if(loadModel && modelPath != NULL) {
-		tld->readFromFile(modelPath);
+	if(loadModel && modelPath != NULL && tld->readFromFile(modelPath)) {
 		reuseFrameOnce = true;
 	} else if(initialBB != NULL) {
 		Rect bb = tldArrayToRect(initialBB);
@@ -107,7 +107,8 @@ void Wrapper::setTemplate(IplImage *img, Rect boundingBox)
 	cvReleaseImage(&grey);
 }
 
-TrackerResult Wrapper::doWork(IplImage *img) 
+//frame, if given, is img prepared once for all the trackers of the frame
+TrackerResult Wrapper::doWork(IplImage *img, TLDFrame *frame)
 {
 
 
@@ -118,7 +119,6 @@ TrackerResult Wrapper::doWork(IplImage *img)
 	FILE * resultsFile = NULL; //SSS added this
 	printResults = 0; //SSS added this
 
-	IplImage *grey;
 	TrackerResult trackerResult; 
 
 	//while(imAcqHasMoreFrames(imAcq)) { SSS
@@ -134,12 +134,16 @@ TrackerResult Wrapper::doWork(IplImage *img)
 			cvCvtColor( img, grey, CV_BGR2GRAY );
 		}
 		*/ //SSS
-			
-		grey = cvCreateImage( cvGetSize(img), 8, 1 );
-		cvCvtColor( img, grey, CV_BGR2GRAY );
+
+		// The grey image is converted by TLD itself, it was only used by the
+		// interactive commands disabled below
 
 		if(!skipProcessingOnce) {
-			tld->processImage(img);
+			if(frame != NULL) {
+				tld->processFrame(frame);
+			} else {
+				tld->processImage(img);
+			}
 		} else {
 			skipProcessingOnce = false;
 		}
@@ -273,14 +277,17 @@ TrackerResult Wrapper::doWork(IplImage *img)
 
 		if(!reuseFrameOnce) {
 			//cvReleaseImage(&img); SSS Commented this out
-			cvReleaseImage(&grey);
 		} else {
 			reuseFrameOnce = false;
 		}
 	//}
 
 	if(exportModelAfterRun) {
-		tld->writeToFile(modelExportFile);
+		if(TLDModel::hasModelExtension(modelExportFile)) {
+			tld->writeToBinaryFile(modelExportFile);
+		} else {
+			tld->writeToFile(modelExportFile);
+		}
 	}
 
 	return trackerResult;
@@ -86,7 +86,7 @@ public:
 
 	void init(IplImage *img);
 	void setTemplate(IplImage *img, Rect boundingBox);
-	TrackerResult doWork(IplImage *img);
+	TrackerResult doWork(IplImage *img, TLDFrame *frame = NULL);
 };
 
 #endif /* WRAPPER_H_ */
@@ -18,6 +18,11 @@ GST_DEBUG_CATEGORY_STATIC (gst_objecttracker_debug);
 
 #define DEFAULT_EVENTNAME  			"objectlocation"
 #define DEFAULT_EVENTRESULTNAME		"objectfound"
+#define DEFAULT_MAXTEMPLATES		200
+#define DEFAULT_DETECTINTERVAL		1
+#define DEFAULT_DETECTTHRESHOLD		0.0
+#define DEFAULT_DETECTTHREAD		FALSE
+#define STATS_PERIOD				1000  // frames between two per-frame cost reports
 
 enum {
 	PROP_0,
@@ -27,6 +32,12 @@ enum {
 	PROP_HEIGHT,
 	PROP_DISPLAYBB,
 	PROP_EVENTNAME,
+	PROP_MAXTEMPLATES,
+	PROP_MODEL,
+	PROP_TARGETS,
+	PROP_DETECTINTERVAL,
+	PROP_DETECTTHRESHOLD,
+	PROP_DETECTTHREAD,
 	PROP_LAST
 };
 
@@ -61,7 +72,11 @@ static GstFlowReturn gst_objecttracker_transform_ip(GstBaseTransform * btrans, G
 static gboolean gst_objecttracker_sink_event(GstPad *pad, GstEvent * event);
 static gboolean gst_objecttracker_notify_trackerresults(GstBaseTransform * btrans,
                                                           GstObjecttracker *objecttracker,
+                                                          GstObjecttrackerTarget *target,
                                                           TrackerResult* trackerResult);
+static GstObjecttrackerTarget* gst_objecttracker_get_target(GstObjecttracker *objecttracker, gint id);
+static void gst_objecttracker_configure_targets(GstObjecttracker *objecttracker);
+static void gst_objecttracker_set_targets(GstObjecttracker *objecttracker, const gchar *targets);
 
 static void gst_objecttracker_set_property(GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec);
 static void gst_objecttracker_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
@@ -74,9 +89,13 @@ void CleanObjecttracker(GstObjecttracker *objecttracker)
 {
   if (objecttracker->cvRGB)
 	  cvReleaseImageHeader(&objecttracker->cvRGB);
-  delete objecttracker->predator;
+  for (int i = 0; i < objecttracker->ntargets; i++)
+    delete objecttracker->targets[i].predator;
+  objecttracker->ntargets = 0;
+  delete objecttracker->frame;
   g_free(objecttracker->eventname);
   g_free(objecttracker->eventresultname);
+  g_free(objecttracker->model);
 }
 
 static void gst_objecttracker_base_init(gpointer g_class)
@@ -139,6 +158,44 @@ static void gst_objecttracker_class_init(GstObjecttrackerClass * klass)
                                     DEFAULT_EVENTNAME,	
                                     (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
+  g_object_class_install_property(gobject_class, PROP_MAXTEMPLATES,
+  	      g_param_spec_int ("maxtemplates", "maxtemplates",
+  	          "Templates kept per class by the NN classifier, the most redundant ones are overwritten (0 = unbounded)",
+  	          0, 100000,
+  	          DEFAULT_MAXTEMPLATES, (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property(gobject_class, PROP_MODEL,
+                                  g_param_spec_string(
+                                    "model", "model", "TLD model to start tracking from instead of the bounding box, "
+                                    "text or binary (" TLD_MODEL_EXTENSION "), binary models load fast, straight from a mapping of the file; "
+                                    "an unreadable model is reported and the bounding box is used",
+                                    NULL,
+                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_TARGETS,
+                                  g_param_spec_string(
+                                    "targets", "targets", "Bounding boxes of the objects to track, \"x,y,width,height;x,y,width,height;...\", "
+                                    "tracked as ids 0, 1, ... in the same frames (first one = x/y/width/height properties)",
+                                    NULL,
+                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property(gobject_class, PROP_DETECTINTERVAL,
+  	      g_param_spec_int ("detectinterval", "detectinterval",
+  	          "Run the detector every N frames, the tracker runs on all of them (0 = only when the tracker is lost or below detectthreshold, 1 = every frame)",
+  	          0, 1000,
+  	          DEFAULT_DETECTINTERVAL, (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property(gobject_class, PROP_DETECTTHRESHOLD,
+  	      g_param_spec_float ("detectthreshold", "detectthreshold",
+  	          "Also run the detector whenever the tracker confidence is below this (0 = never)",
+  	          0.0, 1.0,
+  	          DEFAULT_DETECTTHRESHOLD, (GParamFlags) G_PARAM_READWRITE));
+
+  g_object_class_install_property(gobject_class, PROP_DETECTTHREAD,
+  	      g_param_spec_boolean ("detectthread", "detectthread",
+  	          "Run the detector on a worker thread, its result is merged into the first frame after it completes",
+  	          DEFAULT_DETECTTHREAD, (GParamFlags) G_PARAM_READWRITE));
+
   btrans_class->passthrough_on_same_caps = TRUE;
   //btrans_class->always_in_place = TRUE;
   btrans_class->transform_ip = GST_DEBUG_FUNCPTR (gst_objecttracker_transform_ip);
@@ -152,10 +209,16 @@ static void gst_objecttracker_init(GstObjecttracker * objecttracker, GstObjecttr
   gst_base_transform_set_in_place((GstBaseTransform *)objecttracker, TRUE);
   g_static_mutex_init(&objecttracker->lock);
   objecttracker->cvRGB = NULL;
-  objecttracker->initDone = FALSE;
   objecttracker->displayBB = FALSE;
-  objecttracker->predator = new Predator();
-  objecttracker->bb_x = objecttracker->bb_y = objecttracker->bb_width = objecttracker->bb_height = 0;
+  objecttracker->maxtemplates = DEFAULT_MAXTEMPLATES;
+  objecttracker->detectinterval = DEFAULT_DETECTINTERVAL;
+  objecttracker->detectthreshold = DEFAULT_DETECTTHRESHOLD;
+  objecttracker->detectthread = DEFAULT_DETECTTHREAD;
+  objecttracker->ntargets = 0;
+  gst_objecttracker_get_target(objecttracker, 0);
+  objecttracker->frame = new tld::TLDFrame();
+  objecttracker->processing_time = 0;
+  objecttracker->model = NULL;
   objecttracker->nframes = objecttracker->objectCount = 0;
   objecttracker->eventname = g_strdup(DEFAULT_EVENTNAME);
   objecttracker->eventresultname = g_strdup(DEFAULT_EVENTRESULTNAME);
@@ -183,20 +246,20 @@ static void gst_objecttracker_set_property(GObject * object, guint prop_id, cons
   GST_OBJECTTRACKER_LOCK (objecttracker);
   switch (prop_id) {
   case PROP_WIDTH:
-    objecttracker->bb_width = g_value_get_int(value);
-    objecttracker->initDone = FALSE;
+    objecttracker->targets[0].bb_width = g_value_get_int(value);
+    objecttracker->targets[0].initDone = FALSE;
     break;
   case PROP_HEIGHT:
-    objecttracker->bb_height = g_value_get_int(value);
-    objecttracker->initDone = FALSE;
+    objecttracker->targets[0].bb_height = g_value_get_int(value);
+    objecttracker->targets[0].initDone = FALSE;
     break;
   case PROP_X:
-    objecttracker->bb_x = g_value_get_int(value);
-    objecttracker->initDone = FALSE;
+    objecttracker->targets[0].bb_x = g_value_get_int(value);
+    objecttracker->targets[0].initDone = FALSE;
     break;
   case PROP_Y:
-    objecttracker->bb_y = g_value_get_int(value);
-    objecttracker->initDone = FALSE;
+    objecttracker->targets[0].bb_y = g_value_get_int(value);
+    objecttracker->targets[0].initDone = FALSE;
     break;
   case PROP_DISPLAYBB:
     objecttracker->displayBB = g_value_get_boolean (value);
@@ -207,6 +270,30 @@ static void gst_objecttracker_set_property(GObject * object, guint prop_id, cons
     objecttracker->eventname = g_value_dup_string(value);
     objecttracker->eventresultname = g_strdup(strcmp(objecttracker->eventname, DEFAULT_EVENTNAME) ? "facefound" : DEFAULT_EVENTRESULTNAME);
     break;
+  case PROP_MAXTEMPLATES:
+    objecttracker->maxtemplates = g_value_get_int(value);
+    gst_objecttracker_configure_targets(objecttracker);
+    break;
+  case PROP_DETECTINTERVAL:
+    objecttracker->detectinterval = g_value_get_int(value);
+    gst_objecttracker_configure_targets(objecttracker);
+    break;
+  case PROP_DETECTTHRESHOLD:
+    objecttracker->detectthreshold = g_value_get_float(value);
+    gst_objecttracker_configure_targets(objecttracker);
+    break;
+  case PROP_DETECTTHREAD:
+    objecttracker->detectthread = g_value_get_boolean(value);
+    gst_objecttracker_configure_targets(objecttracker);
+    break;
+  case PROP_MODEL:
+    g_free(objecttracker->model);
+    objecttracker->model = g_value_dup_string(value);
+    objecttracker->targets[0].initDone = FALSE;
+    break;
+  case PROP_TARGETS:
+    gst_objecttracker_set_targets(objecttracker, g_value_get_string(value));
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -220,16 +307,16 @@ static void gst_objecttracker_get_property(GObject * object, guint prop_id, GVal
 
   switch (prop_id) {
   case PROP_WIDTH:
-    g_value_set_int(value, objecttracker->bb_width);
+    g_value_set_int(value, objecttracker->targets[0].bb_width);
     break;
   case PROP_HEIGHT:
-	g_value_set_int(value, objecttracker->bb_height);
+	g_value_set_int(value, objecttracker->targets[0].bb_height);
     break;
   case PROP_X:
-	g_value_set_int(value, objecttracker->bb_x);
+	g_value_set_int(value, objecttracker->targets[0].bb_x);
     break;
   case PROP_Y:
-	g_value_set_int(value, objecttracker->bb_y);
+	g_value_set_int(value, objecttracker->targets[0].bb_y);
     break;
   case PROP_DISPLAYBB:
     g_value_set_boolean (value, objecttracker->displayBB);
@@ -237,6 +324,31 @@ static void gst_objecttracker_get_property(GObject * object, guint prop_id, GVal
   case PROP_EVENTNAME:
     g_value_set_string(value, objecttracker->eventname);
     break;
+  case PROP_MAXTEMPLATES:
+    g_value_set_int(value, objecttracker->maxtemplates);
+    break;
+  case PROP_DETECTINTERVAL:
+    g_value_set_int(value, objecttracker->detectinterval);
+    break;
+  case PROP_DETECTTHRESHOLD:
+    g_value_set_float(value, objecttracker->detectthreshold);
+    break;
+  case PROP_DETECTTHREAD:
+    g_value_set_boolean(value, objecttracker->detectthread);
+    break;
+  case PROP_MODEL:
+    g_value_set_string(value, objecttracker->model);
+    break;
+  case PROP_TARGETS: {
+    GString *targets = g_string_new(NULL);
+    for (int i = 0; i < objecttracker->ntargets; i++) {
+      GstObjecttrackerTarget *target = &objecttracker->targets[i];
+      g_string_append_printf(targets, "%s%d,%d,%d,%d", i ? ";" : "",
+                             target->bb_x, target->bb_y, target->bb_width, target->bb_height);
+    }
+    g_value_take_string(value, g_string_free(targets, FALSE));
+    break;
+  }
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -307,6 +419,7 @@ static GstFlowReturn gst_objecttracker_transform_ip(GstBaseTransform * btrans, G
   CvScalar colour;
 
   GST_OBJECTTRACKER_LOCK (objecttracker);
+  GstClockTime start = gst_util_get_timestamp();
 
   //////////////////////////////////////////////////////////////////////////////
   // Image preprocessing: color space conversion etc
@@ -315,29 +428,58 @@ static GstFlowReturn gst_objecttracker_transform_ip(GstBaseTransform * btrans, G
 
 
   //////////////////////////////////////////////////////////////////////////////
-  // Create the bounding box to use for tracking
-  boundingBox = cv::Rect(objecttracker->bb_x, objecttracker->bb_y, objecttracker->bb_width, objecttracker->bb_height);
+  //  Run iteration of predator tracker on every target, and send event DS
+  //  for each. The grey image and integral images are computed once for all.
+  gboolean framePrepared = FALSE;
+
+  for (int i = 0; i < objecttracker->ntargets; i++) {
+    GstObjecttrackerTarget *target = &objecttracker->targets[i];
+    gboolean fromModel = (i == 0 && objecttracker->model);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Create the bounding box to use for tracking
+    boundingBox = cv::Rect(target->bb_x, target->bb_y, target->bb_width, target->bb_height);
+
+    if ( fromModel && !target->initDone ) {
+      GST_INFO("(Re)initializing object tracker from model %s\n", objecttracker->model);
+      if (target->predator->loadModel(objecttracker->cvRGB, objecttracker->model))
+        target->initDone = TRUE;
+      else {
+        // the target keeps the fresh model, started from its bounding box
+        GST_ELEMENT_WARNING (objecttracker, RESOURCE, READ,
+                             ("Cannot read the TLD model \"%s\".", objecttracker->model),
+                             ("tracking from the bounding box instead"));
+        g_free(objecttracker->model);
+        objecttracker->model = NULL;
+        fromModel = FALSE;
+      }
+    }
 
-  //////////////////////////////////////////////////////////////////////////////
-  //  Run iteration of predator tracker, and send event DS if successful
+    if ( !fromModel && !properties_values_are_consistent(objecttracker->cvRGB, boundingBox) )
+      continue;
 
-  if ( properties_values_are_consistent(objecttracker->cvRGB, boundingBox) ) {
 	// Init or update the BB when updating the plugin parameters or after receiving an upstream event (face, etc)
-    if ( !objecttracker->initDone ) {
-      GST_INFO("(Re)initializing object tracker with bounding box parameters:(%d,%d)+(%d,%d)\n",
-    	       objecttracker->bb_x, objecttracker->bb_y, objecttracker->bb_width, objecttracker->bb_height);
-      objecttracker->predator->resetTemplate(objecttracker->cvRGB, boundingBox); //This specifies the template to be tracked
-      objecttracker->initDone = TRUE;
+    if ( !target->initDone ) {
+      GST_INFO("(Re)initializing object tracker %d with bounding box parameters:(%d,%d)+(%d,%d)\n",
+               target->id, target->bb_x, target->bb_y, target->bb_width, target->bb_height);
+      target->predator->resetTemplate(objecttracker->cvRGB, boundingBox); //This specifies the template to be tracked
+      target->initDone = TRUE;
 
       if ( objecttracker->displayBB )
             cvRectangle(objecttracker->cvRGB,
-                        cvPoint(objecttracker->bb_x, objecttracker->bb_y),
-                        cvPoint(objecttracker->bb_x+objecttracker->bb_width, objecttracker->bb_y+objecttracker->bb_height),
+                        cvPoint(target->bb_x, target->bb_y),
+                        cvPoint(target->bb_x+target->bb_width, target->bb_y+target->bb_height),
                         CV_RGB(255, 0, 0), 1, 1, 0);
     }
+
+    if ( !framePrepared ) {
+      objecttracker->frame->update(cv::Mat(objecttracker->cvRGB));
+      framePrepared = TRUE;
+    }
+
     //////////////////////////////////////////////////////////////////////////
-    TrackerResult trackerResult = objecttracker->predator->doWork(objecttracker->cvRGB);
-      
+    TrackerResult trackerResult = target->predator->doWork(objecttracker->cvRGB, objecttracker->frame);
+
     if(trackerResult.success) {
       objecttracker->objectCount++;
       colour = CV_RGB(0, 255, 0);
@@ -345,30 +487,132 @@ static GstFlowReturn gst_objecttracker_transform_ip(GstBaseTransform * btrans, G
         cvRectangle(objecttracker->cvRGB, trackerResult.boundingBox.tl(), trackerResult.boundingBox.br(), colour, 2, 2, 0);
 
       // Save coordinates of last BB found
-      objecttracker->bb_x = trackerResult.boundingBox.x;
-      objecttracker->bb_y = trackerResult.boundingBox.y;
-      objecttracker->bb_width = trackerResult.boundingBox.width;
-      objecttracker->bb_height = trackerResult.boundingBox.height;
+      target->bb_x = trackerResult.boundingBox.x;
+      target->bb_y = trackerResult.boundingBox.y;
+      target->bb_width = trackerResult.boundingBox.width;
+      target->bb_height = trackerResult.boundingBox.height;
     }
     else{
       colour = CV_RGB(0, 255, 255);
       if ( objecttracker->displayBB )
         cvRectangle(objecttracker->cvRGB,
-                    cvPoint(objecttracker->bb_x, objecttracker->bb_y),
-                    cvPoint(objecttracker->bb_x + objecttracker->bb_width, objecttracker->bb_y + objecttracker->bb_height),
+                    cvPoint(target->bb_x, target->bb_y),
+                    cvPoint(target->bb_x + target->bb_width, target->bb_y + target->bb_height),
                     colour, 2, 2, 0);
-      GST_INFO("Unsuccessful tracking :(");
+      GST_INFO("Unsuccessful tracking of object %d :(", target->id);
     }
     // Send an inbound message downstream
-    gst_objecttracker_notify_trackerresults(btrans, objecttracker, &trackerResult);
+    gst_objecttracker_notify_trackerresults(btrans, objecttracker, target, &trackerResult);
   }
-  
+
   objecttracker->nframes++;
+
+  // With a template budget this stays flat however long the run, see
+  // test/test_objecttracker_budget.sh
+  objecttracker->processing_time += gst_util_get_timestamp() - start;
+  if( objecttracker->nframes % STATS_PERIOD == 0 ){
+    int positives = 0, negatives = 0;
+    for (int i = 0; i < objecttracker->ntargets; i++) {
+      int p, n;
+      objecttracker->targets[i].predator->getModelSize(&p, &n);
+      positives += p;
+      negatives += n;
+    }
+    GST_INFO("frame %d: %.3f ms/frame, templates %d+ %d-", objecttracker->nframes,
+             (double)objecttracker->processing_time / (STATS_PERIOD * GST_MSECOND), positives, negatives);
+    objecttracker->processing_time = 0;
+  }
   GST_OBJECTTRACKER_UNLOCK (objecttracker);
   
   return GST_FLOW_OK;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// A slot set up as a new target with that id, a fresh model and no box yet
+static void gst_objecttracker_init_target(GstObjecttracker *objecttracker, GstObjecttrackerTarget *target, gint id)
+{
+  target->id = id;
+  target->predator = new Predator();
+  target->predator->setMaxTemplates(objecttracker->maxtemplates);
+  target->predator->setDetectionSchedule(objecttracker->detectinterval, objecttracker->detectthreshold,
+                                         objecttracker->detectthread);
+  target->bb_x = target->bb_y = target->bb_width = target->bb_height = 0;
+  target->initDone = FALSE;
+}
+
+// Target with that id, added if there is none yet and there is room left
+static GstObjecttrackerTarget* gst_objecttracker_get_target(GstObjecttracker *objecttracker, gint id)
+{
+  for (int i = 0; i < objecttracker->ntargets; i++)
+    if (objecttracker->targets[i].id == id)
+      return &objecttracker->targets[i];
+
+  if (objecttracker->ntargets == OBJECTTRACKER_MAX_TARGETS) {
+    GST_WARNING("Cannot track object %d, already tracking %d objects", id, OBJECTTRACKER_MAX_TARGETS);
+    return NULL;
+  }
+  GstObjecttrackerTarget *target = &objecttracker->targets[objecttracker->ntargets++];
+  gst_objecttracker_init_target(objecttracker, target, id);
+  return target;
+}
+
+// Slot i as the target with id i: kept if it already is, else given a fresh
+// model (the slots past ntargets are free, the ones before are contiguous)
+static GstObjecttrackerTarget* gst_objecttracker_slot_target(GstObjecttracker *objecttracker, gint i)
+{
+  GstObjecttrackerTarget *target = &objecttracker->targets[i];
+
+  if (i >= objecttracker->ntargets) {
+    gst_objecttracker_init_target(objecttracker, target, i);
+    objecttracker->ntargets = i + 1;
+  }
+  else if (target->id != i) {
+    delete target->predator;
+    gst_objecttracker_init_target(objecttracker, target, i);
+  }
+  return target;
+}
+
+static void gst_objecttracker_configure_targets(GstObjecttracker *objecttracker)
+{
+  for (int i = 0; i < objecttracker->ntargets; i++) {
+    Predator *predator = objecttracker->targets[i].predator;
+    predator->setMaxTemplates(objecttracker->maxtemplates);
+    predator->setDetectionSchedule(objecttracker->detectinterval, objecttracker->detectthreshold,
+                                   objecttracker->detectthread);
+  }
+}
+
+// "x,y,w,h;x,y,w,h;..." -> targets 0, 1, ... in slots 0, 1, ..., whatever ids
+// the slots had from objectlocation events; the targets beyond are dropped
+static void gst_objecttracker_set_targets(GstObjecttracker *objecttracker, const gchar *targets)
+{
+  gchar **boxes = g_strsplit(targets ? targets : "", ";", OBJECTTRACKER_MAX_TARGETS);
+  gint n = 0;
+
+  for (gchar **box = boxes; *box && n < OBJECTTRACKER_MAX_TARGETS; box++) {
+    gint x, y, w, h;
+    if (sscanf(*box, "%d,%d,%d,%d", &x, &y, &w, &h) != 4)
+      continue;
+    GstObjecttrackerTarget *target = gst_objecttracker_slot_target(objecttracker, n++);
+    if (!target)
+      continue;
+    target->bb_x = x;
+    target->bb_y = y;
+    target->bb_width = w;
+    target->bb_height = h;
+    target->initDone = FALSE;
+  }
+  g_strfreev(boxes);
+
+  // targets[0] always exists with id 0, for the x/y/width/height properties
+  if (n == 0)
+    gst_objecttracker_slot_target(objecttracker, 0);
+  for (int i = MAX(n, 1); i < objecttracker->ntargets; i++)
+    delete objecttracker->targets[i].predator;
+  objecttracker->ntargets = MAX(n, 1);
+}
+
 static gboolean properties_values_are_consistent(IplImage *img, cv::Rect boundingBox)
 {
 	if ( boundingBox.x > 0 && boundingBox.y > 0 && \
@@ -389,6 +633,8 @@ static gboolean gst_objecttracker_sink_event(GstPad *pad, GstEvent * event)
   gboolean ret = FALSE;
   double x,y,w,h;
   gboolean t;
+  gint id = 0;
+  GstObjecttrackerTarget *target;
 
   switch (GST_EVENT_TYPE(event)) {
   case GST_EVENT_CUSTOM_DOWNSTREAM:
@@ -400,11 +646,12 @@ static gboolean gst_objecttracker_sink_event(GstPad *pad, GstEvent * event)
       gst_structure_get_double(str, "height", &h);// check bool return
       gst_structure_get_boolean(str, "facefound", &t);// check bool return
       
-      objecttracker->bb_x = (int)x - (int)(w/2);
-      objecttracker->bb_y = (int)y - (int)(h/2);
-      objecttracker->bb_width = (int)w;
-      objecttracker->bb_height = (int)h;
-      objecttracker->initDone = !t;
+      target = &objecttracker->targets[0];
+      target->bb_x = (int)x - (int)(w/2);
+      target->bb_y = (int)y - (int)(h/2);
+      target->bb_width = (int)w;
+      target->bb_height = (int)h;
+      target->initDone = !t;
 
       gst_event_unref(event);
       ret = TRUE;
@@ -415,12 +662,18 @@ static gboolean gst_objecttracker_sink_event(GstPad *pad, GstEvent * event)
       gst_structure_get_double(str, "y", &y);
       gst_structure_get_double(str, "width", &w);
       gst_structure_get_double(str, "height", &h);
-
-      objecttracker->bb_x = (int)x;
-      objecttracker->bb_y = (int)y;
-      objecttracker->bb_width = (int)w;
-      objecttracker->bb_height = (int)h;
-      objecttracker->initDone = FALSE;
+      gst_structure_get_int(str, "id", &id);  // optional, several objects tracked
+
+      GST_OBJECTTRACKER_LOCK (objecttracker);
+      target = gst_objecttracker_get_target(objecttracker, id);
+      if (target) {
+        target->bb_x = (int)x;
+        target->bb_y = (int)y;
+        target->bb_width = (int)w;
+        target->bb_height = (int)h;
+        target->initDone = FALSE;
+      }
+      GST_OBJECTTRACKER_UNLOCK (objecttracker);
 
       gst_event_unref(event);
       ret = TRUE;
@@ -445,6 +698,7 @@ gboolean gst_objecttracker_plugin_init(GstPlugin * plugin)
 //////////////////////////////////////////////////////////////////////////////
 static gboolean gst_objecttracker_notify_trackerresults(GstBaseTransform * btrans,
                                                           GstObjecttracker *objecttracker,
+                                                          GstObjecttrackerTarget *target,
                                                           TrackerResult* trackerResult)
 {
   GstStructure *str;
@@ -454,14 +708,16 @@ static gboolean gst_objecttracker_notify_trackerresults(GstBaseTransform * btran
                                           "y", G_TYPE_DOUBLE, (double)trackerResult->boundingBox.y + trackerResult->boundingBox.height/2,
                                           "width", G_TYPE_DOUBLE, (double)trackerResult->boundingBox.width,
                                           "height", G_TYPE_DOUBLE, (double)trackerResult->boundingBox.height,
-                                          objecttracker->eventresultname, G_TYPE_BOOLEAN, TRUE, NULL);
+                                          objecttracker->eventresultname, G_TYPE_BOOLEAN, TRUE,
+                                          "id", G_TYPE_INT, target->id, NULL);
   else
 	str = gst_structure_new(objecttracker->eventname,
-	                                      "x", G_TYPE_DOUBLE, (double)objecttracker->bb_x+ objecttracker->bb_width/2,
-	                                      "y", G_TYPE_DOUBLE, (double)objecttracker->bb_y + objecttracker->bb_height/2,
-	                                      "width", G_TYPE_DOUBLE, (double)objecttracker->bb_width,
-	                                      "height", G_TYPE_DOUBLE, (double)objecttracker->bb_height,
-	                                      objecttracker->eventresultname, G_TYPE_BOOLEAN, FALSE, NULL);
+	                                      "x", G_TYPE_DOUBLE, (double)target->bb_x+ target->bb_width/2,
+	                                      "y", G_TYPE_DOUBLE, (double)target->bb_y + target->bb_height/2,
+	                                      "width", G_TYPE_DOUBLE, (double)target->bb_width,
+	                                      "height", G_TYPE_DOUBLE, (double)target->bb_height,
+	                                      objecttracker->eventresultname, G_TYPE_BOOLEAN, FALSE,
+	                                      "id", G_TYPE_INT, target->id, NULL);
 
   GstStructure *strcpy = gst_structure_copy(str);
   GstEvent* ev = gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, str);
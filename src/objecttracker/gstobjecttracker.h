@@ -27,6 +27,16 @@ G_BEGIN_DECLS
 typedef struct _GstObjecttracker GstObjecttracker;
 typedef struct _GstObjecttrackerClass GstObjecttrackerClass;
 
+#define OBJECTTRACKER_MAX_TARGETS   16
+
+// One tracked object: its own TLD model and bounding box
+typedef struct {
+  gint id;                            // sent along its events
+  Predator *predator;
+  gint bb_width, bb_height, bb_x, bb_y;
+  gboolean initDone;
+} GstObjecttrackerTarget;
+
 struct _GstObjecttracker {
   GstVideoFilter parent;
 
@@ -36,12 +46,20 @@ struct _GstObjecttracker {
   gint width, height;
   
   IplImage *cvRGB;
-  gboolean initDone, displayBB;
-  Predator *predator;
-  gint bb_width, bb_height, bb_x, bb_y;
+  gboolean displayBB;
+  // targets[0] is the one of the x/y/width/height properties, with id 0
+  GstObjecttrackerTarget targets[OBJECTTRACKER_MAX_TARGETS];
+  gint ntargets;
+  tld::TLDFrame *frame;               // grey image and integral images shared by the targets
+  gint maxtemplates;                  // NN templates kept per class, 0 = unbounded
+  gint detectinterval;                // detector every N frames, 0 = never, 1 = every frame
+  gfloat detectthreshold;             // ...and when the tracker confidence is below this
+  gboolean detectthread;              // detector on a worker thread, merged when done
+  gchar* model;                       // model file for targets[0] instead of its bounding box
 
   // Statistics
   gint nframes, objectCount;
+  GstClockTime processing_time;       // accumulated since the last report
 
   gchar* eventname; // by default is "objectlocation" but can be tuned to anything, ("facelocation" fi)
   gchar* eventresultname;  // By default is "objectfound" or "facefound" if set to something else
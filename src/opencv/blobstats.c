@@ -0,0 +1,200 @@
+
+#include "blobstats.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+t_blobstats* blobstats_create(int width, int height, int max_blobs)
+{
+  t_blobstats *bs = (t_blobstats*)calloc(1, sizeof(t_blobstats));
+  if( !bs )
+    return NULL;
+
+  bs->width     = width;
+  bs->height    = height;
+  bs->max_runs  = ((width + 1) / 2) * height;
+  bs->max_blobs = (max_blobs > 0) ? max_blobs : 1;
+  bs->runs      = (t_blobrun*)malloc(bs->max_runs * sizeof(t_blobrun));
+  bs->run_blob  = (int*)malloc(bs->max_runs * sizeof(int));
+  bs->blobs     = (t_blob*)malloc(bs->max_blobs * sizeof(t_blob));
+  if( !bs->runs || !bs->run_blob || !bs->blobs ){
+    blobstats_destroy(bs);
+    return NULL;
+  }
+  return bs;
+}
+
+void blobstats_destroy(t_blobstats *bs)
+{
+  free(bs->runs);
+  free(bs->run_blob);
+  free(bs->blobs);
+  free(bs);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// union-find on the runs, the root of a set is always its lowest run index so
+// blobs come out in raster order of their first pixel
+static inline int blobstats_find(t_blobrun *runs, int i)
+{
+  while( runs[i].parent != i ){
+    runs[i].parent = runs[runs[i].parent].parent;
+    i = runs[i].parent;
+  }
+  return i;
+}
+
+static inline void blobstats_union(t_blobrun *runs, int a, int b)
+{
+  a = blobstats_find(runs, a);
+  b = blobstats_find(runs, b);
+  if( a < b )      runs[b].parent = a;
+  else if( b < a ) runs[a].parent = b;
+}
+
+// sum of x and of x^2 for x in [x0, x1]
+static inline void blobstats_run_sums(int x0, int x1, double *sx, double *sxx)
+{
+  double a = x0 - 1, b = x1;
+  *sx  = 0.5 * (b * (b + 1) - a * (a + 1));
+  *sxx = (b * (b + 1) * (2 * b + 1) - a * (a + 1) * (2 * a + 1)) / 6.0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int blobstats_label(t_blobstats *bs, const unsigned char *mask, int stride, int step,
+                    int threshold, int connectivity, int min_area)
+{
+  t_blobrun *runs = bs->runs;
+  const int  reach = (connectivity == BLOBSTATS_CONNECT8) ? 1 : 0;
+  int prev_first = 0, prev_last = 0;   // runs of the previous row: [first, last)
+  int n = 0;
+  int i, x, y;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // run extraction and merging with the overlapping runs of the row above
+  for( y = 0; y < bs->height; y++ ){
+    const unsigned char *row = mask + y * stride;
+    const int row_first = n;
+    int p = prev_first;
+
+    for( x = 0; x < bs->width; ){
+      if( row[x * step] <= threshold ){
+        x++;
+        continue;
+      }
+      const int x0 = x;
+      while( x < bs->width && row[x * step] > threshold )
+        x++;
+
+      runs[n].x0     = x0;
+      runs[n].x1     = x - 1;
+      runs[n].y      = y;
+      runs[n].parent = n;
+
+      // runs above ending before this one (diagonally too if 8-connected)
+      // cannot touch this nor any later run of the row
+      while( p < prev_last && runs[p].x1 + reach < x0 )
+        p++;
+      for( i = p; i < prev_last && runs[i].x0 <= runs[n].x1 + reach; i++ )
+        blobstats_union(runs, n, i);
+      n++;
+    }
+    prev_first = row_first;
+    prev_last  = n;
+  }
+  bs->nruns = n;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // flatten the sets and add up the area of each of them on its root run
+  memset(bs->run_blob, 0, n * sizeof(int));
+  for( i = 0; i < n; i++ ){
+    runs[i].parent = runs[runs[i].parent].parent;  // parent < i is already a root
+    bs->run_blob[runs[i].parent] += runs[i].x1 - runs[i].x0 + 1;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // roots come before their runs: number the blobs large enough and accumulate
+  // their moments run by run, in closed form along x
+  bs->nblobs  = 0;
+  bs->dropped = 0;
+  for( i = 0; i < n; i++ ){
+    const t_blobrun *r = &runs[i];
+    int b;
+    if( r->parent == i ){
+      b = BLOBSTATS_SMALL;
+      if( bs->run_blob[i] >= min_area ){
+        b = BLOBSTATS_DROPPED;
+        if( bs->nblobs < bs->max_blobs ){
+          b = bs->nblobs++;
+          t_blob *blob = &bs->blobs[b];
+          memset(blob, 0, sizeof(t_blob));
+          blob->x0 = r->x0;  blob->x1 = r->x1;
+          blob->y0 = r->y;   blob->y1 = r->y;
+        }
+        else
+          bs->dropped++;
+      }
+      bs->run_blob[i] = b;
+    }
+    else
+      b = bs->run_blob[i] = bs->run_blob[r->parent];
+    if( b < 0 )
+      continue;
+
+    t_blob *blob = &bs->blobs[b];
+    const int    len = r->x1 - r->x0 + 1;
+    const double fy  = r->y;
+    double sx, sxx;
+    blobstats_run_sums(r->x0, r->x1, &sx, &sxx);
+
+    blob->area += len;
+    blob->m10  += sx;
+    blob->m01  += len * fy;
+    blob->m20  += sxx;
+    blob->m11  += sx * fy;
+    blob->m02  += len * fy * fy;
+    if( r->x0 < blob->x0 ) blob->x0 = r->x0;
+    if( r->x1 > blob->x1 ) blob->x1 = r->x1;
+    blob->y1 = r->y;                             // runs are in raster order
+  }
+
+  for( i = 0; i < bs->nblobs; i++ ){
+    t_blob *blob = &bs->blobs[i];
+    const double a = blob->area, cx = blob->m10 / a, cy = blob->m01 / a;
+    blob->cx   = (float)cx;
+    blob->cy   = (float)cy;
+    blob->mu20 = (float)(blob->m20 / a - cx * cx);
+    blob->mu11 = (float)(blob->m11 / a - cx * cy);
+    blob->mu02 = (float)(blob->m02 / a - cy * cy);
+  }
+  return bs->nblobs;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int blobstats_largest(const t_blobstats *bs)
+{
+  int i, best = -1;
+  for( i = 0; i < bs->nblobs; i++ )
+    if( best < 0 || bs->blobs[i].area > bs->blobs[best].area )
+      best = i;
+  return best;
+}
+
+void blobstats_paint(const t_blobstats *bs, unsigned char *dst, int stride, int step)
+{
+  int i, x, y;
+
+  for( y = 0; y < bs->height; y++ )
+    for( x = 0; x < bs->width; x++ )
+      dst[y * stride + x * step] = 0;
+
+  for( i = 0; i < bs->nruns; i++ ){
+    const t_blobrun *r = &bs->runs[i];
+    if( bs->run_blob[i] == BLOBSTATS_SMALL )
+      continue;
+    unsigned char *d = dst + r->y * stride + r->x0 * step;
+    for( x = r->x0; x <= r->x1; x++, d += step )
+      *d = 255;
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef __BLOBSTATS_H__
+#define __BLOBSTATS_H__
+
+//////////////////////////////////////////////////////////////////////////////
+/// Connected component labelling of a binary mask with per blob statistics.
+///
+/// The mask is scanned once as horizontal runs of foreground pixels, runs
+/// touching a run of the previous row are merged with a union-find, and the
+/// area, bounding box and first/second order moments of every blob are then
+/// accumulated per run in closed form. No contour is ever traced nor stored,
+/// and all the buffers are allocated once for a given frame size, so labelling
+/// a frame does not allocate. Used by the skin, contours and codebookfgbg
+/// elements.
+//////////////////////////////////////////////////////////////////////////////
+
+#define BLOBSTATS_CONNECT4    4
+#define BLOBSTATS_CONNECT8    8
+
+// run_blob of the runs of unreported blobs
+#define BLOBSTATS_SMALL      -1  // below min_area
+#define BLOBSTATS_DROPPED    -2  // large enough, beyond max_blobs
+
+typedef struct {
+  int    area;                   // pixels
+  int    x0, y0, x1, y1;         // bounding box, inclusive
+  float  cx, cy;                 // centroid
+  float  mu20, mu11, mu02;       // central second order moments, normalised by area
+  double m10, m01, m20, m11, m02;// raw moments
+} t_blob;
+
+typedef struct {
+  int   x0, x1, y;               // inclusive extent of the run
+  int   parent;                  // union-find link, index of a run
+} t_blobrun;
+
+typedef struct {
+  int        width, height;
+  int        max_runs;           // worst case for the frame size, (w+1)/2 per row
+  int        max_blobs;          // blobs beyond this are not reported
+  t_blobrun* runs;
+  int*       run_blob;           // run -> blob, BLOBSTATS_SMALL or BLOBSTATS_DROPPED
+  int        nruns;
+  t_blob*    blobs;
+  int        nblobs;
+  int        dropped;            // blobs found beyond max_blobs in the last frame
+} t_blobstats;
+
+
+t_blobstats* blobstats_create(int width, int height, int max_blobs);
+void         blobstats_destroy(t_blobstats *bs);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function blobstats_label
+/// \param[in]  mask, stride, step: 8 bit mask, bytes per row and per pixel (a
+///             step of 4 labels the alpha byte of an RGBA buffer)
+/// \param[in]  threshold: pixels > threshold are foreground
+/// \param[in]  connectivity: BLOBSTATS_CONNECT4 or BLOBSTATS_CONNECT8
+/// \param[in]  min_area: blobs smaller than this are discarded
+/// \return number of blobs, in raster order of their first pixel, in bs->blobs
+int  blobstats_label(t_blobstats *bs, const unsigned char *mask, int stride, int step,
+                     int threshold, int connectivity, int min_area);
+
+/// index of the blob with the largest area, -1 if there are none
+int  blobstats_largest(const t_blobstats *bs);
+
+/// write 255 on the pixels of the blobs of at least min_area and 0 elsewhere,
+/// i.e. the input mask without the blobs discarded in the last
+/// blobstats_label(); the blobs beyond max_blobs are painted too
+void blobstats_paint(const t_blobstats *bs, unsigned char *dst, int stride, int step);
+
+#endif // __BLOBSTATS_H__
@@ -0,0 +1,592 @@
+/*
+ * GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+/**
+ * SECTION:element- alphacombine
+ *
+ * N-input version of alphamix: any number of RGBA mask sources can be linked
+ * to request pads sink_0, sink_1,... and their alpha planes are fused into one
+ * (max, min or weighted average) in a single pass over the packed buffers,
+ * without splitting into planes. The colour of the lowest-numbered input taking
+ * part in the frame is forwarded to the output. Inputs are paired by
+ * timestamp: buffers further than @tolerance from the earliest pending one are
+ * kept for the next round.
+ *
+ * gst-launch ... ! alphacombine name=ac mode=0 ! ...
+ *            vibe ! ac.sink_0  codebookfgbg ! ac.sink_1  skin ! ac.sink_2
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "gstalphacombine.h"
+
+#define GST_CAT_DEFAULT gst_alphacombine_debug
+GST_DEBUG_CATEGORY_STATIC (GST_CAT_DEFAULT);
+
+
+enum
+{
+  PROP_0,
+  PROP_MODE,
+  PROP_WEIGHTS,
+  PROP_TOLERANCE
+};
+
+#define DEFAULT_MODE       ALPHACOMBINE_MODE_MAX
+#define DEFAULT_TOLERANCE  0
+
+#define DEBUG_INIT(bla) \
+  GST_DEBUG_CATEGORY_INIT (gst_alphacombine_debug, "alphacombine", 0, "alphacombine element");
+
+GST_BOILERPLATE_FULL (GstALPHACOMBINE, gst_alphacombine, GstElement,
+    GST_TYPE_ELEMENT, DEBUG_INIT);
+
+static void gst_alphacombine_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_alphacombine_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_alphacombine_finalize (GObject * object);
+
+static GstPad *gst_alphacombine_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name);
+static void gst_alphacombine_release_pad (GstElement * element, GstPad * pad);
+static GstStateChangeReturn gst_alphacombine_change_state (GstElement * element,
+    GstStateChange transition);
+
+static GstFlowReturn gst_alphacombine_collected (GstCollectPads * pads,
+    gpointer user_data);
+static gboolean gst_alphacombine_sink_event (GstPad * pad, GstEvent * event);
+static GstCaps *gst_alphacombine_getcaps (GstPad * pad);
+static gboolean gst_alphacombine_set_caps (GstPad * pad, GstCaps * caps);
+
+
+static GstStaticPadTemplate gst_alphacombine_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink_%d",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_RGBA)
+    );
+
+static GstStaticPadTemplate gst_alphacombine_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_RGBA)
+    );
+
+static void
+gst_alphacombine_base_init (gpointer klass)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_alphacombine_src_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&gst_alphacombine_sink_template));
+
+  gst_element_class_set_details_simple (element_class,
+                                       "Alpha combiner",
+                                       "Filter/Effect/Video",
+                                       "Fuses the alpha channels of N inputs (max, min or weighted),\n\
+frame by frame, all must be same framesize, inputs are paired by timestamp.\n\
+The colour of the first input is forwarded to the output",
+                                       "miguel casas-sanchez@alcatel-lucent.com");
+}
+
+static void
+gst_alphacombine_class_init (GstALPHACOMBINEClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  GstElementClass *gstelement_class = (GstElementClass *) klass;
+
+  gobject_class->set_property = gst_alphacombine_set_property;
+  gobject_class->get_property = gst_alphacombine_get_property;
+  gobject_class->finalize = gst_alphacombine_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_MODE, g_param_spec_int(
+                                    "mode", "Alpha combination (0-max; 1-min; 2-weighted)",
+                                    "Alpha combination (0-max; 1-min; 2-weighted)", 0, 2, DEFAULT_MODE,
+                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_WEIGHTS, g_param_spec_string(
+                                    "weights", "Weights",
+                                    "Comma separated weight per sink_%d pad, used in weighted mode (e.g. \"2,1,1\")",
+                                    NULL, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_TOLERANCE, g_param_spec_uint64(
+                                    "tolerance", "Tolerance",
+                                    "Max timestamp distance (ns) for buffers to be paired, 0 = half a frame",
+                                    0, G_MAXUINT64, DEFAULT_TOLERANCE,
+                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  gstelement_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_alphacombine_request_new_pad);
+  gstelement_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_alphacombine_release_pad);
+  gstelement_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_alphacombine_change_state);
+}
+
+static void
+gst_alphacombine_init (GstALPHACOMBINE * fs, GstALPHACOMBINEClass * klass)
+{
+  gint i;
+
+  fs->srcpad = gst_pad_new_from_static_template (&gst_alphacombine_src_template, "src");
+  gst_pad_set_getcaps_function (fs->srcpad, GST_DEBUG_FUNCPTR (gst_alphacombine_getcaps));
+  gst_element_add_pad (GST_ELEMENT (fs), fs->srcpad);
+
+  fs->collect = gst_collect_pads_new ();
+  gst_collect_pads_set_function (fs->collect,
+      (GstCollectPadsFunction) GST_DEBUG_FUNCPTR (gst_alphacombine_collected), fs);
+
+  fs->next_sinkpad = 0;
+  fs->mode = DEFAULT_MODE;
+  fs->tolerance = DEFAULT_TOLERANCE;
+  for (i = 0; i < ALPHACOMBINE_MAX_INPUTS; i++)
+    fs->weights[i] = 1.0;
+
+  fs->format = GST_VIDEO_FORMAT_UNKNOWN;
+  fs->width = fs->height = 0;
+  fs->fps_n = 0;
+  fs->fps_d = 1;
+  fs->segment_pending = TRUE;
+  fs->n_frames = 0;
+}
+
+static void
+gst_alphacombine_finalize (GObject * object)
+{
+  GstALPHACOMBINE *fs = GST_ALPHACOMBINE (object);
+
+  gst_object_unref (fs->collect);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_alphacombine_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstALPHACOMBINE *fs = GST_ALPHACOMBINE (object);
+
+  GST_OBJECT_LOCK (fs);
+  switch (prop_id) {
+    case PROP_MODE:
+      fs->mode = (GstAlphaCombineMode) g_value_get_int (value);
+      break;
+    case PROP_WEIGHTS:
+    {
+      const gchar *str = g_value_get_string (value);
+      gchar **tokens;
+      gint i;
+
+      for (i = 0; i < ALPHACOMBINE_MAX_INPUTS; i++)
+        fs->weights[i] = 1.0;
+      if (str == NULL)
+        break;
+      tokens = g_strsplit (str, ",", ALPHACOMBINE_MAX_INPUTS);
+      for (i = 0; tokens[i] != NULL; i++)
+        fs->weights[i] = MAX (0.0, g_ascii_strtod (tokens[i], NULL));
+      g_strfreev (tokens);
+      break;
+    }
+    case PROP_TOLERANCE:
+      fs->tolerance = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (fs);
+}
+
+static void
+gst_alphacombine_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstALPHACOMBINE *fs = GST_ALPHACOMBINE (object);
+
+  GST_OBJECT_LOCK (fs);
+  switch (prop_id) {
+    case PROP_MODE:
+      g_value_set_int (value, fs->mode);
+      break;
+    case PROP_WEIGHTS:
+    {
+      GString *str = g_string_new (NULL);
+      gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+      gint i;
+
+      for (i = 0; i < ALPHACOMBINE_MAX_INPUTS; i++) {
+        if (i)
+          g_string_append_c (str, ',');
+        g_string_append (str, g_ascii_dtostr (buf, sizeof (buf), fs->weights[i]));
+      }
+      g_value_take_string (value, g_string_free (str, FALSE));
+      break;
+    }
+    case PROP_TOLERANCE:
+      g_value_set_uint64 (value, fs->tolerance);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (fs);
+}
+
+static GstPad *
+gst_alphacombine_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * req_name)
+{
+  GstALPHACOMBINE *fs = GST_ALPHACOMBINE (element);
+  GstAlphaCombineCollectData *data;
+  GstPad *newpad;
+  gchar *name;
+  gint index;
+
+  if (templ->direction != GST_PAD_SINK) {
+    GST_WARNING_OBJECT (fs, "request pad that is not a SINK pad");
+    return NULL;
+  }
+
+  GST_OBJECT_LOCK (fs);
+  if (req_name == NULL || strlen (req_name) < 6 || !g_str_has_prefix (req_name, "sink_")) {
+    index = fs->next_sinkpad++;
+  } else {
+    index = atoi (&req_name[5]);
+    if (index >= fs->next_sinkpad)
+      fs->next_sinkpad = index + 1;
+  }
+  GST_OBJECT_UNLOCK (fs);
+
+  if (index < 0 || index >= ALPHACOMBINE_MAX_INPUTS) {
+    GST_WARNING_OBJECT (fs, "only %d inputs supported, refusing sink_%d",
+        ALPHACOMBINE_MAX_INPUTS, index);
+    return NULL;
+  }
+
+  name = g_strdup_printf ("sink_%d", index);
+  newpad = gst_pad_new_from_template (templ, name);
+  g_free (name);
+
+  gst_pad_set_getcaps_function (newpad, GST_DEBUG_FUNCPTR (gst_alphacombine_getcaps));
+  gst_pad_set_setcaps_function (newpad, GST_DEBUG_FUNCPTR (gst_alphacombine_set_caps));
+
+  data = (GstAlphaCombineCollectData *) gst_collect_pads_add_pad (fs->collect,
+      newpad, sizeof (GstAlphaCombineCollectData));
+  data->index = index;
+
+  // collectpads installs its own event function, we need to see segment and
+  // flush events too, so chain up from ours
+  fs->collect_event = (GstPadEventFunction) GST_PAD_EVENTFUNC (newpad);
+  gst_pad_set_event_function (newpad, GST_DEBUG_FUNCPTR (gst_alphacombine_sink_event));
+
+  if (!gst_element_add_pad (element, newpad)) {
+    gst_collect_pads_remove_pad (fs->collect, newpad);
+    gst_object_unref (newpad);
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT (fs, "added pad %s", GST_PAD_NAME (newpad));
+  return newpad;
+}
+
+static void
+gst_alphacombine_release_pad (GstElement * element, GstPad * pad)
+{
+  GstALPHACOMBINE *fs = GST_ALPHACOMBINE (element);
+
+  GST_DEBUG_OBJECT (fs, "release pad %s", GST_PAD_NAME (pad));
+
+  gst_collect_pads_remove_pad (fs->collect, pad);
+  gst_element_remove_pad (element, pad);
+}
+
+static GstCaps *
+gst_alphacombine_getcaps (GstPad * pad)
+{
+  GstALPHACOMBINE *fs;
+  GstCaps *caps;
+
+  fs = GST_ALPHACOMBINE (gst_pad_get_parent (pad));
+
+  // once one input has negotiated, everybody else must agree with it
+  GST_OBJECT_LOCK (fs);
+  if (GST_PAD_CAPS (fs->srcpad))
+    caps = gst_caps_copy (GST_PAD_CAPS (fs->srcpad));
+  else
+    caps = gst_caps_copy (gst_pad_get_pad_template_caps (pad));
+  GST_OBJECT_UNLOCK (fs);
+
+  gst_object_unref (fs);
+
+  return caps;
+}
+
+static gboolean
+gst_alphacombine_set_caps (GstPad * pad, GstCaps * caps)
+{
+  GstALPHACOMBINE *fs;
+  GstVideoFormat format;
+  gint width, height, fps_n = 0, fps_d = 1;
+  gboolean ret = TRUE;
+
+  fs = GST_ALPHACOMBINE (gst_pad_get_parent (pad));
+
+  if (!gst_video_format_parse_caps (caps, &format, &width, &height)) {
+    gst_object_unref (fs);
+    return FALSE;
+  }
+  gst_video_parse_caps_framerate (caps, &fps_n, &fps_d);
+
+  if (fs->width != 0 && (fs->width != width || fs->height != height)) {
+    GST_WARNING_OBJECT (fs, "%s: %dx%d does not match negotiated %dx%d",
+        GST_PAD_NAME (pad), width, height, fs->width, fs->height);
+    ret = FALSE;
+  } else if (fs->width == 0) {
+    fs->format = format;
+    fs->width  = width;
+    fs->height = height;
+    fs->fps_n  = fps_n;
+    fs->fps_d  = fps_d;
+    ret = gst_pad_set_caps (fs->srcpad, caps);
+    GST_WARNING (" Negotiated caps, width=%dp height=%dp inputs=%d",
+        fs->width, fs->height, fs->next_sinkpad);
+  }
+
+  gst_object_unref (fs);
+
+  return ret;
+}
+
+static gboolean
+gst_alphacombine_sink_event (GstPad * pad, GstEvent * event)
+{
+  GstALPHACOMBINE *fs;
+  gboolean ret;
+
+  fs = GST_ALPHACOMBINE (gst_pad_get_parent (pad));
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_NEWSEGMENT:
+    case GST_EVENT_FLUSH_STOP:
+      fs->segment_pending = TRUE;
+      break;
+    default:
+      break;
+  }
+
+  ret = fs->collect_event (pad, event);
+
+  gst_object_unref (fs);
+  return ret;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Fuses the alpha of inputs[1..n-1] into inputs[0], which is modified in place.
+// Packed RGBA, one pass, no intermediate planes. Weights are Q16 fixed point and
+// already normalised so that they add up to 1<<16.
+static void
+alphacombine_fuse (guint8 ** inputs, const guint32 * weights, gint n,
+    GstAlphaCombineMode mode, gint npixels)
+{
+  guint8 *out = inputs[0];
+  gint p, i, off;
+
+  switch (mode) {
+    case ALPHACOMBINE_MODE_MIN:
+      for (p = 0, off = 3; p < npixels; p++, off += 4) {
+        guint8 a = out[off];
+        for (i = 1; i < n; i++)
+          a = MIN (a, inputs[i][off]);
+        out[off] = a;
+      }
+      break;
+    case ALPHACOMBINE_MODE_WEIGHTED:
+      for (p = 0, off = 3; p < npixels; p++, off += 4) {
+        guint32 acc = (1 << 15) + weights[0] * out[off];
+        for (i = 1; i < n; i++)
+          acc += weights[i] * inputs[i][off];
+        out[off] = (guint8) MIN (acc >> 16, 255);
+      }
+      break;
+    case ALPHACOMBINE_MODE_MAX:
+    default:
+      for (p = 0, off = 3; p < npixels; p++, off += 4) {
+        guint8 a = out[off];
+        for (i = 1; i < n; i++)
+          a = MAX (a, inputs[i][off]);
+        out[off] = a;
+      }
+      break;
+  }
+}
+
+static GstFlowReturn
+gst_alphacombine_collected (GstCollectPads * pads, gpointer user_data)
+{
+  GstALPHACOMBINE *fs = GST_ALPHACOMBINE (user_data);
+  GstAlphaCombineCollectData *picked[ALPHACOMBINE_MAX_INPUTS];
+  GstBuffer *bufs[ALPHACOMBINE_MAX_INPUTS];
+  guint8 *planes[ALPHACOMBINE_MAX_INPUTS];
+  guint32 qweights[ALPHACOMBINE_MAX_INPUTS];
+  GstClockTime earliest = GST_CLOCK_TIME_NONE, tolerance;
+  GstAlphaCombineCollectData *base = NULL;
+  GstAlphaCombineMode mode;
+  gdouble wsum = 0.0;
+  GSList *l;
+  gint n = 0, i;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // find the earliest queued buffer, which defines the output timestamp
+  for (l = pads->data; l; l = l->next) {
+    GstAlphaCombineCollectData *data = (GstAlphaCombineCollectData *) l->data;
+    GstBuffer *buf = gst_collect_pads_peek (pads, &data->collect);
+    if (buf == NULL)
+      continue;
+    if (GST_BUFFER_TIMESTAMP_IS_VALID (buf) &&
+        (!GST_CLOCK_TIME_IS_VALID (earliest) || GST_BUFFER_TIMESTAMP (buf) < earliest))
+      earliest = GST_BUFFER_TIMESTAMP (buf);
+    if (base == NULL || data->index < base->index)
+      base = data;
+    gst_buffer_unref (buf);
+  }
+
+  if (base == NULL) {
+    GST_DEBUG_OBJECT (fs, "all inputs are EOS, pushing EOS");
+    gst_pad_push_event (fs->srcpad, gst_event_new_eos ());
+    return GST_FLOW_UNEXPECTED;
+  }
+
+  GST_OBJECT_LOCK (fs);
+  mode = fs->mode;
+  tolerance = fs->tolerance;
+  if (tolerance == 0)
+    tolerance = (fs->fps_n > 0) ?
+        gst_util_uint64_scale_int (GST_SECOND, fs->fps_d, 2 * fs->fps_n) : 20 * GST_MSECOND;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // take every input whose head is within tolerance of the earliest one; the
+  // base (colour) input is the lowest-numbered pad among those
+  base = NULL;
+  for (l = pads->data; l; l = l->next) {
+    GstAlphaCombineCollectData *data = (GstAlphaCombineCollectData *) l->data;
+    GstBuffer *buf = gst_collect_pads_peek (pads, &data->collect);
+    if (buf == NULL)
+      continue;
+    if (GST_CLOCK_TIME_IS_VALID (earliest) && GST_BUFFER_TIMESTAMP_IS_VALID (buf) &&
+        GST_BUFFER_TIMESTAMP (buf) > earliest + tolerance) {
+      GST_LOG_OBJECT (fs, "%s is ahead, keeping it for later", GST_PAD_NAME (data->collect.pad));
+      gst_buffer_unref (buf);
+      continue;
+    }
+    gst_buffer_unref (buf);
+    picked[n++] = data;
+    if (base == NULL || data->index < base->index)
+      base = data;
+  }
+
+  // put the base first, it carries the colour and receives the fused alpha
+  for (i = 0; i < n; i++) {
+    if (picked[i] == base) {
+      picked[i] = picked[0];
+      picked[0] = base;
+      break;
+    }
+  }
+  for (i = 0; i < n; i++)
+    wsum += fs->weights[picked[i]->index];
+  for (i = 0; i < n; i++)
+    qweights[i] = (wsum > 0.0) ?
+        (guint32) (fs->weights[picked[i]->index] / wsum * 65536.0) : (65536 / n);
+  GST_OBJECT_UNLOCK (fs);
+
+  for (i = 0; i < n; i++)
+    bufs[i] = gst_collect_pads_pop (pads, &picked[i]->collect);
+
+  //////////////////////////////////////////////////////////////////////////////
+  bufs[0] = gst_buffer_make_writable (bufs[0]);
+  for (i = 0; i < n; i++)
+    planes[i] = GST_BUFFER_DATA (bufs[i]);
+
+  if (n > 1) {
+    GST_LOG_OBJECT (fs, "fusing %d alpha planes @ %" GST_TIME_FORMAT, n,
+        GST_TIME_ARGS (earliest));
+    alphacombine_fuse (planes, qweights, n, mode, fs->width * fs->height);
+  }
+  fs->n_frames++;
+
+  for (i = 1; i < n; i++)
+    gst_buffer_unref (bufs[i]);
+
+  if (fs->segment_pending) {
+    GstSegment *seg = &base->collect.segment;
+    gst_pad_push_event (fs->srcpad, gst_event_new_new_segment_full (FALSE,
+            seg->rate, seg->applied_rate, seg->format, seg->start, seg->stop,
+            seg->time));
+    fs->segment_pending = FALSE;
+  }
+
+  gst_buffer_set_caps (bufs[0], GST_PAD_CAPS (fs->srcpad));
+  return gst_pad_push (fs->srcpad, bufs[0]);
+}
+
+static GstStateChangeReturn
+gst_alphacombine_change_state (GstElement * element, GstStateChange transition)
+{
+  GstALPHACOMBINE *fs = GST_ALPHACOMBINE (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      fs->segment_pending = TRUE;
+      fs->n_frames = 0;
+      gst_collect_pads_start (fs->collect);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      // stop before chaining up so that the collected function is unblocked
+      gst_collect_pads_stop (fs->collect);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      fs->width = fs->height = 0;
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+
+gboolean gst_alphacombine_plugin_init(GstPlugin * plugin) {
+	return gst_element_register(plugin, "alphacombine", GST_RANK_NONE, GST_TYPE_ALPHACOMBINE);
+}
@@ -0,0 +1,72 @@
+/*
+ */
+
+#ifndef __GST_ALPHACOMBINE_H__
+#define __GST_ALPHACOMBINE_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/base/gstcollectpads.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ALPHACOMBINE            (gst_alphacombine_get_type())
+#define GST_ALPHACOMBINE(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_ALPHACOMBINE,GstALPHACOMBINE))
+#define GST_IS_ALPHACOMBINE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_ALPHACOMBINE))
+#define GST_ALPHACOMBINE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass) ,GST_TYPE_ALPHACOMBINE,GstALPHACOMBINEClass))
+#define GST_IS_ALPHACOMBINE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass) ,GST_TYPE_ALPHACOMBINE))
+#define GST_ALPHACOMBINE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj) ,GST_TYPE_ALPHACOMBINE,GstALPHACOMBINEClass))
+typedef struct _GstALPHACOMBINE GstALPHACOMBINE;
+typedef struct _GstALPHACOMBINEClass GstALPHACOMBINEClass;
+typedef struct _GstAlphaCombineCollectData GstAlphaCombineCollectData;
+
+// maximum number of mask sources that can be fused by a single element
+#define ALPHACOMBINE_MAX_INPUTS 16
+
+typedef enum {
+  ALPHACOMBINE_MODE_MAX = 0,
+  ALPHACOMBINE_MODE_MIN,
+  ALPHACOMBINE_MODE_WEIGHTED
+} GstAlphaCombineMode;
+
+struct _GstAlphaCombineCollectData
+{
+  GstCollectData collect;       /* we extend the CollectData */
+  gint           index;         /* index of the sink_%d pad, selects its weight */
+};
+
+struct _GstALPHACOMBINE
+{
+  GstElement element;
+
+  /* < private > */
+  GstPad *srcpad;
+
+  GstCollectPads *collect;
+  GstPadEventFunction collect_event;
+  gint next_sinkpad;
+
+  GstVideoFormat format;
+  gint width;
+  gint height;
+  gint fps_n, fps_d;
+
+  GstAlphaCombineMode mode;
+  gdouble weights[ALPHACOMBINE_MAX_INPUTS];
+  GstClockTime tolerance;
+
+  gboolean segment_pending;
+  guint64  n_frames;
+};
+
+struct _GstALPHACOMBINEClass
+{
+  GstElementClass parent;
+};
+
+GType gst_alphacombine_get_type (void);
+
+gboolean gst_alphacombine_plugin_init (GstPlugin * plugin);
+
+G_END_DECLS
+#endif /* __GST_ALPHACOMBINE_H__ */
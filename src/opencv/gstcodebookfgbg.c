@@ -88,7 +88,7 @@ static void  classify_gray_as_fg(IplImage *img, IplImage *alpha, CvMatND *fg);
 static void grow_regions_by_gray(IplImage *img, IplImage *alpha, CvMatND *fg);
 #endif
 #ifdef CONNCOMPONENTS
-static          void find_connected_components( IplImage* mask, int poly1_hull0, float perimScale,
+static          void find_connected_components( IplImage* mask, t_blobstats* blobs, float perimScale,
                                                 int* num, CvRect* bbs, CvPoint* centers );
 static void find_pseudo_snake( int snakepoints, IplImage *mask, IplImage *output, CvMemStorage* storage);
 #endif
@@ -100,6 +100,10 @@ void CleanCodebookfgbg(GstCodebookfgbg *codebookfgbg)
   if (codebookfgbg->pFrame)        cvReleaseImageHeader(&codebookfgbg->pFrame);
   if (codebookfgbg->pCodeBookData) cvReleaseImage(&codebookfgbg->pCodeBookData);
   if (codebookfgbg->pFrImg)        cvReleaseImage(&codebookfgbg->pFrImg);
+#ifdef CONNCOMPONENTS
+  if (codebookfgbg->blobs)         blobstats_destroy(codebookfgbg->blobs);
+  codebookfgbg->blobs = NULL;
+#endif
 }
 
 static void gst_codebookfgbg_base_init(gpointer g_class) 
@@ -174,6 +178,9 @@ static void gst_codebookfgbg_init(GstCodebookfgbg * codebookfgbg, GstCodebookfgb
   codebookfgbg->posterize     = true;
   codebookfgbg->experimental  = false;
   codebookfgbg->normalize     = false;
+#ifdef CONNCOMPONENTS
+  codebookfgbg->blobs         = NULL;
+#endif
 }
 
 static void gst_codebookfgbg_finalize(GObject * object) 
@@ -309,6 +316,7 @@ static gboolean gst_codebookfgbg_set_caps(GstBaseTransform * btrans, GstCaps * i
 #ifdef CONNCOMPONENTS
   codebookfgbg->pFrameScratch  = cvCreateImage(size, IPL_DEPTH_8U, 1);
   codebookfgbg->storage        = cvCreateMemStorage(0);
+  codebookfgbg->blobs          = blobstats_create(codebookfgbg->width, codebookfgbg->height, 256);
 #endif
 #ifdef COLOURBINS
   int dimensions[3]; dimensions[0]=dimensions[1]=dimensions[2]=256;
@@ -428,7 +436,7 @@ static GstFlowReturn gst_codebookfgbg_transform_ip(GstBaseTransform * btrans, Gs
   if( codebookfgbg->experimental ){
 #ifdef CONNCOMPONENTS
     // 45 is the smallest area to show: (w+h)/45 , in pixels
-    find_connected_components( codebookfgbg->pFrImg, 0, 45, NULL, NULL, NULL );
+    find_connected_components( codebookfgbg->pFrImg, codebookfgbg->blobs, 45, NULL, NULL, NULL );
 
     // check out the morphological gradient: this paints the external contour of the blobs
     //cvMorphologyEx( codebookfgbg->pFrImg, codebookfgbg->pFrImg, NULL, NULL, CV_MOP_GRADIENT, 1);
@@ -785,158 +793,68 @@ void moulay_y_postnorm(IplImage* img)
 #ifdef CONNCOMPONENTS
 
 ///////////////////////////////////////////////////////////////////
-// void find_connected_components(IplImage *mask, int poly1_hull0,
+// void find_connected_components(IplImage *mask, t_blobstats *blobs,
 //                            float perimScale, int *num,
 //                            CvRect *bbs, CvPoint *centers)
 // This cleans up the foreground segmentation mask derived from calls
 // to backgroundDiff
 //
-// mask          Is a grayscale (8-bit depth) â€œrawâ€ mask image that
+// mask          Is a grayscale (8-bit depth) "raw" mask image that
 //               will be cleaned up
+// blobs         Labeller allocated for the mask size; the blobs kept
+//               are painted back as they are, holes included, there
+//               is no polygon nor convex hull approximation anymore
 //
 // OPTIONAL PARAMETERS:
-// poly1_hull0   If set, approximate connected component by
-//                 (DEFAULT) polygon, or else convex hull (0)
-// perimScale    Len = image (width+height)/perimScale. If contour
-//                 len < this, delete that contour (DEFAULT: 4)
+// perimScale    Len = image (width+height)/perimScale. If blob
+//                 area < this, delete that blob (DEFAULT: 4)
 // num           Maximum number of rectangles and/or centers to
 //                 return; on return, will contain number filled
 //                 (DEFAULT: NULL)
 // bbs           Pointer to bounding box rectangle vector of
 //                 length num. (DEFAULT SETTING: NULL)
-// centers      Pointer to contour centers vector of length
+// centers      Pointer to blob centers vector of length
 //                 num (DEFAULT: NULL)
 //
 
-
-// For connected components:
-// Approx.threshold - the bigger it is, the simpler is the boundary
-//
-#define CVCONTOUR_APPROX_LEVEL  1
-
 // How many iterations of erosion and/or dilation there should be
 //
 #define CVCLOSE_ITR  1
 
-void find_connected_components( IplImage *mask, int poly1_hull0, float perimScale,
+void find_connected_components( IplImage *mask, t_blobstats *blobs, float perimScale,
                                 int *num, CvRect *bbs,   CvPoint *centers) 
 {
-  static CvMemStorage*   mem_storage = NULL;
-  static CvSeq*          contours    = NULL;
   //CLEAN UP RAW MASK
   //
   cvMorphologyEx( mask, mask, 0, 0, CV_MOP_OPEN,  CVCLOSE_ITR );
   cvMorphologyEx( mask, mask, 0, 0, CV_MOP_CLOSE, CVCLOSE_ITR );
- //FIND CONTOURS AROUND ONLY BIGGER REGIONS
-  //
-  if( mem_storage==NULL ) {
-    mem_storage = cvCreateMemStorage(0);
-  } else {
-    cvClearMemStorage(mem_storage);
-  }
-
-  CvContourScanner scanner = cvStartFindContours( mask, mem_storage, sizeof(CvContour),
-                                                  CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE );
-
-  CvSeq* c;
-  int numCont = 0;
-  while( (c = cvFindNextContour( scanner )) != NULL ) {
-    //double len = cvContourPerimeter( c );
-    double len = cvContourArea(c);
-    // calculate perimeter len threshold:
-    //
-    double q = (mask->height + mask->width)/perimScale;
-    //Get rid of blob if its perimeter is too small:
-
-    if( len < q ) {
-       cvSubstituteContour( scanner, NULL );
-    } else {
-      //printf(" area: %f\n", len);
-      // Smooth its edges if its large enough
-      //
-      CvSeq* c_new;
-      if( poly1_hull0 ) {
-        // Polygonal approximation
-        //
-        c_new = cvApproxPoly(
-          c,  sizeof(CvContour), mem_storage, CV_POLY_APPROX_DP, CVCONTOUR_APPROX_LEVEL, 0 );
-      } else {
-        // Convex Hull of the segmentation
-        //
-        c_new = cvConvexHull2( c, mem_storage, CV_CLOCKWISE, 1 );
-      }
-      cvSubstituteContour( scanner, c_new );
-      numCont++;
-    }
-  }
-  contours = cvEndFindContours( &scanner );
-  // Just some convenience variables
-  const CvScalar CVX_WHITE = CV_RGB(0xff,0xff,0xff);
-  const CvScalar CVX_BLACK = CV_RGB(0x00,0x00,0x00);
 
-  // PAINT THE FOUND REGIONS BACK INTO THE IMAGE
+  //KEEP ONLY THE BIGGER REGIONS, AND PAINT THEM BACK INTO THE IMAGE
   //
-  cvZero( mask );
-  IplImage *maskTemp;
- // CALC CENTER OF MASS AND/OR BOUNDING RECTANGLES
+  const int q = (int)((mask->height + mask->width)/perimScale);
+  int nblobs = blobstats_label(blobs, (unsigned char*)mask->imageData, mask->widthStep, 1,
+                               0, BLOBSTATS_CONNECT8, q);
+  blobstats_paint(blobs, (unsigned char*)mask->imageData, mask->widthStep, 1);
+
+  // CALC CENTER OF MASS AND/OR BOUNDING RECTANGLES
   //
   if(num != NULL) {
-    //User wants to collect statistics
+    //User wants to collect statistics, only up to *num of them
     //
-    int N = *num, numFilled = 0, i=0;
-    CvMoments moments;
-    double M00, M01, M10;
-    maskTemp = cvCloneImage(mask);
-    for(i=0, c=contours; c != NULL; c = c->h_next,i++ ) {
-      if(i < N) {
-        // Only process up to *num of them
-        //
-        cvDrawContours(  maskTemp, c,
-                         CVX_WHITE, CVX_WHITE, -1,
-                         CV_FILLED, 8 );
-        // Find the center of each contour
-        //
-        if(centers != NULL) {
-          cvMoments(maskTemp,&moments,1);
-          M00 = cvGetSpatialMoment(&moments,0,0);
-          M10 = cvGetSpatialMoment(&moments,1,0);
-          M01 = cvGetSpatialMoment(&moments,0,1);
-          centers[i].x = (int)(M10/M00);
-          centers[i].y = (int)(M01/M00);
-        }
-        //Bounding rectangles around blobs
-        //
-        if(bbs != NULL) {
-          bbs[i] = cvBoundingRect(c);
-        }
-        cvZero(maskTemp);
-        numFilled++;
+    int numFilled = (nblobs < *num) ? nblobs : *num;
+    for(int i=0; i < numFilled; i++) {
+      const t_blob *blob = &blobs->blobs[i];
+      if(centers != NULL) {
+        centers[i].x = (int)blob->cx;
+        centers[i].y = (int)blob->cy;
+      }
+      if(bbs != NULL) {
+        bbs[i] = cvRect(blob->x0, blob->y0, blob->x1 - blob->x0 + 1, blob->y1 - blob->y0 + 1);
       }
-      // Draw filled contours into mask
-      //
-      cvDrawContours(
-        mask,
-        c,
-        CVX_WHITE,
-        CVX_WHITE,
-        -1,
-        CV_FILLED,
-        8
-        );
-    }                               //end looping over contours
+    }
     *num = numFilled;
-    cvReleaseImage( &maskTemp);
-  } 
-  // ELSE JUST DRAW PROCESSED CONTOURS INTO THE MASK
-  //
-  else {
-    // The user doesn't want statistics, just draw the contours
-    //
-    for( c=contours; c != NULL; c = c->h_next ) {
-      cvDrawContours( mask, c, CVX_WHITE, CVX_BLACK, -1, CV_FILLED, 8 );
   }
 }
-}
 
 
 ///////////////////////////////////////////////////////////////////
@@ -9,6 +9,7 @@
 #include <gst/video/gstvideofilter.h>
 
 #include <opencv/cv.h>
+#include "blobstats.h"
 //#include <opencv/highgui.h>
 
 G_BEGIN_DECLS
@@ -78,6 +79,7 @@ struct _GstCodebookfgbg {
 #ifdef CONNCOMPONENTS
   IplImage* pFrameScratch ;
   CvMemStorage *storage;
+  t_blobstats  *blobs;
 #endif
 };
 
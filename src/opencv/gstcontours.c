@@ -5,6 +5,8 @@
  *
  * This element takes a Gray image, which is supposed to be
  * actually 2-valued, and calculates the contours inside. Draws them too.
+ * The edges are grouped in connected components by a run based labeller, the
+ * area of a contour is that of the bounding box of its component.
  * 
  */
 
@@ -25,6 +27,8 @@ enum {
 	PROP_LAST
 };
 
+#define CONTOURS_MAX_BLOBS 1024
+
 static GstStaticPadTemplate gst_contours_src_template = GST_STATIC_PAD_TEMPLATE (
 		"src",
 		GST_PAD_SRC,
@@ -63,7 +67,9 @@ GST_BOILERPLATE (GstContours, gst_contours, GstVideoFilter, GST_TYPE_VIDEO_FILTE
 void CleanContours(GstContours *contours) 
 {
   if (contours->cvGRAY)       cvReleaseImageHeader(&contours->cvGRAY);
-  if (contours->cvGRAY_copy)  cvReleaseImageHeader(&contours->cvGRAY_copy);
+  if (contours->cvGRAY_copy)  cvReleaseImage(&contours->cvGRAY_copy);
+  if (contours->blobs)        blobstats_destroy(contours->blobs);
+  contours->blobs = NULL;
 }
 
 static void gst_contours_base_init(gpointer g_class) 
@@ -119,10 +125,7 @@ static void gst_contours_init(GstContours * contours, GstContoursClass * klass)
   contours->cvGRAY_copy = NULL;
   contours->display     = 0;
   contours->histeq      = 1;
-
-  contours->storage     = cvCreateMemStorage();
-  contours->contour     = NULL;
-  contours->mode        = CV_RETR_TREE;//CV_RETR_EXTERNAL;
+  contours->blobs       = NULL;
   contours->minarea     = 20.0;
 }
 
@@ -228,6 +231,10 @@ static gboolean gst_contours_set_caps(GstBaseTransform * btrans, GstCaps * incap
   contours->cvGRAY = cvCreateImageHeader(size, IPL_DEPTH_8U, 1);
   // fully allocate the copy
   contours->cvGRAY_copy = cvCreateImage(size, IPL_DEPTH_8U, 1);
+  // and the labeller, for the frame size
+  if( contours->blobs )
+    blobstats_destroy(contours->blobs);
+  contours->blobs = blobstats_create(contours->width, contours->height, CONTOURS_MAX_BLOBS);
 
   GST_INFO("Contours initialized.");
   
@@ -261,37 +268,21 @@ static GstFlowReturn gst_contours_transform_ip(GstBaseTransform * btrans, GstBuf
 
   cvCanny(contours->cvGRAY_copy, contours->cvGRAY_copy ,10, 150);
 
-  // find the contours
-  int Nc =
-   cvFindContours( contours->cvGRAY_copy,
-                   contours->storage,
-                   &(contours->contour),
-                   sizeof(CvContour),
-                   contours->mode,
-                   CV_CHAIN_APPROX_SIMPLE,
-                   cvPoint(0,0));
-
-// if( contours->display )
-//   cvDrawContours( contours->cvGRAY,
-//                   contours->contour,
-//                   CV_RGB(0,255,0),
-//                   CV_RGB(255,0,0),
-//                   2, 2, 8);
+  // find the connected edges, 8-connected like the contour following was
+  int Nc = blobstats_label(contours->blobs, (unsigned char*)contours->cvGRAY_copy->imageData,
+                           contours->cvGRAY_copy->widthStep, 1, 0, BLOBSTATS_CONNECT8, 1);
 
   int    large_contours=0;
-  CvSeq* current_contour = contours->contour;
-  while (current_contour != NULL){
-    double area = fabs(cvContourArea(current_contour, CV_WHOLE_SEQ, false));       
+  for( int i = 0; i < Nc; i++ ){
+    const t_blob *blob = &contours->blobs->blobs[i];
+    double area = (double)(blob->x1 - blob->x0 + 1) * (blob->y1 - blob->y0 + 1);
     if( area > contours->minarea){
       large_contours++;
       if( contours->display )
-        cvDrawContours( contours->cvGRAY,
-                        current_contour,
-                        CV_RGB(0,255,0),
-                        CV_RGB(255,0,0),
-                        0, 2, -8);
+        cvRectangle( contours->cvGRAY,
+                     cvPoint(blob->x0, blob->y0), cvPoint(blob->x1, blob->y1),
+                     cvScalarAll(255), 1, 8, 0);
     }
-    current_contour = current_contour->h_next;
   }
 
   printf(" total contours detected %.5d, large ones: %.5d\n", Nc, large_contours);
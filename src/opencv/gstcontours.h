@@ -9,6 +9,7 @@
 #include <gst/video/gstvideofilter.h>
 
 #include <opencv/cv.h>
+#include "blobstats.h"
 //#include <opencv/highgui.h>
 
 G_BEGIN_DECLS
@@ -40,10 +41,8 @@ struct _GstContours {
   gboolean             display; 
   gboolean             histeq; 
 
-  CvMemStorage        *storage; 
-  CvSeq               *contour;
-  int                  mode;
-  int                  minarea;
+  t_blobstats         *blobs;
+  double               minarea;
 };
 
 struct _GstContoursClass {
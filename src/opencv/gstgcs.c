@@ -24,6 +24,7 @@ enum {
         PROP_DISPLAY,
         PROP_DEBUG,
 	PROP_GHOST,
+	PROP_ADAPTIVE,
 	PROP_LAST
 };
 
@@ -65,7 +66,7 @@ static gboolean get_frame_difference( IplImage* in, IplImage* inprev, IplImage*
 
 static void compose_grabcut_seedmatrix2(CvMat* output, CvRect facebox,  IplImage* seeds, gboolean confidence);
 static void compose_grabcut_seedmatrix3(CvMat* output, IplImage* ghost,  IplImage* seeds );
-static gint compose_skin_matrix(IplImage* rgbin, IplImage* gray_out);
+static gint compose_skin_matrix(t_skinlut* lut, IplImage* rgbain, IplImage* gray_out);
 
 #ifdef KMEANS
 static void create_kmeans_clusters(IplImage* in, CvMat* points, CvMat* cluster, int numclusters, int numsamples);
@@ -87,6 +88,8 @@ GST_BOILERPLATE (GstGcs, gst_gcs, GstVideoFilter, GST_TYPE_VIDEO_FILTER);
 void CleanGcs(GstGcs *gcs) 
 {
   if (gcs->pImageRGBA)  cvReleaseImageHeader(&gcs->pImageRGBA);
+  if (gcs->skinlut)     skinlut_destroy(gcs->skinlut);
+  gcs->skinlut = NULL;
 
   finalise_grabcut( &gcs->GC );
 }
@@ -137,6 +140,11 @@ static void gst_gcs_class_init(GstGcsClass * klass)
                                     "ghost", "ghost", "Ghost file name (png!)",
                                     DEFAULT_GHOSTFILENAME,	
                                     (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, 
+                                  PROP_ADAPTIVE, g_param_spec_boolean(
+                                  "adaptive", "Adaptive",
+                                  "Adapt the skin colour table to the model learned by a facetracker (learnskin=true)", FALSE, 
+                                  (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 }
 
 static void gst_gcs_init(GstGcs * gcs, GstGcsClass * klass) 
@@ -159,6 +167,10 @@ static void gst_gcs_init(GstGcs * gcs, GstGcsClass * klass)
   gcs->pImgCh2           = NULL;
   gcs->pImgCh3           = NULL;
 
+  gcs->skinlut           = NULL;
+  gcs->skinmodel         = (t_skinlut_model*)g_malloc0(sizeof(t_skinlut_model));
+  gcs->adaptive          = false;
+
   gcs->ghostfilename = NULL;
   gcs->display       = false;
   gcs->debug         = 0;
@@ -170,6 +182,7 @@ static void gst_gcs_finalize(GObject * object)
   
   GST_GCS_LOCK (gcs);
   CleanGcs(gcs);
+  g_free(gcs->skinmodel);
   GST_GCS_UNLOCK (gcs);
   GST_INFO("Gcs destroyed (%s).", GST_OBJECT_NAME(object));
   
@@ -195,6 +208,9 @@ static void gst_gcs_set_property(GObject * object, guint prop_id, const GValue *
     g_free(gcs->ghostfilename);
     gcs->ghostfilename = g_value_dup_string(value);
     break;
+  case PROP_ADAPTIVE:
+    gcs->adaptive = g_value_get_boolean(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -216,6 +232,9 @@ static void gst_gcs_get_property(GObject * object, guint prop_id, GValue * value
   case PROP_GHOST:
     g_value_set_string(value, gcs->ghostfilename);
     break;
+  case PROP_ADAPTIVE:
+    g_value_set_boolean(value, gcs->adaptive);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -286,6 +305,13 @@ static gboolean gst_gcs_set_caps(GstBaseTransform * btrans, GstCaps * incaps, Gs
   gcs->pImgChX       = cvCreateImage(size, IPL_DEPTH_8U, 1);
 
   gcs->pImg_skin     = cvCreateImage(size, IPL_DEPTH_8U, 1);
+  if( !gcs->skinlut ){
+    // R > 60 AND R' > 0.4 AND R' < 0.6 AND G' > 0.28 and G' < 0.4, on RGBA input
+    t_skinlut_params skinparams;
+    skinlut_default_params(SKINLUT_METHOD_RGB, &skinparams);
+    skinparams.rn_low = 0.40f;
+    gcs->skinlut = skinlut_create(SKINLUT_METHOD_RGB, SKINLUT_INPUT_RGB, &skinparams);
+  }
 
   gcs->grabcut_mask   = cvCreateMat( size.height, size.width, CV_8UC1);
   cvZero(gcs->grabcut_mask);
@@ -421,7 +447,11 @@ static GstFlowReturn gst_gcs_transform_ip(GstBaseTransform * btrans, GstBuffer *
   gcs->facepos.y = gcs->facepos.y - gcs->facepos.height/2;
 
   // create an IplImage  with the skin colour pixels as 255
-  compose_skin_matrix(gcs->pImgRGB, gcs->pImg_skin);
+  if( gcs->adaptive ){
+    skinlut_model_fetch(gcs->skinmodel);
+    skinlut_learn(gcs->skinlut, gcs->skinmodel, SKINLUT_LEARN_RATE, SKINLUT_LEARN_BUDGET);
+  }
+  compose_skin_matrix(gcs->skinlut, gcs->pImageRGBA, gcs->pImg_skin);
   // And the skin pixels with the movement mask
   cvAnd( gcs->pImg_skin,  gcs->pImgGRAY_diff,  gcs->pImgGRAY_diff);
   //cvErode( gcs->pImgGRAY_diff, gcs->pImgGRAY_diff, cvCreateStructuringElementEx(5, 5, 3, 3, CV_SHAPE_RECT,NULL), 1);
@@ -670,81 +700,16 @@ void compose_grabcut_seedmatrix3(CvMat* output, IplImage* ghost ,  IplImage* see
 
 
 ////////////////////////////////////////////////////////////////////////////////
-gint compose_skin_matrix(IplImage* rgbin, IplImage* gray_out)
+// R' = R / (R+G+B), G' = G / (R + G + B)
+//  Skin pixel if:
+// R > 60 AND R' > 0.4 AND R' < 0.6 AND G' > 0.28 and G' < 0.4
+// all precomputed in the colour table, looked up straight on the RGBA input
+gint compose_skin_matrix(t_skinlut* lut, IplImage* rgbain, IplImage* gray_out)
 {
-/*
-  int skin_under_seed = 0;
-
-  static IplImage* imageHSV = cvCreateImage( cvSize(rgbin->width, rgbin->height), IPL_DEPTH_8U, 3);
-  cvCvtColor(rgbin, imageHSV, CV_RGB2HSV);
-
-  static IplImage* planeH = cvCreateImage( cvGetSize(imageHSV), 8, 1);	// Hue component.
-  ///IplImage* planeH2= cvCreateImage( cvGetSize(imageHSV), 8, 1);	// Hue component, 2nd threshold
-  static IplImage* planeS = cvCreateImage( cvGetSize(imageHSV), 8, 1);	// Saturation component.
-  static IplImage* planeV = cvCreateImage( cvGetSize(imageHSV), 8, 1);	// Brightness component.
-  cvCvtPixToPlane(imageHSV, planeH, planeS, planeV, 0);	// Extract the 3 color components.
-
-  // Detect which pixels in each of the H, S and V channels are probably skin pixels.
-  // Assume that skin has a Hue between 0 to 18 (out of 180), and Saturation above 50, and Brightness above 80.
-  ///cvThreshold(planeH , planeH2, 10, UCHAR_MAX, CV_THRESH_BINARY);         //(hue > 10)
-  cvThreshold(planeH , planeH , 20, UCHAR_MAX, CV_THRESH_BINARY_INV);     //(hue < 20)
-  cvThreshold(planeS , planeS , 48, UCHAR_MAX, CV_THRESH_BINARY);         //(sat > 48)
-  cvThreshold(planeV , planeV , 80, UCHAR_MAX, CV_THRESH_BINARY);         //(val > 80)
-
-  // erode the HUE to get rid of noise.
-  cvErode(planeH, planeH, NULL, 1);
-
-  // Combine all 3 thresholded color components, so that an output pixel will only
-  // be white (255) if the H, S and V pixels were also white.
-
-  // gray_out = (hue > 10) ^ (hue < 20) ^ (sat > 48) ^ (val > 80), where   ^ mean pixels-wise AND
-  cvAnd(planeH  , planeS , gray_out);	
-  //cvAnd(gray_out, planeH2, gray_out);	
-  cvAnd(gray_out, planeV , gray_out);	
-
-  return(skin_under_seed);
-*/
-
-  static IplImage* planeR  = cvCreateImage( cvGetSize(rgbin), 8, 1);	// R component.
-  static IplImage* planeG  = cvCreateImage( cvGetSize(rgbin), 8, 1);	// G component.
-  static IplImage* planeB  = cvCreateImage( cvGetSize(rgbin), 8, 1);	// B component.
-
-  static IplImage* planeAll = cvCreateImage( cvGetSize(rgbin), IPL_DEPTH_32F, 1);	// (R+G+B) component.
-  static IplImage* planeR2  = cvCreateImage( cvGetSize(rgbin), IPL_DEPTH_32F, 1);	// R component, 32bits
-  static IplImage* planeRp  = cvCreateImage( cvGetSize(rgbin), IPL_DEPTH_32F, 1);	// R' and >0.4
-  static IplImage* planeGp  = cvCreateImage( cvGetSize(rgbin), IPL_DEPTH_32F, 1);	// G' and > 0.28
-
-  static IplImage* planeRp2 = cvCreateImage( cvGetSize(rgbin), IPL_DEPTH_32F, 1);	// R' <0.6
-  static IplImage* planeGp2 = cvCreateImage( cvGetSize(rgbin), IPL_DEPTH_32F, 1);	// G' <0.4
-
-  cvCvtPixToPlane(rgbin, planeR, planeG, planeB, 0);	// Extract the 3 color components.
-  cvAdd( planeR, planeG,   planeAll, NULL);
-  cvAdd( planeB, planeAll, planeAll, NULL);  // All = R + G + B
-  cvDiv( planeR, planeAll, planeRp, 1.0);    // R' = R / ( R + G + B)
-  cvDiv( planeG, planeAll, planeGp, 1.0);    // G' = G / ( R + G + B)
-
-  cvConvertScale( planeR, planeR2, 1.0, 0.0);
-  cvCopy(planeGp, planeGp2, NULL);
-  cvCopy(planeRp, planeRp2, NULL);
-
-  cvThreshold(planeR2 , planeR2,   60, UCHAR_MAX, CV_THRESH_BINARY);     //(R > 60)
-  cvThreshold(planeRp , planeRp, 0.40, UCHAR_MAX, CV_THRESH_BINARY);     //(R'> 0.4)
-  cvThreshold(planeRp2, planeRp2, 0.6, UCHAR_MAX, CV_THRESH_BINARY_INV); //(R'< 0.6)
-  cvThreshold(planeGp , planeGp, 0.28, UCHAR_MAX, CV_THRESH_BINARY);     //(G'> 0.28)
-  cvThreshold(planeGp2, planeGp2, 0.4, UCHAR_MAX, CV_THRESH_BINARY_INV); //(G'< 0.4)
-
-  // R’ = R / (R+G+B), G’ = G / (R + G + B)
-  //  Skin pixel if:
-  // R > 60 AND R’ > 0.4 AND R’ < 0.6 AND G’ > 0.28 and G’ < 0.4  
-  static IplImage* imageSkinPixels = cvCreateImage( cvGetSize(rgbin), IPL_DEPTH_32F, 1); 
-  cvAnd( planeR2 ,         planeRp , imageSkinPixels);	
-  cvAnd( planeRp , imageSkinPixels , imageSkinPixels);	
-  cvAnd( planeRp2, imageSkinPixels , imageSkinPixels);	
-  cvAnd( planeGp , imageSkinPixels , imageSkinPixels);	
-  cvAnd( planeGp2, imageSkinPixels , imageSkinPixels);	
-  
-  cvConvertScale( imageSkinPixels, gray_out, 1.0, 0.0);
-  return(0);
+  return skinlut_classify(lut, rgbain->width, rgbain->height,
+                          (unsigned char*)rgbain->imageData, rgbain->widthStep, rgbain->nChannels,
+                          (unsigned char*)gray_out->imageData, gray_out->widthStep, 1,
+                          128, NULL);
 }
 
 
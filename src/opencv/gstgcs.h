@@ -11,6 +11,7 @@
 #include <opencv/cv.h>
 //#include <opencv/highgui.h>
 #include "grabcut_wrapper.hpp"
+#include "skinlut.h"
 
 // if we define KMEANS, the torso bbox is somehow re-centered using the largest 
 // colour-spatial cluster as found by k-Means algorithm
@@ -97,6 +98,9 @@ struct _GstGcs {
 
   // GCS stuff
   IplImage*  pImg_skin;       // Skin colour pixels as {255} or {0}
+  t_skinlut* skinlut;         // colour -> skin table, normalised RGB rules
+  t_skinlut_model* skinmodel; // learned model followed if adaptive
+  bool       adaptive;
 
   CvMat*     grabcut_mask; // mask created by graphcut
   CvRect     bbox_prev;
@@ -4,6 +4,8 @@
  * SECTION:element- morphology
  *
  * This element takes a RGB image, and applies one morphology operator.
+ * The time it takes is in the read only stats property, and posted on the bus
+ * every stats-interval if stats-messages is set.
  * 
  */
 
@@ -15,11 +17,17 @@
 GST_DEBUG_CATEGORY_STATIC (gst_morphology_debug);
 #define GST_CAT_DEFAULT gst_morphology_debug
 
+#define DEFAULT_STATS_INTERVAL STAGEPROF_DEFAULT_INTERVAL
+#define DEFAULT_STATS_MESSAGES FALSE
+
 
 enum {
 	PROP_0,
 	PROP_OP,
 	PROP_ITERATIONS,
+	PROP_STATS,
+	PROP_STATS_INTERVAL,
+	PROP_STATS_MESSAGES,
 	PROP_LAST
 };
 
@@ -103,6 +111,18 @@ static void gst_morphology_class_init(GstMorphologyClass * klass)
                                   g_param_spec_int("iters", "Amount of iterations",
                                                    "Amount of iterations", 
                                                    1, 100, 1, (GParamFlags)G_PARAM_READWRITE ));
+  g_object_class_install_property(gobject_class, PROP_STATS, 
+                                  g_param_spec_string("stats", "Stats",
+                                                      "Count, mean, median, 95th percentile and maximum milliseconds of the operator over the last stats-interval", 
+                                                      NULL, (GParamFlags)G_PARAM_READABLE ));
+  g_object_class_install_property(gobject_class, PROP_STATS_INTERVAL, 
+                                  g_param_spec_int("stats-interval", "Stats interval",
+                                                   "Milliseconds summarised by stats", 
+                                                   100, 60000, DEFAULT_STATS_INTERVAL, (GParamFlags)G_PARAM_READWRITE ));
+  g_object_class_install_property(gobject_class, PROP_STATS_MESSAGES, 
+                                  g_param_spec_boolean("stats-messages", "Stats messages",
+                                                       "Post stats as a stageprof element message every stats-interval", 
+                                                       DEFAULT_STATS_MESSAGES, (GParamFlags)G_PARAM_READWRITE ));
 }
 
 static void gst_morphology_init(GstMorphology * morphology, GstMorphologyClass * klass) 
@@ -113,6 +133,9 @@ static void gst_morphology_init(GstMorphology * morphology, GstMorphologyClass *
   morphology->cvBGR_out  = NULL;
   morphology->iterations = 1;
   morphology->op         = CV_MOP_GRADIENT;
+  morphology->stats_interval = DEFAULT_STATS_INTERVAL;
+  morphology->stats_messages = DEFAULT_STATS_MESSAGES;
+  morphology->prof       = stageprof_create(morphology->stats_interval);
 }
 
 static void gst_morphology_finalize(GObject * object) 
@@ -121,6 +144,7 @@ static void gst_morphology_finalize(GObject * object)
   
   GST_MORPHOLOGY_LOCK (morphology);
   CleanMorphology(morphology);
+  stageprof_destroy(morphology->prof);
   GST_MORPHOLOGY_UNLOCK (morphology);
   GST_INFO("Morphology destroyed (%s).", GST_OBJECT_NAME(object));
   
@@ -148,6 +172,13 @@ static void gst_morphology_set_property(GObject * object, guint prop_id, const G
   case PROP_ITERATIONS:
     morphology->iterations = g_value_get_int(value);
     break;    
+  case PROP_STATS_INTERVAL:
+    morphology->stats_interval = g_value_get_int(value);
+    stageprof_set_interval(morphology->prof, morphology->stats_interval);
+    break;    
+  case PROP_STATS_MESSAGES:
+    morphology->stats_messages = g_value_get_boolean(value);
+    break;    
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -166,6 +197,17 @@ static void gst_morphology_get_property(GObject * object, guint prop_id, GValue
   case PROP_ITERATIONS:
     g_value_set_int(value, morphology->iterations);
     break;    
+  case PROP_STATS: {
+    gchar buffer[1024];
+    g_value_set_string(value, stageprof_print(morphology->prof, buffer, sizeof(buffer)));
+    break;
+  }
+  case PROP_STATS_INTERVAL:
+    g_value_set_int(value, morphology->stats_interval);
+    break;    
+  case PROP_STATS_MESSAGES:
+    g_value_set_boolean(value, morphology->stats_messages);
+    break;    
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -232,8 +274,10 @@ static void gst_morphology_before_transform(GstBaseTransform * btrans, GstBuffer
 static GstFlowReturn gst_morphology_transform_ip(GstBaseTransform * btrans, GstBuffer * gstbuf) 
 {
   GstMorphology *morphology = GST_MORPHOLOGY (btrans);
+  GstMessage *stats = NULL;
 
   GST_MORPHOLOGY_LOCK (morphology);
+  const guint64 t_frame = stageprof_frame_start(morphology->prof);
 
   //////////////////////////////////////////////////////////////////////////////
   // Image preprocessing: color space conversion etc
@@ -243,12 +287,19 @@ static GstFlowReturn gst_morphology_transform_ip(GstBaseTransform * btrans, GstB
   //////////////////////////////////////////////////////////////////////////////
   // here goes the bussiness logic
   //////////////////////////////////////////////////////////////////////////////
+  const guint64 t = stageprof_start(morphology->prof);
   cvMorphologyEx( morphology->cvBGR, morphology->cvBGR, NULL, NULL, 
                    morphology->op, morphology->iterations);
+  stageprof_stop(morphology->prof, STAGEPROF_MORPH, t);
 
   //////////////////////////////////////////////////////////////////////////////
+  if( stageprof_frame_end(morphology->prof, t_frame) && morphology->stats_messages )
+    stats = stageprof_message(morphology->prof, GST_OBJECT(morphology));
   GST_MORPHOLOGY_UNLOCK (morphology);  
   
+  if( stats )
+    gst_element_post_message(GST_ELEMENT(morphology), stats);
+  
   return GST_FLOW_OK;
 }
 
@@ -9,6 +9,7 @@
 #include <gst/video/gstvideofilter.h>
 
 #include <opencv/cv.h>
+#include "stageprof.h"
 //#include <opencv/highgui.h>
 
 G_BEGIN_DECLS
@@ -39,6 +40,10 @@ struct _GstMorphology {
   IplImage            *cvBGR_out;
   gint                 iterations; 
   gint                 op; 
+
+  t_stageprof         *prof;     // see the stats property
+  gint                 stats_interval;
+  gboolean             stats_messages;
 };
 
 struct _GstMorphologyClass {
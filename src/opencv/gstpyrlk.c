@@ -57,11 +57,23 @@ static void gst_pyrlk_finalize(GObject * object);
 static gboolean gst_pyrlk_sink_event(GstPad *pad, GstEvent * event);
 
 
+#define MAX_CORNERS 500
+
 GST_BOILERPLATE (GstPyrlk, gst_pyrlk, GstVideoFilter, GST_TYPE_VIDEO_FILTER);
 
 void CleanPyrlk(GstPyrlk *pyrlk) 
 {
-  if (pyrlk->cvRGB)  cvReleaseImageHeader(&pyrlk->cvRGB);
+  if (pyrlk->cvRGB)        cvReleaseImageHeader(&pyrlk->cvRGB);
+  if (pyrlk->cvRGBout)     cvReleaseImage(&pyrlk->cvRGBout);
+  if (pyrlk->cvEdgeImage)  cvReleaseImage(&pyrlk->cvEdgeImage);
+  if (pyrlk->cvEdgeImage2) cvReleaseImage(&pyrlk->cvEdgeImage2);
+  pyrlk_context_release(&pyrlk->pyrlk_ctx);
+  pyrlk->cvGrey = NULL;
+
+  g_free(pyrlk->cornersA);      pyrlk->cornersA = NULL;
+  g_free(pyrlk->cornersB);      pyrlk->cornersB = NULL;
+  g_free(pyrlk->corners_found); pyrlk->corners_found = NULL;
+  g_free(pyrlk->corners_error); pyrlk->corners_error = NULL;
 }
 
 static void gst_pyrlk_base_init(gpointer g_class) 
@@ -101,6 +113,15 @@ static void gst_pyrlk_init(GstPyrlk * pyrlk, GstPyrlkClass * klass)
   gst_base_transform_set_in_place((GstBaseTransform *)pyrlk, TRUE);
   g_static_mutex_init(&pyrlk->lock);
   pyrlk->cvRGB     = NULL;
+  pyrlk->cvRGBout  = NULL;
+  pyrlk->cvGrey    = NULL;
+  pyrlk->cvEdgeImage   = NULL;
+  pyrlk->cvEdgeImage2  = NULL;
+  pyrlk->pyrlk_ctx = NULL;
+  pyrlk->cornersA  = NULL;
+  pyrlk->cornersB  = NULL;
+  pyrlk->corners_found = NULL;
+  pyrlk->corners_error = NULL;
 
 }
 
@@ -186,15 +207,20 @@ static gboolean gst_pyrlk_set_caps(GstBaseTransform * btrans, GstCaps * incaps,
 
   //////////////////////////////////////////////////////////////////////////////
   // allocate image structs in RGB  ////////////////////////////////////////////
+  CleanPyrlk(pyrlk);
   pyrlk->cvRGB = cvCreateImageHeader(size, IPL_DEPTH_8U, 3);
-  pyrlk->cvRGBprev = cvCreateImage(size, IPL_DEPTH_8U, 3);
   pyrlk->cvRGBout  = cvCreateImage(size, IPL_DEPTH_8U, 3);
 
   //////////////////////////////////////////////////////////////////////////////
-  // Full allocation of Grey Images (for motion flow)
-  pyrlk->cvGrey     = cvCreateImage(size, IPL_DEPTH_8U, 1);
-  //pyrlk->cvGreyPrev = cvCreateImage(size, IPL_DEPTH_8U, 1);
-  pyrlk->cvGreyPrev = NULL;
+  // Full allocation of Grey Images and their pyramids (for motion flow), these
+  // are rotated frame after frame, never copied nor reallocated
+  pyrlk->pyrlk_ctx  = pyrlk_context_create(size);
+  pyrlk->cvGrey     = pyrlk_context_frame(pyrlk->pyrlk_ctx);
+
+  pyrlk->cornersA      = g_new(CvPoint2D32f, MAX_CORNERS);
+  pyrlk->cornersB      = g_new(CvPoint2D32f, MAX_CORNERS);
+  pyrlk->corners_found = g_new(char,  MAX_CORNERS);
+  pyrlk->corners_error = g_new(float, MAX_CORNERS);
 
   pyrlk->cvEdgeImage   = cvCreateImage(size, IPL_DEPTH_16S, 1);
   pyrlk->cvEdgeImage2  = cvCreateImage(size, IPL_DEPTH_16S, 1);
@@ -241,28 +267,25 @@ static GstFlowReturn gst_pyrlk_transform_ip(GstBaseTransform * btrans, GstBuffer
 
 
   //calc_eisemann_durand_luminance(pyrlk->cvRGB, pyrlk->cvGrey);
-  if( pyrlk->cvGreyPrev == NULL)
-    pyrlk->cvGreyPrev = cvCloneImage( pyrlk->cvGrey );
 
 
   //////////////////////////////////////////////////////////////////////////////
   //////////////////////////////////////////////////////////////////////////////
-  #define MAX_CORNERS 500
   int num_corners = MAX_CORNERS;
-  CvPoint2D32f* cornersA = (CvPoint2D32f*)malloc(sizeof(CvPoint2D32f)*MAX_CORNERS);
-  CvPoint2D32f* cornersB = (CvPoint2D32f*)malloc(sizeof(CvPoint2D32f)*MAX_CORNERS);
-  char corners_found[ MAX_CORNERS ];
-  float corners_error[ MAX_CORNERS ];
+  CvPoint2D32f* cornersA = pyrlk->cornersA;
+  CvPoint2D32f* cornersB = pyrlk->cornersB;
+  char*  corners_found   = pyrlk->corners_found;
+  float* corners_error   = pyrlk->corners_error;
 
 
   //cvSobel( pyrlk->cvGrey    , pyrlk->cvEdgeImage , 1, 1, 3 );
-  //cvSobel( pyrlk->cvGreyPrev, pyrlk->cvEdgeImage2, 1, 1, 3 );
   //cvConvertScale(pyrlk->cvEdgeImage, pyrlk->cvGrey, 1.0/256.0, 0); 
   //cvCvtColor( pyrlk->cvGrey, pyrlk->cvRGBout, CV_GRAY2RGB );
-  //cvConvertScale(pyrlk->cvEdgeImage2, pyrlk->cvGreyPrev, 1.0/256, 0); 
 
-  num_corners = calculate_pyrlk( pyrlk->cvGreyPrev, pyrlk->cvGrey, 
-                                 num_corners, cornersA, corners_found, corners_error, cornersB);
+  // previous frame -> cvGrey, then cvGrey becomes the previous frame
+  num_corners = pyrlk_context_track( pyrlk->pyrlk_ctx, 
+                                     num_corners, cornersA, corners_found, corners_error, cornersB);
+  pyrlk->cvGrey = pyrlk_context_frame(pyrlk->pyrlk_ctx);
   //////////////////////////////////////////////////////////////////////////////
   int i;
   if( (pyrlk->facepos.x != 0) && ( pyrlk->facepos.y != 0)){
@@ -291,11 +314,6 @@ static GstFlowReturn gst_pyrlk_transform_ip(GstBaseTransform * btrans, GstBuffer
 
 
 
-  // save the current image for the next iteration
-  pyrlk->cvGreyPrev = cvCloneImage( pyrlk->cvGrey );
-  // save the original frame for the next iteration
-  pyrlk->cvRGBprev  = cvCloneImage( pyrlk->cvRGB );
-
   // copy the RGBout to the input
   cvCopy( pyrlk->cvRGBout, pyrlk->cvRGB, NULL );
 
@@ -37,9 +37,13 @@ struct _GstPyrlk {
   GstVideoFormat in_format, out_format;
   gint width, height;
   
-  IplImage            *cvRGB, *cvRGBprev, *cvRGBout;
-  IplImage            *cvGrey;
-  IplImage            *cvGreyPrev;
+  IplImage            *cvRGB, *cvRGBout;
+  IplImage            *cvGrey;              // current frame, a slot of the ring in pyrlk_ctx
+  struct pyrlk_context *pyrlk_ctx;
+
+  CvPoint2D32f        *cornersA, *cornersB;
+  char                *corners_found;
+  float               *corners_error;
   IplImage            *cvEdgeImage;
   IplImage            *cvEdgeImage2;
 
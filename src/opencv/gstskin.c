@@ -24,12 +24,16 @@ enum {
 	PROP_ENABLE,
 	PROP_DISPLAY,
         PROP_METHOD,
+	PROP_ADAPTIVE,
 	PROP_LAST
 };
 
 #define METHOD_HSV 0
 #define METHOD_RGB 1
 
+#define SKIN_MAX_BLOBS      64
+#define SKIN_MIN_BLOB_AREA  9      // what a 3x3 erosion would have wiped out
+
 static GstStaticPadTemplate gst_skin_src_template = GST_STATIC_PAD_TEMPLATE (
 		"src",
 		GST_PAD_SRC,
@@ -72,6 +76,11 @@ GST_BOILERPLATE (GstSkin, gst_skin, GstVideoFilter, GST_TYPE_VIDEO_FILTER);
 void CleanSkin(GstSkin *skin) 
 {
   if (skin->cvRGB)  cvReleaseImageHeader(&skin->cvRGB);
+  if (skin->lut)    skinlut_destroy(skin->lut);
+  if (skin->morph_kernel) cvReleaseStructuringElement(&skin->morph_kernel);
+  if (skin->blobs)  blobstats_destroy(skin->blobs);
+  skin->lut = NULL;
+  skin->blobs = NULL;
 }
 
 static void gst_skin_base_init(gpointer g_class) 
@@ -123,6 +132,10 @@ static void gst_skin_class_init(GstSkinClass * klass)
                                     "method", "Method to use, meaning thresholds (0-HSV; 1-RGB)",
                                     "Method to use, meaning thresholds (0-HSV; 1-RGB)", 0, 1, 1, 
                                     (GParamFlags)(G_PARAM_READWRITE)));
+  g_object_class_install_property(gobject_class, PROP_ADAPTIVE, 
+                                  g_param_spec_boolean("adaptive", "Adaptive",
+                                  "Adapt the skin colour table to the model learned by a facetracker (learnskin=true)", 
+                                  FALSE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   btrans_class->passthrough_on_same_caps = TRUE;
   //btrans_class->always_in_place = TRUE;
@@ -137,6 +150,11 @@ static void gst_skin_init(GstSkin * skin, GstSkinClass * klass)
   gst_base_transform_set_in_place((GstBaseTransform *)skin, TRUE);
   g_static_mutex_init(&skin->lock);
   skin->cvRGB     = NULL;
+  skin->lut       = NULL;
+  skin->morph_kernel = NULL;
+  skin->blobs     = NULL;
+  skin->model     = (t_skinlut_model*)g_malloc0(sizeof(t_skinlut_model));
+  skin->adaptive  = false;
 
   skin->display    = false;
   skin->enableskin = true;
@@ -152,6 +170,7 @@ static void gst_skin_finalize(GObject * object)
   
   GST_SKIN_LOCK (skin);
   CleanSkin(skin);
+  g_free(skin->model);
   GST_SKIN_UNLOCK (skin);
   GST_INFO("Skin destroyed (%s).", GST_OBJECT_NAME(object));
   
@@ -184,6 +203,9 @@ static void gst_skin_set_property(GObject * object, guint prop_id, const GValue
   case PROP_METHOD:
     skin->method = g_value_get_int(value);
     break;
+  case PROP_ADAPTIVE:
+    skin->adaptive = g_value_get_boolean(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -214,6 +236,9 @@ static void gst_skin_get_property(GObject * object, guint prop_id, GValue * valu
   case PROP_METHOD:
     g_value_set_int(value, skin->method);
     break;  
+  case PROP_ADAPTIVE:
+    g_value_set_boolean(value, skin->adaptive);
+    break;  
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -271,6 +296,16 @@ static gboolean gst_skin_set_caps(GstBaseTransform * btrans, GstCaps * incaps, G
   skin->ch3    = cvCreateImage(size, IPL_DEPTH_8U, 1);
   skin->chA    = cvCreateImage(size, IPL_DEPTH_8U, 1);
 
+  //////////////////////////////////////////////////////////////////////////////
+  // the colour table is built once, input is RGBA in memory order /////////////
+  if( !skin->lut )
+    skin->lut = skinlut_create(skin->method, SKINLUT_INPUT_RGB, NULL);
+  if( !skin->morph_kernel )
+    skin->morph_kernel = cvCreateStructuringElementEx(3,3, 1,1, CV_SHAPE_RECT,NULL);
+  if( skin->blobs )
+    blobstats_destroy(skin->blobs);
+  skin->blobs = blobstats_create(skin->width, skin->height, SKIN_MAX_BLOBS);
+
   GST_INFO("Skin initialized.");
   
   GST_SKIN_UNLOCK (skin);
@@ -288,40 +323,69 @@ static GstFlowReturn gst_skin_transform_ip(GstBaseTransform * btrans, GstBuffer
 
   GST_SKIN_LOCK (skin);
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Image preprocessing: color space conversion etc
-  // get image data from the input, which is BGR/RGB
   skin->cvRGBA->imageData = (char*)GST_BUFFER_DATA(gstbuf);
-  cvCvtColor(skin->cvRGBA, skin->cvRGB, CV_BGRA2BGR);
 
-  //////////////////////////////////////////////////////////////////////////////
-  // here goes the bussiness logic
-  //////////////////////////////////////////////////////////////////////////////
-  ///////////// SKIN COLOUR BLOB FACE DETECTION/////////////////////////////////
-  //////////////////////////////////////////////////////////////////////////////
-  if( skin->enableskin ) 
-  {                                                            
-    int display = 1;                                           
-    if( METHOD_HSV == skin->method ){ // HSV
-      gstskin_find_skin_center_of_mass( skin, display); 
+  if( skin->enableskin && !(skin->showH || skin->showS || skin->showV) )
+  {
+    ////////////////////////////////////////////////////////////////////////////
+    // one look up per pixel, directly on the packed RGBA input
+    if( skin->lut->method != skin->method )
+      skinlut_rebuild(skin->lut, skin->method, NULL);
+    // follow the learned model, if any, a slice of the table per frame
+    if( skin->adaptive ){
+      skinlut_model_fetch(skin->model);
+      skinlut_learn(skin->lut, skin->model, SKINLUT_LEARN_RATE, SKINLUT_LEARN_BUDGET);
     }
-    else if( METHOD_RGB == skin->method ){ // RGB
-      gstskin_find_skin_center_of_mass2( skin, display); 
-    }
-  }                                         
-  //////////////////////////////////////////////////////////////////////////////
-  // After this we have a RGB Black and white image with the skin, in skin->cvRGB
-  // Just copy one channel of the RGB skin, which anyway has just values 255 or 0
-  // and save it for later
-  cvSplit(skin->cvRGB, skin->chA, NULL, NULL, NULL);
+    skinlut_classify(skin->lut, skin->width, skin->height,
+                     (unsigned char*)skin->cvRGBA->imageData, skin->cvRGBA->widthStep, 4,
+                     (unsigned char*)skin->chA->imageData, skin->chA->widthStep, 1,
+                     128, NULL);
+  }
+  else
+  {
+    ////////////////////////////////////////////////////////////////////////////
+    // Image preprocessing: color space conversion etc
+    // get image data from the input, which is BGR/RGB
+    cvCvtColor(skin->cvRGBA, skin->cvRGB, CV_BGRA2BGR);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // the per-plane threshold versions are only kept to show the H/S/V planes
+    if( skin->enableskin ) 
+    {                                                            
+      int display = 1;                                           
+      if( METHOD_HSV == skin->method ){ // HSV
+        gstskin_find_skin_center_of_mass( skin, display); 
+      }
+      else if( METHOD_RGB == skin->method ){ // RGB
+        gstskin_find_skin_center_of_mass2( skin, display); 
+      }
+    }                                         
+    ////////////////////////////////////////////////////////////////////////////
+    // After this we have a RGB Black and white image with the skin, in skin->cvRGB
+    // Just copy one channel of the RGB skin, which anyway has just values 255 or 0
+    cvSplit(skin->cvRGB, skin->chA, NULL, NULL, NULL);
+  }
 
-  cvErode( skin->chA, skin->chA, cvCreateStructuringElementEx(3,3, 1,1, CV_SHAPE_RECT,NULL), 1);
-  cvDilate(skin->chA, skin->chA, cvCreateStructuringElementEx(3,3, 1,1, CV_SHAPE_RECT,NULL), 2);
-  cvErode( skin->chA, skin->chA, cvCreateStructuringElementEx(3,3, 1,1, CV_SHAPE_RECT,NULL), 1);
+  //////////////////////////////////////////////////////////////////////////////
+  // label the skin blobs: the speckles are dropped from the mask, instead of
+  // eroding it, and the position reported is that of the largest blob
+  blobstats_label(skin->blobs, (unsigned char*)skin->chA->imageData, skin->chA->widthStep, 1,
+                  0, BLOBSTATS_CONNECT8, SKIN_MIN_BLOB_AREA);
+  blobstats_paint(skin->blobs, (unsigned char*)skin->chA->imageData, skin->chA->widthStep, 1);
+  int largest = blobstats_largest(skin->blobs);
+  if( largest >= 0 ){
+    const t_blob *blob = &skin->blobs->blobs[largest];
+    skin->x = blob->cx;
+    skin->y = blob->cy;
+    skin->w = (float)(blob->x1 - blob->x0 + 1);
+  }
+  // close the small gaps left between neighbouring skin patches
+  cvDilate(skin->chA, skin->chA, skin->morph_kernel, 1);
+  cvErode( skin->chA, skin->chA, skin->morph_kernel, 1);
 
   // copy the skin output to the alpha channel in the output image
-  cvSplit(skin->cvRGBA, skin->ch1, skin->ch2, skin->ch3, NULL);
-  cvMerge(skin->ch1, skin->ch2, skin->ch3, skin->chA,    skin->cvRGBA);
+  const int from_to[] = { 0, 3 };
+  cvMixChannels((const CvArr**)&skin->chA, 1, (CvArr**)&skin->cvRGBA, 1, from_to, 1);
  
   //////////////////////////////////////////////////////////////////////////////
   // if we want to display, just overwrite the output
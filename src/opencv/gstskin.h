@@ -9,6 +9,8 @@
 #include <gst/video/gstvideofilter.h>
 
 #include <opencv/cv.h>
+#include "skinlut.h"
+#include "blobstats.h"
 //#include <opencv/highgui.h>
 
 G_BEGIN_DECLS
@@ -47,6 +49,11 @@ struct _GstSkin {
   IplImage* ch3;
   IplImage* chA;
 
+  t_skinlut*     lut;          // colour -> skin probability table
+  t_skinlut_model* model;      // learned model followed if adaptive
+  bool           adaptive;
+  IplConvKernel* morph_kernel; // 3x3 kernel for the mask clean up
+  t_blobstats*   blobs;        // skin blobs of the last frame
 };
 
 struct _GstSkinClass {
@@ -0,0 +1,290 @@
+
+#include "haarpyramid.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+//////////////////////////////////////////////////////////////////////////////
+t_haarpyramid* haarpyramid_create(double scale_factor)
+{
+  t_haarpyramid *pyr = (t_haarpyramid*)calloc(1, sizeof(t_haarpyramid));
+  if( !pyr )
+    return NULL;
+  pyr->scale_factor = (scale_factor > 1.0) ? scale_factor : 1.1;
+  return pyr;
+}
+
+static void haarpyramid_free_levels(t_haarpyramid *pyr)
+{
+  int i;
+  for( i = 0; i < pyr->nlevels; i++ ){
+    t_haarlevel *l = &pyr->levels[i];
+    if( l->gray != pyr->gray )
+      cvReleaseImage(&l->gray);
+    cvReleaseMat(&l->sum);
+    cvReleaseMat(&l->sqsum);
+    if( l->tilted )
+      cvReleaseMat(&l->tilted);
+  }
+  pyr->nlevels = 0;
+  if( pyr->gray )
+    cvReleaseImage(&pyr->gray);
+}
+
+void haarscan_release(t_haarscan *scan)
+{
+  free(scan->hits);
+  free(scan->label);
+  free(scan->objects);
+  free(scan->neighbors);
+  memset(scan, 0, sizeof(t_haarscan));
+}
+
+void haarpyramid_destroy(t_haarpyramid *pyr)
+{
+  haarpyramid_free_levels(pyr);
+  haarscan_release(&pyr->scan);
+  free(pyr);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void haarpyramid_set_frame(t_haarpyramid *pyr, const IplImage *img, int code, int equalize)
+{
+  if( img->width != pyr->width || img->height != pyr->height ){
+    double factor = 1.0;
+    haarpyramid_free_levels(pyr);
+    pyr->width  = img->width;
+    pyr->height = img->height;
+    pyr->gray   = cvCreateImage(cvGetSize(img), IPL_DEPTH_8U, 1);
+
+    // down to levels too small for any cascade window
+    while( pyr->nlevels < HAARPYRAMID_MAX_LEVELS ){
+      const CvSize size = cvSize(cvRound(pyr->width / factor), cvRound(pyr->height / factor));
+      if( size.width < 8 || size.height < 8 )
+        break;
+      t_haarlevel *l = &pyr->levels[pyr->nlevels++];
+      l->factor = factor;
+      l->gray   = (pyr->nlevels == 1) ? pyr->gray : cvCreateImage(size, IPL_DEPTH_8U, 1);
+      l->sum    = cvCreateMat(size.height + 1, size.width + 1, CV_32SC1);
+      l->sqsum  = cvCreateMat(size.height + 1, size.width + 1, CV_64FC1);
+      l->tilted = NULL;
+      l->built  = l->built_tilted = 0;
+      factor *= pyr->scale_factor;
+    }
+  }
+
+  if( img->nChannels == 1 )
+    cvCopy(img, pyr->gray, NULL);
+  else
+    cvCvtColor(img, pyr->gray, code);
+  if( equalize )
+    cvEqualizeHist(pyr->gray, pyr->gray);
+  pyr->serial++;
+}
+
+// downscaled image and integral images of a level, for the current frame
+static void haarpyramid_build(t_haarpyramid *pyr, t_haarlevel *l, int tilted)
+{
+  if( tilted && !l->tilted )
+    l->tilted = cvCreateMat(l->sum->rows, l->sum->cols, CV_32SC1);
+
+  if( l->built != pyr->serial ){
+    if( l->gray != pyr->gray )
+      cvResize(pyr->gray, l->gray, CV_INTER_LINEAR);
+    cvIntegral(l->gray, l->sum, l->sqsum, tilted ? l->tilted : NULL);
+    l->built = pyr->serial;
+    l->built_tilted = tilted ? pyr->serial : 0;
+  }
+  else if( tilted && l->built_tilted != pyr->serial ){
+    cvIntegral(l->gray, l->sum, l->sqsum, l->tilted);
+    l->built_tilted = pyr->serial;
+  }
+}
+
+static int haarpyramid_has_tilted(const CvHaarClassifierCascade *cascade)
+{
+  int i, j, k;
+  for( i = 0; i < cascade->count; i++ )
+    for( j = 0; j < cascade->stage_classifier[i].count; j++ ){
+      const CvHaarClassifier *c = &cascade->stage_classifier[i].classifier[j];
+      for( k = 0; k < c->count; k++ )
+        if( c->haar_feature[k].tilted )
+          return 1;
+    }
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// grouping of the hits, same rules as cv::groupRectangles()
+static int haarpyramid_similar(const CvRect *a, const CvRect *b)
+{
+  const double delta = HAARPYRAMID_GROUP_EPS *
+    (MIN(a->width, b->width) + MIN(a->height, b->height)) * 0.5;
+  return abs(a->x - b->x) <= delta && abs(a->y - b->y) <= delta &&
+         abs(a->x + a->width - b->x - b->width) <= delta &&
+         abs(a->y + a->height - b->y - b->height) <= delta;
+}
+
+static inline int haarpyramid_find(int *label, int i)
+{
+  while( label[i] != i ){
+    label[i] = label[label[i]];
+    i = label[i];
+  }
+  return i;
+}
+
+static int haarpyramid_group(t_haarscan *scan, int nhits, int min_neighbors)
+{
+  CvRect *hits = scan->hits, *obj = scan->objects;
+  int    *label = scan->label, *nb = scan->neighbors;
+  int     i, j, nclasses = 0;
+
+  scan->nobjects = 0;
+  if( min_neighbors <= 0 ){
+    memcpy(obj, hits, nhits * sizeof(CvRect));
+    memset(nb, 0, nhits * sizeof(int));
+    return scan->nobjects = nhits;
+  }
+
+  for( i = 0; i < nhits; i++ ){
+    label[i] = i;
+    for( j = 0; j < i; j++ ){
+      if( !haarpyramid_similar(&hits[i], &hits[j]) )
+        continue;
+      const int a = haarpyramid_find(label, i), b = haarpyramid_find(label, j);
+      if( a < b )      label[b] = a;
+      else if( b < a ) label[a] = b;
+    }
+  }
+
+  // sums per class, on the slot of its root
+  memset(obj, 0, nhits * sizeof(CvRect));
+  memset(nb, 0, nhits * sizeof(int));
+  for( i = 0; i < nhits; i++ ){
+    const int r = haarpyramid_find(label, i);
+    obj[r].x += hits[i].x;           obj[r].y += hits[i].y;
+    obj[r].width += hits[i].width;   obj[r].height += hits[i].height;
+    nb[r]++;
+  }
+
+  // average of the classes with enough hits, into hits/label as scratch
+  for( i = 0; i < nhits; i++ ){
+    if( nb[i] <= min_neighbors )
+      continue;
+    const double s = 1.0 / nb[i];
+    hits[nclasses] = cvRect(cvRound(obj[i].x * s), cvRound(obj[i].y * s),
+                            cvRound(obj[i].width * s), cvRound(obj[i].height * s));
+    label[nclasses++] = nb[i];
+  }
+
+  // drop the objects inside a larger one with more neighbours
+  for( i = 0; i < nclasses; i++ ){
+    const CvRect *r1 = &hits[i];
+    const int     n1 = label[i];
+    for( j = 0; j < nclasses; j++ ){
+      const CvRect *r2 = &hits[j];
+      const int     n2 = label[j];
+      const int     dx = cvRound(r2->width * HAARPYRAMID_GROUP_EPS);
+      const int     dy = cvRound(r2->height * HAARPYRAMID_GROUP_EPS);
+      if( i != j && r1->x >= r2->x - dx && r1->y >= r2->y - dy &&
+          r1->x + r1->width <= r2->x + r2->width + dx &&
+          r1->y + r1->height <= r2->y + r2->height + dy &&
+          (n2 > MAX(3, n1) || n1 < 3) )
+        break;
+    }
+    if( j == nclasses ){
+      obj[scan->nobjects] = *r1;
+      nb[scan->nobjects++] = n1;
+    }
+  }
+  return scan->nobjects;
+}
+
+static int haarpyramid_grow(t_haarscan *scan)
+{
+  const int n = scan->max_hits ? 2 * scan->max_hits : 256;
+  CvRect *hits = (CvRect*)realloc(scan->hits, n * sizeof(CvRect));
+  if( hits ) scan->hits = hits;
+  int *label = (int*)realloc(scan->label, n * sizeof(int));
+  if( label ) scan->label = label;
+  CvRect *obj = (CvRect*)realloc(scan->objects, n * sizeof(CvRect));
+  if( obj ) scan->objects = obj;
+  int *nb = (int*)realloc(scan->neighbors, n * sizeof(int));
+  if( nb ) scan->neighbors = nb;
+  if( !hits || !label || !obj || !nb )
+    return 0;
+  scan->max_hits = n;
+  return 1;
+}
+
+// window of the cascade on a level: 1 to scan it, 0 to skip it, -1 if it and
+// all the coarser levels are out of the sizes
+static int haarpyramid_level_used(const t_haarlevel *l, CvSize win0, CvSize min_size, CvSize max_size)
+{
+  const CvSize win = cvSize(cvRound(win0.width * l->factor), cvRound(win0.height * l->factor));
+  if( l->gray->width < win0.width || l->gray->height < win0.height )
+    return -1;
+  if( max_size.width > 0 && (win.width > max_size.width || win.height > max_size.height) )
+    return -1;
+  if( win.width < min_size.width || win.height < min_size.height )
+    return 0;
+  return 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void haarpyramid_prepare(t_haarpyramid *pyr, CvHaarClassifierCascade *cascade,
+                         CvSize min_size, CvSize max_size)
+{
+  const int tilted = haarpyramid_has_tilted(cascade);
+  int i, used;
+
+  for( i = 0; i < pyr->nlevels; i++ ){
+    t_haarlevel *l = &pyr->levels[i];
+    if( (used = haarpyramid_level_used(l, cascade->orig_window_size, min_size, max_size)) < 0 )
+      break;
+    if( used )
+      haarpyramid_build(pyr, l, tilted);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int haarpyramid_detect_scan(t_haarpyramid *pyr, t_haarscan *scan, CvHaarClassifierCascade *cascade,
+                            int min_neighbors, CvSize min_size, CvSize max_size)
+{
+  const CvSize win0   = cascade->orig_window_size;
+  const int    tilted = haarpyramid_has_tilted(cascade);
+  int nhits = 0;
+  int i, x, y, used;
+
+  for( i = 0; i < pyr->nlevels; i++ ){
+    t_haarlevel *l = &pyr->levels[i];
+    if( (used = haarpyramid_level_used(l, win0, min_size, max_size)) < 0 )
+      break;
+    if( !used )
+      continue;
+    const CvSize win = cvSize(cvRound(win0.width * l->factor), cvRound(win0.height * l->factor));
+    const int xmax = l->gray->width - win0.width, ymax = l->gray->height - win0.height;
+
+    haarpyramid_build(pyr, l, tilted);
+    cvSetImagesForHaarClassifierCascade(cascade, l->sum, l->sqsum, tilted ? l->tilted : NULL, 1.0);
+
+    // denser scan on the finer levels, as cvHaarDetectObjects()
+    const int step = (l->factor > 2.0) ? 1 : 2;
+    for( y = 0; y <= ymax; y += step )
+      for( x = 0; x <= xmax; x += step ){
+        if( cvRunHaarClassifierCascade(cascade, cvPoint(x, y), 0) <= 0 )
+          continue;
+        if( nhits == scan->max_hits && !haarpyramid_grow(scan) )
+          return haarpyramid_group(scan, nhits, min_neighbors);
+        scan->hits[nhits++] = cvRect(cvRound(x * l->factor), cvRound(y * l->factor), win.width, win.height);
+      }
+  }
+  return haarpyramid_group(scan, nhits, min_neighbors);
+}
+
+int haarpyramid_detect(t_haarpyramid *pyr, CvHaarClassifierCascade *cascade, int min_neighbors,
+                       CvSize min_size, CvSize max_size)
+{
+  return haarpyramid_detect_scan(pyr, &pyr->scan, cascade, min_neighbors, min_size, max_size);
+}
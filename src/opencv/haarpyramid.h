@@ -0,0 +1,94 @@
+#ifndef __HAARPYRAMID_H__
+#define __HAARPYRAMID_H__
+
+#include <opencv/cv.h>
+
+//////////////////////////////////////////////////////////////////////////////
+/// Image pyramid and integral images shared by the Haar cascades run on a frame.
+///
+/// cvHaarDetectObjects() converts the frame to grey and computes its integral
+/// images again on every call, so a face, a profile and a torso cascade on the
+/// same frame pay for them three times. Here the grey frame is set once per
+/// frame, and every level of the pyramid (the frame downscaled by
+/// scale_factor^i, with its sum, squared sum and, only if a cascade has tilted
+/// features, tilted integral images) is built by the first cascade scanning it;
+/// the next cascades just run their classifier on it. The scan and grouping are
+/// those of the CV_HAAR_SCALE_IMAGE mode of cvHaarDetectObjects(). All buffers
+/// are allocated once for a given frame size. Used by the facetracker,
+/// facetracker3 and facedetector elements.
+///
+/// Several cascades can scan a pyramid at the same time, each with its own
+/// t_haarscan, once haarpyramid_prepare() has built the levels for all of them:
+/// the scan then only reads the levels.
+//////////////////////////////////////////////////////////////////////////////
+
+#define HAARPYRAMID_MAX_LEVELS   64
+#define HAARPYRAMID_GROUP_EPS    0.2       // same as cvHaarDetectObjects()
+
+
+typedef struct {
+  double    factor;                // level size = frame size / factor
+  IplImage *gray;                  // the frame grey itself on level 0
+  CvMat    *sum, *sqsum, *tilted;  // tilted is NULL until needed
+  int       built, built_tilted;   // serial of the frame they hold
+} t_haarlevel;
+
+// scan scratch and output of a detection
+typedef struct {
+  CvRect      *hits;
+  int         *label;
+  int          max_hits;
+  CvRect      *objects;
+  int         *neighbors;
+  int          nobjects;
+} t_haarscan;
+
+typedef struct {
+  int          width, height;
+  double       scale_factor;
+  IplImage    *gray;
+  int          serial;             // incremented by every haarpyramid_set_frame()
+  int          nlevels;
+  t_haarlevel  levels[HAARPYRAMID_MAX_LEVELS];
+  t_haarscan   scan;               // of haarpyramid_detect()
+} t_haarpyramid;
+
+
+t_haarpyramid* haarpyramid_create(double scale_factor);
+void           haarpyramid_destroy(t_haarpyramid *pyr);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function haarpyramid_set_frame
+/// \param[in] img: 8 bit frame, 1 or 3 channels
+/// \param[in] code: colour conversion to grey of a 3 channel frame (e.g.
+///            CV_BGR2GRAY), ignored for 1 channel
+/// \param[in] equalize: equalise the histogram of the grey frame
+/// Reallocates only if the frame size changed. The levels are not rebuilt
+/// here but by the first haarpyramid_detect() needing them.
+void haarpyramid_set_frame(t_haarpyramid *pyr, const IplImage *img, int code, int equalize);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function haarpyramid_detect
+/// Scans the levels where the cascade window is min_size to max_size (0 = no
+/// limit) on the frame and groups the hits with at least min_neighbors
+/// neighbours (0 = no grouping), like cvHaarDetectObjects() would.
+/// \return number of objects, in frame coordinates in pyr->scan.objects,
+///         valid until the next call
+int  haarpyramid_detect(t_haarpyramid *pyr, CvHaarClassifierCascade *cascade, int min_neighbors,
+                        CvSize min_size, CvSize max_size);
+
+/// same, into the caller's scan (zeroed before its first use)
+int  haarpyramid_detect_scan(t_haarpyramid *pyr, t_haarscan *scan, CvHaarClassifierCascade *cascade,
+                             int min_neighbors, CvSize min_size, CvSize max_size);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function haarpyramid_prepare
+/// Builds now the levels haarpyramid_detect() would scan for this cascade and
+/// sizes. Called for every cascade of a frame before they scan concurrently,
+/// since they share the levels and a level is otherwise built by its first scan.
+void haarpyramid_prepare(t_haarpyramid *pyr, CvHaarClassifierCascade *cascade,
+                         CvSize min_size, CvSize max_size);
+
+void haarscan_release(t_haarscan *scan);
+
+#endif // __HAARPYRAMID_H__
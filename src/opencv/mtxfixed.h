@@ -0,0 +1,156 @@
+#ifndef __MTXFIXED_H__
+#define __MTXFIXED_H__
+
+#include <string.h>
+#include <math.h>
+
+//////////////////////////////////////////////////////////////////////////////
+/// Small matrix routines with the dimensions known at compile time.
+///
+/// The Kalman filters of the trackers work on 3x3 to 6x6 float matrices, row
+/// major as in mtxcore. With the sizes as template arguments every loop has a
+/// constant trip count the compiler unrolls and vectorises, the temporaries
+/// live on the stack, and the symmetric positive definite innovation matrices
+/// are inverted in closed form (3x3) or by Cholesky (any size) in double,
+/// instead of by a generic LU. Nothing here allocates. Used by the facetracker
+/// Kalman (kalman.cpp) and the facetracker3 kernel Kalman.
+//////////////////////////////////////////////////////////////////////////////
+
+// a[M,P] = b[M,N] * c[N,P]
+template <unsigned int M, unsigned int N, unsigned int P>
+static inline void mtxf_multiply(float *a, const float *b, const float *c)
+{
+  for( unsigned int i = 0; i < M; i++ )
+    for( unsigned int j = 0; j < P; j++ ){
+      float s = 0;
+      for( unsigned int k = 0; k < N; k++ )
+        s += b[i * N + k] * c[k * P + j];
+      a[i * P + j] = s;
+    }
+}
+
+// a[M,P] = (b[N,M])' * c[N,P]
+template <unsigned int M, unsigned int N, unsigned int P>
+static inline void mtxf_multiply_bt(float *a, const float *b, const float *c)
+{
+  for( unsigned int i = 0; i < M; i++ )
+    for( unsigned int j = 0; j < P; j++ ){
+      float s = 0;
+      for( unsigned int k = 0; k < N; k++ )
+        s += b[k * M + i] * c[k * P + j];
+      a[i * P + j] = s;
+    }
+}
+
+// a[M,P] = b[M,N] * (c[P,N])'
+template <unsigned int M, unsigned int N, unsigned int P>
+static inline void mtxf_multiply_ct(float *a, const float *b, const float *c)
+{
+  for( unsigned int i = 0; i < M; i++ )
+    for( unsigned int j = 0; j < P; j++ ){
+      float s = 0;
+      for( unsigned int k = 0; k < N; k++ )
+        s += b[i * N + k] * c[j * N + k];
+      a[i * P + j] = s;
+    }
+}
+
+// a[N] = b[N] + c[N], may be in place
+template <unsigned int N>
+static inline void mtxf_add(float *a, const float *b, const float *c)
+{
+  for( unsigned int i = 0; i < N; i++ )
+    a[i] = b[i] + c[i];
+}
+
+// a[N] = b[N] - c[N], may be in place
+template <unsigned int N>
+static inline void mtxf_sub(float *a, const float *b, const float *c)
+{
+  for( unsigned int i = 0; i < N; i++ )
+    a[i] = b[i] - c[i];
+}
+
+template <unsigned int N>
+static inline float mtxf_dot(const float *a, const float *b)
+{
+  float s = 0;
+  for( unsigned int i = 0; i < N; i++ )
+    s += a[i] * b[i];
+  return s;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function mtxf_invert_spd
+/// a[N,N] = inv(b[N,N]) for b symmetric positive definite, by Cholesky
+/// \return 0 (a untouched) if b is not positive definite
+template <unsigned int N>
+static inline int mtxf_invert_spd(float *a, const float *b)
+{
+  double l[N * N], li[N * N];
+  unsigned int i, j, k;
+
+  // b = l.l', l lower triangular
+  memset(l, 0, sizeof(l));
+  for( j = 0; j < N; j++ ){
+    double d = b[j * N + j];
+    for( k = 0; k < j; k++ )
+      d -= l[j * N + k] * l[j * N + k];
+    if( d <= 0 )
+      return 0;
+    l[j * N + j] = sqrt(d);
+    for( i = j + 1; i < N; i++ ){
+      double s = b[i * N + j];
+      for( k = 0; k < j; k++ )
+        s -= l[i * N + k] * l[j * N + k];
+      l[i * N + j] = s / l[j * N + j];
+    }
+  }
+
+  // li = inv(l), lower triangular too
+  memset(li, 0, sizeof(li));
+  for( j = 0; j < N; j++ ){
+    li[j * N + j] = 1.0 / l[j * N + j];
+    for( i = j + 1; i < N; i++ ){
+      double s = 0;
+      for( k = j; k < i; k++ )
+        s -= l[i * N + k] * li[k * N + j];
+      li[i * N + j] = s / l[i * N + i];
+    }
+  }
+
+  // inv(b) = li'.li, symmetric
+  for( i = 0; i < N; i++ )
+    for( j = i; j < N; j++ ){
+      double s = 0;
+      for( k = j; k < N; k++ )
+        s += li[k * N + i] * li[k * N + j];
+      a[i * N + j] = a[j * N + i] = (float)s;
+    }
+  return 1;
+}
+
+// closed form for the 3x3 innovation of the facetracker
+template <>
+inline int mtxf_invert_spd<3>(float *a, const float *b)
+{
+  const double c00 = (double)b[4] * b[8] - (double)b[5] * b[7];
+  const double c01 = (double)b[5] * b[6] - (double)b[3] * b[8];
+  const double c02 = (double)b[3] * b[7] - (double)b[4] * b[6];
+  const double det = b[0] * c00 + b[1] * c01 + b[2] * c02;
+  if( det <= 0 )
+    return 0;
+  const double id = 1.0 / det;
+  a[0] = (float)(c00 * id);
+  a[1] = (float)((b[2] * (double)b[7] - b[1] * (double)b[8]) * id);
+  a[2] = (float)((b[1] * (double)b[5] - b[2] * (double)b[4]) * id);
+  a[3] = (float)(c01 * id);
+  a[4] = (float)((b[0] * (double)b[8] - b[2] * (double)b[6]) * id);
+  a[5] = (float)((b[2] * (double)b[3] - b[0] * (double)b[5]) * id);
+  a[6] = (float)(c02 * id);
+  a[7] = (float)((b[1] * (double)b[6] - b[0] * (double)b[7]) * id);
+  a[8] = (float)((b[0] * (double)b[4] - b[1] * (double)b[3]) * id);
+  return 1;
+}
+
+#endif // __MTXFIXED_H__
@@ -3,6 +3,7 @@
 
 #include "opencv_functions.h"
 #include <stdio.h>  //printf
+#include <stdlib.h> //malloc
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -51,11 +52,94 @@ int calculate_pyrlk(IplImage *inputimage, IplImage *inputimage2, int num_vertexe
                           cvSize( win_size, win_size ), 5, vertexes_found, vertexes_error,
                           cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.3 ), 0 );
 
+  cvReleaseImage( &eig_image );
+  cvReleaseImage( &tmp_image );
+  cvReleaseImage( &pyrA );
+  cvReleaseImage( &pyrB );
   return(corner_count);
 }
 
 
 
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+/// \function pyrlk_context_create
+/// \param[in]  size: size of the frames to be tracked
+/// All the images needed per frame are allocated here, once. The pyramid
+/// buffers follow cvCalcOpticalFlowPyrLK: (width+8)*height/3 bytes at least.
+///
+struct pyrlk_context* pyrlk_context_create(CvSize size)
+{
+  struct pyrlk_context *ctx = (struct pyrlk_context*)malloc(sizeof(struct pyrlk_context));
+  CvSize pyr_sz = cvSize( size.width+8, size.height/3 + 1 );
+
+  for( int i=0; i < PYRLK_RING; i++ ){
+    ctx->grey[i] = cvCreateImage( size, IPL_DEPTH_8U, 1 );
+    ctx->pyr[i]  = cvCreateImage( pyr_sz, IPL_DEPTH_8U, 1 );
+  }
+  ctx->eig    = cvCreateImage( size, IPL_DEPTH_32F, 1 );
+  ctx->tmp    = cvCreateImage( size, IPL_DEPTH_32F, 1 );
+  ctx->cur    = 0;
+  ctx->frames = 0;
+  return ctx;
+}
+
+void pyrlk_context_release(struct pyrlk_context **ctx)
+{
+  if( !*ctx )
+    return;
+  for( int i=0; i < PYRLK_RING; i++ ){
+    cvReleaseImage( &(*ctx)->grey[i] );
+    cvReleaseImage( &(*ctx)->pyr[i] );
+  }
+  cvReleaseImage( &(*ctx)->eig );
+  cvReleaseImage( &(*ctx)->tmp );
+  free( *ctx );
+  *ctx = NULL;
+}
+
+IplImage* pyrlk_context_frame(struct pyrlk_context *ctx)
+{
+  return ctx->grey[ ctx->cur ];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function pyrlk_context_track
+/// Same as calculate_pyrlk() between the previous and the current frame of the
+/// context, but without any allocation: the pyramid of the previous frame was
+/// built in the previous call and is flagged CV_LKFLOW_PYR_A_READY, so only the
+/// pyramid of the current frame is computed. The very first frame is tracked
+/// against itself. Afterwards the current slot becomes the previous one.
+///
+int pyrlk_context_track(struct pyrlk_context *ctx, int num_vertexes, 
+                        CvPoint2D32f* vertexesA, char *vertexes_found, float *vertexes_error, 
+                        CvPoint2D32f* vertexesB)
+{
+  const int prev = (ctx->cur + PYRLK_RING - 1) % PYRLK_RING;
+  int win_size = 15;
+  int flags = 0;
+
+  if( ctx->frames == 0 )
+    cvCopy( ctx->grey[ctx->cur], ctx->grey[prev], NULL );
+  else
+    flags |= CV_LKFLOW_PYR_A_READY;
+
+  int corner_count = num_vertexes;
+  // good features to track are taken from the Grey image in t (not in t+1 )
+  cvGoodFeaturesToTrack( ctx->grey[prev], ctx->eig, ctx->tmp, vertexesA, &corner_count,
+                         0.05, 1.0, 0, 3, 0, 0.04 );
+
+  cvCalcOpticalFlowPyrLK( ctx->grey[prev], ctx->grey[ctx->cur], ctx->pyr[prev], ctx->pyr[ctx->cur],
+                          vertexesA, vertexesB, corner_count, 
+                          cvSize( win_size, win_size ), 5, vertexes_found, vertexes_error,
+                          cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.3 ), flags );
+
+  ctx->cur = (ctx->cur + 1) % PYRLK_RING;
+  ctx->frames++;
+  return(corner_count);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
@@ -10,6 +10,28 @@ struct bbox{
 int calculate_pyrlk(IplImage *inputimage, IplImage *inputimage2, int num_vertexes, 
                     CvPoint2D32f* vertexesA, char *vertexes_found, float *vertexes_error, 
                     CvPoint2D32f* vertexesB);
+
+// Preallocated state for tracking along a video: a ring with the grey image
+// and the pyramid of the previous and the current frame, plus the scratch
+// images of the feature detector. The pyramid of frame N, built while tracking
+// N-1 -> N, is reused as is when tracking N -> N+1.
+#define PYRLK_RING 2
+struct pyrlk_context{
+  IplImage *grey[PYRLK_RING];
+  IplImage *pyr[PYRLK_RING];
+  IplImage *eig, *tmp;
+  int       cur;              // slot of the current frame
+  int       frames;           // frames seen, the first has no previous one
+};
+
+struct pyrlk_context* pyrlk_context_create(CvSize size);
+void      pyrlk_context_release(struct pyrlk_context **ctx);
+// grey image where the current frame has to be written before tracking
+IplImage* pyrlk_context_frame(struct pyrlk_context *ctx);
+// tracks from the previous to the current frame, then rotates the ring
+int       pyrlk_context_track(struct pyrlk_context *ctx, int num_vertexes, 
+                              CvPoint2D32f* vertexesA, char *vertexes_found, float *vertexes_error, 
+                              CvPoint2D32f* vertexesB);
 int calc_eisemann_durand_luminance( IplImage* imgin, IplImage* imgout );
 void draw_subdiv_edge( IplImage* img, CvSubdiv2DEdge edge, CvScalar color );
 
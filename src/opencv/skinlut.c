@@ -0,0 +1,282 @@
+
+#include "skinlut.h"
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the learned model shared by all the skin consumers of the process
+static GStaticMutex    skinlut_model_lock = G_STATIC_MUTEX_INIT;
+static t_skinlut_model skinlut_model_shared;
+
+
+//////////////////////////////////////////////////////////////////////////////
+// input colour (in the memory order of the input) to RGB
+static void skinlut_to_rgb(int input, int c0, int c1, int c2, int *r, int *g, int *b)
+{
+  switch(input){
+  case SKINLUT_INPUT_BGR:
+    *r = c2; *g = c1; *b = c0;
+    break;
+  case SKINLUT_INPUT_YUV: {
+    // same coefficients as OpenCV CV_YUV2RGB
+    float y = c0, u = c1 - 128.0f, v = c2 - 128.0f;
+    float fr = y + 1.140f * v;
+    float fg = y - 0.395f * u - 0.581f * v;
+    float fb = y + 2.032f * u;
+    *r = (fr < 0) ? 0 : (fr > 255) ? 255 : (int)(fr + 0.5f);
+    *g = (fg < 0) ? 0 : (fg > 255) ? 255 : (int)(fg + 0.5f);
+    *b = (fb < 0) ? 0 : (fb > 255) ? 255 : (int)(fb + 0.5f);
+    break;
+  }
+  case SKINLUT_INPUT_RGB:
+  default:
+    *r = c0; *g = c1; *b = c2;
+    break;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// the original per-pixel rules, evaluated only when building the table
+static int skinlut_is_skin_hsv(const t_skinlut_params *p, int r, int g, int b)
+{
+  int v    = (r > g) ? ((r > b) ? r : b) : ((g > b) ? g : b);
+  int vmin = (r < g) ? ((r < b) ? r : b) : ((g < b) ? g : b);
+  int diff = v - vmin;
+  int s    = (v) ? (255 * diff + v / 2) / v : 0;
+  float h  = 0;
+
+  // OpenCV 8 bit HSV: H is halved to fit [0..180]
+  if( diff ){
+    if( v == r )      h =         60.0f * (g - b) / diff;
+    else if( v == g ) h = 120.0f + 60.0f * (b - r) / diff;
+    else              h = 240.0f + 60.0f * (r - g) / diff;
+    if( h < 0 ) h += 360.0f;
+  }
+  int h8 = (int)(h / 2.0f + 0.5f);
+
+  return (h8 > p->h_low) && (h8 < p->h_high) && (s > p->s_low) && (v > p->v_low);
+}
+
+static int skinlut_is_skin_rgb(const t_skinlut_params *p, int r, int g, int b)
+{
+  int sum = r + g + b;
+  if( sum == 0 )
+    return 0;
+  float rn = (float)r / sum;
+  float gn = (float)g / sum;
+
+  // R > 60 AND R' > 0.4 AND R' < 0.6 AND G' > 0.28 and G' < 0.4
+  return (r > p->r_low) && (rn > p->rn_low) && (rn < p->rn_high) &&
+         (gn > p->gn_low) && (gn < p->gn_high);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+void skinlut_default_params(int method, t_skinlut_params *params)
+{
+  (void)method;
+  params->h_low   = 10;
+  params->h_high  = 20;
+  params->s_low   = 48;
+  params->v_low   = 80;
+  params->r_low   = 60;
+  params->rn_low  = 0.42f;
+  params->rn_high = 0.6f;
+  params->gn_low  = 0.28f;
+  params->gn_high = 0.4f;
+}
+
+int skinlut_params_equal(const t_skinlut_params *a, const t_skinlut_params *b)
+{
+  return (a->h_low == b->h_low) && (a->h_high == b->h_high) && (a->s_low == b->s_low) &&
+         (a->v_low == b->v_low) && (a->r_low == b->r_low) && (a->rn_low == b->rn_low) &&
+         (a->rn_high == b->rn_high) && (a->gn_low == b->gn_low) && (a->gn_high == b->gn_high);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function skinlut_rebuild
+/// Every bin is sampled at 2x2x2 points inside it, the probability stored is
+/// the fraction of those classified as skin, so bins straddling a threshold get
+/// intermediate values instead of an aliased hard edge.
+void skinlut_rebuild(t_skinlut *lut, int method, const t_skinlut_params *params)
+{
+  const int binw = 256 / SKINLUT_LEVELS;
+  const int offs[2] = { binw / 4, (3 * binw) / 4 };
+  int i0, i1, i2, k;
+
+  lut->method = method;
+  if( params )
+    lut->params = *params;
+  else
+    skinlut_default_params(method, &lut->params);
+
+  for( i0 = 0; i0 < SKINLUT_LEVELS; i0++ ){
+    for( i1 = 0; i1 < SKINLUT_LEVELS; i1++ ){
+      for( i2 = 0; i2 < SKINLUT_LEVELS; i2++ ){
+        int hits = 0;
+        for( k = 0; k < 8; k++ ){
+          int r, g, b;
+          skinlut_to_rgb(lut->input, i0 * binw + offs[k & 1], i1 * binw + offs[(k >> 1) & 1],
+                         i2 * binw + offs[(k >> 2) & 1], &r, &g, &b);
+          if( method == SKINLUT_METHOD_HSV )
+            hits += skinlut_is_skin_hsv(&lut->params, r, g, b);
+          else
+            hits += skinlut_is_skin_rgb(&lut->params, r, g, b);
+        }
+        lut->table[ (i0 << (2 * SKINLUT_BITS)) | (i1 << SKINLUT_BITS) | i2 ] =
+          (unsigned char)((hits * 255 + 4) / 8);
+      }
+    }
+  }
+
+  // the thresholds are the prior, learning restarts from them
+  if( lut->acc )
+    for( k = 0; k < SKINLUT_ENTRIES; k++ )
+      lut->acc[k] = lut->table[k];
+  lut->cursor = 0;
+  lut->model_version = 0;
+}
+
+t_skinlut* skinlut_create(int method, int input, const t_skinlut_params *params)
+{
+  t_skinlut *lut = (t_skinlut*)malloc(sizeof(t_skinlut));
+  if( !lut )
+    return NULL;
+  lut->input = input;
+  lut->acc   = NULL;
+  skinlut_rebuild(lut, method, params);
+  return lut;
+}
+
+void skinlut_destroy(t_skinlut *lut)
+{
+  free(lut->acc);
+  free(lut);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int skinlut_classify(const t_skinlut *lut, int width, int height,
+                     const unsigned char *src, int src_stride, int src_step,
+                     unsigned char *dst, int dst_stride, int dst_step,
+                     int threshold, t_skinlut_moments *moments)
+{
+  double m00 = 0.0, m10 = 0.0, m01 = 0.0;
+  int count = 0;
+  int x, y;
+
+  for( y = 0; y < height; y++ ){
+    const unsigned char *s = src + y * src_stride;
+    unsigned char       *d = (dst) ? dst + y * dst_stride : NULL;
+    unsigned long long   row_m00 = 0, row_m10 = 0;
+
+    for( x = 0; x < width; x++, s += src_step ){
+      unsigned int p = skinlut_lookup(lut, s[0], s[1], s[2]);
+      if( threshold > 0 )
+        p = (p >= (unsigned int)threshold) ? 255 : 0;
+      count += (p != 0);
+      row_m00 += p;
+      row_m10 += (unsigned long long)p * x;
+      if( d ){
+        *d = (unsigned char)p;
+        d += dst_step;
+      }
+    }
+    m00 += (double)row_m00;
+    m10 += (double)row_m10;
+    m01 += (double)row_m00 * y;
+  }
+
+  if( moments ){
+    // normalise so that a fully certain skin pixel weights 1
+    moments->m00 = m00 / 255.0;
+    moments->m10 = m10 / 255.0;
+    moments->m01 = m01 / 255.0;
+  }
+  return count;
+}
+
+int skinlut_center_of_mass(const t_skinlut_moments *moments, float *x, float *y)
+{
+  if( moments->m00 <= 0.1 )
+    return 0;
+  *x = (float)(moments->m10 / moments->m00);
+  *y = (float)(moments->m01 / moments->m00);
+  return 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+int skinlut_model_publish(t_skinlut_model *model)
+{
+  if( (int)model->ny * model->nu * model->nv > SKINLUT_MODEL_MAXBINS ||
+      !model->ny || !model->nu || !model->nv )
+    return 0;
+
+  g_static_mutex_lock(&skinlut_model_lock);
+  model->version = skinlut_model_shared.version + 1;
+  memcpy(&skinlut_model_shared, model, sizeof(t_skinlut_model));
+  g_static_mutex_unlock(&skinlut_model_lock);
+  return 1;
+}
+
+int skinlut_model_fetch(t_skinlut_model *model)
+{
+  int updated = 0;
+
+  g_static_mutex_lock(&skinlut_model_lock);
+  if( skinlut_model_shared.version != model->version ){
+    memcpy(model, &skinlut_model_shared, sizeof(t_skinlut_model));
+    updated = 1;
+  }
+  g_static_mutex_unlock(&skinlut_model_lock);
+  return updated;
+}
+
+// probability of a YUV colour in the model grid, 0 outside
+static unsigned char skinlut_model_score(const t_skinlut_model *m, int y, int u, int v)
+{
+  if( y < m->ymin || y >= m->ymax || u < m->umin || u >= m->umax || v < m->vmin || v >= m->vmax )
+    return 0;
+  int iy = ((y - m->ymin) * m->ny) / (m->ymax - m->ymin);
+  int iu = ((u - m->umin) * m->nu) / (m->umax - m->umin);
+  int iv = ((v - m->vmin) * m->nv) / (m->vmax - m->vmin);
+  return m->prob[ (iy * m->nu + iu) * m->nv + iv ];
+}
+
+int skinlut_learn(t_skinlut *lut, const t_skinlut_model *model, float rate, int max_entries)
+{
+  const int binw = 256 / SKINLUT_LEVELS;
+  const int mask = SKINLUT_LEVELS - 1;
+  int n, k;
+
+  if( !model->version )
+    return 0;
+  if( !lut->acc ){
+    lut->acc = (float*)malloc(SKINLUT_ENTRIES * sizeof(float));
+    if( !lut->acc )
+      return 0;
+    for( k = 0; k < SKINLUT_ENTRIES; k++ )
+      lut->acc[k] = lut->table[k];
+  }
+  if( max_entries > SKINLUT_ENTRIES )
+    max_entries = SKINLUT_ENTRIES;
+
+  for( n = 0, k = lut->cursor; n < max_entries; n++, k = (k + 1) & (SKINLUT_ENTRIES - 1) ){
+    int r, g, b, y, u, v;
+    // bin centre, back to RGB and into the YUV of the model (OpenCV CV_RGB2YUV)
+    skinlut_to_rgb(lut->input,
+                   ((k >> (2 * SKINLUT_BITS)) & mask) * binw + binw / 2,
+                   ((k >> SKINLUT_BITS) & mask) * binw + binw / 2,
+                   (k & mask) * binw + binw / 2, &r, &g, &b);
+    float fy = 0.299f * r + 0.587f * g + 0.114f * b;
+    y = (int)(fy + 0.5f);
+    u = (int)(0.492f * (b - fy) + 128.5f);
+    v = (int)(0.877f * (r - fy) + 128.5f);
+    u = (u < 0) ? 0 : (u > 255) ? 255 : u;
+    v = (v < 0) ? 0 : (v > 255) ? 255 : v;
+
+    lut->acc[k] += rate * ((float)skinlut_model_score(model, y, u, v) - lut->acc[k]);
+    lut->table[k] = (unsigned char)(lut->acc[k] + 0.5f);
+  }
+  lut->cursor = k;
+  lut->model_version = model->version;
+  return n;
+}
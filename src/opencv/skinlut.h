@@ -0,0 +1,108 @@
+#ifndef __SKINLUT_H__
+#define __SKINLUT_H__
+
+//////////////////////////////////////////////////////////////////////////////
+/// Skin colour classifier based on a 3D colour look up table.
+///
+/// The colour space is quantised to SKINLUT_LEVELS^3 bins, each one holding a
+/// skin probability [0..255] precomputed once from the classic HSV or
+/// normalised-RGB thresholds. Classifying a frame is then one table lookup per
+/// pixel straight on the packed input (RGB/BGR/YUV, any pixel stride), and the
+/// centre of mass of the skin pixels is accumulated in the same pass.
+/// Used by the skin and gcs elements and by the facetracker skin fallback.
+//////////////////////////////////////////////////////////////////////////////
+
+#define SKINLUT_BITS      5                       // 32x32x32 bins, 32KB table
+#define SKINLUT_LEVELS    (1 << SKINLUT_BITS)
+#define SKINLUT_ENTRIES   (SKINLUT_LEVELS * SKINLUT_LEVELS * SKINLUT_LEVELS)
+
+// same numbering as the "method" property of the skin element
+#define SKINLUT_METHOD_HSV   0
+#define SKINLUT_METHOD_RGB   1
+
+// memory order of the three colour bytes of the input pixels
+#define SKINLUT_INPUT_RGB    0
+#define SKINLUT_INPUT_BGR    1
+#define SKINLUT_INPUT_YUV    2
+
+typedef struct {
+  // HSV method, OpenCV 8 bit ranges (H in [0..180]): h_low < H < h_high, S > s_low, V > v_low
+  int   h_low, h_high, s_low, v_low;
+  // RGB method: R > r_low, rn_low < R/(R+G+B) < rn_high, gn_low < G/(R+G+B) < gn_high
+  int   r_low;
+  float rn_low, rn_high, gn_low, gn_high;
+} t_skinlut_params;
+
+typedef struct {
+  double m00, m10, m01;       // zeroth and first order moments of the skin mask
+} t_skinlut_moments;
+
+typedef struct {
+  unsigned char    table[SKINLUT_ENTRIES];
+  int              method;
+  int              input;
+  t_skinlut_params params;
+  // online learning state, see skinlut_learn()
+  float*           acc;              // high precision copy of table, NULL until learning
+  int              cursor;           // next entry to be refreshed
+  unsigned int     model_version;    // version of the model last learnt from
+} t_skinlut;
+
+//////////////////////////////////////////////////////////////////////////////
+/// Skin colour model learned online (e.g. the facetracker colour bins): a
+/// probability per bin of a regular YUV grid, Y-major, [min,max) per channel,
+/// anything outside the grid is not skin. It is published process wide so that
+/// every skin consumer can adapt its own table to it.
+#define SKINLUT_MODEL_MAXBINS   4096
+#define SKINLUT_LEARN_RATE      0.05f    // exponential forgetting factor per refresh
+#define SKINLUT_LEARN_BUDGET    4096     // table entries refreshed per frame (1/8 of it)
+
+typedef struct {
+  unsigned char ymin, ymax, umin, umax, vmin, vmax;
+  unsigned char ny, nu, nv;
+  unsigned char prob[SKINLUT_MODEL_MAXBINS];
+  unsigned int  version;                 // 0 == nothing learned yet
+} t_skinlut_model;
+
+
+void       skinlut_default_params(int method, t_skinlut_params *params);
+t_skinlut* skinlut_create(int method, int input, const t_skinlut_params *params);
+void       skinlut_destroy(t_skinlut *lut);
+void       skinlut_rebuild(t_skinlut *lut, int method, const t_skinlut_params *params);
+int        skinlut_params_equal(const t_skinlut_params *a, const t_skinlut_params *b);
+
+static inline unsigned char skinlut_lookup(const t_skinlut *lut, unsigned char c0,
+                                           unsigned char c1, unsigned char c2)
+{
+  return lut->table[ ((c0 >> (8 - SKINLUT_BITS)) << (2 * SKINLUT_BITS)) |
+                     ((c1 >> (8 - SKINLUT_BITS)) << SKINLUT_BITS) |
+                      (c2 >> (8 - SKINLUT_BITS)) ];
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function skinlut_classify
+/// \param[in]  src, src_stride, src_step: packed input, bytes per row and per pixel
+/// \param[out] dst, dst_stride, dst_step: mask output (may point at the alpha
+///             byte of an RGBA buffer with dst_step 4), can be NULL
+/// \param[in]  threshold: if > 0, the output is binary (probability >= threshold
+///             -> 255), otherwise the probability itself is written
+/// \param[out] moments: if not NULL, moments of the output mask
+/// \return amount of pixels classified as skin (probability >= threshold, or > 0)
+int skinlut_classify(const t_skinlut *lut, int width, int height,
+                     const unsigned char *src, int src_stride, int src_step,
+                     unsigned char *dst, int dst_stride, int dst_step,
+                     int threshold, t_skinlut_moments *moments);
+
+/// returns 1 and fills in x,y if the moments have any mass, 0 otherwise
+int skinlut_center_of_mass(const t_skinlut_moments *moments, float *x, float *y);
+
+/// make a model the current process wide learned skin model (copied)
+int  skinlut_model_publish(t_skinlut_model *model);
+/// copy the process wide model into model if it is newer, returns 1 if so
+int  skinlut_model_fetch(t_skinlut_model *model);
+/// move up to max_entries of the table towards the model, by rate, resuming
+/// where the previous call stopped, so a whole table refresh is spread over
+/// several frames. Returns the amount of entries refreshed.
+int  skinlut_learn(t_skinlut *lut, const t_skinlut_model *model, float rate, int max_entries);
+
+#endif // __SKINLUT_H__
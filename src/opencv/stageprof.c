@@ -0,0 +1,220 @@
+
+#include "stageprof.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const gchar *stageprof_names[STAGEPROF_STAGES] =
+  { "convert", "detect", "track", "morphology", "draw", "frame" };
+
+
+//////////////////////////////////////////////////////////////////////////////
+t_stageprof* stageprof_create(gint interval_ms)
+{
+  t_stageprof *p = (t_stageprof*)calloc(1, sizeof(t_stageprof));
+  if( !p )
+    return NULL;
+  g_static_mutex_init(&p->lock);
+  p->interval_ms  = (interval_ms > 0) ? interval_ms : STAGEPROF_DEFAULT_INTERVAL;
+  p->window_start = stageprof_now();
+  return p;
+}
+
+void stageprof_destroy(t_stageprof *p)
+{
+  if( !p )
+    return;
+  g_static_mutex_free(&p->lock);
+  free(p);
+}
+
+void stageprof_set_interval(t_stageprof *p, gint interval_ms)
+{
+  if( p && interval_ms > 0 )
+    p->interval_ms = interval_ms;
+}
+
+const gchar* stageprof_stage_name(gint stage)
+{
+  return (stage >= 0 && stage < STAGEPROF_STAGES) ? stageprof_names[stage] : "unknown";
+}
+
+guint64 stageprof_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (guint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// bins: 1 us wide below 4 us, then 4 per octave
+static inline gint stageprof_bin(gint us)
+{
+  if( us < 4 )
+    return us;
+  const gint o = g_bit_nth_msf((gulong)us, -1);
+  return 4 + (o - 2) * 4 + ((us >> (o - 2)) & 3);
+}
+
+static guint64 stageprof_bin_low(gint b)
+{
+  if( b < 4 )
+    return b;
+  const gint o = (b - 4) / 4 + 2;
+  return (guint64)(4 + (b - 4) % 4) << (o - 2);
+}
+
+static void stageprof_atomic_max(volatile gint *x, gint v)
+{
+  gint old;
+  while( v > (old = g_atomic_int_get(x)) )
+    if( g_atomic_int_compare_and_exchange(x, old, v) )
+      break;
+}
+
+static gint stageprof_atomic_take(volatile gint *x)
+{
+  gint old;
+  do
+    old = g_atomic_int_get(x);
+  while( !g_atomic_int_compare_and_exchange(x, old, 0) );
+  return old;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+guint64 stageprof_start(t_stageprof *p)
+{
+  return p ? stageprof_now() : 0;
+}
+
+guint64 stageprof_stop(t_stageprof *p, gint stage, guint64 t0)
+{
+  if( !p || stage < 0 || stage >= STAGEPROF_STAGES )
+    return 0;
+  const guint64 d = stageprof_now() - t0;
+  const gint us = (d > G_MAXINT) ? G_MAXINT : (gint)d;
+  t_stageprof_stage *s = &p->stage[stage];
+
+  g_atomic_int_add(&s->count, 1);
+  g_atomic_int_add(&s->sum_us, us);
+  g_atomic_int_add(&s->hist[stageprof_bin(us)], 1);
+  stageprof_atomic_max(&s->max_us, us);
+  return d;
+}
+
+guint64 stageprof_frame_start(t_stageprof *p)
+{
+  return stageprof_start(p);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// value of the bin holding rank of the histogram, middle of the bin
+static gdouble stageprof_percentile(const gint *hist, gint total, gdouble q, gint max_us)
+{
+  const gint rank = MAX(1, (gint)(q * total + 0.5));
+  gint b, n = 0;
+  for( b = 0; b < STAGEPROF_BINS; b++ ){
+    if( (n += hist[b]) < rank )
+      continue;
+    const gdouble mid = 0.5 * (stageprof_bin_low(b) + stageprof_bin_low(b + 1));
+    return MIN(mid, (gdouble)max_us) / 1000.0;
+  }
+  return max_us / 1000.0;
+}
+
+static void stageprof_summarise(t_stageprof_stage *s, t_stageprof_summary *sum)
+{
+  gint hist[STAGEPROF_BINS];
+  gint b, total = 0;
+
+  sum->count = stageprof_atomic_take(&s->count);
+  const gint sum_us = stageprof_atomic_take(&s->sum_us);
+  const gint max_us = stageprof_atomic_take(&s->max_us);
+  for( b = 0; b < STAGEPROF_BINS; b++ )
+    total += (hist[b] = stageprof_atomic_take(&s->hist[b]));
+
+  if( sum->count <= 0 || total <= 0 ){
+    memset(sum, 0, sizeof(t_stageprof_summary));
+    return;
+  }
+  sum->mean = sum_us / 1000.0 / sum->count;
+  sum->p50  = stageprof_percentile(hist, total, 0.50, max_us);
+  sum->p95  = stageprof_percentile(hist, total, 0.95, max_us);
+  sum->max  = max_us / 1000.0;
+}
+
+gboolean stageprof_frame_end(t_stageprof *p, guint64 t0)
+{
+  gint i;
+
+  if( !p )
+    return FALSE;
+  stageprof_stop(p, STAGEPROF_FRAME, t0);
+
+  const guint64 now = stageprof_now();
+  if( now - p->window_start < (guint64)p->interval_ms * 1000 )
+    return FALSE;
+
+  g_static_mutex_lock(&p->lock);
+  for( i = 0; i < STAGEPROF_STAGES; i++ )
+    stageprof_summarise(&p->stage[i], &p->snapshot[i]);
+  p->fps   = p->snapshot[STAGEPROF_FRAME].count * 1e6 / (now - p->window_start);
+  p->valid = TRUE;
+  p->window_start = now;
+  g_static_mutex_unlock(&p->lock);
+  return TRUE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+gchar* stageprof_print(t_stageprof *p, gchar *buf, gsize size)
+{
+  gsize n;
+  gint  i;
+
+  if( !p || !p->valid ){
+    g_strlcpy(buf, "NA", size);
+    return buf;
+  }
+  g_static_mutex_lock(&p->lock);
+  n = g_snprintf(buf, size, "fps %.2f", p->fps);
+  for( i = 0; i < STAGEPROF_STAGES && n < size; i++ ){
+    const t_stageprof_summary *s = &p->snapshot[i];
+    if( !s->count )
+      continue;
+    n += g_snprintf(buf + n, size - n, " | %s n=%d mean=%.2f p50=%.2f p95=%.2f max=%.2f ms",
+                    stageprof_names[i], s->count, s->mean, s->p50, s->p95, s->max);
+  }
+  g_static_mutex_unlock(&p->lock);
+  return buf;
+}
+
+GstMessage* stageprof_message(t_stageprof *p, GstObject *src)
+{
+  GstStructure *st;
+  gchar field[32];
+  gint  i;
+
+  if( !p || !p->valid )
+    return NULL;
+  g_static_mutex_lock(&p->lock);
+  st = gst_structure_new("stageprof",
+                         "frames", G_TYPE_INT,    p->snapshot[STAGEPROF_FRAME].count,
+                         "fps",    G_TYPE_DOUBLE, p->fps, NULL);
+  for( i = 0; i < STAGEPROF_STAGES; i++ ){
+    const t_stageprof_summary *s = &p->snapshot[i];
+    if( !s->count )
+      continue;
+    g_snprintf(field, sizeof(field), "%s-count", stageprof_names[i]);
+    gst_structure_set(st, field, G_TYPE_INT, s->count, NULL);
+    g_snprintf(field, sizeof(field), "%s-mean", stageprof_names[i]);
+    gst_structure_set(st, field, G_TYPE_DOUBLE, s->mean, NULL);
+    g_snprintf(field, sizeof(field), "%s-p50", stageprof_names[i]);
+    gst_structure_set(st, field, G_TYPE_DOUBLE, s->p50, NULL);
+    g_snprintf(field, sizeof(field), "%s-p95", stageprof_names[i]);
+    gst_structure_set(st, field, G_TYPE_DOUBLE, s->p95, NULL);
+    g_snprintf(field, sizeof(field), "%s-max", stageprof_names[i]);
+    gst_structure_set(st, field, G_TYPE_DOUBLE, s->max, NULL);
+  }
+  g_static_mutex_unlock(&p->lock);
+  return gst_message_new_element(src, st);
+}
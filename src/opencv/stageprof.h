@@ -0,0 +1,108 @@
+#ifndef __STAGEPROF_H__
+#define __STAGEPROF_H__
+
+#include <gst/gst.h>
+
+//////////////////////////////////////////////////////////////////////////////
+/// Per stage timings of the processing of a frame, shared by the elements.
+///
+/// An element owns a t_stageprof and brackets the stages of its transform
+/// with stageprof_start()/stageprof_stop(), and the whole frame with
+/// stageprof_frame_start()/stageprof_frame_end(). A stage adds its duration to
+/// a histogram of log scale bins (4 per octave of microseconds, so a
+/// percentile is within ~12%) with atomic increments only: the stages can be
+/// timed from the streaming thread and from a worker thread at the same time,
+/// without a lock and without allocating. A stage run several times in a frame
+/// (once per face, say) counts every run. Once per interval the frame that
+/// ends it takes and clears the histograms and summarises them (count, mean,
+/// median, 95th percentile and maximum) into a snapshot, the only part under a
+/// mutex, that the "stats" property of the element prints and that
+/// stageprof_message() turns into a bus message. Every function accepts a NULL
+/// profiler and then does nothing. Used by the facetracker, facetracker3 and
+/// morphology elements.
+//////////////////////////////////////////////////////////////////////////////
+
+enum {
+  STAGEPROF_CONVERT = 0,   // colour conversion of the input
+  STAGEPROF_DETECT,        // object detection
+  STAGEPROF_TRACK,         // tracking, colour model and Kalman
+  STAGEPROF_MORPH,         // morphology operators
+  STAGEPROF_DRAW,          // overlays on the output
+  STAGEPROF_FRAME,         // whole transform of a frame
+  STAGEPROF_STAGES
+};
+
+#define STAGEPROF_BINS              120      // up to 2^31 us
+#define STAGEPROF_DEFAULT_INTERVAL  1000     // ms
+
+
+typedef struct {
+  volatile gint count;
+  volatile gint sum_us;
+  volatile gint max_us;
+  volatile gint hist[STAGEPROF_BINS];
+} t_stageprof_stage;
+
+// summary of a stage over the last interval, times in ms
+typedef struct {
+  gint    count;
+  gdouble mean, p50, p95, max;
+} t_stageprof_summary;
+
+typedef struct {
+  t_stageprof_stage    stage[STAGEPROF_STAGES];
+  gint                 interval_ms;
+  guint64              window_start;     // us
+
+  GStaticMutex         lock;             // of the snapshot
+  t_stageprof_summary  snapshot[STAGEPROF_STAGES];
+  gdouble              fps;
+  gboolean             valid;            // one interval elapsed
+} t_stageprof;
+
+
+t_stageprof* stageprof_create(gint interval_ms);
+void         stageprof_destroy(t_stageprof *p);
+void         stageprof_set_interval(t_stageprof *p, gint interval_ms);
+
+/// monotonic clock, in us
+guint64      stageprof_now(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function stageprof_start
+/// \return the start time of a stage, to be passed to stageprof_stop()
+guint64      stageprof_start(t_stageprof *p);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function stageprof_stop
+/// Adds the time since t0 to the stage.
+/// \return that time in us, to leave it out of an enclosing stage by moving
+///         its t0 forward, 0 without profiler
+guint64      stageprof_stop(t_stageprof *p, gint stage, guint64 t0);
+
+guint64      stageprof_frame_start(t_stageprof *p);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function stageprof_frame_end
+/// Times the frame as STAGEPROF_FRAME and, if the interval elapsed, refreshes
+/// the snapshot from the histograms and clears them.
+/// \return TRUE if the snapshot was refreshed by this call
+gboolean     stageprof_frame_end(t_stageprof *p, guint64 t0);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function stageprof_print
+/// Writes the snapshot as text into buf, "NA" before the first interval.
+/// \return buf
+gchar*       stageprof_print(t_stageprof *p, gchar *buf, gsize size);
+
+//////////////////////////////////////////////////////////////////////////////
+/// \function stageprof_message
+/// Element message "stageprof" of src with the snapshot: "frames" and "fps",
+/// and for every stage run in the interval "<stage>-count", "<stage>-mean",
+/// "<stage>-p50", "<stage>-p95" and "<stage>-max" (ms), e.g. "detect-p95".
+/// \return the message, to be posted by the caller, NULL if no snapshot
+GstMessage*  stageprof_message(t_stageprof *p, GstObject *src);
+
+const gchar* stageprof_stage_name(gint stage);
+
+#endif // __STAGEPROF_H__
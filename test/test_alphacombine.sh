@@ -0,0 +1,36 @@
+#!/bin/sh
+
+GST_DEBUG=2 
+
+if [ $# -eq 0 ]; then FILE=/apps/devnfs/test_videos/chroma_new/green02.flv; else FILE=$1; fi
+
+CMD="gst-launch \
+\
+filesrc location=$FILE ! \
+queue ! \
+flvdemux ! ffdec_flv ! queue ! tee name=t0 \
+t0. ! textoverlay text=\"original sequence\" halignment=0 valignment=2 shaded-background=true ! \
+ ffmpegcolorspace2 ! vm.sink_1 \
+\
+t0. ! ffmpegcolorspace2 ! \
+vibe ! ffmpegcolorspace2 ! queue ! ac.sink_0 \
+\
+t0. ! ffmpegcolorspace2 ! \
+codebookfgbg display=false posterize=true experimental=true ! ffmpegcolorspace2 ! queue ! ac.sink_1 \
+\
+t0. ! ffmpegcolorspace2 ! \
+skin display=false ! ffmpegcolorspace2 ! queue ! ac.sink_2 \
+\
+alphacombine name=ac mode=2 weights=\"2,1,1\" ! queue ! \
+textoverlay text=\"combined alpha (vibe+codebook+skin)\" halignment=0 valignment=2 shaded-background=true ! \
+ffmpegcolorspace2 ! vm.sink_2 \
+\
+ videotestsrc is-live=true pattern=2  ! video/x-raw-yuv, framerate=30/1, width=640, height=240 ! ffmpegcolorspace ! video/x-raw-rgb ! vm.sink_0 \
+vmix name=vm \
+sink_0::zorder=0 \
+sink_1::zorder=1 sink_1::width=320 sink_1::height=240 sink_1::xpos=0   sink_1::ypos=0 \
+sink_2::zorder=2 sink_2::width=320 sink_2::height=240 sink_2::xpos=320 sink_2::ypos=0 \
+! ffmpegcolorspace ! ximagesink  sync=false"
+
+echo $CMD
+$CMD
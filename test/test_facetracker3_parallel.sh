@@ -0,0 +1,21 @@
+#!/bin/sh
+
+# frontal, profile (both sides) and torso cascades evaluated concurrently,
+# the per cascade time is in the cascade-timing property
+#interesting videos: looking left (/apps/devnfs/test_videos/chroma_new/green10.flv)
+# and looking right (/apps/devnfs/test_videos/chroma_new/green03.flv)
+
+if [ $# -ne 1 ]; then FILE=/apps/devnfs/test_videos/chroma_new/green10.flv; else FILE=$1; fi
+
+CMD="gst-launch --gst-debug=facetracker3:2         \
+filesrc location=$FILE ! \
+flvdemux ! ffdec_flv ! identity sync=true ! ffmpegcolorspace2 ! \
+facetracker3 display=true parallel=true cascade-threads=4 \
+  profile=./cascades/haarcascade_frontalface_default.xml \
+  profile2=./cascades/HS.xml    \
+  profile3=./cascades/haarcascade_profileface.xml ! \
+ffmpegcolorspace2 ! fpsdisplaysink sync=false"
+
+
+echo $CMD
+$CMD
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Haar detection on a worker thread, at most 5 detections per second: the
+# output keeps the input framerate, the frames in between are tracked on colour
+# and the boxes are blue only on the frames a detection was merged on.
+
+if [ $# -ne 1 ]; then FILE=/apps/devnfs/test_videos/chroma_new/green02.flv; else FILE=$1; fi
+
+CMD="gst-launch --gst-debug=facetracker:2 \
+filesrc location=$FILE ! \
+decodebin2 ! identity sync=true ! ffmpegcolorspace2 ! \
+facetracker display=true profile=./cascades/haar.txt async=true setfps=5 ! \
+ffmpegcolorspace2 ! fpsdisplaysink sync=false"
+
+
+echo $CMD
+$CMD
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Crowded scenes: every Haar pass keeps at most max-candidates detections in
+# the buffer of the classifier, the ones beyond are dropped instead of
+# overflowing it. Several faces are tracked to use them.
+
+if [ $# -ne 1 ]; then FILE=/apps/devnfs/test_videos/chroma_new/green02.flv; else FILE=$1; fi
+
+CMD="gst-launch --gst-debug=facetracker:3 \
+filesrc location=$FILE ! \
+decodebin2 ! ffmpegcolorspace2 ! \
+facetracker display=true profile=./cascades/haar.txt max-candidates=256 max-faces=8 ! \
+ffmpegcolorspace2 ! xvimagesink"
+
+
+echo $CMD
+$CMD
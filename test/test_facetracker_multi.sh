@@ -0,0 +1,16 @@
+#!/bin/sh
+# Up to 4 faces tracked by one facetracker on one Haar detection pass per
+# frame: every face gets its own box and its own facelocation event, with an
+# "id" that stays with it until it is missed on 5 detections in a row.
+
+if [ $# -ne 1 ]; then FILE=/apps/devnfs/test_videos/chroma_new/green02.flv; else FILE=$1; fi
+
+CMD="gst-launch --gst-debug=facetracker:5 \
+filesrc location=$FILE ! \
+decodebin2 ! ffmpegcolorspace2 ! \
+facetracker display=true profile=./cascades/haar.txt max-faces=4 track-misses=5 ! \
+ffmpegcolorspace2 ! xvimagesink"
+
+
+echo $CMD
+$CMD
@@ -0,0 +1,20 @@
+#!/bin/sh
+
+# Per-frame cost of the objecttracker over a long synthetic run: objecttracker
+# reports the mean ms/frame and the NN template count every 1000 frames.
+# With the default budget both level off, with maxtemplates=0 (unbounded) they
+# keep growing. Usage: test_objecttracker_budget.sh [maxtemplates] [hours]
+
+if [ $# -ge 1 ]; then MAXTEMPLATES=$1; else MAXTEMPLATES=200; fi
+if [ $# -ge 2 ]; then HOURS=$2; else HOURS=3; fi
+FRAMES=$(( $HOURS * 3600 * 30 ))
+
+CMD="gst-launch --gst-debug=objecttracker:4 \
+\
+videotestsrc pattern=18 num-buffers=$FRAMES ! video/x-raw-yuv, framerate=30/1, width=320, height=240 ! \
+ffmpegcolorspace ! video/x-raw-rgb ! \
+objecttracker x=130 y=90 width=60 height=60 maxtemplates=$MAXTEMPLATES ! \
+fakesink sync=false"
+
+echo $CMD
+$CMD 2>&1 | grep "ms/frame"
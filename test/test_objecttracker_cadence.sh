@@ -0,0 +1,20 @@
+#!/bin/sh
+
+# objecttracker with the detector decoupled from the tracker: the median flow
+# tracker runs on every frame, the detector every 10th frame or as soon as the
+# tracker confidence drops below 0.6, on a worker thread. Compare the ms/frame
+# reported every 1000 frames with detectinterval=1 (detector on every frame).
+# Usage: test_objecttracker_cadence.sh [detectinterval] [detectthread]
+
+if [ $# -ge 1 ]; then INTERVAL=$1; else INTERVAL=10; fi
+if [ $# -ge 2 ]; then THREAD=$2; else THREAD=true; fi
+
+CMD="gst-launch --gst-debug=objecttracker:4 \
+\
+videotestsrc pattern=18 num-buffers=10000 ! video/x-raw-yuv, framerate=30/1, width=320, height=240 ! \
+ffmpegcolorspace ! video/x-raw-rgb ! \
+objecttracker x=130 y=90 width=60 height=60 detectinterval=$INTERVAL detectthreshold=0.6 detectthread=$THREAD ! \
+fakesink sync=false"
+
+echo $CMD
+$CMD 2>&1 | grep "ms/frame"
@@ -0,0 +1,17 @@
+#!/bin/sh
+
+# Several objects tracked by one objecttracker: the boxes in "targets" get ids
+# 0, 1, ... and each of them is drawn and reported in its own objectlocation
+# event, carrying its "id". The grey and integral images are computed once per
+# frame for all of them, so the cost per extra object is the tracker and the
+# detector scan only.
+
+CMD="gst-launch --gst-debug=objecttracker:4 \
+\
+videotestsrc pattern=18 ! video/x-raw-yuv, framerate=30/1, width=320, height=240 ! \
+ffmpegcolorspace ! video/x-raw-rgb ! \
+objecttracker targets=130,90,60,60;20,20,40,40;250,170,50,50 displayBB=true ! \
+ffmpegcolorspace ! xvimagesink"
+
+echo $CMD
+$CMD
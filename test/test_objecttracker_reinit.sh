@@ -0,0 +1,21 @@
+#!/bin/sh
+
+# objecttracker selecting its object again and again while running: the first
+# tracker sends an objectlocation event per frame, on which the second one
+# selects the object anew, so its detector is released and initialised on
+# every frame. With a model file, the second tracker starts from it and loads
+# it again on each event. It must run to the end of the stream without crash.
+# Usage: test_objecttracker_reinit.sh [model]
+
+if [ $# -ge 1 ]; then MODEL="model=$1"; else MODEL=""; fi
+
+CMD="gst-launch --gst-debug=objecttracker:3 \
+\
+videotestsrc pattern=18 num-buffers=300 ! video/x-raw-yuv, framerate=30/1, width=320, height=240 ! \
+ffmpegcolorspace ! video/x-raw-rgb ! \
+objecttracker x=130 y=90 width=60 height=60 ! \
+objecttracker $MODEL ! \
+fakesink sync=false"
+
+echo $CMD
+if $CMD; then echo "PASS"; else echo "FAIL"; exit 1; fi
@@ -0,0 +1,18 @@
+#!/bin/sh
+# Per stage timings: facetracker and morphology post a "stageprof" element
+# message every second with the count, mean, p50, p95 and max milliseconds of
+# their detection, tracking, morphology and drawing stages; -m prints them.
+
+if [ $# -ne 1 ]; then FILE=/apps/devnfs/test_videos/chroma_new/green02.flv; else FILE=$1; fi
+
+CMD="gst-launch -m \
+filesrc location=$FILE ! \
+decodebin2 ! ffmpegcolorspace2 ! \
+facetracker display=true profile=./cascades/haar.txt stats-interval=1000 stats-messages=true ! \
+ffmpegcolorspace2 ! video/x-raw-rgb ! \
+morphology iters=3 operator=2 stats-interval=1000 stats-messages=true ! \
+ffmpegcolorspace2 ! xvimagesink"
+
+
+echo $CMD
+$CMD